@@ -91,6 +91,9 @@ static void facerec_training()
 
     deepconvnet_set_dropouts(&convnet, 0.0f);
 
+    /* one output per person */
+    deepconvnet_set_output_activation(&convnet, BP_OUTPUT_SOFTMAX);
+
     convnet.history.interval = 800;
 
     deeplearn_set_title(&learner, TITLE);
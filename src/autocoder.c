@@ -29,6 +29,26 @@
 
 #include "autocoder.h"
 
+/* arguments of the parallel loops over the units of an autocoder */
+typedef struct {
+    ac * autocoder;
+    float * values;
+    unsigned char use_dropouts;
+    float learning_rate;
+} ac_loop;
+
+/**
+ * @brief Frees a partially initialised autocoder when an allocation fails
+ * @param autocoder Autocoder object
+ * @param retval The error to return
+ * @returns retval
+ */
+static int autocoder_init_failed(ac * autocoder, int retval)
+{
+    autocoder_free(autocoder);
+    return retval;
+}
+
 /**
  * @brief Initialise an autocoder
  * @param autocoder Autocoder object
@@ -45,37 +65,56 @@ int autocoder_init(ac * autocoder,
     autocoder->no_of_inputs = no_of_inputs;
     autocoder->no_of_hiddens = no_of_hiddens;
 
+    /* nothing allocated yet, so that autocoder_free can clean up
+       if any of the allocations below fail */
+    autocoder->inputs = 0;
+    autocoder->hiddens = 0;
+    autocoder->bias = 0;
+    autocoder->weights = 0;
+    autocoder->last_weight_change = 0;
+    autocoder->outputs = 0;
+    autocoder->bperr = 0;
+    autocoder->last_bias_change = 0;
+    autocoder->memory = 0;
+
+    if (deeplearn_memory_reserve(
+            autocoder_estimate_memory(no_of_inputs, no_of_hiddens)) != 0)
+        return -9;
+
+    autocoder->memory = autocoder_estimate_memory(no_of_inputs,
+                                                  no_of_hiddens);
+
     FLOATALLOC(autocoder->inputs, no_of_inputs);
     if (!autocoder->inputs)
-        return -1;
+        return autocoder_init_failed(autocoder, -1);
 
     FLOATALLOC(autocoder->hiddens, no_of_hiddens);
     if (!autocoder->hiddens)
-        return -2;
+        return autocoder_init_failed(autocoder, -2);
 
     FLOATALLOC(autocoder->bias, no_of_hiddens);
     if (!autocoder->bias)
-        return -3;
+        return autocoder_init_failed(autocoder, -3);
 
     FLOATALLOC(autocoder->weights, no_of_hiddens*no_of_inputs);
     if (!autocoder->weights)
-        return -4;
+        return autocoder_init_failed(autocoder, -4);
 
     FLOATALLOC(autocoder->last_weight_change, no_of_hiddens*no_of_inputs);
     if (!autocoder->last_weight_change)
-        return -5;
+        return autocoder_init_failed(autocoder, -5);
 
     FLOATALLOC(autocoder->outputs, no_of_inputs);
     if (!autocoder->outputs)
-        return -6;
+        return autocoder_init_failed(autocoder, -6);
 
     FLOATALLOC(autocoder->bperr, no_of_hiddens);
     if (!autocoder->bperr)
-        return -7;
+        return autocoder_init_failed(autocoder, -7);
 
     FLOATALLOC(autocoder->last_bias_change, no_of_hiddens);
     if (!autocoder->last_bias_change)
-        return -8;
+        return autocoder_init_failed(autocoder, -8);
 
     FLOATCLEAR(autocoder->inputs, no_of_inputs);
     FLOATCLEAR(autocoder->outputs, no_of_inputs);
@@ -116,22 +155,60 @@ void autocoder_free(ac * autocoder)
     free(autocoder->last_weight_change);
     free(autocoder->bperr);
     free(autocoder->last_bias_change);
+    autocoder->inputs = 0;
+    autocoder->outputs = 0;
+    autocoder->hiddens = 0;
+    autocoder->bias = 0;
+    autocoder->weights = 0;
+    autocoder->last_weight_change = 0;
+    autocoder->bperr = 0;
+    autocoder->last_bias_change = 0;
+
+    deeplearn_memory_release(autocoder->memory);
+    autocoder->memory = 0;
 }
 
 /**
- * @brief Encodes the inputs to a given array
+ * @brief Returns the number of bytes which will be allocated by
+ *        autocoder_init, not including the autocoder object itself
+ * @param no_of_inputs The number of inputs
+ * @param no_of_hiddens The number of hidden units
+ * @returns Number of bytes
+ */
+size_t autocoder_estimate_memory(int no_of_inputs, int no_of_hiddens)
+{
+    /* inputs and outputs, hiddens, biases, backprop errors and bias
+       changes, then weights and weight changes */
+    return (((size_t)no_of_inputs*2) + ((size_t)no_of_hiddens*4) +
+            ((size_t)no_of_inputs*no_of_hiddens*2))*sizeof(float);
+}
+
+/**
+ * @brief Returns the number of bytes currently allocated by an autocoder
  * @param autocoder Autocoder object
- * @param encoded Array to store the encoded values
- * @param use_dropouts If non-zero then allow dropouts in the returned results
+ * @returns Number of bytes
  */
-void autocoder_encode(ac * autocoder, float encoded[],
-                      unsigned char use_dropouts)
+size_t autocoder_get_memory(ac * autocoder)
+{
+    return autocoder->memory;
+}
+
+/**
+ * @brief Body of the parallel loop which encodes the inputs
+ * @param start Index of the first unit
+ * @param end Index after the last unit
+ * @param context Autocoder and loop arguments
+ */
+static void autocoder_encode_units(int start, int end, void * context)
 {
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
-    COUNTDOWN(h, autocoder->no_of_hiddens) {
+    ac_loop * args = (ac_loop*)context;
+    ac * autocoder = args->autocoder;
+    float * encoded = args->values;
+
+    for (int h = end-1; h >= start; h--) {
         unsigned int randseed = (unsigned int)h + autocoder->random_seed;
 
-        if (use_dropouts != 0) {
+        if (args->use_dropouts != 0) {
             if (rand_num(&randseed)%10000 <
                 autocoder->dropout_percent*100) {
                 autocoder->hiddens[h] = (int)AUTOCODER_DROPPED_OUT;
@@ -157,19 +234,37 @@ void autocoder_encode(ac * autocoder, float encoded[],
         /* activation function */
         encoded[h] = AF(adder);
     }
+}
+
+/**
+ * @brief Encodes the inputs to a given array
+ * @param autocoder Autocoder object
+ * @param encoded Array to store the encoded values
+ * @param use_dropouts If non-zero then allow dropouts in the returned results
+ */
+void autocoder_encode(ac * autocoder, float encoded[],
+                      unsigned char use_dropouts)
+{
+    ac_loop args = { autocoder, encoded, use_dropouts, 0 };
+    deeplearn_parallel_for(autocoder->no_of_hiddens,
+                           autocoder_encode_units, &args);
 
     rand_num(&autocoder->random_seed);
 }
 
 /**
- * @brief Decodes the encoded (hidden) units to a given output array
- * @param autocoder Autocoder object
- * @param decoded Array to store the decoded output values
+ * @brief Body of the parallel loop which decodes the hidden units
+ * @param start Index of the first unit
+ * @param end Index after the last unit
+ * @param context Autocoder and loop arguments
  */
-void autocoder_decode(ac * autocoder, float decoded[])
+static void autocoder_decode_units(int start, int end, void * context)
 {
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
-    COUNTDOWN(i, autocoder->no_of_inputs) {
+    ac_loop * args = (ac_loop*)context;
+    ac * autocoder = args->autocoder;
+    float * decoded = args->values;
+
+    for (int i = end-1; i >= start; i--) {
         /* weighted sum of hidden inputs */
         float adder = 0;
         float * w = &autocoder->weights[i];
@@ -191,6 +286,18 @@ void autocoder_decode(ac * autocoder, float decoded[])
         /* activation function */
         decoded[i] = AF(adder);
     }
+}
+
+/**
+ * @brief Decodes the encoded (hidden) units to a given output array
+ * @param autocoder Autocoder object
+ * @param decoded Array to store the decoded output values
+ */
+void autocoder_decode(ac * autocoder, float decoded[])
+{
+    ac_loop args = { autocoder, decoded, 0, 0 };
+    deeplearn_parallel_for(autocoder->no_of_inputs,
+                           autocoder_decode_units, &args);
 
     rand_num(&autocoder->random_seed);
 }
@@ -205,6 +312,35 @@ void autocoder_feed_forward(ac * autocoder)
     autocoder_decode(autocoder, autocoder->outputs);
 }
 
+/**
+ * @brief Body of the parallel loop which back propogates the error from
+ *        the outputs to each hidden unit. Each hidden unit sums over the
+ *        outputs, so that no two threads update the same unit.
+ * @param start Index of the first unit
+ * @param end Index after the last unit
+ * @param context Autocoder and loop arguments
+ */
+static void autocoder_backprop_hiddens(int start, int end, void * context)
+{
+    ac * autocoder = ((ac_loop*)context)->autocoder;
+
+    for (int h = end-1; h >= start; h--) {
+        if (autocoder->hiddens[h] == AUTOCODER_DROPPED_OUT)
+            continue;
+
+        float * w = &autocoder->weights[h*autocoder->no_of_inputs];
+        float bperr = 0;
+        COUNTDOWN(i, autocoder->no_of_inputs) {
+            float backprop_error =
+                autocoder->inputs[i] - autocoder->outputs[i];
+            float afact =
+                autocoder->outputs[i] * (1.0f - autocoder->outputs[i]);
+            bperr += backprop_error * afact * w[i];
+        }
+        autocoder->bperr[h] = bperr;
+    }
+}
+
 /**
  * @brief Back propogate the error
  * @param autocoder Autocoder object
@@ -217,21 +353,16 @@ void autocoder_backprop(ac * autocoder)
     /* backprop from outputs to hiddens */
     autocoder->backprop_error = 0;
     float error_percent = 0;
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
     COUNTDOWN(i, autocoder->no_of_inputs) {
         float backprop_error = autocoder->inputs[i] - autocoder->outputs[i];
         autocoder->backprop_error += fabs(backprop_error);
         error_percent += fabs(backprop_error);
-        float afact = autocoder->outputs[i] * (1.0f - autocoder->outputs[i]);
-        float bperr = backprop_error * afact;
-        float * w = &autocoder->weights[i];
-        int step = autocoder->no_of_inputs;
-        COUNTDOWN(h, autocoder->no_of_hiddens) {
-            if (autocoder->hiddens[h] != AUTOCODER_DROPPED_OUT)
-                autocoder->bperr[h] += bperr * w[h*step];
-        }
     }
 
+    ac_loop args = { autocoder, NULL, 0, 0 };
+    deeplearn_parallel_for(autocoder->no_of_hiddens,
+                           autocoder_backprop_hiddens, &args);
+
     /* convert summed error to an overall percentage */
     error_percent = error_percent * 100 /
         (NEURON_RANGE*autocoder->no_of_inputs);
@@ -256,16 +387,19 @@ void autocoder_backprop(ac * autocoder)
 }
 
 /**
- * @brief Adjusts weights and biases
- * @param autocoder Autocoder object
+ * @brief Body of the parallel loop which adjusts the weights
+ *        between the outputs and the hidden units
+ * @param start Index of the first unit
+ * @param end Index after the last unit
+ * @param context Autocoder and loop arguments
  */
-void autocoder_learn(ac * autocoder)
+static void autocoder_learn_outputs(int start, int end, void * context)
 {
-    /* weights between outputs and hiddens */
-    float e = autocoder->learning_rate / (1.0f + autocoder->no_of_hiddens);
+    ac_loop * args = (ac_loop*)context;
+    ac * autocoder = args->autocoder;
+    float e = args->learning_rate;
 
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
-    COUNTDOWN(i, autocoder->no_of_inputs) {
+    for (int i = end-1; i >= start; i--) {
         float afact = autocoder->outputs[i] * (1.0f - autocoder->outputs[i]);
         float backprop_error = autocoder->inputs[i] - autocoder->outputs[i];
         float gradient = afact * backprop_error;
@@ -281,12 +415,22 @@ void autocoder_learn(ac * autocoder)
             n -= step;
         }
     }
+}
 
-    /* weights between hiddens and inputs */
-    e = autocoder->learning_rate / (1.0f + autocoder->no_of_inputs);
+/**
+ * @brief Body of the parallel loop which adjusts the weights
+ *        between the hidden units and the inputs
+ * @param start Index of the first unit
+ * @param end Index after the last unit
+ * @param context Autocoder and loop arguments
+ */
+static void autocoder_learn_hiddens(int start, int end, void * context)
+{
+    ac_loop * args = (ac_loop*)context;
+    ac * autocoder = args->autocoder;
+    float e = args->learning_rate;
 
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
-    COUNTDOWN(h, autocoder->no_of_hiddens) {
+    for (int h = end-1; h >= start; h--) {
         if (autocoder->hiddens[h] == AUTOCODER_DROPPED_OUT)
             continue;
 
@@ -307,6 +451,27 @@ void autocoder_learn(ac * autocoder)
     }
 }
 
+/**
+ * @brief Adjusts weights and biases
+ * @param autocoder Autocoder object
+ */
+void autocoder_learn(ac * autocoder)
+{
+    /* weights between outputs and hiddens */
+    float e = autocoder->learning_rate / (1.0f + autocoder->no_of_hiddens);
+
+    ac_loop outputs = { autocoder, NULL, 0, e };
+    deeplearn_parallel_for(autocoder->no_of_inputs,
+                           autocoder_learn_outputs, &outputs);
+
+    /* weights between hiddens and inputs */
+    e = autocoder->learning_rate / (1.0f + autocoder->no_of_inputs);
+
+    ac_loop hiddens = { autocoder, NULL, 0, e };
+    deeplearn_parallel_for(autocoder->no_of_hiddens,
+                           autocoder_learn_hiddens, &hiddens);
+}
+
 /**
  * @brief Save an autocoder to file
  * @param fp Pointer to the file
@@ -354,6 +519,21 @@ int autocoder_save(FILE * fp, ac * autocoder)
     return 0;
 }
 
+/**
+ * @brief Frees an autocoder which was initialised while loading
+ *        if the rest of it could not be read
+ * @param autocoder Autocoder object
+ * @param initialise Whether the autocoder was initialised
+ * @param retval The error to return
+ * @returns retval
+ */
+static int autocoder_load_failed(ac * autocoder, int initialise, int retval)
+{
+    if (initialise != 0)
+        autocoder_free(autocoder);
+    return retval;
+}
+
 /**
  * @brief Load an autocoder from file
  * @param fp Pointer to the file
@@ -392,30 +572,30 @@ int autocoder_load(FILE * fp, ac * autocoder, int initialise)
     }
 
     if (FLOATREAD(autocoder->dropout_percent) == 0)
-        return -5;
+        return autocoder_load_failed(autocoder, initialise, -5);
 
     if (FLOATREADARRAY(autocoder->weights,
                        no_of_inputs*no_of_hiddens) == 0)
-        return -6;
+        return autocoder_load_failed(autocoder, initialise, -6);
 
     if (FLOATREADARRAY(autocoder->last_weight_change,
                        no_of_inputs*no_of_hiddens) == 0)
-        return -7;
+        return autocoder_load_failed(autocoder, initialise, -7);
 
     if (FLOATREADARRAY(autocoder->bias, no_of_hiddens) == 0)
-        return -8;
+        return autocoder_load_failed(autocoder, initialise, -8);
 
     if (FLOATREADARRAY(autocoder->last_bias_change, no_of_hiddens) == 0)
-        return -9;
+        return autocoder_load_failed(autocoder, initialise, -9);
 
     if (FLOATREAD(autocoder->learning_rate) == 0)
-        return -10;
+        return autocoder_load_failed(autocoder, initialise, -10);
 
     if (FLOATREAD(autocoder->noise) == 0)
-        return -11;
+        return autocoder_load_failed(autocoder, initialise, -11);
 
     if (UINTREAD(autocoder->itterations) == 0)
-        return -12;
+        return autocoder_load_failed(autocoder, initialise, -12);
 
     return 0;
 }
@@ -470,9 +650,15 @@ void autocoder_set_hidden(ac * autocoder, int index, float value)
  */
 void autocoder_update(ac * autocoder)
 {
+    deeplearn_perf_begin(DEEPLEARN_PERF_AUTOCODER_UPDATE);
     autocoder_feed_forward(autocoder);
     autocoder_backprop(autocoder);
     autocoder_learn(autocoder);
+    /* encoder and decoder weights are each used in the forward pass,
+       the backward pass and the weight update */
+    deeplearn_perf_end(DEEPLEARN_PERF_AUTOCODER_UPDATE,
+                       (uint64_t)autocoder->no_of_inputs*
+                       autocoder->no_of_hiddens*8);
 }
 
 /**
@@ -528,6 +714,41 @@ int autocoder_compare(ac * autocoder0, ac * autocoder1)
     return 0;
 }
 
+/**
+ * @brief Copies the trained weights of one autocoder to another
+ *        having the same dimensions
+ * @param source The autocoder to copy from
+ * @param dest The autocoder to copy to
+ * @return zero on success
+ */
+int autocoder_copy(ac * source, ac * dest)
+{
+    if (source->no_of_inputs != dest->no_of_inputs)
+        return -1;
+
+    if (source->no_of_hiddens != dest->no_of_hiddens)
+        return -2;
+
+    memcpy((void*)dest->weights, source->weights,
+           source->no_of_inputs*source->no_of_hiddens*sizeof(float));
+    memcpy((void*)dest->bias, source->bias,
+           source->no_of_hiddens*sizeof(float));
+
+    /* clear the previous weight changes */
+    FLOATCLEAR(dest->last_weight_change,
+               dest->no_of_inputs*dest->no_of_hiddens);
+    FLOATCLEAR(dest->last_bias_change, dest->no_of_hiddens);
+
+    dest->dropout_percent = source->dropout_percent;
+    dest->learning_rate = source->learning_rate;
+    dest->noise = source->noise;
+    dest->itterations = source->itterations;
+    dest->backprop_error = source->backprop_error;
+    dest->backprop_error_percent = source->backprop_error_percent;
+    dest->backprop_error_average = source->backprop_error_average;
+    return 0;
+}
+
 /**
  * @brief Plots weight values within an image
  * @param autocoder Autocoder object
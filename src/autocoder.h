@@ -38,6 +38,9 @@
 #include "deeplearn_random.h"
 #include "deeplearn_images.h"
 #include "backprop_neuron.h"
+#include "deeplearn_perf.h"
+#include "deeplearn_executor.h"
+#include "deeplearn_memory.h"
 
 struct autocode {
     unsigned int random_seed;
@@ -78,6 +81,9 @@ struct autocode {
 
     /* training itterations */
     unsigned int itterations;
+
+    /* bytes reserved against the memory budget */
+    size_t memory;
 };
 typedef struct autocode ac;
 
@@ -86,6 +92,8 @@ int autocoder_init(ac * autocoder,
                    int no_of_hiddens,
                    unsigned int random_seed);
 void autocoder_free(ac * autocoder);
+size_t autocoder_estimate_memory(int no_of_inputs, int no_of_hiddens);
+size_t autocoder_get_memory(ac * autocoder);
 void autocoder_encode(ac * autocoder, float encoded[],
                       unsigned char use_dropouts);
 void autocoder_decode(ac * autocoder, float decoded[]);
@@ -101,6 +109,7 @@ void autocoder_set_hidden(ac * autocoder, int index, float value);
 void autocoder_update(ac * autocoder);
 void autocoder_normalise_inputs(ac * autocoder);
 int autocoder_compare(ac * autocoder0, ac * autocoder1);
+int autocoder_copy(ac * source, ac * dest);
 int autocoder_plot_weights(ac * autocoder,
                            int feature_index,
                            int patch_radius, int patch_depth,
@@ -29,6 +29,38 @@
 
 #include "backprop.h"
 
+/* arguments of the parallel loops over the units of a layer */
+typedef struct {
+    bp * net;
+    int layer;
+} bp_layer_loop;
+
+/* arguments of the parallel loop over a batch of samples */
+typedef struct {
+    bp * net;
+    float * inputs, * outputs, * buffer;
+    int widest;
+} bp_batch_loop;
+
+/* arguments of the parallel loop which reprojects the units of a layer */
+typedef struct {
+    bp * net;
+    int layer, widest;
+    float * curr, * next, * reprojected;
+} bp_reproject_loop;
+
+/**
+* @brief Frees a partially initialised network when an allocation fails
+* @param net Backprop neural net object
+* @param retval The error to return
+* @returns retval
+*/
+static int bp_init_failed(bp * net, int retval)
+{
+    bp_free(net);
+    return retval;
+}
+
 /**
 * @brief Initialise a backprop neural net
 * @param net Backprop neural net object
@@ -49,44 +81,76 @@ int bp_init(bp * net,
     bp_neuron * n;
 
     net->learning_rate = 0.2f;
+    net->sample_weight = 1.0f;
     net->noise = 0.0f;
     net->random_seed = *random_seed;
     net->backprop_error = DEEPLEARN_UNKNOWN_ERROR;
     net->backprop_error_average = DEEPLEARN_UNKNOWN_ERROR;
     net->backprop_error_total = DEEPLEARN_UNKNOWN_ERROR;
+    net->output_error = 0;
     net->itterations = 0;
     net->dropout_percent = 20;
+    net->output_activation = BP_OUTPUT_SIGMOID;
 
     net->no_of_inputs = no_of_inputs;
-    NEURON_ARRAY_ALLOC(net->inputs, no_of_inputs);
-    if (!net->inputs)
-        return -1;
-
     net->no_of_hiddens = no_of_hiddens;
     net->no_of_outputs = no_of_outputs;
     net->hidden_layers = hidden_layers;
+
+    /* nothing allocated yet, so that bp_free can clean up
+       if any of the allocations below fail */
+    net->inputs = 0;
+    net->hiddens = 0;
+    net->outputs = 0;
+    net->frozen = 0;
+    net->memory = 0;
+
+    if (deeplearn_memory_reserve(bp_estimate_memory(no_of_inputs,
+                                                    no_of_hiddens,
+                                                    hidden_layers,
+                                                    no_of_outputs)) != 0)
+        return -13;
+
+    net->memory = bp_estimate_memory(no_of_inputs, no_of_hiddens,
+                                     hidden_layers, no_of_outputs);
+
+    NEURON_ARRAY_ALLOC(net->inputs, no_of_inputs);
+    if (!net->inputs)
+        return bp_init_failed(net, -1);
+    memset(net->inputs, '\0', no_of_inputs*sizeof(bp_neuron*));
+
     NEURON_LAYERS_ALLOC(net->hiddens, hidden_layers);
     if (!net->hiddens)
-        return -2;
+        return bp_init_failed(net, -2);
+    memset(net->hiddens, '\0', hidden_layers*sizeof(bp_neuron**));
 
     COUNTDOWN(l, hidden_layers) {
         NEURON_ARRAY_ALLOC(net->hiddens[l], HIDDENS_IN_LAYER(net,l));
         if (!net->hiddens[l])
-            return -3;
+            return bp_init_failed(net, -3);
+        memset(net->hiddens[l], '\0',
+               HIDDENS_IN_LAYER(net,l)*sizeof(bp_neuron*));
     }
 
     NEURON_ARRAY_ALLOC(net->outputs, no_of_outputs);
     if (!net->outputs)
-        return -4;
+        return bp_init_failed(net, -4);
+    memset(net->outputs, '\0', no_of_outputs*sizeof(bp_neuron*));
+
+    /* all layers are trainable */
+    INTALLOC(net->frozen, hidden_layers);
+    if (!net->frozen)
+        return bp_init_failed(net, -12);
+    memset(net->frozen, '\0', hidden_layers*sizeof(int));
 
     /* create inputs */
     COUNTDOWN(i, net->no_of_inputs) {
         NEURONALLOC(net->inputs[i]);
         if (!net->inputs[i])
-            return -5;
+            return bp_init_failed(net, -5);
 
         if (bp_neuron_init(net->inputs[i], 1, random_seed) != 0)
-            return -6;
+            return bp_init_failed(net, -6);
     }
 
     /* create hiddens */
@@ -94,12 +158,12 @@ int bp_init(bp * net,
         COUNTUP(i, HIDDENS_IN_LAYER(net,l)) {
             net->hiddens[l][i] = (bp_neuron*)malloc(sizeof(bp_neuron));
             if (!net->hiddens[l][i])
-                return -7;
+                return bp_init_failed(net, -7);
 
             n = net->hiddens[l][i];
             if (l == 0) {
                 if (bp_neuron_init(n, no_of_inputs, random_seed) != 0)
-                    return -8;
+                    return bp_init_failed(net, -8);
 
                 /* connect to input layer */
                 COUNTDOWN(j, net->no_of_inputs)
@@ -108,7 +172,7 @@ int bp_init(bp * net,
             else {
                 if (bp_neuron_init(n, HIDDENS_IN_LAYER(net,l-1),
                                    random_seed) != 0)
-                    return -9;
+                    return bp_init_failed(net, -9);
 
                 /* connect to previous hidden layer */
                 COUNTDOWN(j, HIDDENS_IN_LAYER(net,l-1))
@@ -121,12 +185,12 @@ int bp_init(bp * net,
     COUNTDOWN(i, net->no_of_outputs) {
         NEURONALLOC(net->outputs[i]);
         if (!net->outputs[i])
-            return -10;
+            return bp_init_failed(net, -10);
 
         n = net->outputs[i];
         if (bp_neuron_init(n, HIDDENS_IN_LAYER(net,hidden_layers-1),
                            random_seed) != 0)
-            return -11;
+            return bp_init_failed(net, -11);
 
         COUNTDOWN(j, HIDDENS_IN_LAYER(net,hidden_layers-1))
             bp_neuron_add_connection(n, j, net->hiddens[hidden_layers-1][j]);
@@ -136,35 +200,223 @@ int bp_init(bp * net,
 }
 
 /**
-* @brief Deallocate the memory for a backprop neural net object
+* @brief Deallocate the memory for a backprop neural net object.
+*        This can also be used on a partially initialised network.
 * @param net Backprop neural net object
 */
 void bp_free(bp * net)
 {
-    COUNTDOWN(i, net->no_of_inputs) {
-        bp_neuron_free(net->inputs[i]);
-        free(net->inputs[i]);
-        net->inputs[i] = 0;
+    if (net->inputs != 0) {
+        COUNTDOWN(i, net->no_of_inputs) {
+            if (net->inputs[i] == 0)
+                continue;
+            bp_neuron_free(net->inputs[i]);
+            free(net->inputs[i]);
+            net->inputs[i] = 0;
+        }
+        free(net->inputs);
+        net->inputs = 0;
     }
-    free(net->inputs);
 
-    COUNTDOWN(l, net->hidden_layers) {
-        COUNTDOWN(i, HIDDENS_IN_LAYER(net,l)) {
-            bp_neuron_free(net->hiddens[l][i]);
-            free(net->hiddens[l][i]);
-            net->hiddens[l][i] = 0;
+    if (net->hiddens != 0) {
+        COUNTDOWN(l, net->hidden_layers) {
+            if (net->hiddens[l] == 0)
+                continue;
+            COUNTDOWN(i, HIDDENS_IN_LAYER(net,l)) {
+                if (net->hiddens[l][i] == 0)
+                    continue;
+                bp_neuron_free(net->hiddens[l][i]);
+                free(net->hiddens[l][i]);
+                net->hiddens[l][i] = 0;
+            }
+            free(net->hiddens[l]);
+            net->hiddens[l] = 0;
         }
-        free(net->hiddens[l]);
-        net->hiddens[l] = 0;
+        free(net->hiddens);
+        net->hiddens = 0;
+    }
+
+    if (net->outputs != 0) {
+        COUNTDOWN(i, net->no_of_outputs) {
+            if (net->outputs[i] == 0)
+                continue;
+            bp_neuron_free(net->outputs[i]);
+            free(net->outputs[i]);
+            net->outputs[i] = 0;
+        }
+        free(net->outputs);
+        net->outputs = 0;
+    }
+
+    free(net->frozen);
+    net->frozen = 0;
+
+    deeplearn_memory_release(net->memory);
+    net->memory = 0;
+}
+
+/**
+* @brief Returns the number of bytes allocated for a neuron
+* @param no_of_inputs The number of inputs to the neuron
+* @returns Number of bytes
+*/
+static size_t bp_neuron_memory(int no_of_inputs)
+{
+    return sizeof(bp_neuron) +
+        ((size_t)no_of_inputs*(2*sizeof(float) + sizeof(bp_neuron*)));
+}
+
+/**
+* @brief Returns the number of bytes which will be allocated by bp_init
+*        for a network of the given size, not including the bp object
+*        itself or any overhead of the memory allocator
+* @param no_of_inputs The number of input units
+* @param no_of_hiddens The number of units in the first hidden layer
+* @param hidden_layers The number of hidden layers
+* @param no_of_outputs The number of output units
+* @returns Number of bytes
+*/
+size_t bp_estimate_memory(int no_of_inputs,
+                          int no_of_hiddens,
+                          int hidden_layers,
+                          int no_of_outputs)
+{
+    bp net;
+    size_t bytes;
+
+    /* dimensions needed by HIDDENS_IN_LAYER */
+    net.no_of_hiddens = no_of_hiddens;
+    net.hidden_layers = hidden_layers;
+    net.no_of_outputs = no_of_outputs;
+
+    /* arrays of pointers to neurons and the frozen flags */
+    bytes = ((size_t)no_of_inputs + no_of_outputs)*sizeof(bp_neuron*) +
+        (size_t)hidden_layers*(sizeof(bp_neuron**) + sizeof(int));
+
+    bytes += (size_t)no_of_inputs*bp_neuron_memory(1);
+
+    COUNTUP(l, hidden_layers) {
+        int inputs = (l == 0 ? no_of_inputs : HIDDENS_IN_LAYER(&net,l-1));
+
+        bytes += (size_t)HIDDENS_IN_LAYER(&net,l)*
+            (sizeof(bp_neuron*) + bp_neuron_memory(inputs));
+    }
+
+    bytes += (size_t)no_of_outputs*
+        bp_neuron_memory(HIDDENS_IN_LAYER(&net,hidden_layers-1));
+
+    return bytes;
+}
+
+/**
+* @brief Returns the number of bytes currently allocated by a network
+* @param net Backprop neural net object
+* @returns Number of bytes
+*/
+size_t bp_get_memory(bp * net)
+{
+    return net->memory;
+}
+
+/**
+* @brief Converts weighted sums into softmax probabilities, scaled into
+*        the NEURON_LOW - NEURON_HIGH range so that they can be used in
+*        the same way as sigmoid outputs
+* @param values Weighted sums, which are replaced by the scaled probabilities
+* @param n The number of values
+*/
+void bp_softmax(float values[], int n)
+{
+    float max = values[0], total = 0, scale;
+
+    /* subtract the maximum so that exp doesn't overflow */
+    FOR(i, 1, n) {
+        if (values[i] > max)
+            max = values[i];
+    }
+
+    COUNTDOWN(i, n) {
+        values[i] = (float)exp(values[i] - max);
+        total += values[i];
+    }
+
+    scale = NEURON_RANGE / total;
+    COUNTDOWN(i, n)
+        values[i] = NEURON_LOW + (values[i] * scale);
+}
+
+/**
+* @brief Propagates the values of the last hidden layer to the output units
+* @param net Backprop neural net object
+*/
+static void bp_feed_forward_outputs(bp * net)
+{
+    float max, total = 0, scale;
+
+    if (net->output_activation != BP_OUTPUT_SOFTMAX) {
+        COUNTDOWN(i, net->no_of_outputs)
+            bp_neuron_feedForward(net->outputs[i],
+                                  net->noise, &net->random_seed);
+        return;
+    }
+
+    COUNTDOWN(i, net->no_of_outputs)
+        bp_neuron_feedForward_linear(net->outputs[i]);
+
+    /* as bp_softmax, but the values are within the output units */
+    max = net->outputs[0]->value;
+    FOR(i, 1, net->no_of_outputs) {
+        if (net->outputs[i]->value > max)
+            max = net->outputs[i]->value;
     }
-    free(net->hiddens);
 
     COUNTDOWN(i, net->no_of_outputs) {
-        bp_neuron_free(net->outputs[i]);
-        free(net->outputs[i]);
-        net->outputs[i] = 0;
+        net->outputs[i]->value = (float)exp(net->outputs[i]->value - max);
+        total += net->outputs[i]->value;
     }
-    free(net->outputs);
+
+    scale = NEURON_RANGE / total;
+    COUNTDOWN(i, net->no_of_outputs)
+        net->outputs[i]->value = NEURON_LOW + (net->outputs[i]->value * scale);
+}
+
+/**
+* @brief Body of the parallel loop which feeds forward the units of
+*        a hidden layer
+* @param start Index of the first unit
+* @param end Index after the last unit
+* @param context Layer being fed forward
+*/
+static void bp_feed_forward_units(int start, int end, void * context)
+{
+    bp_layer_loop * args = (bp_layer_loop*)context;
+    bp * net = args->net;
+
+    for (int i = end-1; i >= start; i--)
+        bp_neuron_feedForward(net->hiddens[args->layer][i],
+                              net->noise, &net->random_seed);
+}
+
+/**
+* @brief Feeds forward the units of a hidden layer, divided into the
+*        number of tasks chosen by the tuner for its shape
+* @param net Backprop neural net object
+* @param layer Index of the hidden layer
+*/
+static void bp_feed_forward_layer(bp * net, int layer)
+{
+    deeplearn_tune_trial trial;
+    int shape[DEEPLEARN_TUNE_SHAPE] = {
+        HIDDENS_IN_LAYER(net,layer),
+        net->hiddens[layer][0]->no_of_inputs, 0, 0, 0, 0
+    };
+    bp_layer_loop args = { net, layer };
+
+    deeplearn_tune_begin(DEEPLEARN_TUNE_FEED_FORWARD, shape, &trial);
+    deeplearn_parallel_for_tasks(HIDDENS_IN_LAYER(net,layer),
+                                 trial.choice.tasks,
+                                 bp_feed_forward_units, &args);
+    deeplearn_tune_end(&trial);
 }
 
 /**
@@ -173,18 +425,16 @@ void bp_free(bp * net)
 */
 void bp_feed_forward(bp * net)
 {
+    deeplearn_trace_begin("bp_feed_forward");
+
     /* for each hidden layer */
-    COUNTUP(l, net->hidden_layers) {
-        /* For each unit within the layer */
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
-        COUNTDOWN(i, HIDDENS_IN_LAYER(net,l))
-            bp_neuron_feedForward(net->hiddens[l][i],
-                                  net->noise, &net->random_seed);
-    }
+    COUNTUP(l, net->hidden_layers)
+        bp_feed_forward_layer(net, l);
 
     /* for each unit in the output layer */
-    COUNTDOWN(i, net->no_of_outputs)
-        bp_neuron_feedForward(net->outputs[i], net->noise, &net->random_seed);
+    bp_feed_forward_outputs(net);
+
+    deeplearn_trace_end("bp_feed_forward");
 }
 
 /**
@@ -200,21 +450,198 @@ void bp_feed_forward_layers(bp * net, int layers)
         /* if this layer is a hidden layer */
         if (l < net->hidden_layers) {
             /* For each unit within the layer */
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
-            COUNTDOWN(i, HIDDENS_IN_LAYER(net,l))
-                bp_neuron_feedForward(net->hiddens[l][i],
-                                      net->noise, &net->random_seed);
+            bp_feed_forward_layer(net, l);
         }
         else {
             /* For each unit within the output layer */
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
-            COUNTDOWN(i, net->no_of_outputs)
-                bp_neuron_feedForward(net->outputs[i],
-                                      net->noise, &net->random_seed);
+            bp_feed_forward_outputs(net);
         }
     }
 }
 
+/**
+* @brief Returns the number of units within the widest layer above the
+*        inputs. This determines the size of the working buffer needed by
+*        bp_feed_forward_sample
+* @param net Backprop neural net object
+* @returns number of units
+*/
+int bp_widest_layer(bp * net)
+{
+    if (net->no_of_outputs > net->no_of_hiddens)
+        return net->no_of_outputs;
+
+    return net->no_of_hiddens;
+}
+
+/**
+* @brief Calculates the output values for a single sample from the values
+*        of the last hidden layer, without altering the state of any units
+* @param net Backprop neural net object
+* @param hiddens Values of the last hidden layer
+* @param outputs Returned output values, one per output unit
+*/
+static void bp_feed_forward_sample_outputs(bp * net, float hiddens[],
+                                           float outputs[])
+{
+    if (net->output_activation == BP_OUTPUT_SOFTMAX) {
+        COUNTDOWN(i, net->no_of_outputs)
+            outputs[i] = bp_neuron_sum(net->outputs[i], hiddens);
+        bp_softmax(outputs, net->no_of_outputs);
+        return;
+    }
+
+    COUNTDOWN(i, net->no_of_outputs)
+        outputs[i] = bp_neuron_activation(net->outputs[i], hiddens);
+}
+
+/**
+* @brief Propagates the input values for a single sample through the
+*        network without altering the state of any units
+* @param net Backprop neural net object
+* @param inputs Input values, one per input unit
+* @param outputs Returned output values, one per output unit
+* @param buffer Working values, with room for twice the number of units
+*        returned by bp_widest_layer
+*/
+void bp_feed_forward_sample(bp * net, float inputs[], float outputs[],
+                            float buffer[])
+{
+    float * prev = buffer;
+    float * curr = buffer + bp_widest_layer(net);
+    float * layer_inputs = inputs;
+
+    COUNTUP(l, net->hidden_layers) {
+        float * swap;
+
+        COUNTDOWN(i, HIDDENS_IN_LAYER(net,l))
+            curr[i] = bp_neuron_activation(net->hiddens[l][i], layer_inputs);
+
+        /* this layer becomes the input to the next */
+        swap = prev;
+        prev = curr;
+        curr = swap;
+        layer_inputs = prev;
+    }
+
+    bp_feed_forward_sample_outputs(net, layer_inputs, outputs);
+}
+
+/**
+* @brief Propagates the values of a hidden layer for a single sample through
+*        the remaining layers without altering the state of any units
+* @param net Backprop neural net object
+* @param layer Index of the hidden layer whose values are given
+* @param values Values of the units within the hidden layer
+* @param outputs Returned output values, one per output unit
+* @param buffer Working values, with room for twice the number of units
+*        returned by bp_widest_layer
+*/
+void bp_feed_forward_from_layer(bp * net, int layer, float values[],
+                                float outputs[], float buffer[])
+{
+    float * prev = buffer;
+    float * curr = buffer + bp_widest_layer(net);
+    float * layer_inputs = values;
+
+    FOR(l, layer+1, net->hidden_layers) {
+        float * swap;
+
+        COUNTDOWN(i, HIDDENS_IN_LAYER(net,l))
+            curr[i] = bp_neuron_activation(net->hiddens[l][i], layer_inputs);
+
+        swap = prev;
+        prev = curr;
+        curr = swap;
+        layer_inputs = prev;
+    }
+
+    bp_feed_forward_sample_outputs(net, layer_inputs, outputs);
+}
+
+/**
+* @brief Body of the parallel loop which feeds forward a batch of samples
+* @param start Index of the first sample
+* @param end Index after the last sample
+* @param context The batch
+*/
+static void bp_feed_forward_batch_samples(int start, int end, void * context)
+{
+    bp_batch_loop * args = (bp_batch_loop*)context;
+    bp * net = args->net;
+
+    for (int b = end-1; b >= start; b--)
+        bp_feed_forward_sample(net,
+                               &args->inputs[b*net->no_of_inputs],
+                               &args->outputs[b*net->no_of_outputs],
+                               &args->buffer[b*args->widest*2]);
+}
+
+/**
+* @brief Propagates a batch of input values through the network.
+*        The state of the units is not altered, so this can safely be
+*        called from several threads at the same time
+* @param net Backprop neural net object
+* @param batch_size The number of samples within the batch
+* @param inputs Input values with no_of_inputs values per sample
+* @param outputs Returned output values with no_of_outputs values per sample
+* @returns zero on success
+*/
+int bp_feed_forward_batch(bp * net, int batch_size,
+                          float inputs[], float outputs[])
+{
+    int widest = bp_widest_layer(net);
+    float * buffer;
+
+    if (batch_size <= 0)
+        return -1;
+
+    /* two layers of working values for each sample */
+    FLOATALLOC(buffer, batch_size*widest*2);
+    if (!buffer)
+        return -2;
+
+    bp_batch_loop args = { net, inputs, outputs, buffer, widest };
+    deeplearn_parallel_for(batch_size, bp_feed_forward_batch_samples, &args);
+
+    free(buffer);
+    return 0;
+}
+
+/**
+* @brief Body of the parallel loop which back-propogates errors from
+*        the output units
+* @param start Index of the first unit
+* @param end Index after the last unit
+* @param context The output layer
+*/
+static void bp_backprop_outputs(int start, int end, void * context)
+{
+    bp * net = ((bp_layer_loop*)context)->net;
+
+    for (int i = end-1; i >= start; i--) {
+        if (net->output_activation == BP_OUTPUT_SOFTMAX)
+            bp_neuron_backprop_softmax(net->outputs[i], net->sample_weight);
+        else
+            bp_neuron_backprop(net->outputs[i], net->sample_weight);
+    }
+}
+
+/**
+* @brief Body of the parallel loop which back-propogates errors from
+*        the units of a hidden layer
+* @param start Index of the first unit
+* @param end Index after the last unit
+* @param context The hidden layer
+*/
+static void bp_backprop_units(int start, int end, void * context)
+{
+    bp_layer_loop * args = (bp_layer_loop*)context;
+
+    for (int i = end-1; i >= start; i--)
+        bp_neuron_backprop(args->net->hiddens[args->layer][i], 1.0f);
+}
+
 /**
 * @brief back-propogate errors from the output layer towards the input layer
 * @param net Backprop neural net object
@@ -223,8 +650,11 @@ void bp_backprop(bp * net, int current_hidden_layer)
 {
     int neuron_count=0;
     int start_hidden_layer = current_hidden_layer-1;
+    int stop_hidden_layer;
     float errorPercent=0;
 
+    deeplearn_trace_begin("bp_backprop");
+
     /* clear all previous backprop errors */
     COUNTDOWN(i, net->no_of_inputs)
         net->inputs[i]->backprop_error = 0;
@@ -233,7 +663,14 @@ void bp_backprop(bp * net, int current_hidden_layer)
     if (start_hidden_layer < 0)
         start_hidden_layer = 0;
 
-    FOR(l, start_hidden_layer, net->hidden_layers) {
+    /* errors don't need to be propagated below the lowest
+       layer which is trainable */
+    stop_hidden_layer = start_hidden_layer;
+    while ((stop_hidden_layer < net->hidden_layers) &&
+           (net->frozen[stop_hidden_layer] != 0))
+        stop_hidden_layer++;
+
+    FOR(l, stop_hidden_layer, net->hidden_layers) {
         /* For each unit within the layer */
         COUNTDOWN(i, HIDDENS_IN_LAYER(net,l))
             net->hiddens[l][i]->backprop_error = 0;
@@ -243,18 +680,19 @@ void bp_backprop(bp * net, int current_hidden_layer)
     net->backprop_error_total = 0;
 
     /* for every output unit */
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
-    COUNTDOWN(i, net->no_of_outputs) {
-        bp_neuron_backprop(net->outputs[i]);
-    }
+    bp_layer_loop outputs = { net, net->hidden_layers };
+    deeplearn_parallel_for(net->no_of_outputs, bp_backprop_outputs, &outputs);
 
     COUNTDOWN(i, net->no_of_outputs) {
         /* update the total error which is used to assess
-            network performance */
-        net->backprop_error_total += net->outputs[i]->backprop_error;
-        errorPercent += fabs(net->outputs[i]->backprop_error);
+            network performance. This is the error of the
+            sample without its weight */
+        float error = net->outputs[i]->backprop_error / net->sample_weight;
+        net->backprop_error_total += error;
+        errorPercent += fabs(error);
     }
     neuron_count += net->no_of_outputs;
+    net->output_error = errorPercent / (NEURON_RANGE*net->no_of_outputs);
 
     /* convert summed error to an overall percentage */
     errorPercent = errorPercent * 100 /
@@ -279,11 +717,23 @@ void bp_backprop(bp * net, int current_hidden_layer)
     }
 
     /* back-propogate through the hidden layers */
-    for (int l = net->hidden_layers-1; l >= start_hidden_layer; l--) {
-        /* for every unit in the hidden layer */
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
-        COUNTDOWN(i, HIDDENS_IN_LAYER(net,l)) {
-            bp_neuron_backprop(net->hiddens[l][i]);
+    for (int l = net->hidden_layers-1; l >= stop_hidden_layer; l--) {
+        /* for every unit in the hidden layer, unless the
+           layer below is frozen */
+        if ((l > stop_hidden_layer) ||
+            (stop_hidden_layer == start_hidden_layer)) {
+            deeplearn_tune_trial trial;
+            int shape[DEEPLEARN_TUNE_SHAPE] = {
+                HIDDENS_IN_LAYER(net,l),
+                net->hiddens[l][0]->no_of_inputs, 0, 0, 0, 0
+            };
+            bp_layer_loop args = { net, l };
+
+            deeplearn_tune_begin(DEEPLEARN_TUNE_BACKPROP, shape, &trial);
+            deeplearn_parallel_for_tasks(HIDDENS_IN_LAYER(net,l),
+                                         trial.choice.tasks,
+                                         bp_backprop_units, &args);
+            deeplearn_tune_end(&trial);
         }
 
         COUNTDOWN(i, HIDDENS_IN_LAYER(net,l)) {
@@ -301,6 +751,8 @@ void bp_backprop(bp * net, int current_hidden_layer)
     /* increment the number of training itterations */
     if (net->itterations < UINT_MAX)
         net->itterations++;
+
+    deeplearn_trace_end("bp_backprop");
 }
 
 /**
@@ -354,6 +806,144 @@ void bp_reproject(bp * net, int layer, int neuron_index)
                 AF(n->value_reprojected);
         }
     }
+
+    /* reproject the first hidden layer onto the inputs */
+    if (layer > 0) {
+        COUNTDOWN(i, HIDDENS_IN_LAYER(net,0))
+            bp_neuron_reproject(net->hiddens[0][i]);
+    }
+}
+
+/**
+ * @brief Body of the parallel loop which reprojects the units of a layer
+ * @param start Index of the first unit
+ * @param end Index after the last unit
+ * @param context The layer and working buffers
+ */
+static void bp_reproject_units(int start, int end, void * context)
+{
+    bp_reproject_loop * args = (bp_reproject_loop*)context;
+    bp * net = args->net;
+
+    for (int u = end-1; u >= start; u--) {
+        float * r = &args->curr[u*args->widest];
+        float * r_next = &args->next[u*args->widest];
+        bp_neuron * n = net->hiddens[args->layer][u];
+
+        /* the unit is set active, so its reprojection onto the previous
+           layer is its weights */
+        COUNTDOWN(i, n->no_of_inputs)
+            r[i] = NEURON_HIGH * n->weights[i];
+
+        for (int l = args->layer; l > 0; l--) {
+            float * swap;
+            int prev_units = HIDDENS_IN_LAYER(net,l-1);
+            int prev_inputs = net->hiddens[l-1][0]->no_of_inputs;
+
+            /* apply the sigmoid function in the previous layer,
+               as with feedforward */
+            COUNTDOWN(i, prev_units)
+                r[i] = AF(r[i]);
+
+            /* multiply by the weights of the previous layer,
+               one row per unit */
+            FLOATCLEAR(r_next, prev_inputs);
+            COUNTUP(i, prev_units) {
+                float v = r[i];
+                float * w = net->hiddens[l-1][i]->weights;
+
+                COUNTDOWN(j, prev_inputs)
+                    r_next[j] += v * w[j];
+            }
+
+            swap = r;
+            r = r_next;
+            r_next = swap;
+        }
+
+        memcpy(&args->reprojected[u*net->no_of_inputs], r,
+               net->no_of_inputs*sizeof(float));
+    }
+}
+
+/**
+ * @brief Reprojects every unit within a hidden layer onto the inputs at
+ *        once. This gives the same values as calling bp_reproject for each
+ *        unit, but the units are reprojected together as a chain of matrix
+ *        products, using multiple threads and without altering the state
+ *        of the network
+ * @param net Backprop neural net object
+ * @param layer The hidden layer to be reprojected
+ * @param reprojected Returned values with no_of_inputs values for each unit
+ *        within the layer
+ * @returns zero on success
+ */
+int bp_reproject_layer(bp * net, int layer, float reprojected[])
+{
+    int units, widest;
+    float * curr, * next;
+
+    if ((layer < 0) || (layer >= net->hidden_layers))
+        return -1;
+
+    /* hidden layers taper towards the outputs, so a later layer can be
+       wider than the first */
+    units = HIDDENS_IN_LAYER(net,layer);
+    widest = net->no_of_inputs;
+    if (bp_widest_layer(net) > widest)
+        widest = bp_widest_layer(net);
+
+    FLOATALLOC(curr, units*widest);
+    if (!curr)
+        return -2;
+
+    FLOATALLOC(next, units*widest);
+    if (!next) {
+        free(curr);
+        return -3;
+    }
+
+    bp_reproject_loop args = { net, layer, widest, curr, next, reprojected };
+    deeplearn_parallel_for(units, bp_reproject_units, &args);
+
+    free(curr);
+    free(next);
+    return 0;
+}
+
+/**
+* @brief Body of the parallel loop which adjusts the weights of the units
+*        of a hidden layer
+* @param start Index of the first unit
+* @param end Index after the last unit
+* @param context The hidden layer
+*/
+static void bp_learn_units(int start, int end, void * context)
+{
+    bp_layer_loop * args = (bp_layer_loop*)context;
+    bp * net = args->net;
+
+    for (int i = end-1; i >= start; i--)
+        bp_neuron_learn(net->hiddens[args->layer][i], net->learning_rate);
+}
+
+/**
+* @brief Body of the parallel loop which adjusts the weights of the
+*        output units
+* @param start Index of the first unit
+* @param end Index after the last unit
+* @param context The output layer
+*/
+static void bp_learn_outputs(int start, int end, void * context)
+{
+    bp * net = ((bp_layer_loop*)context)->net;
+
+    for (int i = end-1; i >= start; i--) {
+        if (net->output_activation == BP_OUTPUT_SOFTMAX)
+            bp_neuron_learn_softmax(net->outputs[i], net->learning_rate);
+        else
+            bp_neuron_learn(net->outputs[i], net->learning_rate);
+    }
 }
 
 /**
@@ -365,19 +955,25 @@ void bp_learn(bp * net, int current_hidden_layer)
 {
     int start_hidden_layer = current_hidden_layer-1;
 
+    deeplearn_trace_begin("bp_learn");
+
     /* for each hidden layers */
     if (start_hidden_layer < 0)
         start_hidden_layer = 0;
 
     FOR(l, start_hidden_layer, net->hidden_layers) {
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
-        COUNTDOWN(i, HIDDENS_IN_LAYER(net,l))
-            bp_neuron_learn(net->hiddens[l][i], net->learning_rate);
+        if (net->frozen[l] != 0)
+            continue;
+
+        bp_layer_loop args = { net, l };
+        deeplearn_parallel_for(HIDDENS_IN_LAYER(net,l),
+                               bp_learn_units, &args);
     }
 
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
-    COUNTDOWN(i, net->no_of_outputs)
-        bp_neuron_learn(net->outputs[i], net->learning_rate);
+    bp_layer_loop outputs = { net, net->hidden_layers };
+    deeplearn_parallel_for(net->no_of_outputs, bp_learn_outputs, &outputs);
+
+    deeplearn_trace_end("bp_learn");
 }
 
 /**
@@ -744,6 +1340,18 @@ float bp_get_desired(bp * net, int index)
     return net->outputs[index]->desired_value;
 }
 
+/**
+* @brief Returns the average absolute error of the output units for the
+*        most recent training step, without the weight of the sample, so
+*        it is unaffected by the weight having been changed since
+* @param net Backprop neural net object
+* @return Error as a fraction of the neuron range
+*/
+float bp_get_output_error(bp * net)
+{
+    return net->output_error;
+}
+
 /**
 * @brief Exclusion flags indicate that a unit has temporarily dropped out.
 *        This clears the all the exclusion flags
@@ -843,17 +1451,107 @@ static void bp_dropouts(bp * net)
     }
 }
 
+/**
+* @brief Returns the number of connection weights within the network
+* @param net Backprop neural net object
+* @returns Number of weights
+*/
+static int bp_no_of_weights(bp * net)
+{
+    int weights = net->no_of_inputs*HIDDENS_IN_LAYER(net,0);
+
+    FOR(l, 1, net->hidden_layers)
+        weights += HIDDENS_IN_LAYER(net,l-1)*HIDDENS_IN_LAYER(net,l);
+
+    return weights +
+        HIDDENS_IN_LAYER(net,net->hidden_layers-1)*net->no_of_outputs;
+}
+
 /**
 * @brief Update the neural net during training
 * @param net Backprop neural net object
 */
 void bp_update(bp * net, int current_hidden_layer)
 {
+    deeplearn_perf_begin(DEEPLEARN_PERF_BP_UPDATE);
     bp_dropouts(net);
     bp_feed_forward(net);
     bp_backprop(net, current_hidden_layer);
     bp_learn(net, current_hidden_layer);
     bp_clear_dropouts(net);
+    /* multiply and add for each weight in the forward pass,
+       the backward pass and the weight update */
+    deeplearn_perf_end(DEEPLEARN_PERF_BP_UPDATE,
+                       (uint64_t)bp_no_of_weights(net)*6);
+}
+
+/**
+* @brief Sets the activation of the output layer. With softmax the outputs
+*        are probabilities which sum to one, scaled into the NEURON_LOW -
+*        NEURON_HIGH range, and training minimises the cross entropy.
+*        This is suited to classification with one output unit per class
+* @param net Backprop neural net object
+* @param activation BP_OUTPUT_SIGMOID or BP_OUTPUT_SOFTMAX
+* @return zero on success
+*/
+int bp_set_output_activation(bp * net, int activation)
+{
+    if ((activation != BP_OUTPUT_SIGMOID) &&
+        (activation != BP_OUTPUT_SOFTMAX))
+        return -1;
+
+    net->output_activation = activation;
+    return 0;
+}
+
+/**
+* @brief Sets the weight of the next training sample within the loss, so
+*        that a sample which stands for several identical rows has the
+*        same effect as training on each of them. The reported training
+*        error is that of the sample without its weight
+* @param net Backprop neural net object
+* @param weight Sample weight, greater than zero
+* @return zero on success
+*/
+int bp_set_sample_weight(bp * net, float weight)
+{
+    if (!(weight > 0))
+        return -1;
+
+    net->sample_weight = weight;
+    return 0;
+}
+
+/**
+* @brief Freezes or unfreezes a hidden layer. The weights of a frozen layer
+*        are not changed during training, and errors are not propagated
+*        below the lowest layer which is not frozen
+* @param net Backprop neural net object
+* @param layer Index of the hidden layer
+* @param frozen Non-zero to freeze the layer
+* @return zero on success
+*/
+int bp_freeze_layer(bp * net, int layer, int frozen)
+{
+    if ((layer < 0) || (layer >= net->hidden_layers))
+        return -1;
+
+    net->frozen[layer] = (frozen != 0);
+    return 0;
+}
+
+/**
+* @brief Returns non-zero if the given hidden layer is frozen
+* @param net Backprop neural net object
+* @param layer Index of the hidden layer
+* @return non-zero if frozen
+*/
+int bp_layer_frozen(bp * net, int layer)
+{
+    if ((layer < 0) || (layer >= net->hidden_layers))
+        return 0;
+
+    return net->frozen[layer];
 }
 
 /**
@@ -864,6 +1562,12 @@ void bp_update(bp * net, int current_hidden_layer)
 */
 int bp_save(FILE * fp, bp * net)
 {
+    unsigned int magic = BP_FILE_MAGIC;
+    int version = BP_FILE_VERSION;
+
+    if ((UINTWRITE(magic) == 0) || (INTWRITE(version) == 0))
+        return -1;
+
     if (UINTWRITE(net->itterations) == 0)
         return -1;
 
@@ -894,6 +1598,9 @@ int bp_save(FILE * fp, bp * net)
     if (UINTWRITE(net->random_seed) == 0)
         return -10;
 
+    if (INTWRITE(net->output_activation) == 0)
+        return -11;
+
     COUNTUP(l, net->hidden_layers) {
         COUNTUP(i, HIDDENS_IN_LAYER(net,l))
             bp_neuron_save(fp,net->hiddens[l][i]);
@@ -919,10 +1626,24 @@ int bp_load(FILE * fp, bp * net)
     float dropout_percent=0;
     unsigned int itterations=0;
     unsigned int random_seed=0;
+    int output_activation=BP_OUTPUT_SIGMOID;
+    int version=0;
 
     if (UINTREAD(itterations) == 0)
         return -1;
 
+    /* unversioned networks begin with the number of iterations */
+    if (itterations == BP_FILE_MAGIC) {
+        if (INTREAD(version) == 0)
+            return -1;
+
+        if ((version < 1) || (version > BP_FILE_VERSION))
+            return -16;
+
+        if (UINTREAD(itterations) == 0)
+            return -1;
+    }
+
     if (INTREAD(no_of_inputs) == 0)
         return -2;
 
@@ -950,23 +1671,29 @@ int bp_load(FILE * fp, bp * net)
     if (UINTREAD(random_seed) == 0)
         return -10;
 
+    if ((version >= 1) && (INTREAD(output_activation) == 0))
+        return -11;
+
     if (bp_init(net, no_of_inputs, no_of_hiddens,
                 hidden_layers, no_of_outputs,
                 &random_seed) != 0)
-        return -11;
+        return -12;
 
     COUNTUP(l, net->hidden_layers) {
         COUNTUP(i, HIDDENS_IN_LAYER(net,l)) {
             if (bp_neuron_load(fp,net->hiddens[l][i]) != 0)
-                return -12;
+                return bp_init_failed(net, -13);
         }
     }
 
     COUNTUP(i, net->no_of_outputs) {
         if (bp_neuron_load(fp,net->outputs[i]) != 0)
-            return -13;
+            return bp_init_failed(net, -14);
     }
 
+    if (bp_set_output_activation(net, output_activation) != 0)
+        return bp_init_failed(net, -15);
+
     net->learning_rate = learning_rate;
     net->noise = noise;
     net->backprop_error_average = backprop_error_average;
@@ -1031,39 +1758,56 @@ int bp_compare(bp * net1, bp * net2)
     if (net1->dropout_percent!= net2->dropout_percent)
         return -10;
 
+    if (net1->output_activation != net2->output_activation)
+        return -11;
+
     return 1;
 }
 
 /**
-* @brief Extract the classification string from the filename.
+* @brief Finds the classification within a filename without copying it.
 *        This assumes a filename of the type class.instance.extension
 * @param filename The filename to examine
-* @param classification The returned classification
+* @param length Returned length of the classification
+* @returns position of the classification within the filename
 */
-void bp_get_classification_from_filename(char * filename,
-                                         char * classification)
+int bp_classification_within_filename(char * filename, int * length)
 {
-    int j, start=0;
-
-    /* start with an empty classification string */
-    classification[0] = 0;
+    int j, start = 0, len = strlen(filename);
 
     /* find the last separator */
-    COUNTUP(i, strlen(filename)) {
+    COUNTUP(i, len) {
         if (filename[i] == '/')
             start = i+1;
     }
 
     /* find the first full stop */
-    for (j = start; j < strlen(filename); j++) {
+    for (j = start; j < len; j++) {
         if ((filename[j] == '.') ||
             (filename[j] == '-') ||
             (filename[j] == '_')) break;
-        classification[j-start] = filename[j];
     }
 
+    *length = j - start;
+    return start;
+}
+
+/**
+* @brief Extract the classification string from the filename.
+*        This assumes a filename of the type class.instance.extension
+* @param filename The filename to examine
+* @param classification The returned classification
+*/
+void bp_get_classification_from_filename(char * filename,
+                                         char * classification)
+{
+    int length;
+    int start = bp_classification_within_filename(filename, &length);
+
+    memcpy(classification, &filename[start], length);
+
     /* add a string terminator */
-    classification[j-start] = 0;
+    classification[length] = 0;
 }
 
 /**
@@ -1072,6 +1816,8 @@ void bp_get_classification_from_filename(char * filename,
 *        array of classification numbers corresponding to the text
 *        descriptions. It's easier for the system to deal with
 *        classification numbers rather than text descriptions.
+*        Labels are looked up within a hash table, so this is linear
+*        in the number of instances.
 * @param no_of_instances The number of instances in the training or test set
 * @param instance_classification Text Description for each instance
 * @param numbers Array of numbers corresponding to each instance
@@ -1080,51 +1826,20 @@ int bp_classifications_to_numbers(int no_of_instances,
                                   char ** instance_classification,
                                   int * numbers)
 {
-    int j;
-    int unique_ctr = 0;
-    char ** unique_classification;
+    deeplearn_labels labels;
 
-    /* allocate memory for a list of unique descriptions (labels) */
-    CHARPTRALLOC(unique_classification, no_of_instances);
-    if (!unique_classification)
+    if (deeplearn_labels_init(&labels, 0) != 0)
         return -1;
 
-    /* create a list of unique classification names */
     COUNTUP(i, no_of_instances) {
-        /* for every class number assigned so far */
-        for (j = 0; j < unique_ctr; j++) {
-            /* is this instance description (label) the same as a previous
-                instance description ? */
-            if (strcmp(instance_classification[i],
-                       unique_classification[j])==0) {
-                /* assign the same class number and finish the search */
-                numbers[i] = j;
-                break;
-            }
-        }
-        /* if this instance has a description which has not been used before */
-        if (j == unique_ctr) {
-            /* store the description */
-            CHARALLOC(unique_classification[unique_ctr],
-                      1+strlen(instance_classification[i]));
-            if (!unique_classification[unique_ctr])
-                return -2;
-
-            sprintf(unique_classification[unique_ctr],
-                    "%s", instance_classification[i]);
-
-            /* store the classification number */
-            numbers[i] = unique_ctr;
-
-            /* increment the number of classes */
-            unique_ctr++;
+        numbers[i] = deeplearn_labels_intern(&labels,
+                                             instance_classification[i], -1);
+        if (numbers[i] < 0) {
+            deeplearn_labels_free(&labels);
+            return -2;
         }
     }
 
-    /* free memory which was used to store descriptions */
-    COUNTDOWN(i, unique_ctr)
-        free(unique_classification[i]);
-
-    free(unique_classification);
+    deeplearn_labels_free(&labels);
     return 0;
 }
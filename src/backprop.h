@@ -39,6 +39,12 @@
 #include "deeplearn_images.h"
 #include "backprop_neuron.h"
 #include "encoding.h"
+#include "deeplearn_trace.h"
+#include "deeplearn_perf.h"
+#include "deeplearn_labels.h"
+#include "deeplearn_executor.h"
+#include "deeplearn_tune.h"
+#include "deeplearn_memory.h"
 
 /* macro returns the number of hidden units at a given layer index */
 #define HIDDENS_IN_LAYER(net, layer)                                    \
@@ -47,6 +53,16 @@
       ((net)->no_of_hiddens -                                             \
        (((net)->no_of_hiddens - (net)->no_of_outputs)*(layer)/(net)->hidden_layers))))
 
+/* activation of the output layer */
+#define BP_OUTPUT_SIGMOID 0
+#define BP_OUTPUT_SOFTMAX 1
+
+/* a saved network begins with this value followed by the format version.
+   Networks saved before the format was versioned begin with the number
+   of iterations and have sigmoid outputs */
+#define BP_FILE_MAGIC   0x5044424cU
+#define BP_FILE_VERSION 1
+
 struct backprop {
     int no_of_inputs,no_of_hiddens,no_of_outputs;
     int hidden_layers;
@@ -54,13 +70,30 @@ struct backprop {
     bp_neuron ** inputs;
     bp_neuron *** hiddens;
     bp_neuron ** outputs;
+
+    /* non-zero for hidden layers whose weights are not trained */
+    int * frozen;
+
+    /* BP_OUTPUT_SIGMOID or BP_OUTPUT_SOFTMAX */
+    int output_activation;
     float backprop_error_total;
     float backprop_error, backprop_error_average;
     float backprop_error_percent;
+
+    /* average absolute error of the output units for the most recent
+       training step, without the sample weight */
+    float output_error;
     float learning_rate;
+
+    /* weight of the current training sample within the loss, such as
+       the number of identical rows which it represents */
+    float sample_weight;
     float noise;
     unsigned int random_seed;
     unsigned int itterations;
+
+    /* bytes reserved against the memory budget */
+    size_t memory;
 };
 typedef struct backprop bp;
 
@@ -71,8 +104,20 @@ int bp_init(bp * net,
             int no_of_outputs,
             unsigned int * random_seed);
 void bp_free(bp * net);
+size_t bp_estimate_memory(int no_of_inputs,
+                          int no_of_hiddens,
+                          int hidden_layers,
+                          int no_of_outputs);
+size_t bp_get_memory(bp * net);
 void bp_feed_forward(bp * net);
 void bp_feed_forward_layers(bp * net, int layers);
+int bp_widest_layer(bp * net);
+void bp_feed_forward_sample(bp * net, float inputs[], float outputs[],
+                            float buffer[]);
+void bp_feed_forward_from_layer(bp * net, int layer, float values[],
+                                float outputs[], float buffer[]);
+int bp_feed_forward_batch(bp * net, int batch_size,
+                          float inputs[], float outputs[]);
 void bp_backprop(bp * net, int current_hidden_layer);
 void bp_learn(bp * net, int current_hidden_layer);
 void bp_set_input_text(bp * net, char * text);
@@ -81,7 +126,13 @@ void bp_set_output(bp * net, int index, float value);
 float bp_get_hidden(bp * net, int layer, int index);
 float bp_get_output(bp * net, int index);
 float bp_get_desired(bp * net, int index);
+float bp_get_output_error(bp * net);
 void bp_update(bp * net, int current_hidden_layer);
+int bp_freeze_layer(bp * net, int layer, int frozen);
+int bp_set_output_activation(bp * net, int activation);
+int bp_set_sample_weight(bp * net, float weight);
+void bp_softmax(float values[], int n);
+int bp_layer_frozen(bp * net, int layer);
 int bp_save(FILE * fp, bp * net);
 int bp_load(FILE * fp, bp * net);
 int bp_compare(bp * net1, bp * net2);
@@ -96,12 +147,14 @@ int bp_plot_weights(bp * net,
                     char * filename,
                     int image_width, int image_height,
                     int input_image_width);
+int bp_classification_within_filename(char * filename, int * length);
 void bp_get_classification_from_filename(char * filename,
                                          char * classification);
 int bp_classifications_to_numbers(int no_of_instances,
                                   char ** instance_classification,
                                   int * numbers);
 void bp_reproject(bp * net, int layer, int neuron_index);
+int bp_reproject_layer(bp * net, int layer, float reprojected[]);
 void bp_normalise_inputs(bp * net);
 float bp_get_input(bp * net, int index);
 float bp_weight_gradient_mean(bp * net, int layer_index);
@@ -101,6 +101,12 @@ int bp_neuron_init(bp_neuron * n,
 
     n->no_of_inputs = no_of_inputs;
 
+    /* nothing allocated yet, so that bp_neuron_free can clean up
+       if any of the allocations below fail */
+    n->weights = 0;
+    n->last_weight_change = 0;
+    n->inputs = 0;
+
     /* create some weights */
     FLOATALLOC(n->weights, no_of_inputs);
     if (!n->weights)
@@ -158,6 +164,9 @@ void bp_neuron_free(bp_neuron * n)
     free(n->weights);
     free(n->last_weight_change);
 
+    if (n->inputs == 0)
+        return;
+
     /* clear the pointers to input neurons */
     COUNTDOWN(i, n->no_of_inputs)
         n->inputs[i]=0;
@@ -224,11 +233,60 @@ void bp_neuron_feedForward(bp_neuron * n,
     n->value = AF(adder);
 }
 
+/**
+* @brief Returns the activation of a neuron for the given input values.
+*        Unlike bp_neuron_feedForward this does not alter the neuron,
+*        and dropouts and noise are not applied
+* @param n Backprop neuron object
+* @param inputs Values of the inputs to the neuron
+* @return Result of the activation function
+*/
+float bp_neuron_activation(bp_neuron * n, float inputs[])
+{
+    return AF(bp_neuron_sum(n, inputs));
+}
+
+/**
+* @brief Returns the weighted sum of the given input values, before the
+*        activation function is applied. This does not alter the neuron
+* @param n Backprop neuron object
+* @param inputs Values of the inputs to the neuron
+* @return Weighted sum including the bias
+*/
+float bp_neuron_sum(bp_neuron * n, float inputs[])
+{
+    float adder = n->bias;
+
+    COUNTDOWN(i, n->no_of_inputs)
+        adder += n->weights[i] * inputs[i];
+
+    return adder;
+}
+
+/**
+* @brief Sets the value of a neuron to the weighted sum of its inputs,
+*        without applying the activation function. This is used for
+*        output units which are normalised together, as with softmax
+* @param n Backprop neuron object
+*/
+void bp_neuron_feedForward_linear(bp_neuron * n)
+{
+    float adder = n->bias;
+
+    COUNTDOWN(i, n->no_of_inputs)
+        adder += n->weights[i] * n->inputs[i]->value;
+
+    n->value = adder;
+}
+
 /**
 * @brief back-propagate the error
 * @param n Backprop neuron object
+* @param weight Weight of the training sample within the loss. This only
+*        applies to output units, since the errors of hidden units are
+*        already weighted by the errors propagated to them
 */
-void bp_neuron_backprop(bp_neuron * n)
+void bp_neuron_backprop(bp_neuron * n, float weight)
 {
     float bperr;
 
@@ -237,7 +295,7 @@ void bp_neuron_backprop(bp_neuron * n)
 
     /* output unit */
     if (n->desired_value > -1)
-        n->backprop_error = n->desired_value - n->value;
+        n->backprop_error = (n->desired_value - n->value) * weight;
 
     /* prepare variable so that we don't need to calculate
        it repeatedly within the loop */
@@ -248,6 +306,30 @@ void bp_neuron_backprop(bp_neuron * n)
         n->inputs[i]->backprop_error += bperr * n->weights[i];
 }
 
+/**
+* @brief back-propagate the error from a softmax output unit trained with
+*        cross entropy. The gradient of the combined softmax and cross
+*        entropy is the difference between the desired and actual
+*        probabilities, so no derivative of the activation is needed
+* @param n Backprop neuron object, whose value and desired value are
+*        probabilities scaled into the NEURON_LOW - NEURON_HIGH range
+* @param weight Weight of the training sample within the loss
+*/
+void bp_neuron_backprop_softmax(bp_neuron * n, float weight)
+{
+    float bperr;
+
+    if (n->excluded > 0) return;
+
+    if (n->desired_value > -1)
+        n->backprop_error = (n->desired_value - n->value) * weight;
+
+    bperr = n->backprop_error / NEURON_RANGE;
+
+    COUNTDOWN(i, n->no_of_inputs)
+        n->inputs[i]->backprop_error += bperr * n->weights[i];
+}
+
 /**
 * @brief Reprojects a neuron value back into the previous layer
 * @param n Backprop neuron object
@@ -263,20 +345,18 @@ void bp_neuron_reproject(bp_neuron * n)
 }
 
 /**
-* @brief Adjust the weights of a neuron
+* @brief Adjust the weights of a neuron using the given gradient
 * @param n Backprop neuron object
 * @param learning_rate Learning rate in the range 0.0 to 1.0
+* @param gradient Gradient of the error with respect to the weighted sum
 */
-void bp_neuron_learn(bp_neuron * n,
-                     float learning_rate)
+static void bp_neuron_learn_gradient(bp_neuron * n,
+                                     float learning_rate,
+                                     float gradient)
 {
-    float afact,e,gradient;
-
-    if (n->excluded > 0) return;
+    float e;
 
     e = learning_rate / (1.0f + n->no_of_inputs);
-    afact = af(n->value);
-    gradient = afact * n->backprop_error;
     n->last_bias_change = e * (n->last_bias_change + 1.0f) * gradient;
     n->bias += n->last_bias_change;
     n->min_weight = 9999;
@@ -300,6 +380,35 @@ void bp_neuron_learn(bp_neuron * n,
     }
 }
 
+/**
+* @brief Adjust the weights of a neuron
+* @param n Backprop neuron object
+* @param learning_rate Learning rate in the range 0.0 to 1.0
+*/
+void bp_neuron_learn(bp_neuron * n,
+                     float learning_rate)
+{
+    if (n->excluded > 0) return;
+
+    bp_neuron_learn_gradient(n, learning_rate,
+                             af(n->value) * n->backprop_error);
+}
+
+/**
+* @brief Adjust the weights of a softmax output unit trained with
+*        cross entropy
+* @param n Backprop neuron object
+* @param learning_rate Learning rate in the range 0.0 to 1.0
+*/
+void bp_neuron_learn_softmax(bp_neuron * n,
+                             float learning_rate)
+{
+    if (n->excluded > 0) return;
+
+    bp_neuron_learn_gradient(n, learning_rate,
+                             n->backprop_error / NEURON_RANGE);
+}
+
 /**
 * @brief Draws a test pattern within the input weights
 *        This can be used for debugging purposes
@@ -72,9 +72,15 @@ void bp_neuron_add_connection(bp_neuron * dest,
 void bp_neuron_feedForward(bp_neuron * n,
                            float noise,
                            unsigned int * random_seed);
-void bp_neuron_backprop(bp_neuron * n);
+void bp_neuron_feedForward_linear(bp_neuron * n);
+float bp_neuron_activation(bp_neuron * n, float inputs[]);
+float bp_neuron_sum(bp_neuron * n, float inputs[]);
+void bp_neuron_backprop(bp_neuron * n, float weight);
+void bp_neuron_backprop_softmax(bp_neuron * n, float weight);
 void bp_neuron_learn(bp_neuron * n,
                      float learning_rate);
+void bp_neuron_learn_softmax(bp_neuron * n,
+                             float learning_rate);
 void bp_neuron_free(bp_neuron * n);
 void bp_neuron_copy(bp_neuron * source,
                     bp_neuron * dest);
@@ -76,6 +76,26 @@ int deepconvnet_init(int no_of_convolutions,
                            "Training History",
                            "Time Step", "Training Error %");
 
+    /* nothing allocated yet, so that deepconvnet_free can clean up
+       if any of the allocations below fail */
+    convnet->convolution = NULL;
+    convnet->learner = NULL;
+    convnet->no_of_images = 0;
+    convnet->images = NULL;
+    convnet->classification_number = NULL;
+    convnet->training_set_index = NULL;
+    convnet->test_set_index = NULL;
+
+    /* fail before allocating anything if the convnet would not
+       fit within the memory budget */
+    if (deeplearn_memory_available() <
+        deepconvnet_estimate_memory(no_of_convolutions, no_of_deep_layers,
+                                    image_width, image_height, image_depth,
+                                    max_features, feature_width,
+                                    final_image_width, final_image_height,
+                                    no_of_outputs, 0))
+        return -5;
+
     convnet->convolution = (deeplearn_conv*)malloc(sizeof(deeplearn_conv));
 
     convnet->layer_itterations = layer_itterations;
@@ -89,13 +109,18 @@ int deepconvnet_init(int no_of_convolutions,
                   image_depth,
                   max_features, feature_width,
                   final_image_width, final_image_height,
-                  convnet->convolution) != 0)
+                  convnet->convolution) != 0) {
+        free(convnet->convolution);
+        convnet->convolution = NULL;
         return -2;
+    }
 
     convnet->learner = (deeplearn*)malloc(sizeof(deeplearn));
 
-    if (!convnet->learner)
+    if (!convnet->learner) {
+        deepconvnet_free(convnet);
         return -3;
+    }
 
     if (deeplearn_init(convnet->learner,
                        convnet->convolution->no_of_outputs,
@@ -103,22 +128,20 @@ int deepconvnet_init(int no_of_convolutions,
                        no_of_deep_layers,
                        no_of_outputs,
                        &error_threshold[0],
-                       random_seed) != 0)
+                       random_seed) != 0) {
+        free(convnet->learner);
+        convnet->learner = NULL;
+        deepconvnet_free(convnet);
         return -4;
+    }
 
     convnet->training_complete = 0;
-    convnet->no_of_images = 0;
-    convnet->images = NULL;
-    convnet->classifications = NULL;
-    convnet->classification_number = NULL;
 
     /* default history settings */
     convnet->backprop_error = DEEPLEARN_UNKNOWN_ERROR;
     convnet->training_ctr = 0;
 
     convnet->current_layer = 0;
-    convnet->training_set_index = NULL;
-    convnet->test_set_index = NULL;
     return 0;
 }
 
@@ -140,11 +163,17 @@ int deepconvnet_is_training(deepconvnet * convnet)
  */
 void deepconvnet_free(deepconvnet * convnet)
 {
-    conv_free(convnet->convolution);
-    free(convnet->convolution);
+    if (convnet->convolution != NULL) {
+        conv_free(convnet->convolution);
+        free(convnet->convolution);
+        convnet->convolution = NULL;
+    }
 
-    deeplearn_free(convnet->learner);
-    free(convnet->learner);
+    if (convnet->learner != NULL) {
+        deeplearn_free(convnet->learner);
+        free(convnet->learner);
+        convnet->learner = NULL;
+    }
 
     if (convnet->no_of_images > 0) {
         COUNTDOWN(i, convnet->no_of_images) {
@@ -152,10 +181,9 @@ void deepconvnet_free(deepconvnet * convnet)
                 free(convnet->images[i]);
                 convnet->images[i] = 0;
             }
-            free(convnet->classifications[i]);
         }
         free(convnet->images);
-        free(convnet->classifications);
+        deeplearn_labels_free(&convnet->labels);
         free(convnet->classification_number);
         convnet->no_of_images = 0;
     }
@@ -165,6 +193,101 @@ void deepconvnet_free(deepconvnet * convnet)
 
     if (convnet->test_set_index != NULL)
         free(convnet->test_set_index);
+
+    convnet->training_set_index = NULL;
+    convnet->test_set_index = NULL;
+}
+
+/**
+ * @brief Returns the number of bytes needed by a deep convnet with the
+ *        given parameters, including its training images, so that jobs
+ *        can be placed on machines with enough memory. The overhead of
+ *        the memory allocator is not included.
+ * @param no_of_convolutions Number of layers in the convolution
+ *        preprocessing stage
+ * @param no_of_deep_layers Number of layers in the deep learner
+ * @param image_width Horizontal resolution of input images
+ * @param image_height Vertical resolution of input images
+ * @param image_depth Depth of input images in bytes
+ * @param max_features The number of features learned at each convolution layer
+ * @param feature_width Width of each feature in the input image
+ * @param final_image_width Width of the output of the convolutional stage
+ * @param final_image_height Height of the output of the convolutional stage
+ * @param no_of_outputs Number of outputs of the deep learner
+ * @param no_of_images Number of training and test images
+ * @returns Number of bytes, or zero if the parameters are not valid
+ */
+size_t deepconvnet_estimate_memory(int no_of_convolutions,
+                                   int no_of_deep_layers,
+                                   int image_width,
+                                   int image_height,
+                                   int image_depth,
+                                   int max_features,
+                                   int feature_width,
+                                   int final_image_width,
+                                   int final_image_height,
+                                   int no_of_outputs,
+                                   int no_of_images)
+{
+    size_t conv_bytes =
+        conv_estimate_memory(no_of_convolutions,
+                             image_width, image_height, image_depth,
+                             max_features, feature_width,
+                             final_image_width, final_image_height);
+
+    /* size of the convolution outputs, as in conv_init */
+    int conv_outputs =
+        final_image_width*final_image_width*image_depth*max_features;
+
+    size_t bytes;
+
+    if (conv_bytes == 0)
+        return 0;
+
+    bytes = sizeof(deeplearn_conv) + conv_bytes + sizeof(deeplearn) +
+        deeplearn_estimate_memory(conv_outputs, conv_outputs*8/10,
+                                  no_of_deep_layers, no_of_outputs, 0);
+
+    /* images, their classifications and the indexes of the
+       training and test sets */
+    if (no_of_images > 0)
+        bytes += ((size_t)no_of_images*
+                  (sizeof(unsigned char*) + sizeof(int) +
+                   ((size_t)image_width*image_height*image_depth))) +
+            (((size_t)no_of_images + 2)*sizeof(int));
+
+    return bytes;
+}
+
+/**
+ * @brief Returns the number of bytes currently allocated by a deep
+ *        convnet, including its training images
+ * @param convnet Deep convnet object
+ * @returns Number of bytes
+ */
+size_t deepconvnet_get_memory(deepconvnet * convnet)
+{
+    size_t bytes = 0;
+
+    if (convnet->convolution != NULL) {
+        deeplearn_conv_layer * input = &convnet->convolution->layer[0];
+
+        bytes += sizeof(deeplearn_conv) +
+            conv_get_memory(convnet->convolution);
+
+        if (convnet->no_of_images > 0)
+            bytes += (size_t)convnet->no_of_images*
+                (sizeof(unsigned char*) + sizeof(int) +
+                 ((size_t)input->width*input->height*input->depth));
+    }
+
+    if (convnet->learner != NULL)
+        bytes += sizeof(deeplearn) + deeplearn_get_memory(convnet->learner);
+
+    if (convnet->training_set_index != NULL)
+        bytes += ((size_t)convnet->no_of_images + 2)*sizeof(int);
+
+    return bytes;
 }
 
 /**
@@ -357,6 +480,8 @@ int deepconvnet_update_img(deepconvnet * convnet, unsigned char img[],
  */
 int deepconvnet_test_img(deepconvnet * convnet, unsigned char img[])
 {
+    uint64_t start = deeplearn_metrics_start();
+
     conv_feed_forward(img, convnet->convolution,
                       convnet->convolution->no_of_layers);
 
@@ -366,6 +491,7 @@ int deepconvnet_test_img(deepconvnet * convnet, unsigned char img[])
 
     deeplearn_feed_forward(convnet->learner);
 
+    deeplearn_metrics_stop(DEEPLEARN_METRIC_CONVNET_TEST, start, 1);
     return 0;
 }
 
@@ -432,6 +558,33 @@ void deepconvnet_set_dropouts(deepconvnet * convnet, float dropout_percent)
     deeplearn_set_dropouts(convnet->learner, dropout_percent);
 }
 
+/**
+ * @brief Draws training images in proportion to their loss once the
+ *        convolution layers have been trained and the final layer of the
+ *        deep learner is being trained
+ * @param convnet Deep convnet object
+ * @param alpha Priority exponent. Zero or less returns to uniform sampling
+ * @param beta Importance weight exponent in the range 0.0 to 1.0
+ * @return zero on success
+ */
+int deepconvnet_set_prioritised_sampling(deepconvnet * convnet,
+                                         float alpha, float beta)
+{
+    return deeplearn_set_prioritised_sampling(convnet->learner, alpha, beta);
+}
+
+/**
+ * @brief Sets the activation of the output layer. Softmax is usually
+ *        better when there is one output per class
+ * @param convnet Deep convnet object
+ * @param activation BP_OUTPUT_SIGMOID or BP_OUTPUT_SOFTMAX
+ * @return zero on success
+ */
+int deepconvnet_set_output_activation(deepconvnet * convnet, int activation)
+{
+    return deeplearn_set_output_activation(convnet->learner, activation);
+}
+
 /**
  * @brief Uses gnuplot to plot the training error for the given learner
  * @param convnet Deep convnet object
@@ -446,6 +599,50 @@ int deepconvnet_plot_history(deepconvnet * convnet,
                                   image_width, image_height);
 }
 
+/**
+ * @brief Performs a final training step with a training image drawn
+ *        by the prioritised sampler
+ * @param convnet Deep convnet object
+ * @param training_images The number of training images
+ * @returns zero on success
+ */
+static int deepconvnet_training_prioritised(deepconvnet * convnet,
+                                            int training_images)
+{
+    deeplearn_sampler * sampler = convnet->learner->sampler;
+    float learning_rate = convnet->learner->net->learning_rate;
+    int index0, index, retval;
+
+    if (sampler->no_of_samples != training_images) {
+        if (sampler->no_of_samples > 0)
+            deeplearn_sampler_free(sampler);
+
+        sampler->no_of_samples = 0;
+        if (deeplearn_sampler_init(sampler, training_images,
+                                   sampler->alpha, sampler->beta) != 0)
+            return -3;
+    }
+
+    index0 = deeplearn_sampler_sample(sampler,
+                                      &convnet->learner->net->random_seed);
+    index = convnet->training_set_index[index0];
+
+    /* correct for the image being drawn more or less often than
+       it would be with uniform sampling */
+    convnet->learner->net->learning_rate *=
+        deeplearn_sampler_weight(sampler, index0);
+    retval = deepconvnet_update_img(convnet, convnet->images[index], 20,
+                                    convnet->layer_itterations,
+                                    convnet->classification_number[index]);
+    convnet->learner->net->learning_rate = learning_rate;
+    if (retval != 0)
+        return -2;
+
+    deeplearn_sampler_update(sampler, index0,
+                             bp_get_output_error(convnet->learner->net));
+    return 0;
+}
+
 /**
  * @brief Performs training
  * @param convnet Deep convnet object
@@ -471,6 +668,12 @@ int deepconvnet_training(deepconvnet * convnet)
     unsigned char * img = convnet->images[index];
     int samples = 20;
 
+    if ((convnet->learner->sampler != 0) &&
+        (convnet->convolution->current_layer >=
+         convnet->convolution->no_of_layers) &&
+        deeplearn_training_last_layer(convnet->learner))
+        return deepconvnet_training_prioritised(convnet, training_images);
+
     if (deepconvnet_update_img(convnet, img, samples,
                                convnet->layer_itterations,
                                convnet->classification_number[index]) != 0)
@@ -628,7 +831,7 @@ int deepconvnet_read_images(char * directory,
 
     convnet->no_of_images =
         deeplearn_load_training_images(directory, &convnet->images,
-                                       &convnet->classifications,
+                                       &convnet->labels,
                                        &convnet->classification_number,
                                        image_width, image_height,
                                        extra_synthetic_images);
@@ -61,7 +61,7 @@ typedef struct {
     /* training/test images */
     int no_of_images;
     unsigned char ** images;
-    char ** classifications;
+    deeplearn_labels labels;
     int * classification_number;
 
     unsigned int training_ctr;
@@ -91,6 +91,18 @@ int deepconvnet_init(int no_of_convolutions,
                      float error_threshold[],
                      unsigned int * random_seed);
 void deepconvnet_free(deepconvnet * convnet);
+size_t deepconvnet_estimate_memory(int no_of_convolutions,
+                                   int no_of_deep_layers,
+                                   int image_width,
+                                   int image_height,
+                                   int image_depth,
+                                   int max_features,
+                                   int feature_width,
+                                   int final_image_width,
+                                   int final_image_height,
+                                   int no_of_outputs,
+                                   int no_of_images);
+size_t deepconvnet_get_memory(deepconvnet * convnet);
 int deepconvnet_save(FILE * fp, deepconvnet * convnet);
 int deepconvnet_load(FILE * fp, deepconvnet * convnet);
 int deepconvnet_update_img(deepconvnet * convnet, unsigned char img[],
@@ -99,6 +111,9 @@ int deepconvnet_update_img(deepconvnet * convnet, unsigned char img[],
 int deepconvnet_test_img(deepconvnet * convnet, unsigned char img[]);
 void deepconvnet_set_learning_rate(deepconvnet * convnet, float rate);
 void deepconvnet_set_dropouts(deepconvnet * convnet, float dropout_percent);
+int deepconvnet_set_output_activation(deepconvnet * convnet, int activation);
+int deepconvnet_set_prioritised_sampling(deepconvnet * convnet,
+                                         float alpha, float beta);
 int deepconvnet_read_images(char * directory,
                             deepconvnet * convnet,
                             int image_width, int image_height,
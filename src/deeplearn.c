@@ -28,6 +28,9 @@
 */
 
 #include "deeplearn.h"
+#include "deeplearn_fixed.h"
+#include "deeplearndata_stream.h"
+#include "deeplearndata_quantise.h"
 
 /**
  * @brief Returns a training error threshold for the given layer
@@ -51,6 +54,37 @@ void deeplearn_set_error_threshold(deeplearn * learner, int index, float value)
     learner->error_threshold[index] = value;
 }
 
+/**
+ * @brief Returns the number of bytes allocated by deeplearn_init in
+ *        addition to those of the network and autocoders
+ * @param no_of_inputs The number of input units
+ * @param hidden_layers The number of hidden layers
+ * @param no_of_outputs The number of output units
+ * @returns Number of bytes
+ */
+static size_t deeplearn_base_memory(int no_of_inputs, int hidden_layers,
+                                    int no_of_outputs)
+{
+    /* network and autocoder objects, error thresholds
+       and input and output ranges */
+    return sizeof(bp) + ((size_t)hidden_layers*(sizeof(ac*) + sizeof(ac))) +
+        (((size_t)hidden_layers + 1 +
+          (((size_t)no_of_inputs + no_of_outputs)*2))*sizeof(float));
+}
+
+/**
+ * @brief Frees a partially initialised learner when an allocation fails
+ *        or a saved learner cannot be read
+ * @param learner Deep learner object
+ * @param retval The error to return
+ * @returns retval
+ */
+static int deeplearn_init_failed(deeplearn * learner, int retval)
+{
+    deeplearn_free(learner);
+    return retval;
+}
+
 /**
  * @brief Initialise a deep learner
  * @param learner Deep learner object
@@ -93,6 +127,39 @@ int deeplearn_init(deeplearn * learner,
 
     learner->no_of_input_fields = 0;
     learner->field_length = 0;
+    learner->model_version = 0;
+    learner->sampler = 0;
+    learner->stream = 0;
+    learner->mean_sample_weight = 1.0f;
+    learner->input_storage = DEEPLEARNDATA_STORE_FLOAT32;
+    learner->inputs_quantised = 0;
+    learner->inputs_quantised_bytes = 0;
+
+    /* nothing allocated yet, so that deeplearn_free can clean up
+       if any of the allocations below fail */
+    learner->input_range_min = 0;
+    learner->input_range_max = 0;
+    learner->output_range_min = 0;
+    learner->output_range_max = 0;
+    learner->error_threshold = 0;
+    learner->net = 0;
+    learner->autocoder = 0;
+    learner->memory = 0;
+
+    /* fail before allocating anything if the whole learner
+       would not fit within the memory budget */
+    if (deeplearn_memory_available() <
+        deeplearn_estimate_memory(no_of_inputs, no_of_hiddens,
+                                  hidden_layers, no_of_outputs, 0))
+        return -12;
+
+    if (deeplearn_memory_reserve(
+            deeplearn_base_memory(no_of_inputs, hidden_layers,
+                                  no_of_outputs)) != 0)
+        return -12;
+
+    learner->memory =
+        deeplearn_base_memory(no_of_inputs, hidden_layers, no_of_outputs);
 
     deeplearn_history_init(&learner->history, "training.png",
                            "Training History",
@@ -106,19 +173,19 @@ int deeplearn_init(deeplearn * learner,
 
     FLOATALLOC(learner->input_range_min, no_of_inputs);
     if (!learner->input_range_min)
-        return -1;
+        return deeplearn_init_failed(learner, -1);
 
     FLOATALLOC(learner->input_range_max, no_of_inputs);
     if (!learner->input_range_max)
-        return -2;
+        return deeplearn_init_failed(learner, -2);
 
     FLOATALLOC(learner->output_range_min, no_of_outputs);
     if (!learner->output_range_min)
-        return -3;
+        return deeplearn_init_failed(learner, -3);
 
     FLOATALLOC(learner->output_range_max, no_of_outputs);
     if (!learner->output_range_max)
-        return -4;
+        return deeplearn_init_failed(learner, -4);
 
     COUNTDOWN(i, no_of_inputs) {
         learner->input_range_min[i] = 99999;
@@ -136,7 +203,7 @@ int deeplearn_init(deeplearn * learner,
     /* create the error thresholds for each layer */
     FLOATALLOC(learner->error_threshold, hidden_layers+1);
     if (!learner->error_threshold)
-        return -5;
+        return deeplearn_init_failed(learner, -5);
 
     memcpy((void*)learner->error_threshold,
            (void*)error_threshold,
@@ -148,24 +215,25 @@ int deeplearn_init(deeplearn * learner,
     /* create the network */
     learner->net = (bp*)malloc(sizeof(bp));
     if (!learner->net)
-        return -6;
+        return deeplearn_init_failed(learner, -6);
 
     /* initialise the network */
     if (bp_init(learner->net,
                 no_of_inputs, no_of_hiddens,
                 hidden_layers, no_of_outputs,
                 random_seed) != 0)
-        return -7;
+        return deeplearn_init_failed(learner, -7);
 
     /* create the autocoder */
     learner->autocoder = (ac**)malloc(sizeof(ac*)*hidden_layers);
     if (!learner->autocoder)
-        return -8;
+        return deeplearn_init_failed(learner, -8);
+    memset(learner->autocoder, '\0', sizeof(ac*)*hidden_layers);
 
     COUNTUP(i, hidden_layers) {
         learner->autocoder[i] = (ac*)malloc(sizeof(ac));
         if (!learner->autocoder[i])
-            return -9;
+            return deeplearn_init_failed(learner, -9);
 
         if (i == 0) {
             /* if this is the first hidden layer then number of inputs
@@ -174,14 +242,14 @@ int deeplearn_init(deeplearn * learner,
             if (autocoder_init(learner->autocoder[i], no_of_inputs,
                                HIDDENS_IN_LAYER(learner->net,i),
                                learner->net->random_seed) != 0)
-                return -10;
+                return deeplearn_init_failed(learner, -10);
         }
         else {
             if (autocoder_init(learner->autocoder[i],
                                HIDDENS_IN_LAYER(learner->net,i-1),
                                HIDDENS_IN_LAYER(learner->net,i),
                                learner->net->random_seed) != 0)
-                return -11;
+                return deeplearn_init_failed(learner, -11);
         }
 
     }
@@ -208,7 +276,11 @@ void deeplearn_set_title(deeplearn * learner, char title[])
  */
 void deeplearn_feed_forward(deeplearn * learner)
 {
+    uint64_t start = deeplearn_metrics_start();
+
     bp_feed_forward(learner->net);
+
+    deeplearn_metrics_stop(DEEPLEARN_METRIC_FEED_FORWARD, start, 1);
 }
 
 /**
@@ -238,6 +310,7 @@ void copy_autocoder_to_hidden_layer(deeplearn * learner, int hidden_layer)
                &autocoder->weights[i*autocoder->no_of_inputs],
                autocoder->no_of_inputs*sizeof(float));
     }
+    learner->model_version++;
 }
 
 /**
@@ -248,6 +321,8 @@ void copy_autocoder_to_hidden_layer(deeplearn * learner, int hidden_layer)
  */
 void deeplearn_pretrain(bp * net, ac * autocoder, int current_layer)
 {
+    deeplearn_trace_begin_layer("deeplearn_pretrain", current_layer);
+
     bp_feed_forward_layers(net, current_layer);
     if (current_layer > 0) {
         /* copy the hidden unit values to the inputs
@@ -264,6 +339,8 @@ void deeplearn_pretrain(bp * net, ac * autocoder, int current_layer)
             autocoder_set_input(autocoder, i, bp_get_input(net, i));
     }
     autocoder_update(autocoder);
+
+    deeplearn_trace_end("deeplearn_pretrain");
 }
 
 /**
@@ -311,11 +388,14 @@ void deeplearn_update(deeplearn * learner)
 {
     float minimum_error_percent = 0;
     int current_layer = learner->current_hidden_layer;
+    uint64_t start;
 
     /* only continue if training is not complete */
     if (learner->training_complete == 1)
         return;
 
+    start = deeplearn_metrics_start();
+
     /* get the maximum backprop error after which a layer
        will be considered to have been trained */
     minimum_error_percent =
@@ -358,6 +438,7 @@ void deeplearn_update(deeplearn * learner)
     }
     else {
         bp_update(learner->net,0);
+        learner->model_version++;
 
         /* update the backprop error value */
         learner->backprop_error = learner->net->backprop_error_percent;
@@ -376,6 +457,8 @@ void deeplearn_update(deeplearn * learner)
     /* increment the number of itterations */
     if (learner->net->itterations < UINT_MAX)
         learner->net->itterations++;
+
+    deeplearn_metrics_stop(DEEPLEARN_METRIC_UPDATE, start, 1);
 }
 
 /**
@@ -408,10 +491,6 @@ void deeplearn_update_continuous(deeplearn * learner)
  */
 void deeplearn_free(deeplearn * learner)
 {
-    /* clear any data */
-    deeplearndata * sample = learner->data;
-    deeplearndata * prev_sample;
-
     free(learner->input_range_min);
     free(learner->input_range_max);
     free(learner->output_range_min);
@@ -419,25 +498,21 @@ void deeplearn_free(deeplearn * learner)
     if (learner->field_length != 0)
         free(learner->field_length);
 
-    while (sample != 0) {
-        prev_sample = sample;
-        sample = (deeplearndata *)sample->next;
-        if (prev_sample != 0) {
-            if (prev_sample->inputs_text != 0) {
-                /* clear any input text strings */
-                COUNTDOWN(i, learner->no_of_input_fields) {
-                    if (prev_sample->inputs_text[i] != 0)
-                        free(prev_sample->inputs_text[i]);
-                }
-                free(prev_sample->inputs_text);
-            }
-            /* clear numerical fields */
-            free(prev_sample->inputs);
-            free(prev_sample->outputs);
-            free(prev_sample);
-        }
+    if (learner->sampler != 0) {
+        deeplearn_sampler_free(learner->sampler);
+        free(learner->sampler);
+        learner->sampler = 0;
     }
 
+    /* samples appended while training are stored in chunks */
+    deeplearndata_stream_free(learner);
+    deeplearndata_free_samples(learner->data,
+                               learner->no_of_input_fields,
+                               learner->net != 0 ?
+                               learner->net->no_of_outputs : 0);
+    learner->data = 0;
+    deeplearndata_quantise_free(learner);
+
     /* free training samples */
     deeplearndata_meta * training_sample = learner->training_data;
     deeplearndata_meta * prev_training_sample;
@@ -467,20 +542,145 @@ void deeplearn_free(deeplearn * learner)
         free(prev_test_sample);
     }
 
+    /* free the indexed arrays */
+    free(learner->indexed_data);
+    learner->indexed_data = 0;
+    free(learner->indexed_training_data);
+    learner->indexed_training_data = 0;
+    free(learner->indexed_training_data_labeled);
+    learner->indexed_training_data_labeled = 0;
+    free(learner->indexed_test_data);
+    learner->indexed_test_data = 0;
+
     /* free the error thresholds */
     free(learner->error_threshold);
+    learner->error_threshold = 0;
 
     /* free the autocoder */
-    COUNTDOWN(i, learner->net->hidden_layers) {
-        autocoder_free(learner->autocoder[i]);
-        free(learner->autocoder[i]);
-        learner->autocoder[i] = 0;
+    if ((learner->autocoder != 0) && (learner->net != 0)) {
+        COUNTDOWN(i, learner->net->hidden_layers) {
+            if (learner->autocoder[i] == 0)
+                continue;
+            autocoder_free(learner->autocoder[i]);
+            free(learner->autocoder[i]);
+            learner->autocoder[i] = 0;
+        }
     }
     free(learner->autocoder);
+    learner->autocoder = 0;
 
     /* free the learner */
-    bp_free(learner->net);
-    free(learner->net);
+    if (learner->net != 0) {
+        bp_free(learner->net);
+        free(learner->net);
+        learner->net = 0;
+    }
+
+    deeplearn_memory_release(learner->memory);
+    learner->memory = 0;
+}
+
+/**
+ * @brief Returns the number of bytes needed by a learner of the given
+ *        size, including its training and test data, so that jobs can
+ *        be placed on machines with enough memory. Samples are assumed
+ *        to have one numeric field for each input unit. The overhead of
+ *        the memory allocator is not included.
+ * @param no_of_inputs The number of input units
+ * @param no_of_hiddens The number of units in the first hidden layer
+ * @param hidden_layers The number of hidden layers
+ * @param no_of_outputs The number of output units
+ * @param no_of_samples The number of training and test samples
+ * @returns Number of bytes
+ */
+size_t deeplearn_estimate_memory(int no_of_inputs,
+                                 int no_of_hiddens,
+                                 int hidden_layers,
+                                 int no_of_outputs,
+                                 int no_of_samples)
+{
+    bp net;
+    size_t bytes =
+        deeplearn_base_memory(no_of_inputs, hidden_layers, no_of_outputs) +
+        bp_estimate_memory(no_of_inputs, no_of_hiddens,
+                           hidden_layers, no_of_outputs);
+
+    /* dimensions needed by HIDDENS_IN_LAYER */
+    net.no_of_hiddens = no_of_hiddens;
+    net.hidden_layers = hidden_layers;
+    net.no_of_outputs = no_of_outputs;
+
+    COUNTUP(l, hidden_layers) {
+        int inputs = (l == 0 ? no_of_inputs : HIDDENS_IN_LAYER(&net,l-1));
+        bytes += autocoder_estimate_memory(inputs, HIDDENS_IN_LAYER(&net,l));
+    }
+
+    /* each sample is within the training or test set, training samples
+       are also listed as labeled, and each list has an index */
+    bytes += (size_t)no_of_samples*
+        (sizeof(deeplearndata) +
+         (((size_t)no_of_inputs + no_of_outputs)*sizeof(float)) +
+         (2*sizeof(deeplearndata_meta)) +
+         sizeof(deeplearndata*) + (2*sizeof(deeplearndata_meta*)));
+
+    return bytes;
+}
+
+/**
+ * @brief Returns the number of bytes currently allocated by a learner,
+ *        including its network, autocoders and data
+ * @param learner Deep learner object
+ * @returns Number of bytes
+ */
+size_t deeplearn_get_memory(deeplearn * learner)
+{
+    size_t bytes = learner->memory;
+    deeplearndata * sample = learner->data;
+
+    if (learner->net != 0) {
+        bytes += bp_get_memory(learner->net);
+
+        if (learner->autocoder != 0) {
+            COUNTDOWN(i, learner->net->hidden_layers) {
+                if (learner->autocoder[i] != 0)
+                    bytes += autocoder_get_memory(learner->autocoder[i]);
+            }
+        }
+    }
+
+    if (learner->field_length != 0)
+        bytes += (size_t)learner->no_of_input_fields*sizeof(int);
+
+    /* quantised inputs are within a single block */
+    bytes += learner->inputs_quantised_bytes;
+
+    while (sample != 0) {
+        bytes += deeplearndata_sample_memory(sample->inputs_text,
+                                             sample->inputs != 0,
+                                             learner->no_of_input_fields,
+                                             learner->net != 0 ?
+                                             learner->net->no_of_outputs : 0);
+        sample = sample->next;
+    }
+
+    bytes += ((size_t)learner->training_data_samples +
+              learner->training_data_labeled_samples +
+              learner->test_data_samples)*sizeof(deeplearndata_meta);
+
+    bytes += (size_t)learner->indexed_data_samples*sizeof(deeplearndata*);
+    bytes += ((size_t)learner->indexed_training_data_samples +
+              learner->indexed_training_data_labeled_samples +
+              learner->indexed_test_data_samples)*
+        sizeof(deeplearndata_meta*);
+
+    if (learner->sampler != 0) {
+        bytes += sizeof(deeplearn_sampler) +
+            ((size_t)learner->sampler->leaves*4*sizeof(float));
+        if (learner->sampler->weight != 0)
+            bytes += (size_t)learner->sampler->no_of_samples*sizeof(float);
+    }
+
+    return bytes;
 }
 
 /**
@@ -517,6 +717,9 @@ void deeplearn_set_inputs(deeplearn * learner, deeplearndata * sample)
     int pos = 0;
 
     COUNTUP(i, learner->no_of_input_fields) {
+        if (learner->field_length[i] == DEEPLEARN_FIELD_DROPPED)
+            continue;
+
         if (learner->field_length[i] > 0) {
             /* text value */
             enc_text_to_binary(sample->inputs_text[i],
@@ -527,12 +730,19 @@ void deeplearn_set_inputs(deeplearn * learner, deeplearndata * sample)
         }
         else {
             /* numerical */
-            value = sample->inputs[i];
             range = learner->input_range_max[i] - learner->input_range_min[i];
             if (range > 0) {
-                normalised =
-                    (((value - learner->input_range_min[i])/range)*
-                     NEURON_RANGE) + NEURON_LOW;
+                if (sample->inputs != 0) {
+                    value = sample->inputs[i];
+                    normalised =
+                        (((value - learner->input_range_min[i])/range)*
+                         NEURON_RANGE) + NEURON_LOW;
+                }
+                else
+                    normalised =
+                        (deeplearndata_quantised_position(learner,
+                                                          sample, i)*
+                         NEURON_RANGE) + NEURON_LOW;
                 deeplearn_set_input(learner, pos, normalised);
             }
             pos++;
@@ -540,6 +750,32 @@ void deeplearn_set_inputs(deeplearn * learner, deeplearndata * sample)
     }
 }
 
+/**
+ * @brief Returns the index of the first input unit for the given field
+ * @param learner Deep learner object
+ * @param fieldindex Index number of the input field
+ * @returns input unit index, or -1 if the field was dropped when the
+ *          data was loaded because it was constant or a duplicate
+ */
+int deeplearn_field_position(deeplearn * learner, int fieldindex)
+{
+    int pos = 0;
+
+    if (learner->field_length[fieldindex] == DEEPLEARN_FIELD_DROPPED)
+        return -1;
+
+    COUNTUP(i, fieldindex) {
+        if (learner->field_length[i] == DEEPLEARN_FIELD_DROPPED)
+            continue;
+
+        if (learner->field_length[i] == 0)
+            pos++;
+        else
+            pos += learner->field_length[i];
+    }
+    return pos;
+}
+
 /**
  * @brief Sets a numeric value for the given input field
  * @param learner Deep learner object
@@ -568,12 +804,11 @@ int deeplearn_set_input_field(deeplearn * learner, int fieldindex, float value)
         return -3;
 
     /* get the offset (first input unit index) of the input field */
-    COUNTUP(i, fieldindex) {
-        if (learner->field_length[i] == 0)
-            pos++;
-        else
-            pos += learner->field_length[i];
-    }
+    pos = deeplearn_field_position(learner, fieldindex);
+
+    /* the field was dropped, so the value makes no difference */
+    if (pos < 0)
+        return 0;
 
     /* set the value */
     bp_set_input(learner->net, pos, value);
@@ -601,17 +836,16 @@ int deeplearn_set_input_field_text(deeplearn * learner, int fieldindex,
     if (learner->field_length == 0)
         return -2;
 
-    /* this is a text field */
+    /* this is not a text field */
     if (learner->field_length[fieldindex] == 0)
         return -3;
 
     /* get the offset (first input unit index) of the input field */
-    COUNTUP(i, fieldindex) {
-        if (learner->field_length[i] == 0)
-            pos++;
-        else
-            pos += learner->field_length[i];
-    }
+    pos = deeplearn_field_position(learner, fieldindex);
+
+    /* the field was dropped, so the value makes no difference */
+    if (pos < 0)
+        return 0;
 
     /* set the value */
     enc_text_to_binary(text,
@@ -672,6 +906,214 @@ void deeplearn_get_outputs(deeplearn * learner, float outputs[])
     }
 }
 
+/**
+ * @brief Returns the number of entries within the input range arrays.
+ *        Ranges are kept for each input field, and when redundant fields
+ *        have been dropped there can be more fields than input units.
+ * @param learner Deep learner object
+ * @returns The number of input ranges
+ */
+int deeplearn_input_ranges(deeplearn * learner)
+{
+    if (learner->no_of_input_fields > learner->net->no_of_inputs)
+        return learner->no_of_input_fields;
+    return learner->net->no_of_inputs;
+}
+
+/**
+ * @brief Enlarges the input range arrays, which are created with one
+ *        entry per input unit, once the number of input fields is known
+ * @param learner Deep learner object
+ * @returns zero on success
+ */
+int deeplearn_resize_input_ranges(deeplearn * learner)
+{
+    int ranges = deeplearn_input_ranges(learner);
+    float * range_min, * range_max;
+
+    if (ranges <= learner->net->no_of_inputs)
+        return 0;
+
+    range_min = (float*)realloc(learner->input_range_min,
+                                ranges*sizeof(float));
+    if (!range_min)
+        return -1;
+    learner->input_range_min = range_min;
+
+    range_max = (float*)realloc(learner->input_range_max,
+                                ranges*sizeof(float));
+    if (!range_max)
+        return -2;
+    learner->input_range_max = range_max;
+
+    FOR(i, learner->net->no_of_inputs, ranges) {
+        learner->input_range_min[i] = 99999;
+        learner->input_range_max[i] = -99999;
+    }
+    return 0;
+}
+
+/**
+ * @brief Copies the field definitions and data ranges of the learner
+ *        which owns the data set into another learner having the same
+ *        inputs and outputs, so that samples can be presented to it in
+ *        the same way
+ * @param source Deep learner object which owns the data set
+ * @param learner Deep learner object to copy to
+ * @returns zero on success
+ */
+int deeplearn_copy_fields(deeplearn * source, deeplearn * learner)
+{
+    learner->no_of_input_fields = source->no_of_input_fields;
+    if ((source->no_of_input_fields > 0) && (source->field_length != 0)) {
+        INTALLOC(learner->field_length, source->no_of_input_fields);
+        if (!learner->field_length)
+            return -1;
+
+        memcpy((void*)learner->field_length, source->field_length,
+               source->no_of_input_fields*sizeof(int));
+    }
+
+    if (deeplearn_resize_input_ranges(learner) != 0)
+        return -2;
+
+    memcpy((void*)learner->input_range_min, source->input_range_min,
+           deeplearn_input_ranges(source)*sizeof(float));
+    memcpy((void*)learner->input_range_max, source->input_range_max,
+           deeplearn_input_ranges(source)*sizeof(float));
+    memcpy((void*)learner->output_range_min, source->output_range_min,
+           source->net->no_of_outputs*sizeof(float));
+    memcpy((void*)learner->output_range_max, source->output_range_max,
+           source->net->no_of_outputs*sizeof(float));
+
+    /* so that quantised samples can be presented */
+    learner->input_storage = source->input_storage;
+    return 0;
+}
+
+/**
+ * @brief Converts the field values of a sample into normalised input
+ *        values without altering the state of the network, so that many
+ *        samples may be prepared concurrently
+ * @param learner Deep learner object
+ * @param fields Numeric field values
+ * @param fields_text Text field values, or NULL if there are no text fields
+ * @param inputs Returned input values, one per input unit
+ * @returns zero on success
+ */
+int deeplearn_fields_to_inputs(deeplearn * learner,
+                               float fields[], char ** fields_text,
+                               float inputs[])
+{
+    float range;
+    int pos = 0;
+
+    COUNTDOWN(i, learner->net->no_of_inputs)
+        inputs[i] = NEURON_UNKNOWN;
+
+    /* No fields are defined, so each field is one input unit */
+    if (learner->no_of_input_fields == 0) {
+        COUNTDOWN(i, learner->net->no_of_inputs) {
+            range = learner->input_range_max[i] - learner->input_range_min[i];
+            if (range > 0)
+                inputs[i] =
+                    (((fields[i] - learner->input_range_min[i])/range)*
+                     NEURON_RANGE) + NEURON_LOW;
+        }
+        return 0;
+    }
+
+    COUNTUP(i, learner->no_of_input_fields) {
+        if (learner->field_length[i] == DEEPLEARN_FIELD_DROPPED)
+            continue;
+
+        if (learner->field_length[i] > 0) {
+            /* text value */
+            if (!fields_text)
+                return -1;
+
+            enc_text_to_float(fields_text[i], inputs,
+                              learner->net->no_of_inputs,
+                              pos, learner->field_length[i]/CHAR_BITS);
+            pos += learner->field_length[i];
+        }
+        else {
+            /* numerical */
+            range = learner->input_range_max[i] - learner->input_range_min[i];
+            if (range > 0)
+                inputs[pos] =
+                    (((fields[i] - learner->input_range_min[i])/range)*
+                     NEURON_RANGE) + NEURON_LOW;
+            pos++;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Feeds a batch of normalised input values through the network.
+ *        The state of the network is not altered, so this may be called
+ *        from several threads at the same time
+ * @param learner Deep learner object
+ * @param batch_size The number of samples within the batch
+ * @param inputs Input values with one value per input unit for each sample
+ * @param outputs Returned output values in the range NEURON_LOW to
+ *        NEURON_HIGH, with one value per output unit for each sample
+ * @returns zero on success
+ */
+int deeplearn_feed_forward_batch(deeplearn * learner, int batch_size,
+                                 float inputs[], float outputs[])
+{
+    uint64_t start = deeplearn_metrics_start();
+    int retval = bp_feed_forward_batch(learner->net, batch_size,
+                                       inputs, outputs);
+
+    deeplearn_metrics_stop(DEEPLEARN_METRIC_FEED_FORWARD_BATCH, start,
+                           batch_size);
+    return retval;
+}
+
+/**
+ * @brief Converts output unit values back into their normal range
+ * @param learner Deep learner object
+ * @param values Output unit values in the range NEURON_LOW to NEURON_HIGH
+ * @param outputs The returned output values
+ */
+void deeplearn_outputs_from_values(deeplearn * learner,
+                                   float values[], float outputs[])
+{
+    COUNTDOWN(i, learner->net->no_of_outputs) {
+        float range =
+            learner->output_range_max[i] - learner->output_range_min[i];
+        if (range > 0)
+            outputs[i] =
+                (((values[i] - NEURON_LOW)/NEURON_RANGE)*range) +
+                learner->output_range_min[i];
+        else
+            outputs[i] = values[i];
+    }
+}
+
+/**
+ * @brief Returns the class with the highest output value
+ * @param learner Deep learner object
+ * @param values Output unit values
+ * @return output class
+ */
+int deeplearn_class_from_values(deeplearn * learner, float values[])
+{
+    int class = -9999;
+    float max = -1;
+
+    COUNTDOWN(i, learner->net->no_of_outputs) {
+        if (values[i] > max) {
+            max = values[i];
+            class = i;
+        }
+    }
+    return class;
+}
+
 /**
  * @brief Returns the value of an output unit
  * @param learner Deep learner object
@@ -729,12 +1171,12 @@ void deeplearn_set_class(deeplearn * learner, int class)
 }
 
 /**
- * @brief Saves the given deep learner object to a file
+ * @brief Writes the fields of a deep learner object to a file
  * @param fp File pointer
  * @param learner Deep learner object
  * @return zero value on success
  */
-int deeplearn_save(FILE * fp, deeplearn * learner)
+static int deeplearn_write(FILE * fp, deeplearn * learner)
 {
     if (INTWRITE(learner->training_complete) == 0)
         return -1;
@@ -770,11 +1212,11 @@ int deeplearn_save(FILE * fp, deeplearn * learner)
 
     /* save ranges */
     if (FLOATWRITEARRAY(learner->input_range_min,
-                        learner->net->no_of_inputs) == 0)
+                        deeplearn_input_ranges(learner)) == 0)
         return -10;
 
     if (FLOATWRITEARRAY(learner->input_range_max,
-                        learner->net->no_of_inputs) == 0)
+                        deeplearn_input_ranges(learner)) == 0)
         return -11;
 
     if (FLOATWRITEARRAY(learner->output_range_min,
@@ -798,22 +1240,65 @@ int deeplearn_save(FILE * fp, deeplearn * learner)
 }
 
 /**
- * @brief Loads a deep learner object from file
+ * @brief Saves the given deep learner object to a file
  * @param fp File pointer
  * @param learner Deep learner object
  * @return zero value on success
  */
-int deeplearn_load(FILE * fp, deeplearn * learner)
+int deeplearn_save(FILE * fp, deeplearn * learner)
+{
+    int retval;
+
+    deeplearn_trace_begin("deeplearn_save");
+    retval = deeplearn_write(fp, learner);
+    deeplearn_trace_end("deeplearn_save");
+    return retval;
+}
+
+/**
+ * @brief Reads the fields of a deep learner object from a file
+ * @param fp File pointer
+ * @param learner Deep learner object
+ * @return zero value on success
+ */
+static int deeplearn_read(FILE * fp, deeplearn * learner)
 {
     /* no training/test data yet */
     learner->data = 0;
     learner->data_samples = 0;
+    learner->indexed_data = 0;
+    learner->indexed_data_samples = 0;
     learner->training_data = 0;
     learner->training_data_samples = 0;
+    learner->indexed_training_data = 0;
+    learner->indexed_training_data_samples = 0;
     learner->training_data_labeled = 0;
     learner->training_data_labeled_samples = 0;
+    learner->indexed_training_data_labeled = 0;
+    learner->indexed_training_data_labeled_samples = 0;
     learner->test_data = 0;
     learner->test_data_samples = 0;
+    learner->indexed_test_data = 0;
+    learner->indexed_test_data_samples = 0;
+    learner->model_version = 0;
+    learner->sampler = 0;
+    learner->stream = 0;
+    learner->mean_sample_weight = 1.0f;
+    learner->input_storage = DEEPLEARNDATA_STORE_FLOAT32;
+    learner->inputs_quantised = 0;
+    learner->inputs_quantised_bytes = 0;
+    learner->memory = 0;
+
+    /* nothing allocated yet, so that deeplearn_free can clean up
+       if the file cannot be read */
+    learner->input_range_min = 0;
+    learner->input_range_max = 0;
+    learner->output_range_min = 0;
+    learner->output_range_max = 0;
+    learner->error_threshold = 0;
+    learner->field_length = 0;
+    learner->net = 0;
+    learner->autocoder = 0;
 
     if (INTREAD(learner->training_complete) == 0)
         return -1;
@@ -827,81 +1312,204 @@ int deeplearn_load(FILE * fp, deeplearn * learner)
     if (INTREAD(learner->no_of_input_fields) == 0)
         return -5;
 
-    learner->field_length = 0;
     if (learner->no_of_input_fields > 0) {
         INTALLOC(learner->field_length,
                  learner->no_of_input_fields);
-        if (INTREADARRAY(learner->field_length,
-                         learner->no_of_input_fields) == 0)
-            return -6;
+        if ((!learner->field_length) ||
+            (INTREADARRAY(learner->field_length,
+                          learner->no_of_input_fields) == 0))
+            return deeplearn_init_failed(learner, -6);
     }
 
     learner->net = (bp*)malloc(sizeof(bp));
+    if (!learner->net)
+        return deeplearn_init_failed(learner, -7);
 
-    if (bp_load(fp, learner->net) != 0)
-        return -7;
+    /* a network which could not be loaded has already been freed */
+    if (bp_load(fp, learner->net) != 0) {
+        free(learner->net);
+        learner->net = 0;
+        return deeplearn_init_failed(learner, -7);
+    }
+
+    if (deeplearn_memory_reserve(
+            deeplearn_base_memory(learner->net->no_of_inputs,
+                                  learner->net->hidden_layers,
+                                  learner->net->no_of_outputs)) != 0)
+        return deeplearn_init_failed(learner, -26);
 
-    learner->autocoder = (ac**)malloc(sizeof(ac*)*learner->net->hidden_layers);
+    learner->memory = deeplearn_base_memory(learner->net->no_of_inputs,
+                                            learner->net->hidden_layers,
+                                            learner->net->no_of_outputs);
+
+    learner->autocoder =
+        (ac**)calloc(learner->net->hidden_layers, sizeof(ac*));
     if (!learner->autocoder)
-        return -8;
+        return deeplearn_init_failed(learner, -8);
 
     COUNTUP(i, learner->net->hidden_layers) {
-        learner->autocoder[i] = (ac*)malloc(sizeof(ac));
-        if (autocoder_load(fp, learner->autocoder[i], 1) != 0)
-            return -9;
+        ac * autocoder = (ac*)malloc(sizeof(ac));
+        if (!autocoder)
+            return deeplearn_init_failed(learner, -9);
+
+        if (autocoder_load(fp, autocoder, 1) != 0) {
+            free(autocoder);
+            return deeplearn_init_failed(learner, -9);
+        }
+        learner->autocoder[i] = autocoder;
     }
 
     /* load error thresholds */
     FLOATALLOC(learner->error_threshold, learner->net->hidden_layers+1);
-    if (FLOATREADARRAY(learner->error_threshold,
-                       learner->net->hidden_layers+1) == 0)
-        return -10;
+    if ((!learner->error_threshold) ||
+        (FLOATREADARRAY(learner->error_threshold,
+                        learner->net->hidden_layers+1) == 0))
+        return deeplearn_init_failed(learner, -10);
 
     /* load ranges */
-    FLOATALLOC(learner->input_range_min, learner->net->no_of_inputs);
+    FLOATALLOC(learner->input_range_min, deeplearn_input_ranges(learner));
     if (!learner->input_range_min)
-        return -15;
+        return deeplearn_init_failed(learner, -15);
 
-    FLOATALLOC(learner->input_range_max, learner->net->no_of_inputs);
+    FLOATALLOC(learner->input_range_max, deeplearn_input_ranges(learner));
     if (!learner->input_range_max)
-        return -16;
+        return deeplearn_init_failed(learner, -16);
 
     FLOATALLOC(learner->output_range_min, learner->net->no_of_outputs);
     if (!learner->output_range_min)
-        return -17;
+        return deeplearn_init_failed(learner, -17);
 
     FLOATALLOC(learner->output_range_max, learner->net->no_of_outputs);
     if (!learner->output_range_max)
-        return -18;
+        return deeplearn_init_failed(learner, -18);
 
     if (FLOATREADARRAY(learner->input_range_min,
-                       learner->net->no_of_inputs) == 0)
-        return -19;
+                       deeplearn_input_ranges(learner)) == 0)
+        return deeplearn_init_failed(learner, -19);
 
     if (FLOATREADARRAY(learner->input_range_max,
-                       learner->net->no_of_inputs) == 0)
-        return -20;
+                       deeplearn_input_ranges(learner)) == 0)
+        return deeplearn_init_failed(learner, -20);
 
     if (FLOATREADARRAY(learner->output_range_min,
                        learner->net->no_of_outputs) == 0)
-        return -21;
+        return deeplearn_init_failed(learner, -21);
 
     if (FLOATREADARRAY(learner->output_range_max,
                        learner->net->no_of_outputs) == 0)
-        return -22;
+        return deeplearn_init_failed(learner, -22);
 
     if (fread(&learner->history, sizeof(deeplearn_history), 1, fp) == 0)
-        return -23;
+        return deeplearn_init_failed(learner, -23);
 
     if (fread(&learner->gradients_std, sizeof(deeplearn_history), 1, fp) == 0)
-        return -24;
+        return deeplearn_init_failed(learner, -24);
 
     if (fread(&learner->gradients_mean, sizeof(deeplearn_history), 1, fp) == 0)
-        return -25;
+        return deeplearn_init_failed(learner, -25);
 
     return 0;
 }
 
+/**
+ * @brief Loads a deep learner object from file
+ * @param fp File pointer
+ * @param learner Deep learner object
+ * @return zero value on success
+ */
+int deeplearn_load(FILE * fp, deeplearn * learner)
+{
+    int retval;
+
+    deeplearn_trace_begin("deeplearn_load");
+    retval = deeplearn_read(fp, learner);
+    deeplearn_trace_end("deeplearn_load");
+    return retval;
+}
+
+/**
+ * @brief Transplants pretrained hidden layers and their autocoders from
+ *        one learner into another having the same inputs, so that
+ *        pretraining of those layers can be skipped. The layers must
+ *        have the same dimensions. Inputs are normalised using the ranges
+ *        of the receiving learner, so both should have similar data.
+ * @param source Deep learner object to copy layers from
+ * @param learner Deep learner object to copy layers to
+ * @param no_of_layers The number of hidden layers to transplant,
+ *        starting from the first
+ * @return zero on success
+ */
+int deeplearn_transplant(deeplearn * source, deeplearn * learner,
+                         int no_of_layers)
+{
+    bp * src = source->net;
+    bp * net = learner->net;
+
+    if ((no_of_layers < 1) ||
+        (no_of_layers > src->hidden_layers) ||
+        (no_of_layers > net->hidden_layers))
+        return -1;
+
+    /* only layers which have been pretrained */
+    if (source->current_hidden_layer < no_of_layers)
+        return -2;
+
+    if (src->no_of_inputs != net->no_of_inputs)
+        return -3;
+
+    if (source->no_of_input_fields != learner->no_of_input_fields)
+        return -4;
+
+    COUNTDOWN(i, learner->no_of_input_fields) {
+        if (source->field_length[i] != learner->field_length[i])
+            return -5;
+    }
+
+    COUNTUP(l, no_of_layers) {
+        if (HIDDENS_IN_LAYER(src,l) != HIDDENS_IN_LAYER(net,l))
+            return -6;
+    }
+
+    COUNTUP(l, no_of_layers) {
+        COUNTDOWN(i, HIDDENS_IN_LAYER(net,l))
+            bp_neuron_copy(src->hiddens[l][i], net->hiddens[l][i]);
+
+        if (autocoder_copy(source->autocoder[l], learner->autocoder[l]) != 0)
+            return -7;
+    }
+
+    /* continue training after the transplanted layers */
+    if (learner->current_hidden_layer < no_of_layers)
+        learner->current_hidden_layer = no_of_layers;
+    learner->training_complete = 0;
+    learner->backprop_error = DEEPLEARN_UNKNOWN_ERROR;
+    learner->model_version++;
+    return 0;
+}
+
+/**
+ * @brief Transplants pretrained hidden layers and their autocoders from
+ *        a saved deep learner into another learner
+ * @param fp File pointer for the saved deep learner
+ * @param learner Deep learner object to copy layers to
+ * @param no_of_layers The number of hidden layers to transplant,
+ *        starting from the first
+ * @return zero on success
+ */
+int deeplearn_transplant_load(FILE * fp, deeplearn * learner,
+                              int no_of_layers)
+{
+    deeplearn source;
+    int retval;
+
+    if (deeplearn_load(fp, &source) != 0)
+        return -1;
+
+    retval = deeplearn_transplant(&source, learner, no_of_layers);
+    deeplearn_free(&source);
+    return retval;
+}
+
 /**
  * @brief Compares two deep learners and returns a greater
  *        than zero value if they are the same
@@ -951,7 +1559,11 @@ int deeplearn_compare(deeplearn * learner1,
             return -10;
     }
 
-    COUNTDOWN(i, learner1->net->no_of_inputs) {
+    if (learner1->no_of_input_fields !=
+        learner2->no_of_input_fields)
+        return -15;
+
+    COUNTDOWN(i, deeplearn_input_ranges(learner1)) {
         if (learner1->input_range_min[i] !=
             learner2->input_range_min[i])
             return -11;
@@ -971,10 +1583,6 @@ int deeplearn_compare(deeplearn * learner1,
             return -14;
     }
 
-    if (learner1->no_of_input_fields !=
-        learner2->no_of_input_fields)
-        return -15;
-
     return 1;
 }
 
@@ -1082,56 +1690,104 @@ void deeplearn_set_dropouts(deeplearn * learner, float dropout_percent)
 }
 
 /**
- * @brief Exports a trained network as a standalone C program
+ * @brief Draws labeled training samples in proportion to their loss rather
+ *        than uniformly, so that examples which are already handled well
+ *        are seen less often. The learning rate for each sample is scaled
+ *        by its importance weight to correct for the sampling bias
  * @param learner Deep learner object
- * @param export_type The flavor of C
- * @param filename The C source file to be produced
- * @returns zero on success
+ * @param alpha Priority exponent, typically DEEPLEARN_SAMPLER_ALPHA.
+ *        Zero or less returns to uniform sampling
+ * @param beta Importance weight exponent, typically DEEPLEARN_SAMPLER_BETA
+ * @return zero on success
  */
-static int deeplearn_export_c_base(deeplearn * learner, int export_type,
-                                   char * filename)
+int deeplearn_set_prioritised_sampling(deeplearn * learner,
+                                       float alpha, float beta)
 {
-    FILE * fp;
-    int no_of_weights;
+    if (learner->sampler != 0) {
+        deeplearn_sampler_free(learner->sampler);
+        free(learner->sampler);
+        learner->sampler = 0;
+    }
 
-    fp = fopen(filename,"w");
-    if (!fp)
+    if (alpha <= 0)
+        return 0;
+
+    /* the priorities are created when the number of samples is known */
+    learner->sampler = (deeplearn_sampler*)malloc(sizeof(deeplearn_sampler));
+    if (!learner->sampler)
         return -1;
 
-    if (export_type == EXPORT_C99) {
-        fprintf(fp,"%s\n", "#include <stdio.h>");
-        fprintf(fp,"%s\n", "#include <stdlib.h>");
+    learner->sampler->no_of_samples = 0;
+    learner->sampler->sum_tree = 0;
+    learner->sampler->min_tree = 0;
+    learner->sampler->weight = 0;
+    learner->sampler->alpha = alpha;
+    learner->sampler->beta = beta;
+    return 0;
+}
 
-        if (learner->no_of_input_fields > 0)
-            fprintf(fp,"%s\n", "#include <string.h>");
+/**
+ * @brief Sets the activation of the output layer. Softmax outputs trained
+ *        with cross entropy usually converge faster for classification,
+ *        where there is one output per class set by deeplearn_set_class
+ * @param learner Deep learner object
+ * @param activation BP_OUTPUT_SIGMOID or BP_OUTPUT_SOFTMAX
+ * @return zero on success
+ */
+int deeplearn_set_output_activation(deeplearn * learner, int activation)
+{
+    int previous = learner->net->output_activation;
 
-        fprintf(fp,"%s\n\n", "#include <math.h>");
-    }
+    if (bp_set_output_activation(learner->net, activation) != 0)
+        return -1;
 
-#if ACTIVATION_FUNCTION == AF_SIGMOID
-    fprintf(fp,"%s\n\n", "#define AF(adder) (1.0f / (1.0f + exp(-(adder))))");
-#elif ACTIVATION_FUNCTION == AF_TANH
-    fprintf(fp,"%s\n\n", "#define AF(adder) " \
-            "((((2.0f / (1.0f + exp(-(2*adder)))) - 1.0f)*0.5f)+0.5f)");
-#elif ACTIVATION_FUNCTION == AF_LINEAR
-    fprintf(fp,"%s\n\n", "#define AF(adder) " \
-            "((adder) < 1.0f ? ((adder) > -1.0f ? " \
-            "(((adder)*0.5f)+0.5f) : 0.0f) : 1.0f)");
-#endif
+    /* every output changes, so cached predictions are no longer valid */
+    if (activation != previous)
+        learner->model_version++;
+    return 0;
+}
 
-    if (learner->no_of_input_fields > 0)
-        fprintf(fp, "const int no_of_input_fields = %d;\n",
-                learner->no_of_input_fields);
+/**
+ * @brief Freezes the given number of hidden layers, starting from the
+ *        first, so that only the layers above them are fine tuned.
+ *        The remaining layers are unfrozen.
+ * @param learner Deep learner object
+ * @param no_of_layers The number of hidden layers to freeze
+ * @returns zero on success
+ */
+int deeplearn_freeze_layers(deeplearn * learner, int no_of_layers)
+{
+    if ((no_of_layers < 0) || (no_of_layers > learner->net->hidden_layers))
+        return -1;
 
-    fprintf(fp, "const int no_of_inputs = %d;\n",
-            learner->net->no_of_inputs);
-    fprintf(fp, "const int no_of_hiddens = %d;\n",
-            learner->net->no_of_hiddens);
-    fprintf(fp, "const int no_of_outputs = %d;\n",
-            learner->net->no_of_outputs);
-    fprintf(fp, "const int hidden_layers = %d;\n\n",
-            learner->net->hidden_layers);
+    COUNTDOWN(l, learner->net->hidden_layers)
+        bp_freeze_layer(learner->net, l, l < no_of_layers);
 
+    return 0;
+}
+
+/**
+ * @brief Returns the number of input values given to an exported program,
+ *        which is one per field if the learner has input fields, including
+ *        any fields which were dropped
+ * @param learner Deep learner object
+ * @returns number of input values
+ */
+static int deeplearn_input_values(deeplearn * learner)
+{
+    if (learner->no_of_input_fields > 0)
+        return learner->no_of_input_fields;
+    return learner->net->no_of_inputs;
+}
+
+/**
+ * @brief Writes the field lengths and the ranges of the inputs and
+ *        outputs within an exported C program
+ * @param learner Deep learner object
+ * @param fp File to write to
+ */
+static void deeplearn_export_c_ranges(deeplearn * learner, FILE * fp)
+{
     /* field lengths */
     if (learner->field_length != 0) {
         if (learner->no_of_input_fields > 0) {
@@ -1149,17 +1805,17 @@ static int deeplearn_export_c_base(deeplearn * learner, int export_type,
     /* ranges */
     fprintf(fp, "%s", "float input_range_min[] = {\n");
     fprintf(fp, "%s", "  ");
-    COUNTUP(i, learner->net->no_of_inputs) {
+    COUNTUP(i, deeplearn_input_ranges(learner)) {
         fprintf(fp, "%.10f", learner->input_range_min[i]);
-        if (i < learner->net->no_of_inputs-1)
+        if (i < deeplearn_input_ranges(learner)-1)
             fprintf(fp, ",");
     }
     fprintf(fp, "%s", "\n};\n\n");
     fprintf(fp, "%s", "float input_range_max[] = {\n");
     fprintf(fp, "%s", "  ");
-    COUNTUP(i, learner->net->no_of_inputs) {
+    COUNTUP(i, deeplearn_input_ranges(learner)) {
         fprintf(fp, "%.10f", learner->input_range_max[i]);
-        if (i < learner->net->no_of_inputs-1)
+        if (i < deeplearn_input_ranges(learner)-1)
             fprintf(fp, ",");
     }
     fprintf(fp, "%s", "\n};\n\n");
@@ -1179,6 +1835,290 @@ static int deeplearn_export_c_base(deeplearn * learner, int export_type,
             fprintf(fp, ",");
     }
     fprintf(fp, "%s", "\n};\n\n");
+}
+
+/**
+ * @brief Writes a function which encodes text fields within an
+ *        exported C program
+ * @param learner Deep learner object
+ * @param fp File to write to
+ */
+static void deeplearn_export_c_encode_text(deeplearn * learner, FILE * fp)
+{
+    if (learner->no_of_input_fields == 0)
+        return;
+
+    fprintf(fp, "%s", "/* Encode some text into the input units */\n");
+    fprintf(fp, "%s", "void encode_text(char * text,\n");
+    fprintf(fp, "%s",
+            "                 float * inputs, int no_of_inputs,\n");
+    fprintf(fp, "%s",
+            "                 int offset, int max_field_length_chars)\n");
+
+    fprintf(fp, "%s",
+            "{\n  int pos = offset, i, bit, max_chars = strlen(text);\n\n");
+
+    fprintf(fp, "  if (max_chars > (no_of_inputs-offset)/%d) {\n",
+            (int)CHAR_BITS);
+    fprintf(fp, "    max_chars = ((no_of_inputs-offset)/%d);\n",
+            (int)CHAR_BITS);
+    fprintf(fp, "%s", "  }\n");
+    fprintf(fp, "%s", "  if (max_chars > max_field_length_chars) {\n");
+    fprintf(fp, "%s", "    max_chars = max_field_length_chars;\n");
+    fprintf(fp, "%s", "  }\n\n");
+
+    fprintf(fp, "%s", "  /* for each character in the string */\n");
+    fprintf(fp, "%s", "  for (i = 0; i < max_chars; i++) {\n");
+    fprintf(fp, "%s", "    /* set the bits for this character */\n");
+    fprintf(fp, "    for (bit = 0; bit < %d; bit++, pos++) {\n",
+            (int)CHAR_BITS);
+    fprintf(fp, "%s", "      if (text[i] & (1<<bit)) {\n");
+    fprintf(fp,       "        inputs[pos] = %.2f;\n", NEURON_HIGH);
+    fprintf(fp, "%s", "      }\n");
+    fprintf(fp, "%s", "      else {\n");
+    fprintf(fp,       "        inputs[pos] = %.2f;\n", NEURON_LOW);
+    fprintf(fp, "%s", "      }\n");
+    fprintf(fp, "%s", "    }\n");
+    fprintf(fp, "%s", "  }\n");
+    fprintf(fp, "%s",
+            "  /* set the remaining inputs within the field to neutral */\n");
+    fprintf(fp, "%s", "  while (i < max_field_length_chars) {\n");
+    fprintf(fp,       "    for (bit = 0; bit < %d; bit++) {\n",
+            (int)CHAR_BITS);
+    fprintf(fp, "%s", "      if (pos >= no_of_inputs) {\n");
+    fprintf(fp, "%s", "        i = max_field_length_chars;\n");
+    fprintf(fp, "%s", "        break;\n");
+    fprintf(fp, "%s", "      }\n");
+    fprintf(fp,       "      inputs[pos++] = %.1f;\n", NEURON_UNKNOWN);
+    fprintf(fp, "%s", "    }\n");
+    fprintf(fp, "%s", "    i++;\n");
+    fprintf(fp, "%s", "  }\n");
+    fprintf(fp, "%s", "}\n\n");
+}
+
+/**
+ * @brief Writes the entry point of an exported C program
+ * @param export_type The flavor of C
+ * @param fp File to write to
+ */
+static void deeplearn_export_c_entry(int export_type, FILE * fp)
+{
+    if (export_type == EXPORT_C99)
+        fprintf(fp, "%s", "int main(int argc, char* argv[])\n");
+    else {
+        fprintf(fp, "%s", "void setup()\n");
+        fprintf(fp, "%s", "{\n");
+        fprintf(fp, "%s", "  Serial.begin(115200);\n");
+        fprintf(fp, "%s", "}\n\n");
+        fprintf(fp, "%s", "void loop()\n");
+    }
+
+    fprintf(fp, "%s", "{\n");
+}
+
+/**
+ * @brief Writes the part of an exported C program which reads the
+ *        inputs and normalises them into network_inputs
+ * @param learner Deep learner object
+ * @param export_type The flavor of C
+ * @param fp File to write to
+ */
+static void deeplearn_export_c_inputs(deeplearn * learner, int export_type,
+                                      FILE * fp)
+{
+    if (export_type == EXPORT_C99) {
+        fprintf(fp, "  if (argc < %d) return -1;\n\n",
+                deeplearn_input_values(learner));
+        fprintf(fp, "%s",
+                "  /* Obtain input values from command arguments */\n");
+        fprintf(fp, "%s", "  for (i = 1; i < argc; i++) {\n");
+        fprintf(fp, "    if (i > %d) return -2;\n",
+                deeplearn_input_values(learner));
+        fprintf(fp, "%s", "    inputs[i-1] = atof(argv[i]);\n");
+        fprintf(fp, "%s", "  }\n\n");
+    }
+    else {
+        fprintf(fp, "%s", "  /* Change the read pin numbers as needed */\n");
+        COUNTUP(i, deeplearn_input_values(learner))
+            fprintf(fp, "  inputs[%d] = analogRead(%d);\n", i, i);
+        fprintf(fp, "%s", "\n");
+    }
+
+    if (learner->no_of_input_fields == 0) {
+        fprintf(fp,
+                "  /* Normalise inputs into a %.2f - %.2f range */\n",
+                NEURON_LOW, NEURON_HIGH);
+        fprintf(fp, "%s", "  for (i = 0; i < no_of_inputs; i++) {\n");
+        fprintf(fp, "    network_inputs[i] = %.2f + ((inputs[i] - " \
+                "input_range_min[i])*%.2f/(input_range_max[i] - " \
+                "input_range_min[i]));\n",
+                NEURON_LOW, NEURON_RANGE);
+        fprintf(fp,
+                "    if (network_inputs[i] < %.2f) " \
+                "network_inputs[i] = %.2f;\n",
+                NEURON_LOW, NEURON_LOW);
+        fprintf(fp,
+                "    if (network_inputs[i] > %.2f) " \
+                "network_inputs[i] = %.2f;\n",
+                NEURON_HIGH, NEURON_HIGH);
+        fprintf(fp, "%s", "  }\n\n");
+    }
+    else {
+        fprintf(fp, "%s", "  pos = 0;\n");
+        fprintf(fp, "%s", "  for (i = 0; i < no_of_input_fields; i++) {\n");
+        fprintf(fp, "%s", "    /* constant or duplicated field */\n");
+        fprintf(fp, "    if (field_length[i] == %d) continue;\n",
+                DEEPLEARN_FIELD_DROPPED);
+        fprintf(fp, "%s", "    if (field_length[i] == 0) {\n");
+        fprintf(fp,
+                "      /* Normalise numeric inputs into a " \
+                "%.2f - %.2f range */\n",
+                NEURON_LOW, NEURON_HIGH);
+        fprintf(fp, "      network_inputs[pos] = %.2f + " \
+                "((inputs[i] - input_range_min[i])*%.2f/" \
+                "(input_range_max[i] - input_range_min[i]));\n",
+                NEURON_LOW, NEURON_RANGE);
+        fprintf(fp,
+                "      if (network_inputs[pos] < %.2f) " \
+                "network_inputs[pos] = %.2f;\n",
+                NEURON_LOW, NEURON_LOW);
+        fprintf(fp, "      if (network_inputs[pos] > %.2f) " \
+                "network_inputs[pos] = %.2f;\n",
+                NEURON_HIGH, NEURON_HIGH);
+        fprintf(fp, "%s", "      pos++;\n");
+        fprintf(fp, "%s", "    }\n");
+        fprintf(fp, "%s", "    else {\n");
+        fprintf(fp, "%s", "      /* text value */\n");
+        if (export_type == EXPORT_C99)
+            fprintf(fp, "%s", "      encode_text(argv[i+1], " \
+                    "network_inputs, no_of_inputs,\n");
+        else
+            fprintf(fp, "%s", "      encode_text(\"\", " \
+                    "network_inputs, no_of_inputs,\n");
+
+        fprintf(fp,       "                  pos, field_length[i]/%d);\n",
+                (int)CHAR_BITS);
+        fprintf(fp, "%s", "      pos += field_length[i];\n");
+        fprintf(fp, "%s", "    }\n");
+        fprintf(fp, "%s", "  }\n\n");
+    }
+}
+
+/**
+ * @brief Writes a softmax over the output sums of an exported C program
+ * @param fp File to write to
+ */
+static void deeplearn_export_c_softmax(FILE * fp)
+{
+    fprintf(fp, "%s", "  /* Softmax */\n");
+    fprintf(fp, "%s", "  {\n");
+    fprintf(fp, "%s", "    float max = outputs[0], total = 0;\n");
+    fprintf(fp, "%s", "    for (i = 1; i < no_of_outputs; i++) {\n");
+    fprintf(fp, "%s", "      if (outputs[i] > max) max = outputs[i];\n");
+    fprintf(fp, "%s", "    }\n");
+    fprintf(fp, "%s", "    for (i = 0; i < no_of_outputs; i++) {\n");
+    fprintf(fp, "%s", "      outputs[i] = exp(outputs[i] - max);\n");
+    fprintf(fp, "%s", "      total += outputs[i];\n");
+    fprintf(fp, "%s", "    }\n");
+    fprintf(fp, "%s", "    for (i = 0; i < no_of_outputs; i++) {\n");
+    fprintf(fp, "      outputs[i] = %.2f + (outputs[i]*%.2f/total);\n",
+            NEURON_LOW, NEURON_RANGE);
+    fprintf(fp, "%s", "    }\n");
+    fprintf(fp, "%s", "  }\n\n");
+}
+
+/**
+ * @brief Writes the part of an exported C program which converts the
+ *        outputs back to their original range and then shows them
+ * @param export_type The flavor of C
+ * @param fp File to write to
+ */
+static void deeplearn_export_c_outputs(int export_type, FILE * fp)
+{
+    fprintf(fp, "%s", "  for (i = 0; i < no_of_outputs; i++) {\n");
+    fprintf(fp, "    /* Convert outputs from %.2f - %.2f " \
+            "back to their original range */\n",
+            NEURON_LOW, NEURON_HIGH);
+    fprintf(fp, "    outputs[i] = output_range_min[i] + " \
+            "((outputs[i]-%.2f)*(output_range_max[i] - " \
+            "output_range_min[i])/%.2f);\n",
+            NEURON_LOW, NEURON_RANGE);
+
+    if (export_type == EXPORT_C99) {
+        fprintf(fp, "%s", "    /* Send the outputs to stdout */\n");
+        fprintf(fp, "%s", "    printf(\"%.10f\",outputs[i]);\n");
+        fprintf(fp, "%s", "    if (i < no_of_outputs-1) {\n");
+        fprintf(fp, "%s", "      printf(\" \");\n");
+        fprintf(fp, "%s", "    }\n");
+        fprintf(fp, "%s", "  }\n\n");
+        fprintf(fp, "%s", "  printf(\"\\n\");");
+        fprintf(fp, "%s", "\n");
+        fprintf(fp, "%s", "  return 0;\n");
+    }
+    else {
+        fprintf(fp, "%s", "    /* Do something with the outputs here */\n");
+        fprintf(fp, "%s", "    Serial.print(outputs[i]);\n");
+        fprintf(fp, "%s", "    if (i < no_of_outputs-1) {\n");
+        fprintf(fp, "%s", "      Serial.print(\" \");\n");
+        fprintf(fp, "%s", "    }\n");
+        fprintf(fp, "%s", "  }\n\n");
+        fprintf(fp, "%s", "  Serial.println(\"\");");
+        fprintf(fp, "%s", "\n");
+    }
+}
+
+/**
+ * @brief Exports a trained network as a standalone C program
+ * @param learner Deep learner object
+ * @param export_type The flavor of C
+ * @param filename The C source file to be produced
+ * @returns zero on success
+ */
+static int deeplearn_export_c_base(deeplearn * learner, int export_type,
+                                   char * filename)
+{
+    FILE * fp;
+    int no_of_weights;
+
+    fp = fopen(filename,"w");
+    if (!fp)
+        return -1;
+
+    if (export_type == EXPORT_C99) {
+        fprintf(fp,"%s\n", "#include <stdio.h>");
+        fprintf(fp,"%s\n", "#include <stdlib.h>");
+
+        if (learner->no_of_input_fields > 0)
+            fprintf(fp,"%s\n", "#include <string.h>");
+
+        fprintf(fp,"%s\n\n", "#include <math.h>");
+    }
+
+#if ACTIVATION_FUNCTION == AF_SIGMOID
+    fprintf(fp,"%s\n\n", "#define AF(adder) (1.0f / (1.0f + exp(-(adder))))");
+#elif ACTIVATION_FUNCTION == AF_TANH
+    fprintf(fp,"%s\n\n", "#define AF(adder) " \
+            "((((2.0f / (1.0f + exp(-(2*adder)))) - 1.0f)*0.5f)+0.5f)");
+#elif ACTIVATION_FUNCTION == AF_LINEAR
+    fprintf(fp,"%s\n\n", "#define AF(adder) " \
+            "((adder) < 1.0f ? ((adder) > -1.0f ? " \
+            "(((adder)*0.5f)+0.5f) : 0.0f) : 1.0f)");
+#endif
+
+    if (learner->no_of_input_fields > 0)
+        fprintf(fp, "const int no_of_input_fields = %d;\n",
+                learner->no_of_input_fields);
+
+    fprintf(fp, "const int no_of_inputs = %d;\n",
+            learner->net->no_of_inputs);
+    fprintf(fp, "const int no_of_hiddens = %d;\n",
+            learner->net->no_of_hiddens);
+    fprintf(fp, "const int no_of_outputs = %d;\n",
+            learner->net->no_of_outputs);
+    fprintf(fp, "const int hidden_layers = %d;\n\n",
+            learner->net->hidden_layers);
+
+    deeplearn_export_c_ranges(learner, fp);
 
     /* hidden unit weights */
     COUNTUP(i, learner->net->hidden_layers) {
@@ -1240,72 +2180,15 @@ static int deeplearn_export_c_base(deeplearn * learner, int export_type,
             fprintf(fp, ",");
     }
     fprintf(fp, "%s", "\n};\n\n");
-    fprintf(fp, "float inputs[%d];\n",learner->net->no_of_inputs);
+    fprintf(fp, "float inputs[%d];\n",deeplearn_input_values(learner));
     fprintf(fp, "float network_inputs[%d];\n",learner->net->no_of_inputs);
-    fprintf(fp, "float prev_hiddens[%d];\n",learner->net->no_of_hiddens);
-    fprintf(fp, "float hiddens[%d];\n",learner->net->no_of_hiddens);
+    fprintf(fp, "float prev_hiddens[%d];\n",bp_widest_layer(learner->net));
+    fprintf(fp, "float hiddens[%d];\n",bp_widest_layer(learner->net));
     fprintf(fp, "float outputs[%d];\n\n",learner->net->no_of_outputs);
 
-    if (learner->no_of_input_fields > 0) {
-        fprintf(fp, "%s", "/* Encode some text into the input units */\n");
-        fprintf(fp, "%s", "void encode_text(char * text,\n");
-        fprintf(fp, "%s",
-                "                 float * inputs, int no_of_inputs,\n");
-        fprintf(fp, "%s",
-                "                 int offset, int max_field_length_chars)\n");
-
-        fprintf(fp, "%s",
-                "{\n  int pos = offset, i, bit, max_chars = strlen(text);\n\n");
-
-        fprintf(fp, "  if (max_chars > (no_of_inputs-offset)/%d) {\n",
-                (int)CHAR_BITS);
-        fprintf(fp, "    max_chars = ((no_of_inputs-offset)/%d);\n",
-                (int)CHAR_BITS);
-        fprintf(fp, "%s", "  }\n");
-        fprintf(fp, "%s", "  if (max_chars > max_field_length_chars) {\n");
-        fprintf(fp, "%s", "    max_chars = max_field_length_chars;\n");
-        fprintf(fp, "%s", "  }\n\n");
-
-        fprintf(fp, "%s", "  /* for each character in the string */\n");
-        fprintf(fp, "%s", "  for (i = 0; i < max_chars; i++) {\n");
-        fprintf(fp, "%s", "    /* set the bits for this character */\n");
-        fprintf(fp, "    for (bit = 0; bit < %d; bit++, pos++) {\n",
-                (int)CHAR_BITS);
-        fprintf(fp, "%s", "      if (text[i] & (1<<bit)) {\n");
-        fprintf(fp,       "        inputs[pos] = %.2f;\n", NEURON_HIGH);
-        fprintf(fp, "%s", "      }\n");
-        fprintf(fp, "%s", "      else {\n");
-        fprintf(fp,       "        inputs[pos] = %.2f;\n", NEURON_LOW);
-        fprintf(fp, "%s", "      }\n");
-        fprintf(fp, "%s", "    }\n");
-        fprintf(fp, "%s", "  }\n");
-        fprintf(fp, "%s",
-                "  /* set the remaining inputs within the field to neutral */\n");
-        fprintf(fp, "%s", "  while (i < max_field_length_chars) {\n");
-        fprintf(fp,       "    for (bit = 0; bit < %d; bit++) {\n",
-                (int)CHAR_BITS);
-        fprintf(fp, "%s", "      if (pos >= no_of_inputs) {\n");
-        fprintf(fp, "%s", "        i = max_field_length_chars;\n");
-        fprintf(fp, "%s", "        break;\n");
-        fprintf(fp, "%s", "      }\n");
-        fprintf(fp,       "      inputs[pos++] = %.1f;\n", NEURON_UNKNOWN);
-        fprintf(fp, "%s", "    }\n");
-        fprintf(fp, "%s", "    i++;\n");
-        fprintf(fp, "%s", "  }\n");
-        fprintf(fp, "%s", "}\n\n");
-    }
-
-    if (export_type == EXPORT_C99)
-        fprintf(fp, "%s", "int main(int argc, char* argv[])\n");
-    else {
-        fprintf(fp, "%s", "void setup()\n");
-        fprintf(fp, "%s", "{\n");
-        fprintf(fp, "%s", "  Serial.begin(115200);\n");
-        fprintf(fp, "%s", "}\n\n");
-        fprintf(fp, "%s", "void loop()\n");
-    }
+    deeplearn_export_c_encode_text(learner, fp);
 
-    fprintf(fp, "%s", "{\n");
+    deeplearn_export_c_entry(export_type, fp);
 
     if (learner->no_of_input_fields == 0)
         fprintf(fp, "%s", "  int i,j;\n");
@@ -1314,82 +2197,7 @@ static int deeplearn_export_c_base(deeplearn * learner, int export_type,
 
     fprintf(fp, "%s", "  float sum;\n\n");
 
-    if (export_type == EXPORT_C99) {
-        if (learner->no_of_input_fields == 0)
-            fprintf(fp, "  if (argc < %d) return -1;\n\n",
-                    learner->net->no_of_inputs);
-        else
-            fprintf(fp, "  if (argc < %d) return -1;\n\n",
-                    learner->no_of_input_fields);
-        fprintf(fp, "%s",
-                "  /* Obtain input values from command arguments */\n");
-        fprintf(fp, "%s", "  for (i = 1; i < argc; i++) {\n");
-        fprintf(fp, "%s", "    if (i > no_of_inputs) return -2;\n");
-        fprintf(fp, "%s", "    inputs[i-1] = atof(argv[i]);\n");
-        fprintf(fp, "%s", "  }\n\n");
-    }
-    else {
-        fprintf(fp, "%s", "  /* Change the read pin numbers as needed */\n");
-        COUNTUP(i, learner->net->no_of_inputs)
-            fprintf(fp, "  inputs[%d] = analogRead(%d);\n", i, i);
-        fprintf(fp, "%s", "\n");
-    }
-
-    if (learner->no_of_input_fields == 0) {
-        fprintf(fp,
-                "  /* Normalise inputs into a %.2f - %.2f range */\n",
-                NEURON_LOW, NEURON_HIGH);
-        fprintf(fp, "%s", "  for (i = 0; i < no_of_inputs; i++) {\n");
-        fprintf(fp, "    network_inputs[i] = %.2f + ((inputs[i] - " \
-                "input_range_min[i])*%.2f/(input_range_max[i] - " \
-                "input_range_min[i]));\n",
-                NEURON_LOW, NEURON_RANGE);
-        fprintf(fp,
-                "    if (network_inputs[i] < %.2f) " \
-                "network_inputs[i] = %.2f;\n",
-                NEURON_LOW, NEURON_LOW);
-        fprintf(fp,
-                "    if (network_inputs[i] > %.2f) " \
-                "network_inputs[i] = %.2f;\n",
-                NEURON_HIGH, NEURON_HIGH);
-        fprintf(fp, "%s", "  }\n\n");
-    }
-    else {
-        fprintf(fp, "%s", "  pos = 0;\n");
-        fprintf(fp, "%s", "  for (i = 0; i < no_of_input_fields; i++) {\n");
-        fprintf(fp, "%s", "    if (field_length[i] == 0) {\n");
-        fprintf(fp,
-                "      /* Normalise numeric inputs into a " \
-                "%.2f - %.2f range */\n",
-                NEURON_LOW, NEURON_HIGH);
-        fprintf(fp, "      network_inputs[pos] = %.2f + " \
-                "((inputs[i] - input_range_min[i])*%.2f/" \
-                "(input_range_max[i] - input_range_min[i]));\n",
-                NEURON_LOW, NEURON_RANGE);
-        fprintf(fp,
-                "      if (network_inputs[pos] < %.2f) " \
-                "network_inputs[pos] = %.2f;\n",
-                NEURON_LOW, NEURON_LOW);
-        fprintf(fp, "      if (network_inputs[pos] > %.2f) " \
-                "network_inputs[pos] = %.2f;\n",
-                NEURON_HIGH, NEURON_HIGH);
-        fprintf(fp, "%s", "      pos++;\n");
-        fprintf(fp, "%s", "    }\n");
-        fprintf(fp, "%s", "    else {\n");
-        fprintf(fp, "%s", "      /* text value */\n");
-        if (export_type == EXPORT_C99)
-            fprintf(fp, "%s", "      encode_text(argv[i+1], " \
-                    "network_inputs, no_of_inputs,\n");
-        else
-            fprintf(fp, "%s", "      encode_text(\"\", " \
-                    "network_inputs, no_of_inputs,\n");
-
-        fprintf(fp,       "                  pos, field_length[i]/%d);\n",
-                (int)CHAR_BITS);
-        fprintf(fp, "%s", "      pos += field_length[i];\n");
-        fprintf(fp, "%s", "    }\n");
-        fprintf(fp, "%s", "  }\n\n");
-    }
+    deeplearn_export_c_inputs(learner, export_type, fp);
 
     fprintf(fp, "%s", "  /* Hidden layer 0 */\n");
     fprintf(fp, "%s", "  for (i = 0; i < no_of_hiddens; i++) {\n");
@@ -1429,40 +2237,18 @@ static int deeplearn_export_c_base(deeplearn * learner, int export_type,
     fprintf(fp, "      sum += output_layer_weights[i*%d+j]*prev_hiddens[j];\n",
             HIDDENS_IN_LAYER(learner->net,learner->net->hidden_layers-1));
     fprintf(fp, "%s", "    }\n");
-    fprintf(fp, "%s", "    outputs[i] = AF(sum);\n");
-    fprintf(fp, "%s", "  }\n\n");
-
-    fprintf(fp, "%s", "  for (i = 0; i < no_of_outputs; i++) {\n");
-    fprintf(fp, "    /* Convert outputs from %.2f - %.2f " \
-            "back to their original range */\n",
-            NEURON_LOW, NEURON_HIGH);
-    fprintf(fp, "    outputs[i] = output_range_min[i] + " \
-            "((outputs[i]-%.2f)*(output_range_max[i] - " \
-            "output_range_min[i])/%.2f);\n",
-            NEURON_LOW, NEURON_RANGE);
-
-    if (export_type == EXPORT_C99) {
-        fprintf(fp, "%s", "    /* Send the outputs to stdout */\n");
-        fprintf(fp, "%s", "    printf(\"%.10f\",outputs[i]);\n");
-        fprintf(fp, "%s", "    if (i < no_of_outputs-1) {\n");
-        fprintf(fp, "%s", "      printf(\" \");\n");
-        fprintf(fp, "%s", "    }\n");
+    if (learner->net->output_activation == BP_OUTPUT_SOFTMAX) {
+        fprintf(fp, "%s", "    outputs[i] = sum;\n");
         fprintf(fp, "%s", "  }\n\n");
-        fprintf(fp, "%s", "  printf(\"\\n\");");
-        fprintf(fp, "%s", "\n");
-        fprintf(fp, "%s", "  return 0;\n");
+        deeplearn_export_c_softmax(fp);
     }
     else {
-        fprintf(fp, "%s", "    /* Do something with the outputs here */\n");
-        fprintf(fp, "%s", "    Serial.print(outputs[i]);\n");
-        fprintf(fp, "%s", "    if (i < no_of_outputs-1) {\n");
-        fprintf(fp, "%s", "      Serial.print(\" \");\n");
-        fprintf(fp, "%s", "    }\n");
+        fprintf(fp, "%s", "    outputs[i] = AF(sum);\n");
         fprintf(fp, "%s", "  }\n\n");
-        fprintf(fp, "%s", "  Serial.println(\"\");");
-        fprintf(fp, "%s", "\n");
     }
 
+    deeplearn_export_c_outputs(export_type, fp);
+
     fprintf(fp, "%s", "}\n");
     fclose(fp);
     return 0;
@@ -1490,6 +2276,285 @@ static int deeplearn_export_arduino(deeplearn * learner, char * filename)
     return deeplearn_export_c_base(learner, EXPORT_ARDUINO, filename);
 }
 
+/**
+ * @brief Writes an array of fixed point weights within an exported program
+ * @param fixed Fixed point network
+ * @param layer Index of the layer
+ * @param name Name of the array
+ * @param fp File to write to
+ */
+static void deeplearn_export_fixed_weights(deeplearn_fixed * fixed,
+                                           int layer, char * name, FILE * fp)
+{
+    int n = fixed->units[layer]*fixed->no_of_inputs[layer];
+
+    fprintf(fp, "const weight_t %s_weights[] PROGMEM = {\n  ", name);
+    COUNTUP(i, n) {
+        fprintf(fp, "%d", (int)fixed->weights[layer][i]);
+        if (i < n-1)
+            fprintf(fp, ",");
+    }
+    fprintf(fp, "%s", "\n};\n\n");
+
+    fprintf(fp, "const sum_t %s_bias[] = {\n  ", name);
+    COUNTUP(i, fixed->units[layer]) {
+        fprintf(fp, "%lld", (long long)fixed->bias[layer][i]);
+        if (i < fixed->units[layer]-1)
+            fprintf(fp, ",");
+    }
+    fprintf(fp, "%s", "\n};\n\n");
+}
+
+/**
+ * @brief Writes the weighted sums for one layer within an exported program
+ * @param fixed Fixed point network
+ * @param layer Index of the layer
+ * @param name Name of the weights array
+ * @param fp File to write to
+ */
+static void deeplearn_export_fixed_sum(deeplearn_fixed * fixed,
+                                       int layer, char * name, FILE * fp)
+{
+    int no_of_inputs = fixed->no_of_inputs[layer];
+
+    fprintf(fp, "  for (i = 0; i < %d; i++) {\n", fixed->units[layer]);
+    fprintf(fp, "    sum = %s_bias[i];\n", name);
+    fprintf(fp, "    for (j = 0; j < %d; j++) {\n", no_of_inputs);
+    fprintf(fp, "      sum += (sum_t)READ_WEIGHT(%s_weights[i*%d+j])*" \
+            "prev_hiddens[j];\n", name, no_of_inputs);
+    fprintf(fp, "%s", "    }\n");
+}
+
+/**
+ * @brief Writes the expression which converts the sum of a unit into
+ *        a position within the lookup table
+ * @param fixed Fixed point network
+ * @param layer Index of the layer
+ * @param fp File to write to
+ */
+static void deeplearn_export_fixed_lut_position(deeplearn_fixed * fixed,
+                                                int layer, FILE * fp)
+{
+    int shift = fixed->lut_shift[layer];
+
+    if (shift > 0)
+        fprintf(fp, "sum >> %d", shift);
+    else if (shift < 0)
+        fprintf(fp, "sum * (sum_t)%ld", 1L << -shift);
+    else
+        fprintf(fp, "%s", "sum");
+}
+
+/**
+ * @brief Exports a trained network as a standalone C program which only
+ *        uses integer arithmetic to feed forward, for microcontrollers
+ *        without floating point hardware. Weights are quantised to either
+ *        8 or 16 bits with a separate scale for each layer, and the
+ *        activation function is a lookup table. If the learner has test
+ *        data then the performance of the float and fixed point networks
+ *        on it is reported at the top of the program.
+ * @param learner Deep learner object
+ * @param filename The C source file to be produced. If it includes the
+ *        word "sketch" or "arduino" then Arduino C will be produced.
+ * @param bits DEEPLEARN_FIXED_Q7 or DEEPLEARN_FIXED_Q15
+ * @returns zero on success, or -1 if the network cannot be quantised
+ *          to this precision
+ */
+int deeplearn_export_fixed(deeplearn * learner, char * filename, int bits)
+{
+    FILE * fp;
+    deeplearn_fixed fixed;
+    int export_type = EXPORT_C99;
+    int last = learner->net->hidden_layers;
+    int widest;
+    char name[32];
+
+    if (deeplearn_fixed_init(&fixed, learner->net, bits) != 0)
+        return -1;
+
+    if ((strstr(filename, "sketch") != NULL) ||
+        (strstr(filename, "arduino") != NULL))
+        export_type = EXPORT_ARDUINO;
+
+    fp = fopen(filename,"w");
+    if (!fp) {
+        deeplearn_fixed_free(&fixed);
+        return -2;
+    }
+
+    fprintf(fp, "/* Q%d fixed point network */\n", fixed.activation_bits);
+    if (learner->test_data_samples > 0) {
+        float fixed_performance =
+            deeplearn_fixed_get_performance(&fixed, learner);
+        float float_performance = deeplearndata_get_performance(learner);
+        fprintf(fp, "/* Test set performance %.3f%%, " \
+                "floating point %.3f%%, difference %.3f%% */\n",
+                fixed_performance, float_performance,
+                fixed_performance - float_performance);
+    }
+    fprintf(fp, "%s", "\n");
+
+    if (export_type == EXPORT_C99) {
+        fprintf(fp,"%s\n", "#include <stdio.h>");
+        fprintf(fp,"%s\n", "#include <stdlib.h>");
+        fprintf(fp,"%s\n", "#include <stdint.h>");
+
+        if (learner->no_of_input_fields > 0)
+            fprintf(fp,"%s\n", "#include <string.h>");
+
+        if (fixed.softmax)
+            fprintf(fp,"%s\n", "#include <math.h>");
+        fprintf(fp, "%s", "\n");
+    }
+
+    /* weights and the lookup table are kept in flash on AVR */
+    fprintf(fp, "%s", "#if defined(__AVR__)\n");
+    fprintf(fp, "%s", "#include <avr/pgmspace.h>\n");
+    if (bits == DEEPLEARN_FIXED_Q7) {
+        fprintf(fp, "%s",
+                "#define READ_WEIGHT(w) ((weight_t)pgm_read_byte(&(w)))\n");
+        fprintf(fp, "%s",
+                "#define READ_LUT(v) ((activation_t)pgm_read_byte(&(v)))\n");
+    }
+    else {
+        fprintf(fp, "%s",
+                "#define READ_WEIGHT(w) ((weight_t)pgm_read_word(&(w)))\n");
+        fprintf(fp, "%s",
+                "#define READ_LUT(v) ((activation_t)pgm_read_word(&(v)))\n");
+    }
+    fprintf(fp, "%s", "#else\n");
+    fprintf(fp, "%s", "#ifndef PROGMEM\n");
+    fprintf(fp, "%s", "#define PROGMEM\n");
+    fprintf(fp, "%s", "#endif\n");
+    fprintf(fp, "%s", "#define READ_WEIGHT(w) (w)\n");
+    fprintf(fp, "%s", "#define READ_LUT(v) (v)\n");
+    fprintf(fp, "%s", "#endif\n\n");
+
+    if (bits == DEEPLEARN_FIXED_Q7) {
+        fprintf(fp, "%s", "typedef int8_t weight_t;\n");
+        fprintf(fp, "%s", "typedef uint8_t activation_t;\n");
+        fprintf(fp, "%s", "typedef int32_t sum_t;\n\n");
+    }
+    else {
+        fprintf(fp, "%s", "typedef int16_t weight_t;\n");
+        fprintf(fp, "%s", "typedef uint16_t activation_t;\n");
+        fprintf(fp, "%s", "typedef int64_t sum_t;\n\n");
+    }
+
+    if (learner->no_of_input_fields > 0)
+        fprintf(fp, "const int no_of_input_fields = %d;\n",
+                learner->no_of_input_fields);
+
+    fprintf(fp, "const int no_of_inputs = %d;\n",
+            learner->net->no_of_inputs);
+    fprintf(fp, "const int no_of_hiddens = %d;\n",
+            learner->net->no_of_hiddens);
+    fprintf(fp, "const int no_of_outputs = %d;\n",
+            learner->net->no_of_outputs);
+    fprintf(fp, "const int hidden_layers = %d;\n\n",
+            learner->net->hidden_layers);
+
+    deeplearn_export_c_ranges(learner, fp);
+
+    COUNTUP(l, learner->net->hidden_layers) {
+        sprintf(name, "hidden_layer_%d", l);
+        deeplearn_export_fixed_weights(&fixed, l, name, fp);
+    }
+    deeplearn_export_fixed_weights(&fixed, last, "output_layer", fp);
+
+    fprintf(fp, "/* Activation function from %d to %d " \
+            "in steps of 1/%d */\n",
+            -DEEPLEARN_FIXED_LUT_RANGE, DEEPLEARN_FIXED_LUT_RANGE,
+            DEEPLEARN_FIXED_LUT_STEPS);
+    fprintf(fp, "%s", "const activation_t lut[] PROGMEM = {\n  ");
+    COUNTUP(i, DEEPLEARN_FIXED_LUT_SIZE) {
+        fprintf(fp, "%d", (int)fixed.lut[i]);
+        if (i < DEEPLEARN_FIXED_LUT_SIZE-1)
+            fprintf(fp, ",");
+    }
+    fprintf(fp, "%s", "\n};\n\n");
+
+    widest = deeplearn_fixed_widest(&fixed);
+
+    fprintf(fp, "float inputs[%d];\n",deeplearn_input_values(learner));
+    fprintf(fp, "float network_inputs[%d];\n",learner->net->no_of_inputs);
+    fprintf(fp, "activation_t prev_hiddens[%d];\n", widest);
+    fprintf(fp, "activation_t hiddens[%d];\n", widest);
+    fprintf(fp, "float outputs[%d];\n\n",learner->net->no_of_outputs);
+
+    deeplearn_export_c_encode_text(learner, fp);
+
+    fprintf(fp, "%s",
+            "/* Interpolates the activation function for a table position */\n");
+    fprintf(fp, "%s", "activation_t activation(sum_t t)\n");
+    fprintf(fp, "%s", "{\n");
+    fprintf(fp, "  sum_t index = (t >> %d) + %d;\n",
+            DEEPLEARN_FIXED_LUT_FRACTION, DEEPLEARN_FIXED_LUT_SIZE/2);
+    fprintf(fp, "%s", "  activation_t low;\n\n");
+    fprintf(fp, "%s", "  if (index < 0) return READ_LUT(lut[0]);\n");
+    fprintf(fp, "  if (index >= %d) return READ_LUT(lut[%d]);\n",
+            DEEPLEARN_FIXED_LUT_SIZE-1, DEEPLEARN_FIXED_LUT_SIZE-1);
+    fprintf(fp, "%s", "  low = READ_LUT(lut[index]);\n");
+    fprintf(fp, "  return low + (activation_t)((((int32_t)READ_LUT(" \
+            "lut[index+1]) - low)*(int32_t)(t & %d)) >> %d);\n",
+            (1 << DEEPLEARN_FIXED_LUT_FRACTION) - 1,
+            DEEPLEARN_FIXED_LUT_FRACTION);
+    fprintf(fp, "%s", "}\n\n");
+
+    deeplearn_export_c_entry(export_type, fp);
+
+    if (learner->no_of_input_fields == 0)
+        fprintf(fp, "%s", "  int i,j;\n");
+    else
+        fprintf(fp, "%s", "  int i,j,pos;\n");
+
+    fprintf(fp, "%s", "  sum_t sum;\n\n");
+
+    deeplearn_export_c_inputs(learner, export_type, fp);
+
+    fprintf(fp, "%s", "  /* Convert inputs to fixed point */\n");
+    fprintf(fp, "%s", "  for (i = 0; i < no_of_inputs; i++) {\n");
+    fprintf(fp, "    prev_hiddens[i] = " \
+            "(activation_t)(network_inputs[i]*%d.0f + 0.5f);\n",
+            1 << fixed.activation_bits);
+    fprintf(fp, "%s", "  }\n\n");
+
+    COUNTUP(l, learner->net->hidden_layers) {
+        sprintf(name, "hidden_layer_%d", l);
+        fprintf(fp, "  /* Hidden layer %d */\n", l);
+        deeplearn_export_fixed_sum(&fixed, l, name, fp);
+        fprintf(fp, "%s", "    hiddens[i] = activation(");
+        deeplearn_export_fixed_lut_position(&fixed, l, fp);
+        fprintf(fp, "%s", ");\n");
+        fprintf(fp, "%s", "  }\n");
+        fprintf(fp, "  for (i = 0; i < %d; i++) {\n", fixed.units[l]);
+        fprintf(fp, "%s", "    prev_hiddens[i] = hiddens[i];\n");
+        fprintf(fp, "%s", "  }\n\n");
+    }
+
+    fprintf(fp, "%s", "  /* Output layer */\n");
+    deeplearn_export_fixed_sum(&fixed, last, "output_layer", fp);
+    if (fixed.softmax) {
+        fprintf(fp, "    outputs[i] = sum / %.1ff;\n",
+                ldexp(1, fixed.weight_shift[last] + fixed.activation_bits));
+        fprintf(fp, "%s", "  }\n\n");
+        deeplearn_export_c_softmax(fp);
+    }
+    else {
+        fprintf(fp, "%s", "    outputs[i] = activation(");
+        deeplearn_export_fixed_lut_position(&fixed, last, fp);
+        fprintf(fp, ") / %d.0f;\n", 1 << fixed.activation_bits);
+        fprintf(fp, "%s", "  }\n\n");
+    }
+
+    deeplearn_export_c_outputs(export_type, fp);
+
+    fprintf(fp, "%s", "}\n");
+    fclose(fp);
+    deeplearn_fixed_free(&fixed);
+    return 0;
+}
+
 /**
  * @brief Exports a trained network as a standalone python class
  * @param learner Deep learner object
@@ -1538,16 +2603,16 @@ static int deeplearn_export_python(deeplearn * learner, char * filename)
 
     /* ranges */
     fprintf(fp, "%s", "  input_range_min = [");
-    COUNTUP(i, learner->net->no_of_inputs) {
+    COUNTUP(i, deeplearn_input_ranges(learner)) {
         fprintf(fp, "%.10f", learner->input_range_min[i]);
-        if (i < learner->net->no_of_inputs-1)
+        if (i < deeplearn_input_ranges(learner)-1)
             fprintf(fp, ",");
     }
     fprintf(fp, "%s", "]\n\n");
     fprintf(fp, "%s", "  input_range_max = [");
-    COUNTUP(i, learner->net->no_of_inputs) {
+    COUNTUP(i, deeplearn_input_ranges(learner)) {
         fprintf(fp, "%.10f", learner->input_range_max[i]);
-        if (i < learner->net->no_of_inputs-1)
+        if (i < deeplearn_input_ranges(learner)-1)
             fprintf(fp, ",");
     }
     fprintf(fp, "%s", "]\n\n");
@@ -1697,10 +2762,7 @@ static int deeplearn_export_python(deeplearn * learner, char * filename)
     fprintf(fp, "%s", "    hiddens = []\n");
     fprintf(fp, "%s", "    outputs = []\n\n");
 
-    if (learner->no_of_input_fields == 0)
-        fprintf(fp, "    if len(inputs) < %d:\n", learner->net->no_of_inputs);
-    else
-        fprintf(fp, "    if len(inputs) < %d:\n", learner->no_of_input_fields);
+    fprintf(fp, "    if len(inputs) < %d:\n", deeplearn_input_values(learner));
 
     fprintf(fp, "%s", "        return []\n\n");
 
@@ -1720,6 +2782,10 @@ static int deeplearn_export_python(deeplearn * learner, char * filename)
     }
     else {
         fprintf(fp, "%s", "    for i in range(this.no_of_input_fields):\n");
+        fprintf(fp, "%s", "      # constant or duplicated field\n");
+        fprintf(fp,       "      if this.field_length[i] == %d:\n",
+                DEEPLEARN_FIELD_DROPPED);
+        fprintf(fp, "%s", "        continue\n");
         fprintf(fp, "%s", "      if this.field_length[i] == 0:\n");
         fprintf(fp,
                 "        # Normalise numeric inputs into a " \
@@ -1775,7 +2841,19 @@ static int deeplearn_export_python(deeplearn * learner, char * filename)
     fprintf(fp, "        adder = adder + " \
             "this.output_layer_weights[i*%d+j]*prev_hiddens[j]\n",
             HIDDENS_IN_LAYER(learner->net,learner->net->hidden_layers-1));
-    fprintf(fp, "%s", "      outputs.append(this.af(adder))\n\n");
+    if (learner->net->output_activation == BP_OUTPUT_SOFTMAX) {
+        fprintf(fp, "%s", "      outputs.append(adder)\n\n");
+        fprintf(fp, "%s", "    # Softmax\n");
+        fprintf(fp, "%s", "    maximum = max(outputs)\n");
+        fprintf(fp, "%s", "    outputs = [math.exp(v - maximum) " \
+                "for v in outputs]\n");
+        fprintf(fp, "%s", "    total = sum(outputs)\n");
+        fprintf(fp,       "    outputs = [%.2f + (v*%.2f/total) " \
+                "for v in outputs]\n\n", NEURON_LOW, NEURON_RANGE);
+    }
+    else {
+        fprintf(fp, "%s", "      outputs.append(this.af(adder))\n\n");
+    }
     fprintf(fp,
             "    # Convert outputs from %.2f - %.2f " \
             "back to their original range\n",
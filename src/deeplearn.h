@@ -40,6 +40,8 @@
 #include "utils.h"
 #include "deeplearn_history.h"
 #include "deeplearn_conv.h"
+#include "deeplearn_metrics.h"
+#include "deeplearn_sampler.h"
 
 /* Enumerate different flavors of C which can be exported
    as a standalone program */
@@ -55,11 +57,18 @@ enum {
 };
 
 struct deeplearndata {
+    /* zero if the inputs are quantised */
     float * inputs;
+
+    /* quantised inputs within the block belonging to the learner */
+    unsigned char * inputs_quantised;
     char ** inputs_text;
     float * outputs;
     unsigned int flags;
     unsigned int labeled;
+
+    /* number of identical rows which the sample represents */
+    float weight;
     struct deeplearndata * prev;
     struct deeplearndata * next;
 };
@@ -72,6 +81,9 @@ struct deeplearndata_meta {
 };
 typedef struct deeplearndata_meta deeplearndata_meta;
 
+/* defined in deeplearndata_stream.h */
+typedef struct deeplearndata_stream deeplearndata_stream;
+
 struct deepl {
     bp * net;
     ac ** autocoder;
@@ -109,6 +121,33 @@ struct deepl {
 
     unsigned int training_ctr;
 
+    /* incremented whenever the weights of the network change,
+       so that cached predictions can be invalidated */
+    unsigned int model_version;
+
+    /* if not zero then labeled training samples are drawn in proportion
+       to their loss rather than uniformly */
+    deeplearn_sampler * sampler;
+
+    /* if not zero then samples can be appended while training */
+    deeplearndata_stream * stream;
+
+    /* mean weight of the samples. Sample weights are divided by this so
+       that on average weighted training steps are the same size as
+       unweighted ones */
+    float mean_sample_weight;
+
+    /* format of the numeric input values of samples, as defined in
+       deeplearndata_quantise.h, and the block containing them if they
+       are quantised */
+    int input_storage;
+    unsigned char * inputs_quantised;
+    size_t inputs_quantised_bytes;
+
+    /* bytes reserved against the memory budget, not including the
+       network and autocoders which reserve their own */
+    size_t memory;
+
     deeplearn_history history;
     deeplearn_history gradients_std;
     deeplearn_history gradients_mean;
@@ -125,8 +164,15 @@ int deeplearn_init(deeplearn * learner,
 void deeplearn_feed_forward(deeplearn * learner);
 void deeplearn_update(deeplearn * learner);
 void deeplearn_free(deeplearn * learner);
+size_t deeplearn_estimate_memory(int no_of_inputs,
+                                 int no_of_hiddens,
+                                 int hidden_layers,
+                                 int no_of_outputs,
+                                 int no_of_samples);
+size_t deeplearn_get_memory(deeplearn * learner);
 void deeplearn_set_input_text(deeplearn * learner, char * text);
 void deeplearn_set_input(deeplearn * learner, int index, float value);
+int deeplearn_field_position(deeplearn * learner, int fieldindex);
 int deeplearn_set_input_field(deeplearn * learner, int fieldindex,
                               float value);
 int deeplearn_set_input_field_text(deeplearn * learner, int fieldindex,
@@ -135,12 +181,27 @@ void deeplearn_set_inputs(deeplearn * learner, deeplearndata * sample);
 void deeplearn_set_output(deeplearn * learner, int index, float value);
 void deeplearn_set_outputs(deeplearn * learner, deeplearndata * sample);
 void deeplearn_get_outputs(deeplearn * learner, float outputs[]);
+int deeplearn_input_ranges(deeplearn * learner);
+int deeplearn_resize_input_ranges(deeplearn * learner);
+int deeplearn_copy_fields(deeplearn * source, deeplearn * learner);
+int deeplearn_fields_to_inputs(deeplearn * learner,
+                               float fields[], char ** fields_text,
+                               float inputs[]);
+int deeplearn_feed_forward_batch(deeplearn * learner, int batch_size,
+                                 float inputs[], float outputs[]);
+void deeplearn_outputs_from_values(deeplearn * learner,
+                                   float values[], float outputs[]);
+int deeplearn_class_from_values(deeplearn * learner, float values[]);
 float deeplearn_get_output(deeplearn * learner, int index);
 float deeplearn_get_desired(deeplearn * learner, int index);
 int deeplearn_get_class(deeplearn * learner);
 void deeplearn_set_class(deeplearn * learner, int class);
 int deeplearn_save(FILE * fp, deeplearn * learner);
 int deeplearn_load(FILE * fp, deeplearn * learner);
+int deeplearn_transplant(deeplearn * source, deeplearn * learner,
+                         int no_of_layers);
+int deeplearn_transplant_load(FILE * fp, deeplearn * learner,
+                              int no_of_layers);
 int deeplearn_compare(deeplearn * learner1,
                       deeplearn * learner2);
 int deeplearn_plot_history(deeplearn * learner,
@@ -156,7 +217,12 @@ void deeplearn_inputs_from_image(deeplearn * learner,
                                  int image_width, int image_height);
 void deeplearn_set_learning_rate(deeplearn * learner, float rate);
 void deeplearn_set_dropouts(deeplearn * learner, float dropout_percent);
+int deeplearn_set_prioritised_sampling(deeplearn * learner,
+                                       float alpha, float beta);
+int deeplearn_set_output_activation(deeplearn * learner, int activation);
+int deeplearn_freeze_layers(deeplearn * learner, int no_of_layers);
 int deeplearn_export(deeplearn * learner, char * filename);
+int deeplearn_export_fixed(deeplearn * learner, char * filename, int bits);
 float deeplearn_get_error_threshold(deeplearn * learner, int index);
 void deeplearn_set_error_threshold(deeplearn * learner, int index,
                                    float value);
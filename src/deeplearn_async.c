@@ -0,0 +1,366 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_async.h"
+
+/**
+ * @brief Allocates the buffers used by a worker thread
+ * @param handle Asynchronous prediction handle
+ * @param state Worker state to be allocated
+ * @returns zero on success
+ */
+static int deeplearn_async_state_init(deeplearn_async * handle,
+                                      deeplearn_async_worker_state * state)
+{
+    bp * net = handle->learner->net;
+
+    state->handle = handle;
+    state->requests = (deeplearn_async_request*)
+        malloc(handle->max_batch_size*sizeof(deeplearn_async_request));
+    FLOATALLOC(state->inputs, handle->max_batch_size*net->no_of_inputs);
+    FLOATALLOC(state->outputs, handle->max_batch_size*net->no_of_outputs);
+    FLOATALLOC(state->buffer, bp_widest_layer(net)*2);
+    if ((!state->requests) || (!state->inputs) ||
+        (!state->outputs) || (!state->buffer))
+        return -1;
+    return 0;
+}
+
+/**
+ * @brief Deallocates the buffers used by a worker thread
+ * @param state Worker state
+ */
+static void deeplearn_async_state_free(deeplearn_async_worker_state * state)
+{
+    free(state->requests);
+    free(state->inputs);
+    free(state->outputs);
+    free(state->buffer);
+}
+
+/**
+ * @brief Worker thread which takes batches of requests from the queue,
+ *        feeds them forward through the network and invokes callbacks
+ * @param arg Worker state
+ */
+static void * deeplearn_async_worker(void * arg)
+{
+    deeplearn_async_worker_state * state = (deeplearn_async_worker_state*)arg;
+    deeplearn_async * handle = state->handle;
+    bp * net = handle->learner->net;
+    deeplearn_async_request * requests = state->requests;
+    float * inputs = state->inputs;
+    float * outputs = state->outputs;
+    float * buffer = state->buffer;
+    int batch_size, slot;
+
+    pthread_mutex_lock(&handle->lock);
+    for (;;) {
+        while ((handle->pending == 0) && (handle->shutdown == 0))
+            pthread_cond_wait(&handle->work, &handle->lock);
+
+        /* only exit once the queue has been drained, so that
+           every callback is invoked */
+        if (handle->pending == 0)
+            break;
+
+        /* coalesce whatever is waiting into a batch */
+        batch_size = handle->pending;
+        if (batch_size > handle->max_batch_size)
+            batch_size = handle->max_batch_size;
+
+        COUNTUP(i, batch_size) {
+            slot = (handle->head + i) % handle->max_pending;
+            requests[i] = handle->queue[slot];
+            memcpy(&inputs[i*net->no_of_inputs],
+                   &handle->queue_inputs[slot*net->no_of_inputs],
+                   net->no_of_inputs*sizeof(float));
+        }
+        handle->head = (handle->head + batch_size) % handle->max_pending;
+        handle->pending -= batch_size;
+        handle->active += batch_size;
+
+        /* let another worker pick up any remaining requests */
+        if (handle->pending > 0)
+            pthread_cond_signal(&handle->work);
+
+        pthread_mutex_unlock(&handle->lock);
+
+        COUNTUP(i, batch_size) {
+            if (requests[i].cancelled != 0) {
+                requests[i].callback(requests[i].id,
+                                     DEEPLEARN_ASYNC_CANCELLED,
+                                     NULL, net->no_of_outputs,
+                                     requests[i].user_data);
+                continue;
+            }
+
+            bp_feed_forward_sample(net,
+                                   &inputs[i*net->no_of_inputs],
+                                   &outputs[i*net->no_of_outputs],
+                                   buffer);
+            requests[i].callback(requests[i].id,
+                                 DEEPLEARN_ASYNC_COMPLETE,
+                                 &outputs[i*net->no_of_outputs],
+                                 net->no_of_outputs,
+                                 requests[i].user_data);
+        }
+
+        pthread_mutex_lock(&handle->lock);
+        handle->active -= batch_size;
+        if ((handle->pending == 0) && (handle->active == 0))
+            pthread_cond_broadcast(&handle->idle);
+    }
+    pthread_mutex_unlock(&handle->lock);
+    return NULL;
+}
+
+/**
+ * @brief Creates a pool of worker threads which make predictions
+ *        using the given learner. The learner must not be trained or
+ *        freed while the pool exists
+ * @param handle Asynchronous prediction handle
+ * @param learner Deep learner object
+ * @param no_of_workers The number of worker threads
+ * @param max_batch_size The maximum number of requests which a worker
+ *        processes at once
+ * @param max_pending The maximum number of requests which may be
+ *        waiting. Beyond this new requests are refused
+ * @returns zero on success
+ */
+int deeplearn_async_init(deeplearn_async * handle,
+                         deeplearn * learner,
+                         int no_of_workers,
+                         int max_batch_size,
+                         int max_pending)
+{
+    if ((no_of_workers < 1) || (max_batch_size < 1) || (max_pending < 1))
+        return -1;
+
+    handle->learner = learner;
+    handle->max_pending = max_pending;
+    handle->max_batch_size = max_batch_size;
+    handle->head = 0;
+    handle->pending = 0;
+    handle->active = 0;
+    handle->next_id = 1;
+    handle->shutdown = 0;
+
+    handle->no_of_workers = 0;
+    handle->worker = NULL;
+    handle->worker_state = NULL;
+    handle->queue_inputs = NULL;
+
+    pthread_mutex_init(&handle->lock, NULL);
+    pthread_cond_init(&handle->work, NULL);
+    pthread_cond_init(&handle->idle, NULL);
+
+    handle->queue = (deeplearn_async_request*)
+        malloc(max_pending*sizeof(deeplearn_async_request));
+    if (!handle->queue) {
+        deeplearn_async_free(handle);
+        return -2;
+    }
+
+    FLOATALLOC(handle->queue_inputs, max_pending*learner->net->no_of_inputs);
+    if (!handle->queue_inputs) {
+        deeplearn_async_free(handle);
+        return -3;
+    }
+
+    handle->worker = (pthread_t*)malloc(no_of_workers*sizeof(pthread_t));
+    handle->worker_state = (deeplearn_async_worker_state*)
+        calloc(no_of_workers, sizeof(deeplearn_async_worker_state));
+    if ((!handle->worker) || (!handle->worker_state)) {
+        deeplearn_async_free(handle);
+        return -4;
+    }
+
+    /* allocate the worker buffers before any thread starts, so that
+       every worker is able to serve its share of the queue */
+    COUNTUP(i, no_of_workers) {
+        if (deeplearn_async_state_init(handle,
+                                       &handle->worker_state[i]) != 0) {
+            FOR(j, 0, i+1)
+                deeplearn_async_state_free(&handle->worker_state[j]);
+            deeplearn_async_free(handle);
+            return -6;
+        }
+    }
+
+    COUNTUP(i, no_of_workers) {
+        if (pthread_create(&handle->worker[i], NULL,
+                           deeplearn_async_worker,
+                           &handle->worker_state[i]) != 0) {
+            /* buffers of workers which were not started */
+            FOR(j, i, no_of_workers)
+                deeplearn_async_state_free(&handle->worker_state[j]);
+            deeplearn_async_free(handle);
+            return -5;
+        }
+        handle->no_of_workers++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Stops the worker threads and deallocates memory.
+ *        Any pending requests are completed first
+ * @param handle Asynchronous prediction handle
+ */
+void deeplearn_async_free(deeplearn_async * handle)
+{
+    pthread_mutex_lock(&handle->lock);
+    handle->shutdown = 1;
+    pthread_cond_broadcast(&handle->work);
+    pthread_mutex_unlock(&handle->lock);
+
+    COUNTUP(i, handle->no_of_workers) {
+        pthread_join(handle->worker[i], NULL);
+        deeplearn_async_state_free(&handle->worker_state[i]);
+    }
+
+    pthread_mutex_destroy(&handle->lock);
+    pthread_cond_destroy(&handle->work);
+    pthread_cond_destroy(&handle->idle);
+
+    free(handle->worker);
+    free(handle->worker_state);
+    free(handle->queue);
+    free(handle->queue_inputs);
+}
+
+/**
+ * @brief Queues a prediction. This does not block, and the callback will
+ *        be invoked from a worker thread when the prediction is complete
+ * @param handle Asynchronous prediction handle
+ * @param inputs Input values, one per input unit, in the range
+ *        NEURON_LOW to NEURON_HIGH. These are copied, so the array may be
+ *        reused as soon as this returns.
+ *        See deeplearn_fields_to_inputs
+ * @param callback Function to be called when the prediction is complete
+ * @param user_data Pointer passed to the callback
+ * @returns request identifier which is greater than zero, or a negative
+ *          value if the request could not be queued
+ */
+long deeplearn_predict_async(deeplearn_async * handle,
+                             float inputs[],
+                             deeplearn_async_callback callback,
+                             void * user_data)
+{
+    int no_of_inputs = handle->learner->net->no_of_inputs;
+    int slot;
+    long id;
+
+    if (!callback)
+        return -1;
+
+    pthread_mutex_lock(&handle->lock);
+
+    if (handle->shutdown != 0) {
+        pthread_mutex_unlock(&handle->lock);
+        return -2;
+    }
+
+    /* backpressure: refuse the request if the queue is full */
+    if (handle->pending >= handle->max_pending) {
+        pthread_mutex_unlock(&handle->lock);
+        return -3;
+    }
+
+    slot = (handle->head + handle->pending) % handle->max_pending;
+    id = handle->next_id++;
+    handle->queue[slot].id = id;
+    handle->queue[slot].cancelled = 0;
+    handle->queue[slot].callback = callback;
+    handle->queue[slot].user_data = user_data;
+    memcpy(&handle->queue_inputs[slot*no_of_inputs], inputs,
+           no_of_inputs*sizeof(float));
+    handle->pending++;
+
+    pthread_cond_signal(&handle->work);
+    pthread_mutex_unlock(&handle->lock);
+    return id;
+}
+
+/**
+ * @brief Cancels a request which has not yet been taken by a worker.
+ *        Its callback is still invoked, with a status of
+ *        DEEPLEARN_ASYNC_CANCELLED, so that any user data can be released
+ * @param handle Asynchronous prediction handle
+ * @param id Request identifier returned by deeplearn_predict_async
+ * @returns zero if the request was cancelled
+ */
+int deeplearn_async_cancel(deeplearn_async * handle, long id)
+{
+    int retval = -1;
+
+    pthread_mutex_lock(&handle->lock);
+    COUNTUP(i, handle->pending) {
+        int slot = (handle->head + i) % handle->max_pending;
+        if (handle->queue[slot].id != id)
+            continue;
+
+        if (handle->queue[slot].cancelled == 0) {
+            handle->queue[slot].cancelled = 1;
+            retval = 0;
+        }
+        break;
+    }
+    pthread_mutex_unlock(&handle->lock);
+    return retval;
+}
+
+/**
+ * @brief Returns the number of requests waiting to be processed
+ * @param handle Asynchronous prediction handle
+ * @returns number of pending requests
+ */
+int deeplearn_async_pending(deeplearn_async * handle)
+{
+    int pending;
+
+    pthread_mutex_lock(&handle->lock);
+    pending = handle->pending;
+    pthread_mutex_unlock(&handle->lock);
+    return pending;
+}
+
+/**
+ * @brief Waits until all queued requests have been processed and their
+ *        callbacks have returned. This must not be called from a callback
+ * @param handle Asynchronous prediction handle
+ */
+void deeplearn_async_wait(deeplearn_async * handle)
+{
+    pthread_mutex_lock(&handle->lock);
+    while ((handle->pending > 0) || (handle->active > 0))
+        pthread_cond_wait(&handle->idle, &handle->lock);
+    pthread_mutex_unlock(&handle->lock);
+}
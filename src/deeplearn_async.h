@@ -0,0 +1,116 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_ASYNC_H
+#define DEEPLEARN_ASYNC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "globals.h"
+#include "backprop.h"
+#include "deeplearn.h"
+
+/* status values passed to prediction callbacks */
+enum {
+    DEEPLEARN_ASYNC_COMPLETE = 0,
+    DEEPLEARN_ASYNC_CANCELLED
+};
+
+/* Called from a worker thread when a prediction is complete.
+   The output values are in the range NEURON_LOW to NEURON_HIGH, or NULL
+   if the request was cancelled, and are only valid during the call */
+typedef void (*deeplearn_async_callback)(long id, int status,
+                                         float outputs[], int no_of_outputs,
+                                         void * user_data);
+
+typedef struct {
+    long id;
+    int cancelled;
+    deeplearn_async_callback callback;
+    void * user_data;
+} deeplearn_async_request;
+
+typedef struct deeplearn_async_s deeplearn_async;
+
+/* buffers used by a worker thread, allocated before it starts */
+typedef struct {
+    deeplearn_async * handle;
+    deeplearn_async_request * requests;
+    float * inputs;
+    float * outputs;
+    float * buffer;
+} deeplearn_async_worker_state;
+
+struct deeplearn_async_s {
+    deeplearn * learner;
+
+    int no_of_workers;
+    pthread_t * worker;
+    deeplearn_async_worker_state * worker_state;
+
+    /* pending requests are held within a ring buffer, so that the
+       number of requests waiting to be processed is bounded */
+    int max_pending;
+    deeplearn_async_request * queue;
+    float * queue_inputs;
+    int head;
+    int pending;
+
+    /* the maximum number of pending requests which a worker
+       takes from the queue at once */
+    int max_batch_size;
+
+    /* requests taken from the queue whose callbacks have not returned */
+    int active;
+
+    long next_id;
+    int shutdown;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t idle;
+};
+
+int deeplearn_async_init(deeplearn_async * handle,
+                         deeplearn * learner,
+                         int no_of_workers,
+                         int max_batch_size,
+                         int max_pending);
+void deeplearn_async_free(deeplearn_async * handle);
+long deeplearn_predict_async(deeplearn_async * handle,
+                             float inputs[],
+                             deeplearn_async_callback callback,
+                             void * user_data);
+int deeplearn_async_cancel(deeplearn_async * handle, long id);
+int deeplearn_async_pending(deeplearn_async * handle);
+void deeplearn_async_wait(deeplearn_async * handle);
+
+#endif
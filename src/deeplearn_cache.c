@@ -0,0 +1,593 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_cache.h"
+
+/**
+ * @brief Returns the number of raw fields within a sample
+ * @param learner Deep learner object
+ * @returns number of fields
+ */
+static int deeplearn_cache_fields(deeplearn * learner)
+{
+    if (learner->no_of_input_fields > 0)
+        return learner->no_of_input_fields;
+
+    return learner->net->no_of_inputs;
+}
+
+/**
+ * @brief Returns the maximum number of characters for a text field,
+ *        or zero for a numeric field
+ * @param learner Deep learner object
+ * @param field Index of the field
+ * @returns maximum number of characters
+ */
+static int deeplearn_cache_text_length(deeplearn * learner, int field)
+{
+    if (learner->no_of_input_fields == 0)
+        return 0;
+
+    return learner->field_length[field]/CHAR_BITS;
+}
+
+/**
+ * @brief Returns the number of characters of a text field which are
+ *        encoded. Characters beyond the field length don't alter the
+ *        prediction, so they are not part of the key
+ * @param text Text value
+ * @param max_chars Maximum number of characters
+ * @returns number of characters
+ */
+static int deeplearn_cache_text_chars(char * text, int max_chars)
+{
+    int n = 0;
+
+    while ((n < max_chars) && (text[n] != 0))
+        n++;
+
+    return n;
+}
+
+/**
+ * @brief Returns the hash for the raw field values of a sample
+ * @param cache Prediction cache object
+ * @param fields Numeric field values
+ * @param fields_text Text field values
+ * @returns hash value
+ */
+static uint64_t deeplearn_cache_key_hash(deeplearn_cache * cache,
+                                         float fields[], char ** fields_text)
+{
+    deeplearn * learner = cache->learner;
+    uint64_t h = 0;
+
+    /* purely numeric fields can be hashed in one go */
+    if (cache->text_fields == 0)
+        return deeplearn_hash64(fields,
+                                deeplearn_cache_fields(learner)*sizeof(float),
+                                h);
+
+    COUNTUP(i, deeplearn_cache_fields(learner)) {
+        int max_chars = deeplearn_cache_text_length(learner, i);
+
+        if (max_chars > 0)
+            h = deeplearn_hash64(fields_text[i],
+                                 deeplearn_cache_text_chars(fields_text[i],
+                                                            max_chars), h);
+        else
+            h = deeplearn_hash64(&fields[i], sizeof(float), h);
+    }
+    return h;
+}
+
+/**
+ * @brief Returns non-zero if a stored key is the same as the given
+ *        field values
+ * @param cache Prediction cache object
+ * @param key Stored key
+ * @param fields Numeric field values
+ * @param fields_text Text field values
+ * @returns non-zero if the key matches
+ */
+static int deeplearn_cache_key_matches(deeplearn_cache * cache,
+                                       unsigned char * key,
+                                       float fields[], char ** fields_text)
+{
+    deeplearn * learner = cache->learner;
+
+    if (cache->text_fields == 0)
+        return (memcmp(key, fields, cache->key_size) == 0);
+
+    COUNTUP(i, deeplearn_cache_fields(learner)) {
+        int max_chars = deeplearn_cache_text_length(learner, i);
+
+        if (max_chars > 0) {
+            int n = deeplearn_cache_text_chars(fields_text[i], max_chars);
+            if (memcmp(key, fields_text[i], n) != 0)
+                return 0;
+            if ((n < max_chars) && (key[n] != 0))
+                return 0;
+            key += max_chars;
+        }
+        else {
+            if (memcmp(key, &fields[i], sizeof(float)) != 0)
+                return 0;
+            key += sizeof(float);
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Stores the given field values as a key.
+ *        Text fields are padded with zeros
+ * @param cache Prediction cache object
+ * @param key Returned key
+ * @param fields Numeric field values
+ * @param fields_text Text field values
+ */
+static void deeplearn_cache_key_write(deeplearn_cache * cache,
+                                      unsigned char * key,
+                                      float fields[], char ** fields_text)
+{
+    deeplearn * learner = cache->learner;
+
+    if (cache->text_fields == 0) {
+        memcpy(key, fields, cache->key_size);
+        return;
+    }
+
+    COUNTUP(i, deeplearn_cache_fields(learner)) {
+        int max_chars = deeplearn_cache_text_length(learner, i);
+
+        if (max_chars > 0) {
+            memset(key, 0, max_chars);
+            memcpy(key, fields_text[i],
+                   deeplearn_cache_text_chars(fields_text[i], max_chars));
+            key += max_chars;
+        }
+        else {
+            memcpy(key, &fields[i], sizeof(float));
+            key += sizeof(float);
+        }
+    }
+}
+
+/**
+ * @brief Removes all entries from a shard
+ * @param shard Cache shard
+ */
+static void deeplearn_cache_shard_clear(deeplearn_cache_shard * shard)
+{
+    shard->used = 0;
+    shard->head = -1;
+    shard->tail = -1;
+    COUNTDOWN(i, shard->no_of_buckets)
+        shard->bucket[i] = -1;
+}
+
+/**
+ * @brief Returns the index of the entry for the given field values
+ * @param cache Prediction cache object
+ * @param shard Cache shard
+ * @param hash Hash of the field values
+ * @param fields Numeric field values
+ * @param fields_text Text field values
+ * @returns entry index, or -1 if not found
+ */
+static int deeplearn_cache_shard_find(deeplearn_cache * cache,
+                                      deeplearn_cache_shard * shard,
+                                      uint64_t hash,
+                                      float fields[], char ** fields_text)
+{
+    int index = shard->bucket[hash & (shard->no_of_buckets-1)];
+
+    while (index != -1) {
+        if ((shard->entry[index].hash == hash) &&
+            (deeplearn_cache_key_matches(cache,
+                                         &shard->keys[index*cache->key_size],
+                                         fields, fields_text) != 0))
+            return index;
+
+        index = shard->entry[index].chain;
+    }
+    return -1;
+}
+
+/**
+ * @brief Removes an entry from the least recently used list
+ * @param shard Cache shard
+ * @param index Entry index
+ */
+static void deeplearn_cache_shard_unlink(deeplearn_cache_shard * shard,
+                                         int index)
+{
+    deeplearn_cache_entry * e = &shard->entry[index];
+
+    if (e->prev != -1)
+        shard->entry[e->prev].next = e->next;
+    else
+        shard->head = e->next;
+
+    if (e->next != -1)
+        shard->entry[e->next].prev = e->prev;
+    else
+        shard->tail = e->prev;
+}
+
+/**
+ * @brief Makes an entry the most recently used
+ * @param shard Cache shard
+ * @param index Entry index
+ */
+static void deeplearn_cache_shard_push_front(deeplearn_cache_shard * shard,
+                                             int index)
+{
+    deeplearn_cache_entry * e = &shard->entry[index];
+
+    e->prev = -1;
+    e->next = shard->head;
+    if (shard->head != -1)
+        shard->entry[shard->head].prev = index;
+    shard->head = index;
+    if (shard->tail == -1)
+        shard->tail = index;
+}
+
+/**
+ * @brief Returns a free entry, evicting the least recently used
+ *        entry if the shard is full
+ * @param shard Cache shard
+ * @returns entry index
+ */
+static int deeplearn_cache_shard_slot(deeplearn_cache_shard * shard)
+{
+    int index, * link;
+
+    if (shard->used < shard->capacity)
+        return shard->used++;
+
+    index = shard->tail;
+    deeplearn_cache_shard_unlink(shard, index);
+
+    /* remove it from its hash bucket */
+    link = &shard->bucket[shard->entry[index].hash & (shard->no_of_buckets-1)];
+    while (*link != index)
+        link = &shard->entry[*link].chain;
+    *link = shard->entry[index].chain;
+
+    shard->evictions++;
+    return index;
+}
+
+/**
+ * @brief Deallocates the arrays of a shard and the shard itself
+ * @param shard Cache shard
+ */
+static void deeplearn_cache_shard_free(deeplearn_cache_shard * shard)
+{
+    free(shard->entry);
+    free(shard->keys);
+    free(shard->outputs);
+    free(shard->bucket);
+    free(shard->inputs);
+    free(shard->buffer);
+    free(shard);
+}
+
+/**
+ * @brief Frees the shards which were created when a cache
+ *        can't be initialised
+ * @param cache Prediction cache object
+ * @param retval The error to return
+ * @returns retval
+ */
+static int deeplearn_cache_init_failed(deeplearn_cache * cache, int retval)
+{
+    deeplearn_cache_free(cache);
+    return retval;
+}
+
+/**
+ * @brief Creates a cache of predictions for the given learner
+ * @param cache Prediction cache object
+ * @param learner Deep learner object
+ * @param capacity The maximum number of cached predictions
+ * @param no_of_shards The number of independently locked parts of the
+ *        cache. More shards reduce contention between threads
+ * @returns zero on success
+ */
+int deeplearn_cache_init(deeplearn_cache * cache,
+                         deeplearn * learner,
+                         int capacity,
+                         int no_of_shards)
+{
+    int shard_capacity;
+
+    if ((capacity < 1) || (no_of_shards < 1))
+        return -1;
+
+    if (no_of_shards > capacity)
+        no_of_shards = capacity;
+
+    cache->learner = learner;
+    cache->no_of_shards = 0;
+    cache->text_fields = 0;
+    cache->key_size = 0;
+    COUNTUP(i, deeplearn_cache_fields(learner)) {
+        int max_chars = deeplearn_cache_text_length(learner, i);
+        if (max_chars > 0) {
+            cache->key_size += max_chars;
+            cache->text_fields++;
+        }
+        else
+            cache->key_size += sizeof(float);
+    }
+
+    cache->shard = (deeplearn_cache_shard**)
+        malloc(no_of_shards*sizeof(deeplearn_cache_shard*));
+    if (!cache->shard)
+        return -2;
+
+    shard_capacity = (capacity + no_of_shards - 1) / no_of_shards;
+
+    /* only shards which are complete, with their locks initialised,
+       are counted within no_of_shards and freed on failure */
+    COUNTUP(s, no_of_shards) {
+        deeplearn_cache_shard * shard =
+            (deeplearn_cache_shard*)calloc(1, sizeof(deeplearn_cache_shard));
+        if (!shard)
+            return deeplearn_cache_init_failed(cache, -3);
+
+        shard->capacity = shard_capacity;
+        shard->no_of_buckets = 1;
+        while (shard->no_of_buckets < shard_capacity)
+            shard->no_of_buckets <<= 1;
+
+        shard->entry = (deeplearn_cache_entry*)
+            malloc(shard_capacity*sizeof(deeplearn_cache_entry));
+        UCHARALLOC(shard->keys, shard_capacity*cache->key_size);
+        FLOATALLOC(shard->outputs,
+                   shard_capacity*learner->net->no_of_outputs);
+        INTALLOC(shard->bucket, shard->no_of_buckets);
+        FLOATALLOC(shard->inputs, learner->net->no_of_inputs);
+        FLOATALLOC(shard->buffer, bp_widest_layer(learner->net)*2);
+        if ((!shard->entry) || (!shard->keys) ||
+            (!shard->outputs) || (!shard->bucket) ||
+            (!shard->inputs) || (!shard->buffer)) {
+            deeplearn_cache_shard_free(shard);
+            return deeplearn_cache_init_failed(cache, -4);
+        }
+
+        if (pthread_mutex_init(&shard->lock, NULL) != 0) {
+            deeplearn_cache_shard_free(shard);
+            return deeplearn_cache_init_failed(cache, -5);
+        }
+
+        if (pthread_mutex_init(&shard->scratch_lock, NULL) != 0) {
+            pthread_mutex_destroy(&shard->lock);
+            deeplearn_cache_shard_free(shard);
+            return deeplearn_cache_init_failed(cache, -5);
+        }
+
+        cache->shard[s] = shard;
+        cache->no_of_shards++;
+
+        deeplearn_cache_shard_clear(shard);
+        shard->model_version = learner->model_version;
+        shard->hits = 0;
+        shard->misses = 0;
+        shard->evictions = 0;
+        shard->invalidations = 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Deallocates memory for a prediction cache
+ * @param cache Prediction cache object
+ */
+void deeplearn_cache_free(deeplearn_cache * cache)
+{
+    COUNTUP(s, cache->no_of_shards) {
+        deeplearn_cache_shard * shard = cache->shard[s];
+        pthread_mutex_destroy(&shard->lock);
+        pthread_mutex_destroy(&shard->scratch_lock);
+        deeplearn_cache_shard_free(shard);
+    }
+    free(cache->shard);
+    cache->shard = 0;
+    cache->no_of_shards = 0;
+}
+
+/**
+ * @brief Returns a prediction for the given raw field values, either from
+ *        the cache or by feeding them forward through the network.
+ *        This may be called from several threads at the same time, but not
+ *        while the learner is being trained.
+ *        If the weights of the network change then cached predictions
+ *        are discarded
+ * @param cache Prediction cache object
+ * @param fields Numeric field values, or one value per input unit if no
+ *        fields are defined
+ * @param fields_text Text field values, or NULL if there are no text fields
+ * @param outputs Returned output values in the range NEURON_LOW to
+ *        NEURON_HIGH
+ * @returns 1 if the prediction was cached, 0 if it was calculated, or
+ *          a negative value on error
+ */
+int deeplearn_cache_predict(deeplearn_cache * cache,
+                            float fields[], char ** fields_text,
+                            float outputs[])
+{
+    deeplearn * learner = cache->learner;
+    bp * net = learner->net;
+    deeplearn_cache_shard * shard;
+    uint64_t hash;
+    int index;
+
+    if ((cache->text_fields > 0) && (!fields_text))
+        return -1;
+
+    hash = deeplearn_cache_key_hash(cache, fields, fields_text);
+    shard = cache->shard[(hash >> 40) % cache->no_of_shards];
+
+    pthread_mutex_lock(&shard->lock);
+
+    if (shard->model_version != learner->model_version) {
+        if (shard->used > 0)
+            shard->invalidations++;
+        deeplearn_cache_shard_clear(shard);
+        shard->model_version = learner->model_version;
+    }
+
+    index = deeplearn_cache_shard_find(cache, shard, hash,
+                                       fields, fields_text);
+    if (index != -1) {
+        shard->hits++;
+        deeplearn_cache_shard_unlink(shard, index);
+        deeplearn_cache_shard_push_front(shard, index);
+        memcpy(outputs, &shard->outputs[index*net->no_of_outputs],
+               net->no_of_outputs*sizeof(float));
+        pthread_mutex_unlock(&shard->lock);
+        return 1;
+    }
+    shard->misses++;
+    pthread_mutex_unlock(&shard->lock);
+
+    /* calculate the prediction without holding the lock on the entries */
+    pthread_mutex_lock(&shard->scratch_lock);
+    if (deeplearn_fields_to_inputs(learner, fields, fields_text,
+                                   shard->inputs) != 0) {
+        pthread_mutex_unlock(&shard->scratch_lock);
+        return -4;
+    }
+    bp_feed_forward_sample(net, shard->inputs, outputs, shard->buffer);
+    pthread_mutex_unlock(&shard->scratch_lock);
+
+    pthread_mutex_lock(&shard->lock);
+
+    /* another thread may have inserted the same key meanwhile */
+    if ((shard->model_version == learner->model_version) &&
+        (deeplearn_cache_shard_find(cache, shard, hash,
+                                    fields, fields_text) == -1)) {
+        index = deeplearn_cache_shard_slot(shard);
+        shard->entry[index].hash = hash;
+        deeplearn_cache_key_write(cache, &shard->keys[index*cache->key_size],
+                                  fields, fields_text);
+        memcpy(&shard->outputs[index*net->no_of_outputs], outputs,
+               net->no_of_outputs*sizeof(float));
+
+        shard->entry[index].chain =
+            shard->bucket[hash & (shard->no_of_buckets-1)];
+        shard->bucket[hash & (shard->no_of_buckets-1)] = index;
+        deeplearn_cache_shard_push_front(shard, index);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+    return 0;
+}
+
+/**
+ * @brief Discards all cached predictions. This is needed if the weights
+ *        of the network are changed other than through training, for
+ *        example by loading a different model into the same learner
+ * @param cache Prediction cache object
+ */
+void deeplearn_cache_invalidate(deeplearn_cache * cache)
+{
+    COUNTUP(s, cache->no_of_shards) {
+        deeplearn_cache_shard * shard = cache->shard[s];
+
+        pthread_mutex_lock(&shard->lock);
+        if (shard->used > 0)
+            shard->invalidations++;
+        deeplearn_cache_shard_clear(shard);
+        shard->model_version = cache->learner->model_version;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+/**
+ * @brief Returns the combined statistics for all shards
+ * @param cache Prediction cache object
+ * @param stats Returned statistics
+ */
+void deeplearn_cache_get_stats(deeplearn_cache * cache,
+                               deeplearn_cache_stats * stats)
+{
+    memset(stats, 0, sizeof(deeplearn_cache_stats));
+
+    COUNTUP(s, cache->no_of_shards) {
+        deeplearn_cache_shard * shard = cache->shard[s];
+
+        pthread_mutex_lock(&shard->lock);
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->evictions += shard->evictions;
+        stats->invalidations += shard->invalidations;
+        stats->entries += shard->used;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+/**
+ * @brief Resets the statistics counters without altering cached entries
+ * @param cache Prediction cache object
+ */
+void deeplearn_cache_reset_stats(deeplearn_cache * cache)
+{
+    COUNTUP(s, cache->no_of_shards) {
+        deeplearn_cache_shard * shard = cache->shard[s];
+
+        pthread_mutex_lock(&shard->lock);
+        shard->hits = 0;
+        shard->misses = 0;
+        shard->evictions = 0;
+        shard->invalidations = 0;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+/**
+ * @brief Returns the proportion of predictions which were cached
+ * @param cache Prediction cache object
+ * @returns hit rate in the range 0.0 to 1.0
+ */
+float deeplearn_cache_hit_rate(deeplearn_cache * cache)
+{
+    deeplearn_cache_stats stats;
+
+    deeplearn_cache_get_stats(cache, &stats);
+    if (stats.hits + stats.misses == 0)
+        return 0;
+
+    return stats.hits / (float)(stats.hits + stats.misses);
+}
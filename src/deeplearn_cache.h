@@ -0,0 +1,117 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_CACHE_H
+#define DEEPLEARN_CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "globals.h"
+#include "utils.h"
+#include "backprop.h"
+#include "deeplearn.h"
+
+typedef struct {
+    uint64_t hash;
+
+    /* least recently used list, with the most recent at the head */
+    int prev;
+    int next;
+
+    /* next entry within the same hash bucket */
+    int chain;
+} deeplearn_cache_entry;
+
+typedef struct {
+    pthread_mutex_t lock;
+
+    int capacity;
+    int used;
+    deeplearn_cache_entry * entry;
+    unsigned char * keys;
+    float * outputs;
+    int head;
+    int tail;
+
+    int no_of_buckets;
+    int * bucket;
+
+    /* model version for which the entries are valid */
+    unsigned int model_version;
+
+    /* inputs and feed forward buffer used to calculate a prediction
+       which isn't cached. These have their own lock so that lookups
+       are not held up while the network is fed forward */
+    pthread_mutex_t scratch_lock;
+    float * inputs;
+    float * buffer;
+
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long invalidations;
+} deeplearn_cache_shard;
+
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long invalidations;
+    int entries;
+} deeplearn_cache_stats;
+
+typedef struct {
+    deeplearn * learner;
+
+    /* number of bytes needed to store the raw field values of a sample */
+    int key_size;
+    int text_fields;
+
+    int no_of_shards;
+    deeplearn_cache_shard ** shard;
+} deeplearn_cache;
+
+int deeplearn_cache_init(deeplearn_cache * cache,
+                         deeplearn * learner,
+                         int capacity,
+                         int no_of_shards);
+void deeplearn_cache_free(deeplearn_cache * cache);
+int deeplearn_cache_predict(deeplearn_cache * cache,
+                            float fields[], char ** fields_text,
+                            float outputs[]);
+void deeplearn_cache_invalidate(deeplearn_cache * cache);
+void deeplearn_cache_get_stats(deeplearn_cache * cache,
+                               deeplearn_cache_stats * stats);
+void deeplearn_cache_reset_stats(deeplearn_cache * cache);
+float deeplearn_cache_hit_rate(deeplearn_cache * cache);
+
+#endif
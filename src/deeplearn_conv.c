@@ -29,6 +29,131 @@
 
 #include "deeplearn_conv.h"
 
+/* arguments of the parallel loops over the rows of a layer */
+typedef struct {
+    float * img;
+    int img_width, img_height, img_depth;
+    int feature_width, no_of_features, pooling_factor;
+    float * feature;
+    float * layer;
+    int layer_width, unpooled_layer_width, half_feature_width;
+    unsigned int * updates_per_pixel;
+
+    /* summed area tables of the image and of each feature */
+    double * img_area;
+    double * feature_area;
+} conv_loop;
+
+/**
+ * @brief Calculates the dimensions of each convolution layer
+ * @param no_of_layers The number of layers
+ * @param image_width Width of the input image or layer
+ * @param image_height Height of the input image or layer
+ * @param image_depth Depth of the input image
+ * @param no_of_features The number of features to learn in the first layer
+ * @param feature_width Width of features in the first layer
+ * @param final_image_width Width of the final output layer
+ * @param final_image_height Height of the final layer
+ * @param layer Returned layer dimensions
+ * @param no_of_outputs Returned size of the outputs array
+ * @returns zero on success, or -1 if the final layer is too small
+ */
+static int conv_layer_dimensions(int no_of_layers,
+                                 int image_width, int image_height,
+                                 int image_depth,
+                                 int no_of_features, int feature_width,
+                                 int final_image_width,
+                                 int final_image_height,
+                                 deeplearn_conv_layer layer[],
+                                 int * no_of_outputs)
+{
+    COUNTUP(l, no_of_layers) {
+        layer[l].ctr = (unsigned int)0;
+        layer[l].depth = image_depth;
+        layer[l].no_of_features = no_of_features;
+        layer[l].layer = 0;
+        layer[l].feature = 0;
+
+        layer[l].width =
+            image_width -
+            ((image_width-final_image_width)*l/no_of_layers);
+
+        layer[l].pooling_factor = 1;
+
+        /* After the initial layer, width and height are the same */
+        if (l == 0)
+            layer[l].height =
+                image_height -
+                ((image_height-final_image_height)*l/no_of_layers);
+        else {
+            if (layer[l].width / POOLING_FACTOR > final_image_width) {
+                layer[l].width /= POOLING_FACTOR;
+                layer[l-1].pooling_factor = POOLING_FACTOR;
+            }
+            layer[l].height = layer[l].width;
+        }
+
+        /* make feature width proportional to width of the layer */
+        layer[l].feature_width =
+            feature_width*layer[l].width/image_width;
+
+        /* feature width should not be too small */
+        if (layer[l].feature_width < 3)
+            layer[l].feature_width = 3;
+    }
+
+    if (layer[no_of_layers-1].width < final_image_width)
+        return -1;
+
+    /* for convenience this is the size of the outputs array */
+    *no_of_outputs =
+        final_image_width*final_image_width*image_depth*
+        layer[no_of_layers-1].no_of_features;
+
+    return 0;
+}
+
+/**
+ * @brief Returns the number of bytes needed for the layers, features
+ *        and outputs of a convolution with the given dimensions
+ * @param no_of_layers The number of layers
+ * @param layer Layer dimensions
+ * @param no_of_outputs Size of the outputs array
+ * @returns Number of bytes
+ */
+static size_t conv_layers_memory(int no_of_layers,
+                                 deeplearn_conv_layer layer[],
+                                 int no_of_outputs)
+{
+    size_t floats = (size_t)no_of_outputs;
+
+    COUNTUP(l, no_of_layers) {
+        size_t layer_size =
+            (size_t)layer[l].width*layer[l].height*layer[l].depth;
+
+        if (l > 0)
+            layer_size *= layer[l-1].no_of_features;
+
+        floats += layer_size +
+            ((size_t)layer[l].no_of_features*
+             layer[l].feature_width*layer[l].feature_width*layer[l].depth);
+    }
+    return floats*sizeof(float);
+}
+
+/**
+ * @brief Frees a partially initialised convolution when an
+ *        allocation fails
+ * @param conv Convolution instance
+ * @param retval The error to return
+ * @returns retval
+ */
+static int conv_init_failed(deeplearn_conv * conv, int retval)
+{
+    conv_free(conv);
+    return retval;
+}
+
 /**
  * @brief Create a number of convolutional layers
  * @param no_of_layers The number of layers
@@ -60,90 +185,58 @@ int conv_init(int no_of_layers,
                            "Feature Learning Training History",
                            "Time Step", "Training Error %");
 
-    COUNTUP(l, no_of_layers) {
-        conv->layer[l].ctr = (unsigned int)0;
-        conv->layer[l].depth = image_depth;
-        conv->layer[l].no_of_features = no_of_features;
+    /* nothing allocated yet, so that conv_free can clean up
+       if any of the allocations below fail */
+    conv->outputs = 0;
+    conv->memory = 0;
+
+    if (conv_layer_dimensions(no_of_layers,
+                              image_width, image_height, image_depth,
+                              no_of_features, feature_width,
+                              final_image_width, final_image_height,
+                              conv->layer, &conv->no_of_outputs) != 0) {
+        printf("%d %d\n", conv->layer[no_of_layers-1].width,
+               final_image_width);
+        return 3;
+    }
 
-        conv->layer[l].width =
-            image_width -
-            ((image_width-final_image_width)*l/no_of_layers);
+    conv->outputs_width = final_image_width;
 
-        conv->layer[l].pooling_factor = 1;
+    if (deeplearn_memory_reserve(
+            conv_layers_memory(no_of_layers, conv->layer,
+                               conv->no_of_outputs)) != 0)
+        return 5;
 
-        /* After the initial layer, width and height are the same */
-        if (l == 0)
-            conv->layer[l].height =
-                image_height -
-                ((image_height-final_image_height)*l/no_of_layers);
-        else {
-            if (conv->layer[l].width / POOLING_FACTOR > final_image_width) {
-                conv->layer[l].width /= POOLING_FACTOR;
-                conv->layer[l-1].pooling_factor = POOLING_FACTOR;
-            }
-            conv->layer[l].height = conv->layer[l].width;
-        }
+    conv->memory = conv_layers_memory(no_of_layers, conv->layer,
+                                      conv->no_of_outputs);
 
-        /* make feature width proportional to width of the layer */
-        conv->layer[l].feature_width =
-            feature_width*conv->layer[l].width/image_width;
+    COUNTUP(l, no_of_layers) {
+        int layer_size = conv->layer[l].width*conv->layer[l].height*
+            conv->layer[l].depth;
+        int feature_size = conv->layer[l].no_of_features*
+            conv->layer[l].feature_width*conv->layer[l].feature_width*
+            conv->layer[l].depth;
 
-        /* feature width should not be too small */
-        if (conv->layer[l].feature_width < 3)
-            conv->layer[l].feature_width = 3;
-
-        if (l == 0) {
-            /* allocate memory for the layer */
-            FLOATALLOC(conv->layer[l].layer,
-                       conv->layer[l].width*conv->layer[l].height*
-                       conv->layer[l].depth);
-            if (!conv->layer[l].layer)
-                return 1;
-            FLOATCLEAR(conv->layer[l].layer,
-                       conv->layer[l].width*conv->layer[l].height*
-                       conv->layer[l].depth);
-        }
-        else {
-            /* allocate memory for the layer */
-            FLOATALLOC(conv->layer[l].layer,
-                       conv->layer[l].width*conv->layer[l].height*
-                       conv->layer[l].depth*conv->layer[l-1].no_of_features);
-            if (!conv->layer[l].layer)
-                return 1;
-            FLOATCLEAR(conv->layer[l].layer,
-                       conv->layer[l].width*conv->layer[l].height*
-                       conv->layer[l].depth*conv->layer[l-1].no_of_features);
-        }
+        if (l > 0)
+            layer_size *= conv->layer[l-1].no_of_features;
+
+        /* allocate memory for the layer */
+        FLOATALLOC(conv->layer[l].layer, layer_size);
+        if (!conv->layer[l].layer)
+            return conv_init_failed(conv, 1);
+        FLOATCLEAR(conv->layer[l].layer, layer_size);
 
         /* allocate memory for learned feature set */
-        FLOATALLOC(conv->layer[l].feature,
-                   conv->layer[l].no_of_features*
-                   conv->layer[l].feature_width*conv->layer[l].feature_width*
-                   conv->layer[l].depth);
+        FLOATALLOC(conv->layer[l].feature, feature_size);
         if (!conv->layer[l].feature)
-            return 2;
-        FLOATCLEAR(conv->layer[l].feature,
-                   conv->layer[l].no_of_features*
-                   conv->layer[l].feature_width*conv->layer[l].feature_width*
-                   conv->layer[l].depth);
+            return conv_init_failed(conv, 2);
+        FLOATCLEAR(conv->layer[l].feature, feature_size);
     }
 
-    if (conv->layer[no_of_layers-1].width < final_image_width) {
-        printf("%d %d\n", conv->layer[no_of_layers-1].width, final_image_width);
-        return 3;
-    }
-
-    conv->outputs_width = final_image_width;
-
-    /* for convenience this is the size of the outputs array */
-    conv->no_of_outputs =
-        final_image_width*final_image_width*image_depth*
-        conv->layer[no_of_layers-1].no_of_features;
-
     /* allocate array of output values */
     FLOATALLOC(conv->outputs, conv->no_of_outputs);
     if (!conv->outputs)
-        return 4;
+        return conv_init_failed(conv, 4);
 
     /* clear the outputs */
     FLOATCLEAR(conv->outputs, conv->no_of_outputs);
@@ -160,9 +253,59 @@ void conv_free(deeplearn_conv * conv)
     COUNTDOWN(l, conv->no_of_layers) {
         free(conv->layer[l].layer);
         free(conv->layer[l].feature);
+        conv->layer[l].layer = 0;
+        conv->layer[l].feature = 0;
     }
 
     free(conv->outputs);
+    conv->outputs = 0;
+
+    deeplearn_memory_release(conv->memory);
+    conv->memory = 0;
+}
+
+/**
+ * @brief Returns the number of bytes which will be allocated by conv_init
+ *        for the given parameters, not including the deeplearn_conv
+ *        object itself
+ * @param no_of_layers The number of layers
+ * @param image_width Width of the input image or layer
+ * @param image_height Height of the input image or layer
+ * @param image_depth Depth of the input image
+ * @param no_of_features The number of features to learn in the first layer
+ * @param feature_width Width of features in the first layer
+ * @param final_image_width Width of the final output layer
+ * @param final_image_height Height of the final layer
+ * @returns Number of bytes, or zero if the parameters are not valid
+ */
+size_t conv_estimate_memory(int no_of_layers,
+                            int image_width, int image_height,
+                            int image_depth,
+                            int no_of_features, int feature_width,
+                            int final_image_width, int final_image_height)
+{
+    deeplearn_conv_layer layer[PREPROCESS_MAX_LAYERS];
+    int no_of_outputs;
+
+    if (conv_layer_dimensions(no_of_layers,
+                              image_width, image_height, image_depth,
+                              no_of_features, feature_width,
+                              final_image_width, final_image_height,
+                              layer, &no_of_outputs) != 0)
+        return 0;
+
+    return conv_layers_memory(no_of_layers, layer, no_of_outputs);
+}
+
+/**
+ * @brief Returns the number of bytes currently allocated for the layers,
+ *        features and outputs of a convolution
+ * @param conv Convolution instance
+ * @returns Number of bytes
+ */
+size_t conv_get_memory(deeplearn_conv * conv)
+{
+    return conv->memory;
 }
 
 /**
@@ -265,50 +408,28 @@ int conv_load(FILE * fp, deeplearn_conv * conv)
 }
 
 /**
- * @brief Convolves an input image or layer to an output layer
- * @param img Input image or previous layer with values in the range 0.0 -> 1.0
- * @param img_width Width of the image
- * @param img_height Height of the image
- * @param img_depth Depth of the image. If this is the first layer then it is
- *        the color depth, otherwise it is the number of features learned in
- *        the previous layer
- * @param feature_width Width if each image patch
- * @param no_of_features The number of features in the set
- * @param pooling_factor Pooling factor
- * @param feature Array containing the learned features, having values in
- *        the range 0.0 -> 1.0
- * @param layer The output layer
- * @param layer_width Width of the output layer. The total size of the
- *        output layer should be layer_width*layer_width*no_of_features
+ * @brief Body of the parallel loop which convolves the rows of a layer
+ * @param start Index of the first row
+ * @param end Index after the last row
+ * @param context Images, features and layer
  */
-void convolve_image(float img[],
-                    int img_width, int img_height, int img_depth,
-                    int feature_width, int no_of_features,
-                    int pooling_factor,
-                    float feature[],
-                    float layer[], int layer_width)
+static void convolve_image_rows(int start, int end, void * context)
 {
-    if (img_depth == 1) {
-        convolve_image_mono(img, img_width, img_height,
-                            feature_width, no_of_features,
-                            pooling_factor,
-                            feature, layer, layer_width);
-        return;
-    }
-
-    int half_feature_width = feature_width/2;
-    int unpooled_layer_width = layer_width;
-
-    if (pooling_factor > 1) {
-        /* if we are pooling then clear the values within the layer
-           which will be updated, so that maximums can be calculated */
-        unpooled_layer_width = layer_width*pooling_factor;
-        FLOATCLEAR(layer, layer_width*layer_width*no_of_features*img_depth);
-    }
-
-    /* for each unit in the output layer */
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
-    COUNTDOWN(layer_y, unpooled_layer_width) {
+    conv_loop * args = (conv_loop*)context;
+    float * img = args->img;
+    int img_width = args->img_width;
+    int img_height = args->img_height;
+    int img_depth = args->img_depth;
+    int feature_width = args->feature_width;
+    int no_of_features = args->no_of_features;
+    int pooling_factor = args->pooling_factor;
+    float * feature = args->feature;
+    float * layer = args->layer;
+    int layer_width = args->layer_width;
+    int unpooled_layer_width = args->unpooled_layer_width;
+    int half_feature_width = args->half_feature_width;
+
+    for (int layer_y = end-1; layer_y >= start; layer_y--) {
         int pooled_layer_y = layer_y / pooling_factor;
         int y_img = layer_y * img_height / unpooled_layer_width;
         int ty = y_img - half_feature_width;
@@ -370,40 +491,28 @@ void convolve_image(float img[],
 }
 
 /**
- * @brief Convolves a mono input image or layer to an output layer
- * @param img Input image or previous layer with values in the range 0.0 -> 1.0
- * @param img_width Width of the image
- * @param img_height Height of the image
- *        the color depth, otherwise it is the number of features learned in
- *        the previous layer
- * @param feature_width Width if each image patch
- * @param no_of_features The number of features in the set
- * @param feature Array containing the learned features, having values in
- *        the range 0.0 -> 1.0
- * @param layer The output layer
- * @param layer_width Width of the output layer. The total size of the
- *        output layer should be layer_width*layer_width*no_of_features
+ * @brief Body of the parallel loop which convolves the rows of a layer
+ *        from a mono image
+ * @param start Index of the first row
+ * @param end Index after the last row
+ * @param context Images, features and layer
  */
-void convolve_image_mono(float img[],
-                         int img_width, int img_height,
-                         int feature_width, int no_of_features,
-                         int pooling_factor,
-                         float feature[],
-                         float layer[], int layer_width)
+static void convolve_image_mono_rows(int start, int end, void * context)
 {
-    int half_feature_width = feature_width/2;
-    int unpooled_layer_width = layer_width;
-
-    if (pooling_factor > 1) {
-        /* if we are pooling then clear the values within the layer
-           which will be updated, so that maximums can be calculated */
-        unpooled_layer_width = layer_width*pooling_factor;
-        FLOATCLEAR(layer, layer_width*layer_width*no_of_features);
-    }
-
-    /* for each unit in the output layer */
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
-    COUNTDOWN(layer_y, unpooled_layer_width) {
+    conv_loop * args = (conv_loop*)context;
+    float * img = args->img;
+    int img_width = args->img_width;
+    int img_height = args->img_height;
+    int feature_width = args->feature_width;
+    int no_of_features = args->no_of_features;
+    int pooling_factor = args->pooling_factor;
+    float * feature = args->feature;
+    float * layer = args->layer;
+    int layer_width = args->layer_width;
+    int unpooled_layer_width = args->unpooled_layer_width;
+    int half_feature_width = args->half_feature_width;
+
+    for (int layer_y = end-1; layer_y >= start; layer_y--) {
         int pooled_layer_y = layer_y / pooling_factor;
         int y_img = layer_y * img_height / unpooled_layer_width;
         int ty = y_img - half_feature_width;
@@ -455,41 +564,326 @@ void convolve_image_mono(float img[],
 }
 
 /**
- * @brief Deconvolves a layer back to the source image
+ * @brief Creates summed area tables of the image and of the features.
+ *        Since the match between a feature and an image patch is the
+ *        sum of their differences it can then be calculated from
+ *        four values of the image table and one of the feature table,
+ *        rather than by visiting every pixel of the patch.
+ * @param args Image and features. The tables are returned within this
+ * @returns zero on success
+ */
+static int convolve_image_summed_area(conv_loop * args)
+{
+    int img_width = args->img_width;
+    int img_height = args->img_height;
+    int img_depth = args->img_depth;
+    int feature_width = args->feature_width;
+    int area_width = img_width + 1;
+    int feature_area_width = feature_width + 1;
+    int feature_area_size =
+        feature_area_width*feature_area_width*img_depth;
+
+    DOUBLEALLOC(args->img_area, area_width*(img_height+1)*img_depth);
+    if (!args->img_area)
+        return -1;
+
+    DOUBLEALLOC(args->feature_area, feature_area_size*args->no_of_features);
+    if (!args->feature_area) {
+        free(args->img_area);
+        args->img_area = NULL;
+        return -2;
+    }
+
+    /* image table, where each entry is the sum of the pixels above
+       and to the left of it */
+    memset((void*)args->img_area, '\0',
+           area_width*(img_height+1)*img_depth*sizeof(double));
+    COUNTUP(y, img_height) {
+        double * above = &args->img_area[(y*area_width)*img_depth];
+        double * area = &args->img_area[((y+1)*area_width)*img_depth];
+        float * row = &args->img[y*img_width*img_depth];
+        COUNTUP(d, img_depth) {
+            double row_sum = 0;
+            COUNTUP(x, img_width) {
+                row_sum += row[x*img_depth + d];
+                area[(x+1)*img_depth + d] =
+                    above[(x+1)*img_depth + d] + row_sum;
+            }
+        }
+    }
+
+    /* a table for each feature */
+    memset((void*)args->feature_area, '\0',
+           feature_area_size*args->no_of_features*sizeof(double));
+    COUNTUP(f, args->no_of_features) {
+        float * curr_feature =
+            &args->feature[f*feature_width*feature_width*img_depth];
+        double * curr_area = &args->feature_area[f*feature_area_size];
+        COUNTUP(y, feature_width) {
+            double * above = &curr_area[(y*feature_area_width)*img_depth];
+            double * area =
+                &curr_area[((y+1)*feature_area_width)*img_depth];
+            float * row = &curr_feature[y*feature_width*img_depth];
+            COUNTUP(d, img_depth) {
+                double row_sum = 0;
+                COUNTUP(x, feature_width) {
+                    row_sum += row[x*img_depth + d];
+                    area[(x+1)*img_depth + d] =
+                        above[(x+1)*img_depth + d] + row_sum;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Body of the parallel loop which convolves the rows of a layer
+ *        using summed area tables
+ * @param start Index of the first row
+ * @param end Index after the last row
+ * @param context Images, features, layer and summed area tables
+ */
+static void convolve_image_summed_area_rows(int start, int end,
+                                            void * context)
+{
+    conv_loop * args = (conv_loop*)context;
+    int img_width = args->img_width;
+    int img_height = args->img_height;
+    int img_depth = args->img_depth;
+    int feature_width = args->feature_width;
+    int no_of_features = args->no_of_features;
+    int pooling_factor = args->pooling_factor;
+    float * layer = args->layer;
+    int layer_width = args->layer_width;
+    int unpooled_layer_width = args->unpooled_layer_width;
+    int half_feature_width = args->half_feature_width;
+    int area_width = img_width + 1;
+    int feature_area_width = feature_width + 1;
+    int feature_area_size =
+        feature_area_width*feature_area_width*img_depth;
+
+    for (int layer_y = end-1; layer_y >= start; layer_y--) {
+        int pooled_layer_y = layer_y / pooling_factor;
+        int y_img = layer_y * img_height / unpooled_layer_width;
+        int ty = y_img - half_feature_width;
+        int by = ty + feature_width;
+        if (ty < 0) ty = 0;
+        if (by >= img_height) by = img_height-1;
+        if (by < ty) by = ty;
+        COUNTDOWN(layer_x, unpooled_layer_width) {
+            int pooled_layer_x = layer_x / pooling_factor;
+            int x_img = layer_x * img_width / unpooled_layer_width;
+            int tx = x_img - half_feature_width;
+            int bx = tx + feature_width;
+            if (tx < 0) tx = 0;
+            if (bx >= img_width) bx = img_width-1;
+            if (bx < tx) bx = tx;
+
+            /* corners of the patch within the image table */
+            double * top_left =
+                &args->img_area[((ty*area_width) + tx)*img_depth];
+            double * top_right =
+                &args->img_area[((ty*area_width) + bx)*img_depth];
+            double * bottom_left =
+                &args->img_area[((by*area_width) + tx)*img_depth];
+            double * bottom_right =
+                &args->img_area[((by*area_width) + bx)*img_depth];
+            int feature_corner =
+                (((by-ty)*feature_area_width) + (bx-tx))*img_depth;
+
+            /* for every learned feature */
+            COUNTDOWN(f, no_of_features) {
+                double * curr_area =
+                    &args->feature_area[f*feature_area_size +
+                                        feature_corner];
+                int layer_unit_index =
+                    ((layer_y*unpooled_layer_width) + layer_x)*
+                    no_of_features + f;
+
+                if (pooling_factor > 1)
+                    layer_unit_index =
+                        ((pooled_layer_y*layer_width) + pooled_layer_x)*
+                        no_of_features + f;
+
+                COUNTDOWN(d, img_depth) {
+                    float match = (float)
+                        (bottom_right[d] - bottom_left[d] -
+                         top_right[d] + top_left[d] - curr_area[d]);
+                    float v = AF(match);
+
+                    if (pooling_factor <= 1) {
+                        layer[(layer_unit_index*img_depth) + d] = v;
+                    }
+                    else {
+                        /* max pooling */
+                        if (v > layer[(layer_unit_index*img_depth) + d])
+                            layer[(layer_unit_index*img_depth) + d] = v;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Convolves an input image or layer to an output layer
  * @param img Input image or previous layer with values in the range 0.0 -> 1.0
  * @param img_width Width of the image
  * @param img_height Height of the image
+ * @param img_depth Depth of the image. If this is the first layer then it is
  *        the color depth, otherwise it is the number of features learned in
  *        the previous layer
  * @param feature_width Width if each image patch
  * @param no_of_features The number of features in the set
+ * @param pooling_factor Pooling factor
  * @param feature Array containing the learned features, having values in
  *        the range 0.0 -> 1.0
- * @param layer The output layer to begin from
+ * @param layer The output layer
  * @param layer_width Width of the output layer. The total size of the
  *        output layer should be layer_width*layer_width*no_of_features
  */
-void deconvolve_image_mono(float img[],
-                           int img_width, int img_height,
-                           int feature_width, int no_of_features,
-                           float feature[],
-                           float layer[], int layer_width)
+void convolve_image(float img[],
+                    int img_width, int img_height, int img_depth,
+                    int feature_width, int no_of_features,
+                    int pooling_factor,
+                    float feature[],
+                    float layer[], int layer_width)
 {
+    /* a subtraction and an addition for each element of each feature
+       at each position within the unpooled layer */
+    uint64_t flops =
+        (uint64_t)layer_width*pooling_factor*layer_width*pooling_factor*
+        no_of_features*feature_width*feature_width*img_depth*2;
     int half_feature_width = feature_width/2;
-    unsigned int * updates_per_pixel;
+    int unpooled_layer_width = layer_width;
+    deeplearn_loop rows = convolve_image_rows;
+    deeplearn_tune_trial trial;
 
-    UINTALLOC(updates_per_pixel, img_width*img_height);
-    if (!updates_per_pixel)
-        return;
+    deeplearn_perf_begin(DEEPLEARN_PERF_CONVOLVE_IMAGE);
 
-    UINTCLEAR(updates_per_pixel, img_width*img_height);
+    if (pooling_factor > 1) {
+        /* if we are pooling then clear the values within the layer
+           which will be updated, so that maximums can be calculated */
+        unpooled_layer_width = layer_width*pooling_factor;
+        FLOATCLEAR(layer, layer_width*layer_width*no_of_features*img_depth);
+    }
 
-    /* clear the input image */
-    FLOATCLEAR(img, img_width*img_height);
+    int shape[DEEPLEARN_TUNE_SHAPE] = {
+        img_width, img_height, img_depth,
+        feature_width, no_of_features, unpooled_layer_width
+    };
+    deeplearn_tune_begin(DEEPLEARN_TUNE_CONVOLVE, shape, &trial);
 
     /* for each unit in the output layer */
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
-    COUNTDOWN(layer_y, layer_width) {
+    conv_loop args = {
+        .img = img,
+        .img_width = img_width,
+        .img_height = img_height,
+        .img_depth = img_depth,
+        .feature_width = feature_width,
+        .no_of_features = no_of_features,
+        .pooling_factor = pooling_factor,
+        .feature = feature,
+        .layer = layer,
+        .layer_width = layer_width,
+        .unpooled_layer_width = unpooled_layer_width,
+        .half_feature_width = half_feature_width
+    };
+
+    if (img_depth == 1)
+        rows = convolve_image_mono_rows;
+
+    if (trial.choice.algorithm == DEEPLEARN_TUNE_SUMMED_AREA) {
+        if (convolve_image_summed_area(&args) == 0)
+            rows = convolve_image_summed_area_rows;
+    }
+
+    deeplearn_parallel_for_tasks(unpooled_layer_width, trial.choice.tasks,
+                                 rows, &args);
+
+    if (args.img_area != NULL) {
+        free(args.img_area);
+        free(args.feature_area);
+    }
+
+    deeplearn_tune_end(&trial);
+    deeplearn_perf_end(DEEPLEARN_PERF_CONVOLVE_IMAGE, flops);
+}
+
+/**
+ * @brief Convolves a mono input image or layer to an output layer
+ * @param img Input image or previous layer with values in the range 0.0 -> 1.0
+ * @param img_width Width of the image
+ * @param img_height Height of the image
+ *        the color depth, otherwise it is the number of features learned in
+ *        the previous layer
+ * @param feature_width Width if each image patch
+ * @param no_of_features The number of features in the set
+ * @param feature Array containing the learned features, having values in
+ *        the range 0.0 -> 1.0
+ * @param layer The output layer
+ * @param layer_width Width of the output layer. The total size of the
+ *        output layer should be layer_width*layer_width*no_of_features
+ */
+void convolve_image_mono(float img[],
+                         int img_width, int img_height,
+                         int feature_width, int no_of_features,
+                         int pooling_factor,
+                         float feature[],
+                         float layer[], int layer_width)
+{
+    int half_feature_width = feature_width/2;
+    int unpooled_layer_width = layer_width;
+
+    if (pooling_factor > 1) {
+        /* if we are pooling then clear the values within the layer
+           which will be updated, so that maximums can be calculated */
+        unpooled_layer_width = layer_width*pooling_factor;
+        FLOATCLEAR(layer, layer_width*layer_width*no_of_features);
+    }
+
+    /* for each unit in the output layer */
+    conv_loop args = {
+        .img = img,
+        .img_width = img_width,
+        .img_height = img_height,
+        .img_depth = 1,
+        .feature_width = feature_width,
+        .no_of_features = no_of_features,
+        .pooling_factor = pooling_factor,
+        .feature = feature,
+        .layer = layer,
+        .layer_width = layer_width,
+        .unpooled_layer_width = unpooled_layer_width,
+        .half_feature_width = half_feature_width
+    };
+    deeplearn_parallel_for(unpooled_layer_width,
+                           convolve_image_mono_rows, &args);
+}
+
+/**
+ * @brief Body of the parallel loop which deconvolves the rows of a layer
+ *        into a mono image
+ * @param start Index of the first row
+ * @param end Index after the last row
+ * @param context Images, features and layer
+ */
+static void deconvolve_image_mono_rows(int start, int end, void * context)
+{
+    conv_loop * args = (conv_loop*)context;
+    float * img = args->img;
+    int img_width = args->img_width;
+    int img_height = args->img_height;
+    int feature_width = args->feature_width;
+    int no_of_features = args->no_of_features;
+    float * feature = args->feature;
+    float * layer = args->layer;
+    int layer_width = args->layer_width;
+    int half_feature_width = args->half_feature_width;
+    unsigned int * updates_per_pixel = args->updates_per_pixel;
+
+    for (int layer_y = end-1; layer_y >= start; layer_y--) {
         int y_img = layer_y * img_height / layer_width;
         int ty = y_img - half_feature_width;
         int by = ty + feature_width;
@@ -526,6 +920,56 @@ void deconvolve_image_mono(float img[],
             }
         }
     }
+}
+
+/**
+ * @brief Deconvolves a layer back to the source image
+ * @param img Input image or previous layer with values in the range 0.0 -> 1.0
+ * @param img_width Width of the image
+ * @param img_height Height of the image
+ *        the color depth, otherwise it is the number of features learned in
+ *        the previous layer
+ * @param feature_width Width if each image patch
+ * @param no_of_features The number of features in the set
+ * @param feature Array containing the learned features, having values in
+ *        the range 0.0 -> 1.0
+ * @param layer The output layer to begin from
+ * @param layer_width Width of the output layer. The total size of the
+ *        output layer should be layer_width*layer_width*no_of_features
+ */
+void deconvolve_image_mono(float img[],
+                           int img_width, int img_height,
+                           int feature_width, int no_of_features,
+                           float feature[],
+                           float layer[], int layer_width)
+{
+    int half_feature_width = feature_width/2;
+    unsigned int * updates_per_pixel;
+
+    UINTALLOC(updates_per_pixel, img_width*img_height);
+    if (!updates_per_pixel)
+        return;
+
+    UINTCLEAR(updates_per_pixel, img_width*img_height);
+
+    /* clear the input image */
+    FLOATCLEAR(img, img_width*img_height);
+
+    /* for each unit in the output layer */
+    conv_loop args = {
+        .img = img,
+        .img_width = img_width,
+        .img_height = img_height,
+        .img_depth = 1,
+        .feature_width = feature_width,
+        .no_of_features = no_of_features,
+        .feature = feature,
+        .layer = layer,
+        .layer_width = layer_width,
+        .half_feature_width = half_feature_width,
+        .updates_per_pixel = updates_per_pixel
+    };
+    deeplearn_parallel_for(layer_width, deconvolve_image_mono_rows, &args);
 
     /* divide the values for each pixel by the number of times that
        pixel is touched during convolution */
@@ -586,49 +1030,27 @@ void deconvolve_image_mono(float img[],
 }
 
 /**
- * @brief Deconvolves a layer back to the source image
- * @param img Input image or previous layer with values in the range 0.0 -> 1.0
- * @param img_width Width of the image
- * @param img_height Height of the image
- * @param img_depth Depth of the image. If this is the first layer then it is
- *        the color depth, otherwise it is the number of features learned in
- *        the previous layer
- * @param feature_width Width if each image patch
- * @param no_of_features The number of features in the set
- * @param feature Array containing the learned features, having values in
- *        the range 0.0 -> 1.0
- * @param layer The output layer to start from
- * @param layer_width Width of the output layer. The total size of the
- *        output layer should be layer_width*layer_width*no_of_features
+ * @brief Body of the parallel loop which deconvolves the rows of a layer
+ * @param start Index of the first row
+ * @param end Index after the last row
+ * @param context Images, features and layer
  */
-void deconvolve_image(float img[],
-                      int img_width, int img_height, int img_depth,
-                      int feature_width, int no_of_features,
-                      float feature[],
-                      float layer[], int layer_width)
+static void deconvolve_image_rows(int start, int end, void * context)
 {
-    if (img_depth == 1) {
-        deconvolve_image_mono(img, img_width, img_height,
-                              feature_width, no_of_features,
-                              feature, layer, layer_width);
-        return;
-    }
-
-    int half_feature_width = feature_width/2;
-    unsigned int * updates_per_pixel;
-
-    UINTALLOC(updates_per_pixel, img_width*img_height);
-    if (!updates_per_pixel)
-        return;
-
-    UINTCLEAR(updates_per_pixel, img_width*img_height);
-
-    /* clear the input image */
-    FLOATCLEAR(img, img_width*img_height*img_depth);
-
-    /* for each unit in the output layer */
-#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
-    COUNTDOWN(layer_y, layer_width) {
+    conv_loop * args = (conv_loop*)context;
+    float * img = args->img;
+    int img_width = args->img_width;
+    int img_height = args->img_height;
+    int img_depth = args->img_depth;
+    int feature_width = args->feature_width;
+    int no_of_features = args->no_of_features;
+    float * feature = args->feature;
+    float * layer = args->layer;
+    int layer_width = args->layer_width;
+    int half_feature_width = args->half_feature_width;
+    unsigned int * updates_per_pixel = args->updates_per_pixel;
+
+    for (int layer_y = end-1; layer_y >= start; layer_y--) {
         int y_img = layer_y * img_height / layer_width;
         int ty = y_img - half_feature_width;
         int by = ty + feature_width;
@@ -668,6 +1090,64 @@ void deconvolve_image(float img[],
             }
         }
     }
+}
+
+/**
+ * @brief Deconvolves a layer back to the source image
+ * @param img Input image or previous layer with values in the range 0.0 -> 1.0
+ * @param img_width Width of the image
+ * @param img_height Height of the image
+ * @param img_depth Depth of the image. If this is the first layer then it is
+ *        the color depth, otherwise it is the number of features learned in
+ *        the previous layer
+ * @param feature_width Width if each image patch
+ * @param no_of_features The number of features in the set
+ * @param feature Array containing the learned features, having values in
+ *        the range 0.0 -> 1.0
+ * @param layer The output layer to start from
+ * @param layer_width Width of the output layer. The total size of the
+ *        output layer should be layer_width*layer_width*no_of_features
+ */
+void deconvolve_image(float img[],
+                      int img_width, int img_height, int img_depth,
+                      int feature_width, int no_of_features,
+                      float feature[],
+                      float layer[], int layer_width)
+{
+    if (img_depth == 1) {
+        deconvolve_image_mono(img, img_width, img_height,
+                              feature_width, no_of_features,
+                              feature, layer, layer_width);
+        return;
+    }
+
+    int half_feature_width = feature_width/2;
+    unsigned int * updates_per_pixel;
+
+    UINTALLOC(updates_per_pixel, img_width*img_height);
+    if (!updates_per_pixel)
+        return;
+
+    UINTCLEAR(updates_per_pixel, img_width*img_height);
+
+    /* clear the input image */
+    FLOATCLEAR(img, img_width*img_height*img_depth);
+
+    /* for each unit in the output layer */
+    conv_loop args = {
+        .img = img,
+        .img_width = img_width,
+        .img_height = img_height,
+        .img_depth = img_depth,
+        .feature_width = feature_width,
+        .no_of_features = no_of_features,
+        .feature = feature,
+        .layer = layer,
+        .layer_width = layer_width,
+        .half_feature_width = half_feature_width,
+        .updates_per_pixel = updates_per_pixel
+    };
+    deeplearn_parallel_for(layer_width, deconvolve_image_rows, &args);
 
     /* divide the values for each pixel by the number of times that
        pixel is touched during convolution */
@@ -774,6 +1254,7 @@ void conv_feed_forward(unsigned char * img,
             next_layer_width = conv->layer[l+1].width;
         }
 
+        deeplearn_trace_begin_layer("conv_feed_forward", l);
         convolve_image(conv->layer[l].layer,
                        conv->layer[l].width, conv->layer[l].height,
                        conv->layer[l].depth,
@@ -782,6 +1263,7 @@ void conv_feed_forward(unsigned char * img,
                        conv->layer[l].pooling_factor,
                        conv->layer[l].feature,
                        next_layer, next_layer_width);
+        deeplearn_trace_end("conv_feed_forward");
     }
 }
 
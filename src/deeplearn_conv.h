@@ -83,6 +83,9 @@ typedef struct {
        adding noise to the input layer */
     unsigned char training;
 
+    /* bytes reserved against the memory budget */
+    size_t memory;
+
     deeplearn_history history;
 } deeplearn_conv;
 
@@ -100,6 +103,12 @@ float conv_learn(unsigned char * img,
                  unsigned int * random_seed);
 
 void conv_free(deeplearn_conv * conv);
+size_t conv_estimate_memory(int no_of_layers,
+                            int image_width, int image_height,
+                            int image_depth,
+                            int no_of_features, int feature_width,
+                            int final_image_width, int final_image_height);
+size_t conv_get_memory(deeplearn_conv * conv);
 
 int conv_plot_history(deeplearn_conv * conv,
                       int img_width, int img_height);
@@ -0,0 +1,457 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_crossval.h"
+
+/* a fold, with its samples given as indexes into the data set of the
+   learner which owns it, so that no sample data is copied */
+typedef struct {
+    deeplearn * learner;
+
+    /* every sample which is not held out, used for pretraining */
+    int * pretraining;
+    int pretraining_samples;
+
+    /* labeled samples which are not held out */
+    int * training;
+    int training_samples;
+
+    /* held out samples */
+    int * test;
+    int test_samples;
+
+    /* non-zero if the fold could not be run */
+    int failed;
+} deeplearn_crossval_task;
+
+/* arguments of the loop which runs the folds */
+typedef struct {
+    deeplearn_crossval_params * params;
+    deeplearn * data;
+    deeplearn_crossval_task * task;
+    deeplearn_crossval_result * result;
+} deeplearn_crossval_loop;
+
+/**
+ * @brief Sets default cross validation parameters
+ * @param params Cross validation parameters
+ * @param no_of_hiddens The number of hidden units within each layer
+ * @param hidden_layers The number of hidden layers
+ * @param error_threshold Minimum training error for each hidden layer plus
+ *        the output layer
+ * @param random_seed Random number generator seed
+ */
+void deeplearn_crossval_init_params(deeplearn_crossval_params * params,
+                                    int no_of_hiddens, int hidden_layers,
+                                    float error_threshold[],
+                                    unsigned int random_seed)
+{
+    params->no_of_hiddens = no_of_hiddens;
+    params->hidden_layers = hidden_layers;
+    params->error_threshold = error_threshold;
+    params->random_seed = random_seed;
+    params->max_iterations = DEEPLEARN_CROSSVAL_MAX_ITERATIONS;
+    params->fold_threads = 0;
+    params->nested = 0;
+}
+
+/**
+ * @brief Frees the folds
+ * @param task Array of folds
+ * @param k The number of folds
+ */
+static void deeplearn_crossval_free_tasks(deeplearn_crossval_task * task,
+                                          int k)
+{
+    COUNTDOWN(f, k) {
+        if (task[f].learner != 0) {
+            deeplearn_free(task[f].learner);
+            free(task[f].learner);
+        }
+        free(task[f].pretraining);
+        free(task[f].training);
+        free(task[f].test);
+    }
+    free(task);
+}
+
+/**
+ * @brief Assigns each labeled sample to a fold at random, so that the
+ *        folds differ in size by at most one sample
+ * @param data Deep learner object which owns the data set
+ * @param k The number of folds
+ * @param random_seed Random number generator seed
+ * @param fold_of Returned fold of each sample, or -1 for unlabeled samples
+ * @returns The number of labeled samples, or negative on failure
+ */
+static int deeplearn_crossval_assign(deeplearn * data, int k,
+                                     unsigned int * random_seed,
+                                     int * fold_of)
+{
+    int * labeled, labeled_samples = 0, j, swap;
+
+    INTALLOC(labeled, data->indexed_data_samples);
+    if (!labeled)
+        return -1;
+
+    COUNTUP(i, data->indexed_data_samples) {
+        fold_of[i] = -1;
+        if (data->indexed_data[i]->labeled != 0)
+            labeled[labeled_samples++] = i;
+    }
+
+    /* shuffle, then deal the samples out to the folds */
+    for (int i = labeled_samples-1; i > 0; i--) {
+        j = rand_num(random_seed)%(i+1);
+        swap = labeled[i];
+        labeled[i] = labeled[j];
+        labeled[j] = swap;
+    }
+
+    COUNTUP(i, labeled_samples)
+        fold_of[labeled[i]] = i%k;
+
+    free(labeled);
+    return labeled_samples;
+}
+
+/**
+ * @brief Creates the sample index sets and learner for one fold
+ * @param params Cross validation parameters
+ * @param data Deep learner object which owns the data set
+ * @param fold_of Fold of each sample, or -1 for unlabeled samples
+ * @param f Index of the fold
+ * @param task Returned fold
+ * @param random_seed Random number generator seed
+ * @returns zero on success
+ */
+static int deeplearn_crossval_create(deeplearn_crossval_params * params,
+                                     deeplearn * data, int * fold_of, int f,
+                                     deeplearn_crossval_task * task,
+                                     unsigned int * random_seed)
+{
+    int samples = data->indexed_data_samples;
+    unsigned int fold_seed = rand_num(random_seed);
+
+    INTALLOC(task->pretraining, samples);
+    INTALLOC(task->training, samples);
+    INTALLOC(task->test, samples);
+    if ((!task->pretraining) || (!task->training) || (!task->test))
+        return -1;
+
+    COUNTUP(i, samples) {
+        if (fold_of[i] == f) {
+            task->test[task->test_samples++] = i;
+            continue;
+        }
+
+        task->pretraining[task->pretraining_samples++] = i;
+        if (fold_of[i] >= 0)
+            task->training[task->training_samples++] = i;
+    }
+
+    task->learner = (deeplearn*)malloc(sizeof(deeplearn));
+    if (!task->learner)
+        return -2;
+
+    if (deeplearn_init(task->learner,
+                       data->net->no_of_inputs,
+                       params->no_of_hiddens, params->hidden_layers,
+                       data->net->no_of_outputs,
+                       params->error_threshold, &fold_seed) != 0) {
+        free(task->learner);
+        task->learner = 0;
+        return -3;
+    }
+
+    if (deeplearn_copy_fields(data, task->learner) != 0)
+        return -4;
+
+    task->learner->net->output_activation = data->net->output_activation;
+    return 0;
+}
+
+/**
+ * @brief Trains the learner for one fold on the samples which are not
+ *        held out
+ * @param params Cross validation parameters
+ * @param data Deep learner object which owns the data set
+ * @param task The fold
+ * @param fold Returned training statistics
+ */
+static void deeplearn_crossval_train(deeplearn_crossval_params * params,
+                                     deeplearn * data,
+                                     deeplearn_crossval_task * task,
+                                     deeplearn_crossval_fold * fold)
+{
+    deeplearn * learner = task->learner;
+    deeplearndata * sample;
+    int index;
+
+    fold->iterations = 0;
+    while (fold->iterations < params->max_iterations) {
+        if ((learner->net->hidden_layers > 1) &&
+            (learner->current_hidden_layer < learner->net->hidden_layers)) {
+            index = task->pretraining[rand_num(&learner->net->random_seed)%
+                                      task->pretraining_samples];
+            sample = deeplearndata_get(data, index);
+            deeplearn_set_inputs(learner, sample);
+            deeplearn_update(learner);
+        }
+        else if (learner->training_complete == 0) {
+            index = task->training[rand_num(&learner->net->random_seed)%
+                                   task->training_samples];
+            sample = deeplearndata_get(data, index);
+            deeplearn_set_inputs(learner, sample);
+            deeplearn_set_outputs(learner, sample);
+            bp_set_sample_weight(learner->net,
+                                 deeplearndata_sample_weight(data, sample));
+            deeplearn_update(learner);
+            bp_set_sample_weight(learner->net, 1.0f);
+        }
+        else
+            break;
+
+        fold->iterations++;
+    }
+
+    fold->training_samples = task->training_samples;
+    fold->test_samples = task->test_samples;
+    fold->training_complete = learner->training_complete;
+}
+
+/**
+ * @brief Evaluates the learner for one fold on its held out samples
+ * @param data Deep learner object which owns the data set
+ * @param task The fold
+ * @param outputs Array used to store the outputs of the learner
+ * @param fold Returned performance
+ */
+static void deeplearn_crossval_evaluate(deeplearn * data,
+                                        deeplearn_crossval_task * task,
+                                        float outputs[],
+                                        deeplearn_crossval_fold * fold)
+{
+    deeplearn * learner = task->learner;
+    deeplearndata * sample;
+    float error_percent, error, total_error = 0, squared_error = 0;
+    float average_error, hits = 0, values = 0;
+
+    COUNTUP(s, task->test_samples) {
+        sample = deeplearndata_get(data, task->test[s]);
+        deeplearn_set_inputs(learner, sample);
+        deeplearn_feed_forward(learner);
+        deeplearn_get_outputs(learner, outputs);
+
+        COUNTUP(i, learner->net->no_of_outputs) {
+            error = sample->outputs[i] - outputs[i];
+            squared_error += error*error*sample->weight;
+            values += sample->weight;
+
+            if (sample->outputs[i] != 0) {
+                error_percent = error / sample->outputs[i];
+                total_error += error_percent*error_percent*sample->weight;
+                hits += sample->weight;
+            }
+        }
+    }
+
+    fold->performance = 0;
+    if (hits > 0) {
+        average_error = (float)sqrt(total_error / hits) * 100;
+        if (average_error > 100) average_error = 100;
+        fold->performance = 100 - average_error;
+    }
+
+    fold->rms_error = 0;
+    if (values > 0)
+        fold->rms_error = (float)sqrt(squared_error / values);
+}
+
+/**
+ * @brief Trains and evaluates a range of folds
+ * @param start The first fold
+ * @param end The fold after the last one
+ * @param context deeplearn_crossval_loop object
+ */
+static void deeplearn_crossval_run(int start, int end, void * context)
+{
+    deeplearn_crossval_loop * args = (deeplearn_crossval_loop*)context;
+    float * outputs;
+
+    FOR(f, start, end) {
+        FLOATALLOC(outputs, args->data->net->no_of_outputs);
+        if (!outputs) {
+            args->task[f].failed = 1;
+            continue;
+        }
+
+        deeplearn_crossval_train(args->params, args->data, &args->task[f],
+                                 &args->result->fold[f]);
+        deeplearn_crossval_evaluate(args->data, &args->task[f], outputs,
+                                    &args->result->fold[f]);
+        free(outputs);
+    }
+}
+
+/**
+ * @brief Estimates how well a network generalises using k-fold cross
+ *        validation. The labeled samples are divided into k folds once,
+ *        then for each fold a new learner is trained on the other folds
+ *        and tested on the held out one. Folds are trained concurrently
+ *        on the current executor and all of them read the samples of the
+ *        given learner, which are not copied. Each fold has its own
+ *        random seed, so the results do not depend upon the number of
+ *        threads.
+ * @param params Cross validation parameters
+ * @param data Deep learner object which owns the data set, such as one
+ *        created by deeplearndata_read_csv
+ * @param k The number of folds
+ * @param result Returned metrics for each fold and their aggregate
+ * @returns zero on success
+ */
+int deeplearn_cross_validate(deeplearn_crossval_params * params,
+                             deeplearn * data, int k,
+                             deeplearn_crossval_result * result)
+{
+    deeplearn_crossval_task * task;
+    deeplearn_crossval_loop args;
+    unsigned int random_seed = params->random_seed;
+    int * fold_of, labeled_samples, retval = 0;
+    int threads = params->fold_threads;
+    int active_levels = 0;
+    float deviation;
+
+    result->no_of_folds = 0;
+    result->fold = 0;
+
+    if ((k < 2) || (data->data == 0) || (params->max_iterations < 1))
+        return -1;
+
+    INTALLOC(fold_of, data->indexed_data_samples);
+    if (!fold_of)
+        return -2;
+
+    labeled_samples =
+        deeplearn_crossval_assign(data, k, &random_seed, fold_of);
+    if (labeled_samples < k) {
+        free(fold_of);
+        return -3;
+    }
+
+    task = (deeplearn_crossval_task*)
+        malloc(k*sizeof(deeplearn_crossval_task));
+    result->fold = (deeplearn_crossval_fold*)
+        malloc(k*sizeof(deeplearn_crossval_fold));
+    if ((!task) || (!result->fold)) {
+        free(task);
+        free(result->fold);
+        result->fold = 0;
+        free(fold_of);
+        return -4;
+    }
+    memset(task, 0, k*sizeof(deeplearn_crossval_task));
+    memset(result->fold, 0, k*sizeof(deeplearn_crossval_fold));
+
+    COUNTUP(f, k) {
+        if (deeplearn_crossval_create(params, data, fold_of, f,
+                                      &task[f], &random_seed) != 0) {
+            retval = -5;
+            break;
+        }
+    }
+    free(fold_of);
+
+    if (retval != 0) {
+        deeplearn_crossval_free_tasks(task, k);
+        deeplearn_crossval_free(result);
+        return retval;
+    }
+
+    if ((threads <= 0) || (threads > k))
+        threads = (k < DEEPLEARN_THREADS) ? k : DEEPLEARN_THREADS;
+
+    /* the OpenMP executor only runs loops within a fold on multiple
+       threads if nesting is enabled */
+    if (params->nested != 0) {
+        active_levels = omp_get_max_active_levels();
+        omp_set_max_active_levels(2);
+    }
+
+    args.params = params;
+    args.data = data;
+    args.task = task;
+    args.result = result;
+    deeplearn_parallel_for_tasks(k, threads, deeplearn_crossval_run, &args);
+
+    if (params->nested != 0)
+        omp_set_max_active_levels(active_levels);
+
+    COUNTUP(f, k) {
+        if (task[f].failed != 0)
+            retval = -6;
+    }
+    deeplearn_crossval_free_tasks(task, k);
+
+    if (retval != 0) {
+        deeplearn_crossval_free(result);
+        return retval;
+    }
+
+    /* aggregate metrics */
+    result->no_of_folds = k;
+    result->mean_performance = 0;
+    result->mean_rms_error = 0;
+    COUNTUP(f, k) {
+        result->mean_performance += result->fold[f].performance;
+        result->mean_rms_error += result->fold[f].rms_error;
+    }
+    result->mean_performance /= k;
+    result->mean_rms_error /= k;
+
+    result->performance_std = 0;
+    COUNTUP(f, k) {
+        deviation = result->fold[f].performance - result->mean_performance;
+        result->performance_std += deviation*deviation;
+    }
+    result->performance_std = (float)sqrt(result->performance_std / k);
+
+    return 0;
+}
+
+/**
+ * @brief Deallocates the metrics returned by deeplearn_cross_validate
+ * @param result Cross validation result
+ */
+void deeplearn_crossval_free(deeplearn_crossval_result * result)
+{
+    free(result->fold);
+    result->fold = 0;
+    result->no_of_folds = 0;
+}
@@ -0,0 +1,101 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_CROSSVAL_H
+#define DEEPLEARN_CROSSVAL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include "globals.h"
+#include "deeplearn.h"
+#include "deeplearndata.h"
+#include "deeplearn_random.h"
+
+/* default maximum number of training iterations for each fold */
+#define DEEPLEARN_CROSSVAL_MAX_ITERATIONS 100000
+
+typedef struct {
+    int no_of_hiddens;
+    int hidden_layers;
+
+    /* minimum training error for each hidden layer plus the output layer */
+    float * error_threshold;
+
+    unsigned int random_seed;
+
+    /* training of a fold stops after this many iterations even if
+       its error thresholds have not been reached */
+    int max_iterations;
+
+    /* the number of tasks which the folds are divided between, each
+       of which the executor may run on its own thread, or zero for one
+       task per fold up to DEEPLEARN_THREADS */
+    int fold_threads;
+
+    /* if non-zero then with the OpenMP executor the parallel loops
+       within each fold also run on multiple threads, otherwise they
+       run on the fold's thread */
+    int nested;
+} deeplearn_crossval_params;
+
+typedef struct {
+    int training_samples;
+    int test_samples;
+    int iterations;
+    int training_complete;
+
+    /* as returned by deeplearndata_get_performance */
+    float performance;
+
+    /* root mean square error of the outputs on the held out samples */
+    float rms_error;
+} deeplearn_crossval_fold;
+
+typedef struct {
+    int no_of_folds;
+    deeplearn_crossval_fold * fold;
+
+    float mean_performance;
+    float performance_std;
+    float mean_rms_error;
+} deeplearn_crossval_result;
+
+void deeplearn_crossval_init_params(deeplearn_crossval_params * params,
+                                    int no_of_hiddens, int hidden_layers,
+                                    float error_threshold[],
+                                    unsigned int random_seed);
+int deeplearn_cross_validate(deeplearn_crossval_params * params,
+                             deeplearn * data, int k,
+                             deeplearn_crossval_result * result);
+void deeplearn_crossval_free(deeplearn_crossval_result * result);
+
+#endif
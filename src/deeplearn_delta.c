@@ -0,0 +1,383 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_delta.h"
+
+/**
+ * @brief Copies the first layer weights of the network, so that the
+ *        weights from each input unit are contiguous
+ * @param delta Incremental inference object
+ */
+static void deeplearn_delta_copy_weights(deeplearn_delta * delta)
+{
+    bp * net = delta->learner->net;
+
+    COUNTDOWN(h, delta->no_of_hiddens) {
+        bp_neuron * n = net->hiddens[0][h];
+
+        delta->bias[h] = n->bias;
+        COUNTDOWN(i, delta->no_of_inputs)
+            delta->weights[i*delta->no_of_hiddens + h] = n->weights[i];
+    }
+    delta->model_version = delta->learner->model_version;
+}
+
+/**
+ * @brief Calculates the first layer sums for the given inputs in full
+ * @param delta Incremental inference object
+ * @param inputs Input values, one per input unit
+ * @param sums Returned sums, one per unit within the first hidden layer
+ */
+static void deeplearn_delta_sums(deeplearn_delta * delta,
+                                 float inputs[], float sums[])
+{
+    memcpy(sums, delta->bias, delta->no_of_hiddens*sizeof(float));
+
+    COUNTUP(i, delta->no_of_inputs) {
+        float * w = &delta->weights[i*delta->no_of_hiddens];
+        float v = inputs[i];
+
+        COUNTDOWN(h, delta->no_of_hiddens)
+            sums[h] += w[h] * v;
+    }
+}
+
+/**
+ * @brief If the network has been trained since the sums were calculated
+ *        then the weights are copied again and the sums recalculated
+ * @param delta Incremental inference object
+ */
+static void deeplearn_delta_refresh(deeplearn_delta * delta)
+{
+    if (delta->model_version == delta->learner->model_version)
+        return;
+
+    deeplearn_delta_copy_weights(delta);
+    deeplearn_delta_sums(delta, delta->base_inputs, delta->base_sums);
+    deeplearn_delta_sums(delta, delta->inputs, delta->sums);
+}
+
+/**
+ * @brief Frees a partially created incremental inference object
+ *        when an allocation fails
+ * @param delta Incremental inference object
+ * @param retval The error to return
+ * @returns retval
+ */
+static int deeplearn_delta_init_failed(deeplearn_delta * delta, int retval)
+{
+    deeplearn_delta_free(delta);
+    return retval;
+}
+
+/**
+ * @brief Creates an object for incremental inference, where a base sample
+ *        is evaluated repeatedly with a few of its fields changed.
+ *        The first layer sums are updated only for the inputs which change
+ * @param delta Incremental inference object
+ * @param learner Deep learner object
+ * @returns zero on success
+ */
+int deeplearn_delta_init(deeplearn_delta * delta, deeplearn * learner)
+{
+    bp * net = learner->net;
+
+    delta->learner = learner;
+    delta->no_of_inputs = net->no_of_inputs;
+    delta->no_of_hiddens = HIDDENS_IN_LAYER(net,0);
+    delta->changed_inputs = 0;
+
+    /* nothing allocated yet, so that deeplearn_delta_free can clean up
+       if any of the allocations below fail */
+    delta->weights = 0;
+    delta->bias = 0;
+    delta->base_inputs = 0;
+    delta->inputs = 0;
+    delta->field_inputs = 0;
+    delta->base_sums = 0;
+    delta->sums = 0;
+    delta->hiddens = 0;
+    delta->buffer = 0;
+
+    FLOATALLOC(delta->weights, delta->no_of_inputs*delta->no_of_hiddens);
+    if (!delta->weights)
+        return deeplearn_delta_init_failed(delta, -1);
+
+    FLOATALLOC(delta->bias, delta->no_of_hiddens);
+    if (!delta->bias)
+        return deeplearn_delta_init_failed(delta, -2);
+
+    FLOATALLOC(delta->base_inputs, delta->no_of_inputs);
+    if (!delta->base_inputs)
+        return deeplearn_delta_init_failed(delta, -3);
+
+    FLOATALLOC(delta->inputs, delta->no_of_inputs);
+    if (!delta->inputs)
+        return deeplearn_delta_init_failed(delta, -4);
+
+    FLOATALLOC(delta->field_inputs, delta->no_of_inputs);
+    if (!delta->field_inputs)
+        return deeplearn_delta_init_failed(delta, -5);
+
+    FLOATALLOC(delta->base_sums, delta->no_of_hiddens);
+    if (!delta->base_sums)
+        return deeplearn_delta_init_failed(delta, -6);
+
+    FLOATALLOC(delta->sums, delta->no_of_hiddens);
+    if (!delta->sums)
+        return deeplearn_delta_init_failed(delta, -7);
+
+    FLOATALLOC(delta->hiddens, delta->no_of_hiddens);
+    if (!delta->hiddens)
+        return deeplearn_delta_init_failed(delta, -8);
+
+    FLOATALLOC(delta->buffer, bp_widest_layer(net)*2);
+    if (!delta->buffer)
+        return deeplearn_delta_init_failed(delta, -9);
+
+    COUNTDOWN(i, delta->no_of_inputs)
+        delta->base_inputs[i] = NEURON_UNKNOWN;
+
+    deeplearn_delta_copy_weights(delta);
+    return deeplearn_delta_set_base_inputs(delta, delta->base_inputs);
+}
+
+/**
+ * @brief Frees memory for an incremental inference object
+ * @param delta Incremental inference object
+ */
+void deeplearn_delta_free(deeplearn_delta * delta)
+{
+    free(delta->weights);
+    free(delta->bias);
+    free(delta->base_inputs);
+    free(delta->inputs);
+    free(delta->field_inputs);
+    free(delta->base_sums);
+    free(delta->sums);
+    free(delta->hiddens);
+    free(delta->buffer);
+    delta->weights = 0;
+    delta->bias = 0;
+    delta->base_inputs = 0;
+    delta->inputs = 0;
+    delta->field_inputs = 0;
+    delta->base_sums = 0;
+    delta->sums = 0;
+    delta->hiddens = 0;
+    delta->buffer = 0;
+}
+
+/**
+ * @brief Sets the base sample from its field values
+ * @param delta Incremental inference object
+ * @param fields Numeric field values
+ * @param fields_text Text field values, or NULL if there are no text fields
+ * @returns zero on success
+ */
+int deeplearn_delta_set_base(deeplearn_delta * delta,
+                             float fields[], char ** fields_text)
+{
+    if (deeplearn_fields_to_inputs(delta->learner, fields, fields_text,
+                                   delta->field_inputs) != 0)
+        return -1;
+
+    return deeplearn_delta_set_base_inputs(delta, delta->field_inputs);
+}
+
+/**
+ * @brief Sets the base sample from normalised input values and calculates
+ *        its first layer sums in full
+ * @param delta Incremental inference object
+ * @param inputs Input values, one per input unit
+ * @returns zero on success
+ */
+int deeplearn_delta_set_base_inputs(deeplearn_delta * delta,
+                                    float inputs[])
+{
+    if (delta->model_version != delta->learner->model_version)
+        deeplearn_delta_copy_weights(delta);
+
+    if (inputs != delta->base_inputs)
+        memcpy(delta->base_inputs, inputs, delta->no_of_inputs*sizeof(float));
+
+    deeplearn_delta_sums(delta, delta->base_inputs, delta->base_sums);
+    deeplearn_delta_reset(delta);
+    return 0;
+}
+
+/**
+ * @brief Discards any changes, returning to the base sample
+ * @param delta Incremental inference object
+ */
+void deeplearn_delta_reset(deeplearn_delta * delta)
+{
+    memcpy(delta->inputs, delta->base_inputs,
+           delta->no_of_inputs*sizeof(float));
+    memcpy(delta->sums, delta->base_sums,
+           delta->no_of_hiddens*sizeof(float));
+    delta->changed_inputs = 0;
+}
+
+/**
+ * @brief Changes the value of a single input unit, updating the first
+ *        layer sums by the weights from that unit times the change
+ * @param delta Incremental inference object
+ * @param index Index of the input unit
+ * @param value Normalised input value
+ * @returns zero on success
+ */
+int deeplearn_delta_set_input(deeplearn_delta * delta,
+                              int index, float value)
+{
+    float * w;
+    float diff;
+
+    if ((index < 0) || (index >= delta->no_of_inputs))
+        return -1;
+
+    diff = value - delta->inputs[index];
+    if (diff == 0)
+        return 0;
+
+    deeplearn_delta_refresh(delta);
+
+    w = &delta->weights[index*delta->no_of_hiddens];
+    COUNTDOWN(h, delta->no_of_hiddens)
+        delta->sums[h] += w[h] * diff;
+
+    delta->inputs[index] = value;
+    delta->changed_inputs++;
+    return 0;
+}
+
+/**
+ * @brief Changes the value of a numeric field
+ * @param delta Incremental inference object
+ * @param fieldindex Index number of the input field. If no fields are
+ *        defined then this is the input unit index
+ * @param value Field value within its original range
+ * @returns zero on success
+ */
+int deeplearn_delta_set_field(deeplearn_delta * delta,
+                              int fieldindex, float value)
+{
+    deeplearn * learner = delta->learner;
+    float range, normalised = NEURON_UNKNOWN;
+    int pos = fieldindex;
+
+    if (learner->no_of_input_fields == 0) {
+        if ((fieldindex < 0) || (fieldindex >= delta->no_of_inputs))
+            return -1;
+    }
+    else {
+        if ((fieldindex < 0) || (fieldindex >= learner->no_of_input_fields))
+            return -1;
+
+        /* this is a text field */
+        if (learner->field_length[fieldindex] > 0)
+            return -2;
+
+        pos = deeplearn_field_position(learner, fieldindex);
+
+        /* the field was dropped, so the value makes no difference */
+        if (pos < 0)
+            return 0;
+    }
+
+    range = learner->input_range_max[fieldindex] -
+        learner->input_range_min[fieldindex];
+    if (range > 0)
+        normalised =
+            (((value - learner->input_range_min[fieldindex])/range)*
+             NEURON_RANGE) + NEURON_LOW;
+
+    return deeplearn_delta_set_input(delta, pos, normalised);
+}
+
+/**
+ * @brief Changes the value of a text field. Only the input units for
+ *        bits which differ from the current text are updated
+ * @param delta Incremental inference object
+ * @param fieldindex Index number of the input field
+ * @param text Text value for the field
+ * @returns zero on success
+ */
+int deeplearn_delta_set_field_text(deeplearn_delta * delta,
+                                   int fieldindex, char * text)
+{
+    deeplearn * learner = delta->learner;
+    int pos, end;
+
+    if ((fieldindex < 0) || (fieldindex >= learner->no_of_input_fields))
+        return -1;
+
+    /* this is not a text field */
+    if (learner->field_length[fieldindex] == 0)
+        return -2;
+
+    pos = deeplearn_field_position(learner, fieldindex);
+
+    /* the field was dropped, so the value makes no difference */
+    if (pos < 0)
+        return 0;
+
+    end = pos + learner->field_length[fieldindex];
+    if (end > delta->no_of_inputs)
+        end = delta->no_of_inputs;
+
+    enc_text_to_float(text, delta->field_inputs, delta->no_of_inputs,
+                      pos, learner->field_length[fieldindex]/CHAR_BITS);
+
+    FOR(i, pos, end) {
+        if (delta->field_inputs[i] != delta->inputs[i])
+            deeplearn_delta_set_input(delta, i, delta->field_inputs[i]);
+    }
+    return 0;
+}
+
+/**
+ * @brief Feeds the current sample forward from the first layer sums.
+ *        The state of the network is not altered
+ * @param delta Incremental inference object
+ * @param outputs Returned output values in the range NEURON_LOW to
+ *        NEURON_HIGH, one per output unit
+ * @returns zero on success
+ */
+int deeplearn_delta_feed_forward(deeplearn_delta * delta, float outputs[])
+{
+    deeplearn_delta_refresh(delta);
+
+    COUNTDOWN(h, delta->no_of_hiddens)
+        delta->hiddens[h] = AF(delta->sums[h]);
+
+    bp_feed_forward_from_layer(delta->learner->net, 0, delta->hiddens,
+                               outputs, delta->buffer);
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_DELTA_H
+#define DEEPLEARN_DELTA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+#include "backprop.h"
+#include "encoding.h"
+#include "deeplearn.h"
+
+typedef struct {
+    deeplearn * learner;
+
+    /* model version for which the weights and sums are valid */
+    unsigned int model_version;
+
+    int no_of_inputs;
+    int no_of_hiddens;
+
+    /* first layer weights, stored with the weights for each input unit
+       contiguous so that a change in one input is a single pass */
+    float * weights;
+    float * bias;
+
+    /* inputs and first layer sums for the base sample */
+    float * base_inputs;
+    float * base_sums;
+
+    /* inputs and first layer sums after changes to the base sample */
+    float * inputs;
+    float * sums;
+
+    /* working values */
+    float * field_inputs;
+    float * hiddens;
+    float * buffer;
+
+    /* number of input units updated since the base was set or reset */
+    unsigned long changed_inputs;
+} deeplearn_delta;
+
+int deeplearn_delta_init(deeplearn_delta * delta, deeplearn * learner);
+void deeplearn_delta_free(deeplearn_delta * delta);
+int deeplearn_delta_set_base(deeplearn_delta * delta,
+                             float fields[], char ** fields_text);
+int deeplearn_delta_set_base_inputs(deeplearn_delta * delta,
+                                    float inputs[]);
+void deeplearn_delta_reset(deeplearn_delta * delta);
+int deeplearn_delta_set_input(deeplearn_delta * delta,
+                              int index, float value);
+int deeplearn_delta_set_field(deeplearn_delta * delta,
+                              int fieldindex, float value);
+int deeplearn_delta_set_field_text(deeplearn_delta * delta,
+                                   int fieldindex, char * text);
+int deeplearn_delta_feed_forward(deeplearn_delta * delta, float outputs[]);
+
+#endif
@@ -0,0 +1,821 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_ensemble.h"
+
+/* arguments of the loop which evaluates one layer of all members */
+typedef struct {
+    int members, units, no_of_inputs, input_stride;
+    int shared_inputs, linear;
+    float * weights, * bias, * inputs, * outputs;
+} deeplearn_ensemble_layer_loop;
+
+/**
+ * @brief Creates a bootstrap view of a data set, which is an array of
+ *        sample indexes drawn with replacement
+ * @param samples The number of samples in the data set
+ * @param view Returned array of indexes
+ * @param random_seed Random number generator seed
+ * @returns zero on success
+ */
+static int deeplearn_ensemble_bootstrap(int samples, int ** view,
+                                        unsigned int * random_seed)
+{
+    *view = 0;
+    if (samples <= 0)
+        return 0;
+
+    INTALLOC(*view, samples);
+    if (!(*view))
+        return -1;
+
+    COUNTDOWN(i, samples)
+        (*view)[i] = rand_num(random_seed)%samples;
+
+    return 0;
+}
+
+/**
+ * @brief Frees a partially initialised ensemble when creating it fails
+ * @param ensemble Ensemble object
+ * @param retval The error to return
+ * @returns retval
+ */
+static int deeplearn_ensemble_init_failed(deeplearn_ensemble * ensemble,
+                                          int retval)
+{
+    deeplearn_ensemble_free(ensemble);
+    return retval;
+}
+
+/**
+ * @brief Initialise an ensemble of deep learners which are trained on
+ *        bootstrap views of the data set belonging to a source learner,
+ *        such as one created by deeplearndata_read_csv
+ * @param ensemble Ensemble object
+ * @param no_of_members The number of deep learners within the ensemble
+ * @param source Deep learner object which owns the data set
+ * @param no_of_hiddens The number of hidden units within each layer
+ * @param hidden_layers The number of hidden layers
+ * @param error_threshold Minimum training error for each hidden layer plus
+ *        the output layer
+ * @param random_seed Random number generator seed
+ * @returns zero on success
+ */
+int deeplearn_ensemble_init(deeplearn_ensemble * ensemble,
+                            int no_of_members,
+                            deeplearn * source,
+                            int no_of_hiddens,
+                            int hidden_layers,
+                            float error_threshold[],
+                            unsigned int * random_seed)
+{
+    deeplearn * member;
+
+    if (no_of_members < 1)
+        return -1;
+
+    ensemble->no_of_members = no_of_members;
+    ensemble->source = source;
+    ensemble->combine = ENSEMBLE_AVERAGE;
+    ensemble->packed = 0;
+    ensemble->layer_weights = 0;
+    ensemble->layer_bias = 0;
+    ensemble->inputs = 0;
+    ensemble->outputs = 0;
+    ensemble->bootstrap_samples = source->indexed_training_data_samples;
+    ensemble->bootstrap_labeled_samples =
+        source->indexed_training_data_labeled_samples;
+
+    /* cleared, so that a partially created ensemble can be freed */
+    ensemble->member = (deeplearn**)calloc(no_of_members, sizeof(deeplearn*));
+    ensemble->bootstrap = (int**)calloc(no_of_members, sizeof(int*));
+    ensemble->bootstrap_labeled = (int**)calloc(no_of_members, sizeof(int*));
+    ensemble->status = (int*)calloc(no_of_members, sizeof(int));
+    if ((!ensemble->member) || (!ensemble->bootstrap) ||
+        (!ensemble->bootstrap_labeled) || (!ensemble->status))
+        return deeplearn_ensemble_init_failed(ensemble, -2);
+
+    COUNTUP(m, no_of_members) {
+        /* each member gets its own random seed */
+        unsigned int member_seed = rand_num(random_seed);
+
+        member = (deeplearn*)malloc(sizeof(deeplearn));
+        if (!member)
+            return deeplearn_ensemble_init_failed(ensemble, -5);
+
+        if (deeplearn_init(member,
+                           source->net->no_of_inputs,
+                           no_of_hiddens, hidden_layers,
+                           source->net->no_of_outputs,
+                           error_threshold, &member_seed) != 0) {
+            free(member);
+            return deeplearn_ensemble_init_failed(ensemble, -6);
+        }
+        ensemble->member[m] = member;
+
+        if (deeplearn_copy_fields(source, member) != 0)
+            return deeplearn_ensemble_init_failed(ensemble, -7);
+
+        member->net->output_activation = source->net->output_activation;
+
+        if (deeplearn_ensemble_bootstrap(ensemble->bootstrap_samples,
+                                         &ensemble->bootstrap[m],
+                                         &member_seed) != 0)
+            return deeplearn_ensemble_init_failed(ensemble, -8);
+
+        if (deeplearn_ensemble_bootstrap(ensemble->bootstrap_labeled_samples,
+                                         &ensemble->bootstrap_labeled[m],
+                                         &member_seed) != 0)
+            return deeplearn_ensemble_init_failed(ensemble, -9);
+    }
+
+    FLOATALLOC(ensemble->inputs, source->net->no_of_inputs);
+    if (!ensemble->inputs)
+        return deeplearn_ensemble_init_failed(ensemble, -10);
+
+    FLOATALLOC(ensemble->outputs, source->net->no_of_outputs);
+    if (!ensemble->outputs)
+        return deeplearn_ensemble_init_failed(ensemble, -11);
+
+    COUNTDOWN(i, source->net->no_of_inputs)
+        ensemble->inputs[i] = NEURON_UNKNOWN;
+
+    FLOATCLEAR(ensemble->outputs, source->net->no_of_outputs);
+    return 0;
+}
+
+/**
+ * @brief Frees the stacked weights used for fused inference
+ * @param ensemble Ensemble object
+ */
+static void deeplearn_ensemble_unpack(deeplearn_ensemble * ensemble)
+{
+    int layers;
+
+    if ((ensemble->layer_weights == 0) && (ensemble->layer_bias == 0))
+        return;
+
+    layers = ensemble->member[0]->net->hidden_layers+1;
+    COUNTDOWN(l, layers) {
+        if (ensemble->layer_weights != 0)
+            free(ensemble->layer_weights[l]);
+        if (ensemble->layer_bias != 0)
+            free(ensemble->layer_bias[l]);
+    }
+    free(ensemble->layer_weights);
+    free(ensemble->layer_bias);
+    ensemble->layer_weights = 0;
+    ensemble->layer_bias = 0;
+    ensemble->packed = 0;
+}
+
+/**
+ * @brief Deallocates memory for the given ensemble. Note that the
+ *        source learner is not freed
+ * @param ensemble Ensemble object
+ */
+void deeplearn_ensemble_free(deeplearn_ensemble * ensemble)
+{
+    deeplearn_ensemble_unpack(ensemble);
+
+    COUNTDOWN(m, ensemble->no_of_members) {
+        if ((ensemble->member != 0) && (ensemble->member[m] != 0)) {
+            deeplearn_free(ensemble->member[m]);
+            free(ensemble->member[m]);
+        }
+        if ((ensemble->bootstrap != 0) && (ensemble->bootstrap[m] != 0))
+            free(ensemble->bootstrap[m]);
+        if ((ensemble->bootstrap_labeled != 0) &&
+            (ensemble->bootstrap_labeled[m] != 0))
+            free(ensemble->bootstrap_labeled[m]);
+    }
+    free(ensemble->member);
+    free(ensemble->bootstrap);
+    free(ensemble->bootstrap_labeled);
+    free(ensemble->status);
+    free(ensemble->inputs);
+    free(ensemble->outputs);
+    ensemble->member = 0;
+    ensemble->bootstrap = 0;
+    ensemble->bootstrap_labeled = 0;
+    ensemble->status = 0;
+    ensemble->inputs = 0;
+    ensemble->outputs = 0;
+}
+
+/**
+ * @brief Performs a single training step for one member of the ensemble
+ * @param ensemble Ensemble object
+ * @param m Index of the ensemble member
+ * @returns 1=pretraining,2=final training,0=training complete,-1=no training data
+ */
+static int deeplearn_ensemble_member_training(deeplearn_ensemble * ensemble,
+                                              int m)
+{
+    deeplearn * learner = ensemble->member[m];
+    deeplearn * source = ensemble->source;
+    deeplearndata * sample;
+    int index;
+
+    if ((learner->net->hidden_layers > 1) &&
+        (learner->current_hidden_layer < learner->net->hidden_layers)) {
+        if (ensemble->bootstrap_samples == 0)
+            return -1;
+
+        /* a random sample from this member's view of the training set */
+        index = ensemble->bootstrap[m][rand_num(&learner->net->random_seed)%
+                                       ensemble->bootstrap_samples];
+        sample = deeplearndata_get_training(source, index);
+        deeplearn_set_inputs(learner, sample);
+        deeplearn_update(learner);
+        return 1;
+    }
+
+    if (learner->training_complete == 0) {
+        if (ensemble->bootstrap_labeled_samples == 0)
+            return -1;
+
+        index =
+            ensemble->bootstrap_labeled[m][rand_num(&learner->net->random_seed)%
+                                           ensemble->bootstrap_labeled_samples];
+        sample = deeplearndata_get_training_labeled(source, index);
+        deeplearn_set_inputs(learner, sample);
+        deeplearn_set_outputs(learner, sample);
+        deeplearn_update(learner);
+        return 2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Body of the parallel loop which trains a range of members
+ * @param start Index of the first member
+ * @param end Index after the last member
+ * @param context Ensemble object
+ */
+static void deeplearn_ensemble_train_members(int start, int end,
+                                             void * context)
+{
+    deeplearn_ensemble * ensemble = (deeplearn_ensemble*)context;
+
+    FOR(m, start, end)
+        ensemble->status[m] = deeplearn_ensemble_member_training(ensemble, m);
+}
+
+/**
+ * @brief Performs a single training step for every member of the ensemble.
+ *        Members are trained concurrently.
+ * @param ensemble Ensemble object
+ * @returns The number of members still training, zero if training is
+ *          complete or -1 if there is no training data
+ */
+int deeplearn_ensemble_training(deeplearn_ensemble * ensemble)
+{
+    int still_training = 0, no_data = 0;
+
+    /* one task per member, since members may finish at different times */
+    deeplearn_parallel_for_tasks(ensemble->no_of_members,
+                                 ensemble->no_of_members,
+                                 deeplearn_ensemble_train_members, ensemble);
+
+    COUNTDOWN(m, ensemble->no_of_members) {
+        if (ensemble->status[m] > 0)
+            still_training++;
+        if (ensemble->status[m] < 0)
+            no_data++;
+    }
+
+    /* weights have changed, so any stacked weights are now stale */
+    if (still_training > 0)
+        ensemble->packed = 0;
+
+    if (no_data > 0)
+        return -1;
+
+    return still_training;
+}
+
+/**
+ * @brief Returns non-zero if all ensemble members have the same topology
+ * @param ensemble Ensemble object
+ * @returns non-zero if the members share a topology
+ */
+static int deeplearn_ensemble_same_topology(deeplearn_ensemble * ensemble)
+{
+    bp * net0 = ensemble->member[0]->net;
+
+    FOR(m, 1, ensemble->no_of_members) {
+        bp * net = ensemble->member[m]->net;
+        if ((net->no_of_inputs != net0->no_of_inputs) ||
+            (net->no_of_hiddens != net0->no_of_hiddens) ||
+            (net->hidden_layers != net0->hidden_layers) ||
+            (net->no_of_outputs != net0->no_of_outputs))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Returns the units within the given layer.
+ *        Layer index hidden_layers is the output layer
+ * @param net Backprop neural net object
+ * @param layer Index of the layer
+ * @param units Returned number of units
+ * @returns Array of units
+ */
+static bp_neuron ** deeplearn_ensemble_layer_units(bp * net, int layer,
+                                                   int * units)
+{
+    if (layer < net->hidden_layers) {
+        *units = HIDDENS_IN_LAYER(net, layer);
+        return net->hiddens[layer];
+    }
+    *units = net->no_of_outputs;
+    return net->outputs;
+}
+
+/**
+ * @brief Returns the number of inputs to each unit within the given layer
+ * @param net Backprop neural net object
+ * @param layer Index of the layer
+ * @returns Number of inputs per unit
+ */
+static int deeplearn_ensemble_layer_inputs(bp * net, int layer)
+{
+    if (layer == 0)
+        return net->no_of_inputs;
+    return HIDDENS_IN_LAYER(net, layer-1);
+}
+
+/**
+ * @brief Stacks the weights of every member into a single matrix per layer
+ *        so that all members can be evaluated within one fused pass.
+ *        For the first layer the inputs are shared, so the result is
+ *        a wider weight matrix.
+ * @param ensemble Ensemble object
+ * @returns zero on success
+ */
+int deeplearn_ensemble_pack(deeplearn_ensemble * ensemble)
+{
+    bp * net0 = ensemble->member[0]->net;
+    int layers = net0->hidden_layers+1;
+    int members = ensemble->no_of_members;
+
+    deeplearn_ensemble_unpack(ensemble);
+
+    if (!deeplearn_ensemble_same_topology(ensemble))
+        return -1;
+
+    /* cleared, so that a partially packed ensemble can be unpacked */
+    ensemble->layer_weights = (float**)calloc(layers, sizeof(float*));
+    ensemble->layer_bias = (float**)calloc(layers, sizeof(float*));
+    if ((!ensemble->layer_weights) || (!ensemble->layer_bias)) {
+        deeplearn_ensemble_unpack(ensemble);
+        return -2;
+    }
+
+    COUNTUP(l, layers) {
+        int units;
+        int no_of_weights = deeplearn_ensemble_layer_inputs(net0, l);
+
+        deeplearn_ensemble_layer_units(net0, l, &units);
+
+        FLOATALLOC(ensemble->layer_weights[l], members*units*no_of_weights);
+        FLOATALLOC(ensemble->layer_bias[l], members*units);
+        if ((!ensemble->layer_weights[l]) || (!ensemble->layer_bias[l])) {
+            deeplearn_ensemble_unpack(ensemble);
+            return -3;
+        }
+
+        COUNTDOWN(m, members) {
+            bp_neuron ** neurons =
+                deeplearn_ensemble_layer_units(ensemble->member[m]->net,
+                                               l, &units);
+            COUNTDOWN(i, units) {
+                int row = m*units + i;
+                memcpy((void*)&ensemble->layer_weights[l][row*no_of_weights],
+                       neurons[i]->weights, no_of_weights*sizeof(float));
+                ensemble->layer_bias[l][row] = neurons[i]->bias;
+            }
+        }
+    }
+
+    ensemble->packed = 1;
+    return 0;
+}
+
+/**
+ * @brief Sets the way in which member outputs are combined
+ * @param ensemble Ensemble object
+ * @param combine ENSEMBLE_AVERAGE or ENSEMBLE_VOTE
+ */
+void deeplearn_ensemble_set_combine(deeplearn_ensemble * ensemble,
+                                    int combine)
+{
+    ensemble->combine = combine;
+}
+
+/**
+ * @brief Body of the parallel loop which evaluates a range of the rows of
+ *        a layer, where each row is one unit of one member for one sample
+ * @param start Index of the first row
+ * @param end Index after the last row
+ * @param context deeplearn_ensemble_layer_loop object
+ */
+static void deeplearn_ensemble_layer_rows(int start, int end, void * context)
+{
+    deeplearn_ensemble_layer_loop * args =
+        (deeplearn_ensemble_layer_loop*)context;
+    int rows = args->members*args->units;
+    int no_of_inputs = args->no_of_inputs;
+
+    FOR(r, start, end) {
+        int b = r / rows;
+        int row = r % rows;
+        float * w = &args->weights[row*no_of_inputs];
+        float * inp = &args->inputs[b*args->input_stride];
+        float adder = args->bias[row];
+
+        if (args->shared_inputs == 0)
+            inp += (row / args->units)*no_of_inputs;
+
+        COUNTDOWN(i, no_of_inputs)
+            adder += w[i] * inp[i];
+
+        if (args->linear != 0)
+            args->outputs[b*rows + row] = adder;
+        else
+            args->outputs[b*rows + row] = AF(adder);
+    }
+}
+
+/**
+ * @brief Evaluates one layer of all members for a batch of samples
+ * @param batch_size The number of samples in the batch
+ * @param members The number of ensemble members
+ * @param units The number of units in the layer for each member
+ * @param no_of_inputs The number of inputs to each unit
+ * @param shared_inputs Non-zero if all members see the same inputs
+ * @param linear Non-zero to return weighted sums without the activation
+ * @param weights Stacked weights for the layer
+ * @param bias Stacked biases for the layer
+ * @param inputs Layer inputs for the batch
+ * @param outputs Returned layer outputs for the batch
+ */
+static void deeplearn_ensemble_layer(int batch_size, int members,
+                                     int units, int no_of_inputs,
+                                     int shared_inputs, int linear,
+                                     float weights[], float bias[],
+                                     float inputs[], float outputs[])
+{
+    deeplearn_ensemble_layer_loop args = {
+        members, units, no_of_inputs, no_of_inputs,
+        shared_inputs, linear,
+        weights, bias, inputs, outputs
+    };
+
+    if (shared_inputs == 0)
+        args.input_stride = members*no_of_inputs;
+
+    deeplearn_parallel_for(batch_size*members*units,
+                           deeplearn_ensemble_layer_rows, &args);
+}
+
+/**
+ * @brief Evaluates each member separately. This is used when the members
+ *        do not share a topology
+ * @param ensemble Ensemble object
+ * @param batch_size The number of samples in the batch
+ * @param inputs Network input values for the batch
+ * @param member_outputs Returned outputs for each sample and member
+ */
+static void deeplearn_ensemble_feed_forward_members(deeplearn_ensemble * ensemble,
+                                                    int batch_size,
+                                                    float inputs[],
+                                                    float member_outputs[])
+{
+    int members = ensemble->no_of_members;
+    int no_of_inputs = ensemble->source->net->no_of_inputs;
+    int no_of_outputs = ensemble->source->net->no_of_outputs;
+
+    COUNTUP(b, batch_size) {
+        COUNTUP(m, members) {
+            deeplearn * learner = ensemble->member[m];
+            COUNTDOWN(i, no_of_inputs)
+                bp_set_input(learner->net, i, inputs[b*no_of_inputs + i]);
+            deeplearn_feed_forward(learner);
+            COUNTDOWN(i, no_of_outputs)
+                member_outputs[(b*members + m)*no_of_outputs + i] =
+                    bp_get_output(learner->net, i);
+        }
+    }
+}
+
+/**
+ * @brief Combines member outputs by averaging or voting
+ * @param ensemble Ensemble object
+ * @param batch_size The number of samples in the batch
+ * @param member_outputs Outputs for each sample and member
+ * @param outputs Returned combined outputs for each sample
+ */
+static void deeplearn_ensemble_combine(deeplearn_ensemble * ensemble,
+                                       int batch_size,
+                                       float member_outputs[],
+                                       float outputs[])
+{
+    int members = ensemble->no_of_members;
+    int no_of_outputs = ensemble->source->net->no_of_outputs;
+
+    COUNTDOWN(b, batch_size) {
+        float * out = &outputs[b*no_of_outputs];
+
+        FLOATCLEAR(out, no_of_outputs);
+        COUNTDOWN(m, members) {
+            float * curr = &member_outputs[(b*members + m)*no_of_outputs];
+
+            if (ensemble->combine == ENSEMBLE_VOTE) {
+                /* each member votes for its most active class */
+                int winner = 0;
+                FOR(i, 1, no_of_outputs) {
+                    if (curr[i] > curr[winner])
+                        winner = i;
+                }
+                out[winner] += 1.0f;
+            }
+            else {
+                COUNTDOWN(i, no_of_outputs)
+                    out[i] += curr[i];
+            }
+        }
+
+        COUNTDOWN(i, no_of_outputs) {
+            if (ensemble->combine == ENSEMBLE_VOTE)
+                /* fraction of votes within the neuron range */
+                out[i] = NEURON_LOW + (out[i]*NEURON_RANGE/members);
+            else
+                out[i] /= members;
+        }
+    }
+}
+
+/**
+ * @brief Evaluates all ensemble members for a batch of samples
+ *        within a single fused pass
+ * @param ensemble Ensemble object
+ * @param batch_size The number of samples in the batch
+ * @param inputs Network input values in the range NEURON_LOW to NEURON_HIGH
+ *        with no_of_inputs values per sample
+ * @param outputs Returned combined outputs with no_of_outputs values
+ *        per sample, in the range NEURON_LOW to NEURON_HIGH
+ * @returns zero on success
+ */
+int deeplearn_ensemble_feed_forward_batch(deeplearn_ensemble * ensemble,
+                                          int batch_size,
+                                          float inputs[],
+                                          float outputs[])
+{
+    bp * net0 = ensemble->member[0]->net;
+    int members = ensemble->no_of_members;
+    int widest = net0->no_of_hiddens;
+    float * layer_inputs, * layer_outputs, * swap;
+
+    if (batch_size <= 0)
+        return -1;
+
+    if (net0->no_of_outputs > widest)
+        widest = net0->no_of_outputs;
+
+    FLOATALLOC(layer_inputs, batch_size*members*widest);
+    if (!layer_inputs)
+        return -2;
+
+    FLOATALLOC(layer_outputs, batch_size*members*widest);
+    if (!layer_outputs) {
+        free(layer_inputs);
+        return -3;
+    }
+
+    if (ensemble->packed == 0)
+        deeplearn_ensemble_pack(ensemble);
+
+    if (ensemble->packed == 0) {
+        /* members do not share a topology */
+        deeplearn_ensemble_feed_forward_members(ensemble, batch_size,
+                                                inputs, layer_outputs);
+    }
+    else {
+        int softmax = (net0->output_activation == BP_OUTPUT_SOFTMAX);
+
+        COUNTUP(l, net0->hidden_layers+1) {
+            int units;
+            int no_of_weights = deeplearn_ensemble_layer_inputs(net0, l);
+
+            deeplearn_ensemble_layer_units(net0, l, &units);
+
+            deeplearn_ensemble_layer(batch_size, members, units,
+                                     no_of_weights, (l == 0),
+                                     (softmax && (l == net0->hidden_layers)),
+                                     ensemble->layer_weights[l],
+                                     ensemble->layer_bias[l],
+                                     (l == 0 ? inputs : layer_inputs),
+                                     layer_outputs);
+
+            /* outputs of this layer become inputs to the next */
+            swap = layer_inputs;
+            layer_inputs = layer_outputs;
+            layer_outputs = swap;
+        }
+
+        swap = layer_inputs;
+        layer_inputs = layer_outputs;
+        layer_outputs = swap;
+
+        /* softmax over the outputs of each member */
+        if (softmax) {
+            COUNTDOWN(r, batch_size*members)
+                bp_softmax(&layer_outputs[r*net0->no_of_outputs],
+                           net0->no_of_outputs);
+        }
+    }
+
+    deeplearn_ensemble_combine(ensemble, batch_size, layer_outputs, outputs);
+
+    free(layer_inputs);
+    free(layer_outputs);
+    return 0;
+}
+
+/**
+ * @brief Sets the value of an input to the ensemble
+ * @param ensemble Ensemble object
+ * @param index Index number of the input unit
+ * @param value Value to set the input unit to in the range 0.0 to 1.0
+ */
+void deeplearn_ensemble_set_input(deeplearn_ensemble * ensemble,
+                                  int index, float value)
+{
+    ensemble->inputs[index] = value;
+}
+
+/**
+ * @brief Sets the ensemble inputs from the given data sample,
+ *        normalising them in the same way as deeplearn_set_inputs
+ * @param ensemble Ensemble object
+ * @param sample The data sample
+ */
+void deeplearn_ensemble_set_inputs(deeplearn_ensemble * ensemble,
+                                   deeplearndata * sample)
+{
+    deeplearn * learner = ensemble->member[0];
+
+    COUNTDOWN(i, learner->net->no_of_inputs)
+        bp_set_input(learner->net, i, ensemble->inputs[i]);
+
+    deeplearn_set_inputs(learner, sample);
+
+    COUNTDOWN(i, learner->net->no_of_inputs)
+        ensemble->inputs[i] = bp_get_input(learner->net, i);
+}
+
+/**
+ * @brief Feeds the current inputs through every member of the ensemble
+ * @param ensemble Ensemble object
+ * @returns zero on success
+ */
+int deeplearn_ensemble_feed_forward(deeplearn_ensemble * ensemble)
+{
+    return deeplearn_ensemble_feed_forward_batch(ensemble, 1,
+                                                 ensemble->inputs,
+                                                 ensemble->outputs);
+}
+
+/**
+ * @brief Returns a combined output value
+ * @param ensemble Ensemble object
+ * @param index Index number of the output unit
+ * @returns Output value in the range NEURON_LOW to NEURON_HIGH
+ */
+float deeplearn_ensemble_get_output(deeplearn_ensemble * ensemble, int index)
+{
+    return ensemble->outputs[index];
+}
+
+/**
+ * @brief Returns the output class of the ensemble
+ * @param ensemble Ensemble object
+ * @returns output class
+ */
+int deeplearn_ensemble_get_class(deeplearn_ensemble * ensemble)
+{
+    int class = -9999;
+    float max = -1;
+
+    COUNTDOWN(i, ensemble->source->net->no_of_outputs) {
+        if (ensemble->outputs[i] > max) {
+            max = ensemble->outputs[i];
+            class = i;
+        }
+    }
+    return class;
+}
+
+/**
+ * @brief Returns the performance of the ensemble on the test data set
+ *        of the source learner as a percentage value
+ * @param ensemble Ensemble object
+ * @return Test performance in the range 0 to 100%
+ */
+float deeplearn_ensemble_get_performance(deeplearn_ensemble * ensemble)
+{
+    deeplearn * source = ensemble->source;
+    int no_of_inputs = source->net->no_of_inputs;
+    int no_of_outputs = source->net->no_of_outputs;
+    int samples = source->indexed_test_data_samples;
+    int hits = 0;
+    float error_percent, total_error = 0, average_error;
+    float * inputs, * outputs;
+
+    if (samples == 0)
+        return 0;
+
+    FLOATALLOC(inputs, samples*no_of_inputs);
+    if (!inputs)
+        return -1;
+
+    FLOATALLOC(outputs, samples*no_of_outputs);
+    if (!outputs) {
+        free(inputs);
+        return -1;
+    }
+
+    /* the whole test set is evaluated as a single batch */
+    COUNTUP(s, samples) {
+        deeplearn_ensemble_set_inputs(ensemble,
+                                      deeplearndata_get_test(source, s));
+        memcpy((void*)&inputs[s*no_of_inputs], ensemble->inputs,
+               no_of_inputs*sizeof(float));
+    }
+
+    if (deeplearn_ensemble_feed_forward_batch(ensemble, samples,
+                                              inputs, outputs) != 0) {
+        free(inputs);
+        free(outputs);
+        return -1;
+    }
+
+    COUNTUP(s, samples) {
+        deeplearndata * sample = deeplearndata_get_test(source, s);
+        COUNTUP(i, no_of_outputs) {
+            float range =
+                source->output_range_max[i] - source->output_range_min[i];
+            float value = outputs[s*no_of_outputs + i];
+            if (range > 0)
+                value = (((value - NEURON_LOW)/NEURON_RANGE)*range) +
+                    source->output_range_min[i];
+
+            if (sample->outputs[i] != 0) {
+                error_percent =
+                    (sample->outputs[i] - value) / sample->outputs[i];
+                total_error += error_percent*error_percent;
+                hits++;
+            }
+        }
+    }
+
+    free(inputs);
+    free(outputs);
+
+    if (hits > 0) {
+        average_error = (float)sqrt(total_error / hits) * 100;
+        if (average_error > 100) average_error = 100;
+        return 100 - average_error;
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_ENSEMBLE_H
+#define DEEPLEARN_ENSEMBLE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "globals.h"
+#include "deeplearn.h"
+#include "deeplearndata.h"
+
+/* ways in which the outputs of ensemble members can be combined */
+enum {
+    ENSEMBLE_AVERAGE = 0,
+    ENSEMBLE_VOTE
+};
+
+typedef struct {
+    int no_of_members;
+    deeplearn ** member;
+
+    /* learner which owns the shared data set */
+    deeplearn * source;
+
+    /* how member outputs are combined */
+    int combine;
+
+    /* bootstrap views of the source training sets.
+       These are indexes, so no sample data is copied */
+    int bootstrap_samples;
+    int ** bootstrap;
+    int bootstrap_labeled_samples;
+    int ** bootstrap_labeled;
+
+    /* stacked weights and biases of all members for each layer,
+       used for fused inference. Index hidden_layers is the output layer */
+    int packed;
+    float ** layer_weights;
+    float ** layer_bias;
+
+    /* network input values and combined outputs */
+    float * inputs;
+    float * outputs;
+
+    /* result of the most recent training step of each member */
+    int * status;
+} deeplearn_ensemble;
+
+int deeplearn_ensemble_init(deeplearn_ensemble * ensemble,
+                            int no_of_members,
+                            deeplearn * source,
+                            int no_of_hiddens,
+                            int hidden_layers,
+                            float error_threshold[],
+                            unsigned int * random_seed);
+void deeplearn_ensemble_free(deeplearn_ensemble * ensemble);
+int deeplearn_ensemble_training(deeplearn_ensemble * ensemble);
+int deeplearn_ensemble_pack(deeplearn_ensemble * ensemble);
+void deeplearn_ensemble_set_combine(deeplearn_ensemble * ensemble,
+                                    int combine);
+void deeplearn_ensemble_set_input(deeplearn_ensemble * ensemble,
+                                  int index, float value);
+void deeplearn_ensemble_set_inputs(deeplearn_ensemble * ensemble,
+                                   deeplearndata * sample);
+int deeplearn_ensemble_feed_forward_batch(deeplearn_ensemble * ensemble,
+                                          int batch_size,
+                                          float inputs[],
+                                          float outputs[]);
+int deeplearn_ensemble_feed_forward(deeplearn_ensemble * ensemble);
+float deeplearn_ensemble_get_output(deeplearn_ensemble * ensemble,
+                                    int index);
+int deeplearn_ensemble_get_class(deeplearn_ensemble * ensemble);
+float deeplearn_ensemble_get_performance(deeplearn_ensemble * ensemble);
+
+#endif
@@ -0,0 +1,482 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_executor.h"
+#include "deeplearn_perf.h"
+
+/* number of chunks which each thread's share of a loop is divided into,
+   so that idle threads have something to steal */
+#define DEEPLEARN_POOL_CHUNKS 8
+
+static void deeplearn_openmp_parallel_for(void * data, int n,
+                                          deeplearn_loop loop,
+                                          void * context);
+
+/* the executor used by all parallel loops */
+static deeplearn_executor executor_current = {
+    deeplearn_openmp_parallel_for, NULL
+};
+
+/**
+ * @brief Runs a loop on the OpenMP thread pool, with each thread
+ *        being given an equal share of the iterations
+ * @param data Not used
+ * @param n The number of iterations
+ * @param loop Body of the loop
+ * @param context Passed to the body of the loop
+ */
+static void deeplearn_openmp_parallel_for(void * data, int n,
+                                          deeplearn_loop loop,
+                                          void * context)
+{
+    int threads = DEEPLEARN_THREADS;
+
+    if (n < threads)
+        threads = n;
+
+#pragma omp parallel for schedule(static) num_threads(DEEPLEARN_THREADS)
+    COUNTDOWN(t, threads)
+        loop(n*t/threads, n*(t+1)/threads, context);
+}
+
+/**
+ * @brief Runs a loop on the calling thread
+ * @param data Not used
+ * @param n The number of iterations
+ * @param loop Body of the loop
+ * @param context Passed to the body of the loop
+ */
+static void deeplearn_serial_parallel_for(void * data, int n,
+                                          deeplearn_loop loop,
+                                          void * context)
+{
+    loop(0, n, context);
+}
+
+/**
+ * @brief Sets the executor which runs parallel loops within backprop,
+ *        autocoders and convolution. This should be called when no
+ *        training or prediction is in progress.
+ * @param executor Table of functions, or NULL to restore the default
+ *        OpenMP executor
+ * @returns zero on success
+ */
+int deeplearn_set_executor(deeplearn_executor * executor)
+{
+    if (executor == NULL) {
+        deeplearn_executor_openmp(&executor_current);
+        return 0;
+    }
+
+    if (executor->parallel_for == NULL)
+        return -1;
+
+    executor_current = *executor;
+    return 0;
+}
+
+/**
+ * @brief Returns the executor which is currently used for parallel loops
+ * @param executor Returned table of functions
+ */
+void deeplearn_get_executor(deeplearn_executor * executor)
+{
+    *executor = executor_current;
+}
+
+/**
+ * @brief Runs a loop using the current executor
+ * @param n The number of iterations
+ * @param loop Body of the loop, which is called for ranges of iterations
+ * @param context Passed to the body of the loop
+ */
+void deeplearn_parallel_for(int n, deeplearn_loop loop, void * context)
+{
+    if (n <= 0)
+        return;
+
+    if (n == 1) {
+        loop(0, 1, context);
+        return;
+    }
+
+    executor_current.parallel_for(executor_current.data, n, loop, context);
+}
+
+/* a loop divided into a fixed number of tasks */
+typedef struct {
+    int n, tasks;
+    deeplearn_loop loop;
+    void * context;
+} deeplearn_tasks_loop;
+
+/**
+ * @brief Runs the iterations belonging to a range of tasks
+ * @param start The first task
+ * @param end The task after the last one
+ * @param context deeplearn_tasks_loop object
+ */
+static void deeplearn_parallel_for_tasks_range(int start, int end,
+                                               void * context)
+{
+    deeplearn_tasks_loop * args = (deeplearn_tasks_loop*)context;
+
+    for (int t = start; t < end; t++) {
+        int first = (int)((long)args->n * t / args->tasks);
+        int last = (int)((long)args->n * (t + 1) / args->tasks);
+
+        if (last > first)
+            args->loop(first, last, args->context);
+    }
+}
+
+/**
+ * @brief Runs a loop divided into a given number of tasks of roughly
+ *        equal size. Fewer tasks mean less scheduling overhead and
+ *        larger blocks of memory per thread, more tasks give a better
+ *        balance between threads.
+ * @param n Number of iterations
+ * @param tasks The number of tasks. One runs the loop on the calling
+ *        thread and zero or less leaves the division to the executor
+ * @param loop Body of the loop
+ * @param context Data passed to the loop body
+ */
+void deeplearn_parallel_for_tasks(int n, int tasks,
+                                  deeplearn_loop loop, void * context)
+{
+    deeplearn_tasks_loop args;
+
+    if (tasks <= 0) {
+        deeplearn_parallel_for(n, loop, context);
+        return;
+    }
+
+    if (n <= 0)
+        return;
+
+    if ((tasks == 1) || (n == 1)) {
+        loop(0, n, context);
+        return;
+    }
+
+    if (tasks > n)
+        tasks = n;
+
+    args.n = n;
+    args.tasks = tasks;
+    args.loop = loop;
+    args.context = context;
+    deeplearn_parallel_for(tasks, deeplearn_parallel_for_tasks_range, &args);
+}
+
+/**
+ * @brief Returns an executor which uses OpenMP. This is the default.
+ * @param executor Returned table of functions
+ */
+void deeplearn_executor_openmp(deeplearn_executor * executor)
+{
+    executor->parallel_for = deeplearn_openmp_parallel_for;
+    executor->data = NULL;
+}
+
+/**
+ * @brief Returns an executor which runs loops on the calling thread,
+ *        for applications which do their own scheduling
+ * @param executor Returned table of functions
+ */
+void deeplearn_executor_serial(deeplearn_executor * executor)
+{
+    executor->parallel_for = deeplearn_serial_parallel_for;
+    executor->data = NULL;
+}
+
+/**
+ * @brief Takes the next chunk of iterations from the range of a thread
+ * @param pool Thread pool object
+ * @param index Index of the thread
+ * @param start Returned first iteration
+ * @param end Returned end of the iterations
+ * @returns non-zero if there were iterations remaining
+ */
+static int deeplearn_pool_take(deeplearn_pool * pool, int index,
+                               int * start, int * end)
+{
+    deeplearn_pool_range * range = &pool->range[index];
+    int found = 0;
+
+    pthread_mutex_lock(&range->lock);
+    if (range->start < range->end) {
+        *start = range->start;
+        *end = range->start + pool->grain;
+        if (*end > range->end)
+            *end = range->end;
+        range->start = *end;
+        found = 1;
+    }
+    pthread_mutex_unlock(&range->lock);
+    return found;
+}
+
+/**
+ * @brief Steals the upper half of the remaining iterations of another
+ *        thread, and gives them to the given thread
+ * @param pool Thread pool object
+ * @param index Index of the thread which has run out of iterations
+ * @returns non-zero if any iterations were stolen
+ */
+static int deeplearn_pool_steal(deeplearn_pool * pool, int index)
+{
+    FOR(i, 1, pool->no_of_threads) {
+        deeplearn_pool_range * victim =
+            &pool->range[(index + i) % pool->no_of_threads];
+        int start = 0, end = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->start < victim->end) {
+            start = victim->start + (victim->end - victim->start)/2;
+            end = victim->end;
+            victim->end = start;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (start < end) {
+            pthread_mutex_lock(&pool->range[index].lock);
+            pool->range[index].start = start;
+            pool->range[index].end = end;
+            pthread_mutex_unlock(&pool->range[index].lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs iterations of the current loop until none remain
+ * @param pool Thread pool object
+ * @param index Index of the thread
+ */
+static void deeplearn_pool_work(deeplearn_pool * pool, int index)
+{
+    int start, end;
+
+    do {
+        while (deeplearn_pool_take(pool, index, &start, &end) != 0)
+            pool->loop(start, end, pool->context);
+    } while (deeplearn_pool_steal(pool, index) != 0);
+}
+
+/**
+ * @brief Worker thread of a pool, which sleeps until there is a loop to run
+ * @param arg Thread pool object
+ */
+static void * deeplearn_pool_worker(void * arg)
+{
+    deeplearn_pool * pool = (deeplearn_pool*)arg;
+    unsigned long generation = 0;
+    int index;
+
+    pthread_mutex_lock(&pool->lock);
+    /* threads are numbered from one, since the calling thread is zero */
+    index = ++pool->started;
+    pthread_cond_signal(&pool->done);
+
+    while (1) {
+        while ((pool->shutdown == 0) && (pool->generation == generation))
+            pthread_cond_wait(&pool->work, &pool->lock);
+
+        if (pool->shutdown != 0)
+            break;
+
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        deeplearn_perf_register_thread();
+        deeplearn_pool_work(pool, index);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->active--;
+        if (pool->active == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * @brief Runs a loop on a thread pool. Each thread starts with an equal
+ *        share of the iterations, and threads which finish early steal
+ *        from the others.
+ * @param data Thread pool object
+ * @param n The number of iterations
+ * @param loop Body of the loop
+ * @param context Passed to the body of the loop
+ */
+static void deeplearn_pool_parallel_for(void * data, int n,
+                                        deeplearn_loop loop,
+                                        void * context)
+{
+    deeplearn_pool * pool = (deeplearn_pool*)data;
+    int threads = pool->no_of_threads;
+
+    /* the pool is already running a loop */
+    if ((threads < 2) || (pthread_mutex_trylock(&pool->running) != 0)) {
+        loop(0, n, context);
+        return;
+    }
+
+    pool->loop = loop;
+    pool->context = context;
+    pool->grain = n / (threads*DEEPLEARN_POOL_CHUNKS);
+    if (pool->grain < 1)
+        pool->grain = 1;
+
+    COUNTDOWN(t, threads) {
+        pool->range[t].start = (int)((long)n*t/threads);
+        pool->range[t].end = (int)((long)n*(t+1)/threads);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->active = threads-1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    deeplearn_perf_register_thread();
+    deeplearn_pool_work(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_mutex_unlock(&pool->running);
+}
+
+/**
+ * @brief Creates a work stealing thread pool which can be used to run
+ *        parallel loops instead of OpenMP
+ * @param pool Thread pool object
+ * @param no_of_threads The number of threads, including the thread which
+ *        calls each loop
+ * @returns zero on success
+ */
+int deeplearn_pool_init(deeplearn_pool * pool, int no_of_threads)
+{
+    if (no_of_threads < 1)
+        return -1;
+
+    pool->no_of_threads = no_of_threads;
+    pool->loop = NULL;
+    pool->context = NULL;
+    pool->grain = 1;
+    pool->generation = 0;
+    pool->shutdown = 0;
+
+    pool->range = (deeplearn_pool_range*)
+        malloc(no_of_threads*sizeof(deeplearn_pool_range));
+    if (!pool->range)
+        return -2;
+
+    pool->worker = (pthread_t*)malloc(no_of_threads*sizeof(pthread_t));
+    if (!pool->worker) {
+        free(pool->range);
+        return -3;
+    }
+
+    COUNTDOWN(t, no_of_threads) {
+        pthread_mutex_init(&pool->range[t].lock, NULL);
+        pool->range[t].start = 0;
+        pool->range[t].end = 0;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_mutex_init(&pool->running, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    pool->active = 0;
+    pool->started = 0;
+    FOR(t, 1, no_of_threads) {
+        if (pthread_create(&pool->worker[t], NULL,
+                           deeplearn_pool_worker, (void*)pool) != 0) {
+            /* only stop the workers which were created */
+            pool->no_of_threads = t;
+            deeplearn_pool_free(pool);
+            return -4;
+        }
+    }
+
+    /* wait for the workers to take their indexes */
+    pthread_mutex_lock(&pool->lock);
+    while (pool->started < no_of_threads-1)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    return 0;
+}
+
+/**
+ * @brief Stops the threads of a pool and deallocates its memory.
+ *        If the pool is the current executor then another executor
+ *        should be set first.
+ * @param pool Thread pool object
+ */
+void deeplearn_pool_free(deeplearn_pool * pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    FOR(t, 1, pool->no_of_threads)
+        pthread_join(pool->worker[t], NULL);
+
+    COUNTDOWN(t, pool->no_of_threads)
+        pthread_mutex_destroy(&pool->range[t].lock);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->running);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+
+    free(pool->range);
+    free(pool->worker);
+}
+
+/**
+ * @brief Returns an executor which runs loops on a thread pool
+ * @param pool Thread pool object
+ * @param executor Returned table of functions
+ */
+void deeplearn_pool_executor(deeplearn_pool * pool,
+                             deeplearn_executor * executor)
+{
+    executor->parallel_for = deeplearn_pool_parallel_for;
+    executor->data = (void*)pool;
+}
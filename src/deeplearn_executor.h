@@ -0,0 +1,104 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_EXECUTOR_H
+#define DEEPLEARN_EXECUTOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <omp.h>
+#include "globals.h"
+
+/* Body of a parallel loop, which is called for the iterations from
+   start up to but not including end */
+typedef void (*deeplearn_loop)(int start, int end, void * context);
+
+/* Runs the given loop over n iterations, returning once all of them
+   have been completed */
+typedef void (*deeplearn_parallel_for_function)(void * data, int n,
+                                                deeplearn_loop loop,
+                                                void * context);
+
+typedef struct {
+    deeplearn_parallel_for_function parallel_for;
+    void * data;
+} deeplearn_executor;
+
+/* iterations remaining for one thread of a pool, which other threads
+   may steal from once they run out of their own */
+typedef struct {
+    pthread_mutex_t lock;
+    int start, end;
+} deeplearn_pool_range;
+
+typedef struct {
+    /* the number of threads including the one which calls the loop */
+    int no_of_threads;
+    pthread_t * worker;
+    deeplearn_pool_range * range;
+
+    /* the loop which is currently running */
+    deeplearn_loop loop;
+    void * context;
+    int grain;
+
+    /* incremented for each loop so that sleeping workers know
+       that there is work to do */
+    unsigned long generation;
+
+    /* workers which have not yet finished the current loop */
+    int active;
+
+    /* workers which have started, used to number them */
+    int started;
+    int shutdown;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+
+    /* held while a loop is running. Loops which are called from within
+       a loop, or from other threads at the same time, run serially */
+    pthread_mutex_t running;
+} deeplearn_pool;
+
+int deeplearn_set_executor(deeplearn_executor * executor);
+void deeplearn_get_executor(deeplearn_executor * executor);
+void deeplearn_parallel_for(int n, deeplearn_loop loop, void * context);
+void deeplearn_parallel_for_tasks(int n, int tasks,
+                                  deeplearn_loop loop, void * context);
+void deeplearn_executor_openmp(deeplearn_executor * executor);
+void deeplearn_executor_serial(deeplearn_executor * executor);
+int deeplearn_pool_init(deeplearn_pool * pool, int no_of_threads);
+void deeplearn_pool_free(deeplearn_pool * pool);
+void deeplearn_pool_executor(deeplearn_pool * pool,
+                             deeplearn_executor * executor);
+
+#endif
@@ -94,6 +94,86 @@ int draw_features(unsigned char img[],
     return 0;
 }
 
+/* arguments of the loop which scores features against an image patch */
+typedef struct {
+    float * img;
+    int img_width, img_depth;
+    int feature_width;
+    float * feature;
+    float * feature_score;
+
+    /* top left corner of the image patch */
+    int tx, ty;
+} features_loop;
+
+/**
+ * @brief Body of the loop which calculates the matching scores of
+ *        features against an image patch
+ * @param start Index of the first feature
+ * @param end Index after the last feature
+ * @param context Image patch and features
+ */
+static void learn_features_score_units(int start, int end, void * context)
+{
+    features_loop * args = (features_loop*)context;
+    float * img = args->img;
+    int img_width = args->img_width;
+    int img_depth = args->img_depth;
+    int feature_width = args->feature_width;
+    float * feature_score = args->feature_score;
+    int tx = args->tx;
+    int ty = args->ty;
+
+    for (int f = end-1; f >= start; f--) {
+        float * curr_feature =
+            &args->feature[f*feature_width*feature_width*img_depth];
+
+        /* calculate the matching score for this feature */
+        feature_score[f] = 0;
+        COUNTDOWN(yy, feature_width) {
+            int n0 = (((ty + yy)*img_width) + tx) * img_depth;
+            int n1 = (yy * feature_width) * img_depth;
+            COUNTDOWN(xx, feature_width) {
+                COUNTDOWN(d, img_depth)
+                    feature_score[f] +=
+                        (img[n0+d] - curr_feature[n1+d])*
+                        (img[n0+d] - curr_feature[n1+d]);
+                n0 += img_depth;
+                n1 += img_depth;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Calculates the matching scores for each feature against an
+ *        image patch
+ * @param args Image patch and features
+ * @param no_of_features The number of features
+ * @param tasks Number of tasks to divide the features into, or zero
+ *        to score them on the calling thread
+ * @returns Sum of the root mean square differences
+ */
+static float learn_features_score(features_loop * args,
+                                  int no_of_features, int tasks)
+{
+    float total_match_score = 0;
+    float pixels = (float)(args->feature_width*args->feature_width*
+                           args->img_depth);
+
+    if (tasks <= 0)
+        learn_features_score_units(0, no_of_features, args);
+    else
+        deeplearn_parallel_for_tasks(no_of_features, tasks,
+                                     learn_features_score_units, args);
+
+    COUNTDOWN(f, no_of_features)
+        total_match_score +=
+            (float)sqrt(args->feature_score[f]/pixels);
+
+    return total_match_score;
+}
+
 /**
  * @brief Learns a set of features from a given mono input layer
  *        If the initial layer is an image it should be converted to floats
@@ -109,6 +189,8 @@ int draw_features(unsigned char img[],
  * @param samples The number of samples to take from the image
  * @param learning_rate Learning rate in the range 0.0 -> 1.0
  * @param random_seed Random number generator seed
+ * @param tasks Number of tasks which feature scoring is divided into,
+ *        or zero to score on the calling thread
  * @returns Total matching score
  */
 static float learn_features_mono(float img[],
@@ -118,7 +200,8 @@ static float learn_features_mono(float img[],
                                  float feature_score[],
                                  int samples,
                                  float learning_rate,
-                                 unsigned int * random_seed)
+                                 unsigned int * random_seed,
+                                 int tasks)
 {
     int width = img_width-1-feature_width;
     int height = img_height-1-feature_width;
@@ -133,28 +216,18 @@ static float learn_features_mono(float img[],
         int ty = rand_num(random_seed) % height;
 
         /* calculate matching scores for each feature for this image patch */
-        COUNTDOWN(f, no_of_features) {
-            float * curr_feature =
-                &feature[f*feature_width*feature_width];
-
-            /* calculate the matching score for this feature */
-            feature_score[f] = 0;
-            COUNTDOWN(yy, feature_width) {
-                int n0 = ((ty + yy)*img_width) + tx;
-                int n1 = yy * feature_width;
-                COUNTDOWN(xx, feature_width) {
-                    feature_score[f] +=
-                        (img[n0] - curr_feature[n1])*
-                        (img[n0] - curr_feature[n1]);
-                    n0++;
-                    n1++;
-                }
-            }
-
-            total_match_score +=
-                (float)sqrt(feature_score[f]/
-                            (float)(feature_width*feature_width));
-        }
+        features_loop args = {
+            .img = img,
+            .img_width = img_width,
+            .img_depth = 1,
+            .feature_width = feature_width,
+            .feature = feature,
+            .feature_score = feature_score,
+            .tx = tx,
+            .ty = ty
+        };
+        total_match_score +=
+            learn_features_score(&args, no_of_features, tasks);
 
         /* get the N closest feature indexes based upon match scores */
         int index[closest_matches];
@@ -283,11 +356,33 @@ float learn_features(float img[],
        calculations which can be avoided by using a more
        specialised version of this function */
 
-    if (img_depth == 1)
-        return learn_features_mono(img, img_width, img_height,
-                                   feature_width, no_of_features,
-                                   feature, feature_score, samples,
-                                   learning_rate, random_seed);
+    /* matching against each feature followed by an update
+       of the closest matches */
+    uint64_t flops = (uint64_t)samples*no_of_features*
+        feature_width*feature_width*img_depth*3;
+    deeplearn_tune_trial trial;
+    int shape[DEEPLEARN_TUNE_SHAPE] = {
+        img_width, img_height, img_depth,
+        feature_width, no_of_features, samples
+    };
+    int tasks;
+
+    deeplearn_trace_begin("learn_features");
+    deeplearn_perf_begin(DEEPLEARN_PERF_LEARN_FEATURES);
+    deeplearn_tune_begin(DEEPLEARN_TUNE_LEARN_FEATURES, shape, &trial);
+    tasks = trial.choice.tasks;
+
+    if (img_depth == 1) {
+        total_match_score =
+            learn_features_mono(img, img_width, img_height,
+                                feature_width, no_of_features,
+                                feature, feature_score, samples,
+                                learning_rate, random_seed, tasks);
+        deeplearn_tune_end(&trial);
+        deeplearn_perf_end(DEEPLEARN_PERF_LEARN_FEATURES, flops);
+        deeplearn_trace_end("learn_features");
+        return total_match_score;
+    }
 
     /* sample the image a number of times */
     COUNTDOWN(i, samples) {
@@ -297,29 +392,18 @@ float learn_features(float img[],
         int ty = rand_num(random_seed) % height;
 
         /* calculate matching scores for each feature for this image patch */
-        COUNTDOWN(f, no_of_features) {
-            float * curr_feature =
-                &feature[f*feature_width*feature_width*img_depth];
-
-            /* calculate the matching score for this feature */
-            feature_score[f] = 0;
-            COUNTDOWN(yy, feature_width) {
-                int n0 = (((ty + yy)*img_width) + tx) * img_depth;
-                int n1 = (yy * feature_width) * img_depth;
-                COUNTDOWN(xx, feature_width) {
-                    COUNTDOWN(d, img_depth)
-                        feature_score[f] +=
-                            (img[n0+d] - curr_feature[n1+d])*
-                            (img[n0+d] - curr_feature[n1+d]);
-                    n0 += img_depth;
-                    n1 += img_depth;
-                }
-            }
-
-            total_match_score +=
-                (float)sqrt(feature_score[f]/
-                            (float)(feature_width*feature_width*img_depth));
-        }
+        features_loop args = {
+            .img = img,
+            .img_width = img_width,
+            .img_depth = img_depth,
+            .feature_width = feature_width,
+            .feature = feature,
+            .feature_score = feature_score,
+            .tx = tx,
+            .ty = ty
+        };
+        total_match_score +=
+            learn_features_score(&args, no_of_features, tasks);
 
         /* get the N closest feature indexes based upon match scores */
         int index[closest_matches];
@@ -409,5 +493,8 @@ float learn_features(float img[],
         }
     }
 
+    deeplearn_tune_end(&trial);
+    deeplearn_perf_end(DEEPLEARN_PERF_LEARN_FEATURES, flops);
+    deeplearn_trace_end("learn_features");
     return total_match_score/(float)samples;
 }
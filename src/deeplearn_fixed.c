@@ -0,0 +1,419 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_fixed.h"
+
+/**
+ * @brief Returns the largest magnitude weight within a layer
+ * @param layer Array of neurons
+ * @param units The number of neurons within the layer
+ * @param no_of_inputs The number of inputs to each neuron
+ * @returns Largest absolute weight value
+ */
+static float deeplearn_fixed_max_weight(bp_neuron ** layer,
+                                        int units, int no_of_inputs)
+{
+    float max = 0;
+
+    COUNTDOWN(i, units) {
+        COUNTDOWN(j, no_of_inputs) {
+            if (fabs(layer[i]->weights[j]) > max)
+                max = (float)fabs(layer[i]->weights[j]);
+        }
+    }
+    return max;
+}
+
+/**
+ * @brief Returns the largest magnitude of a sum within an exported
+ *        program. Q7 programs accumulate in 32 bits, so that they are
+ *        fast on 8 bit microcontrollers, and Q15 programs in 64 bits.
+ * @param fixed Fixed point network
+ * @returns Largest sum
+ */
+static double deeplearn_fixed_max_sum(deeplearn_fixed * fixed)
+{
+    if (fixed->bits == DEEPLEARN_FIXED_Q7)
+        return (double)INT32_MAX;
+    return (double)INT64_MAX;
+}
+
+/**
+ * @brief Quantises the weights and biases of one layer
+ * @param fixed Fixed point network
+ * @param l Index of the layer
+ * @param layer Array of neurons
+ * @returns zero on success, or -3 if the sums of the layer could
+ *          overflow the accumulator
+ */
+static int deeplearn_fixed_layer(deeplearn_fixed * fixed, int l,
+                                 bp_neuron ** layer)
+{
+    int units = fixed->units[l];
+    int no_of_inputs = fixed->no_of_inputs[l];
+    int max_weight = (1 << (fixed->bits-1)) - 1;
+    float max = deeplearn_fixed_max_weight(layer, units, no_of_inputs);
+    int shift = 0;
+
+    /* the largest shift which keeps every weight within range */
+    if (max > 0)
+        shift = (int)floor(log2(max_weight / max));
+
+    fixed->weight_shift[l] = shift;
+    fixed->lut_shift[l] = shift + fixed->activation_bits -
+        (int)log2(DEEPLEARN_FIXED_LUT_STEPS) - DEEPLEARN_FIXED_LUT_FRACTION;
+
+    /* the largest sum, including its conversion into a table position,
+       must fit within the accumulator of an exported program */
+    COUNTDOWN(i, units) {
+        double sum =
+            fabs(ldexp(layer[i]->bias, shift + fixed->activation_bits)) +
+            ldexp((double)no_of_inputs*max_weight, fixed->activation_bits);
+        if (fixed->lut_shift[l] < 0)
+            sum = ldexp(sum, -fixed->lut_shift[l]);
+        if (sum > deeplearn_fixed_max_sum(fixed))
+            return -3;
+    }
+
+    fixed->weights[l] =
+        (int32_t*)malloc(units*no_of_inputs*sizeof(int32_t));
+    if (!fixed->weights[l])
+        return -1;
+
+    fixed->bias[l] = (int64_t*)malloc(units*sizeof(int64_t));
+    if (!fixed->bias[l])
+        return -2;
+
+    COUNTDOWN(i, units) {
+        COUNTDOWN(j, no_of_inputs) {
+            int32_t w =
+                (int32_t)lround(ldexp(layer[i]->weights[j], shift));
+            if (w > max_weight) w = max_weight;
+            if (w < -max_weight) w = -max_weight;
+            fixed->weights[l][i*no_of_inputs + j] = w;
+        }
+        fixed->bias[l][i] =
+            (int64_t)llround(ldexp(layer[i]->bias,
+                                   shift + fixed->activation_bits));
+    }
+    return 0;
+}
+
+/**
+ * @brief Creates a fixed point version of a trained network, for use
+ *        on processors without floating point hardware
+ * @param fixed Fixed point network
+ * @param net Backprop neural net object
+ * @param bits DEEPLEARN_FIXED_Q7 or DEEPLEARN_FIXED_Q15
+ * @returns zero on success, -3 or -4 if the sums of a hidden or the
+ *          output layer could overflow the accumulator at this precision
+ */
+int deeplearn_fixed_init(deeplearn_fixed * fixed, bp * net, int bits)
+{
+    int retval;
+
+    if ((bits != DEEPLEARN_FIXED_Q7) && (bits != DEEPLEARN_FIXED_Q15))
+        return -1;
+
+    fixed->bits = bits;
+    fixed->activation_bits = bits - 1;
+    fixed->no_of_layers = net->hidden_layers + 1;
+    fixed->softmax = (net->output_activation == BP_OUTPUT_SOFTMAX);
+    fixed->prev = 0;
+    fixed->curr = 0;
+
+    INTALLOC(fixed->units, fixed->no_of_layers);
+    INTALLOC(fixed->no_of_inputs, fixed->no_of_layers);
+    INTALLOC(fixed->weight_shift, fixed->no_of_layers);
+    INTALLOC(fixed->lut_shift, fixed->no_of_layers);
+    fixed->weights =
+        (int32_t**)calloc(fixed->no_of_layers, sizeof(int32_t*));
+    fixed->bias =
+        (int64_t**)calloc(fixed->no_of_layers, sizeof(int64_t*));
+    if ((!fixed->units) || (!fixed->no_of_inputs) ||
+        (!fixed->weight_shift) || (!fixed->lut_shift) ||
+        (!fixed->weights) || (!fixed->bias)) {
+        deeplearn_fixed_free(fixed);
+        return -2;
+    }
+
+    COUNTUP(l, net->hidden_layers) {
+        fixed->units[l] = HIDDENS_IN_LAYER(net, l);
+        if (l == 0)
+            fixed->no_of_inputs[l] = net->no_of_inputs;
+        else
+            fixed->no_of_inputs[l] = HIDDENS_IN_LAYER(net, l-1);
+
+        retval = deeplearn_fixed_layer(fixed, l, net->hiddens[l]);
+        if (retval != 0) {
+            deeplearn_fixed_free(fixed);
+            return -3;
+        }
+    }
+
+    fixed->units[net->hidden_layers] = net->no_of_outputs;
+    fixed->no_of_inputs[net->hidden_layers] =
+        HIDDENS_IN_LAYER(net, net->hidden_layers-1);
+    retval = deeplearn_fixed_layer(fixed, net->hidden_layers, net->outputs);
+    if (retval != 0) {
+        deeplearn_fixed_free(fixed);
+        return -4;
+    }
+
+    fixed->prev =
+        (int32_t*)malloc(deeplearn_fixed_widest(fixed)*sizeof(int32_t));
+    fixed->curr =
+        (int32_t*)malloc(deeplearn_fixed_widest(fixed)*sizeof(int32_t));
+    if ((!fixed->prev) || (!fixed->curr)) {
+        deeplearn_fixed_free(fixed);
+        return -5;
+    }
+
+    /* activation function sampled at regular intervals */
+    COUNTUP(i, DEEPLEARN_FIXED_LUT_SIZE) {
+        float x = (i - (DEEPLEARN_FIXED_LUT_SIZE/2)) /
+            (float)DEEPLEARN_FIXED_LUT_STEPS;
+        fixed->lut[i] =
+            (int32_t)lround(ldexp(AF(x), fixed->activation_bits));
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Deallocates memory for a fixed point network
+ * @param fixed Fixed point network
+ */
+void deeplearn_fixed_free(deeplearn_fixed * fixed)
+{
+    if (fixed->weights) {
+        COUNTDOWN(l, fixed->no_of_layers)
+            free(fixed->weights[l]);
+        free(fixed->weights);
+    }
+
+    if (fixed->bias) {
+        COUNTDOWN(l, fixed->no_of_layers)
+            free(fixed->bias[l]);
+        free(fixed->bias);
+    }
+
+    free(fixed->units);
+    free(fixed->no_of_inputs);
+    free(fixed->weight_shift);
+    free(fixed->lut_shift);
+    free(fixed->prev);
+    free(fixed->curr);
+    fixed->weights = 0;
+    fixed->bias = 0;
+    fixed->units = 0;
+    fixed->no_of_inputs = 0;
+    fixed->weight_shift = 0;
+    fixed->lut_shift = 0;
+    fixed->prev = 0;
+    fixed->curr = 0;
+}
+
+/**
+ * @brief Converts a normalised input value into a fixed point activation
+ * @param fixed Fixed point network
+ * @param value Input value in the range 0.0 to 1.0
+ * @returns Fixed point activation
+ */
+int32_t deeplearn_fixed_input(deeplearn_fixed * fixed, float value)
+{
+    int32_t max = 1 << fixed->activation_bits;
+    int32_t v = (int32_t)lround(ldexp(value, fixed->activation_bits));
+
+    if (v < 0) return 0;
+    if (v > max) return max;
+    return v;
+}
+
+/**
+ * @brief Returns the activation for the sum of a unit, by interpolating
+ *        within the lookup table. This is the same integer arithmetic
+ *        as within exported programs.
+ * @param fixed Fixed point network
+ * @param sum Weighted sum of the unit plus its bias
+ * @param layer Index of the layer
+ * @returns Fixed point activation
+ */
+int32_t deeplearn_fixed_activation(deeplearn_fixed * fixed,
+                                   int64_t sum, int layer)
+{
+    int64_t t, index;
+    int shift = fixed->lut_shift[layer];
+
+    if (shift >= 0)
+        t = sum >> shift;
+    else
+        t = sum * ((int64_t)1 << -shift);
+
+    index = (t >> DEEPLEARN_FIXED_LUT_FRACTION) +
+        (DEEPLEARN_FIXED_LUT_SIZE/2);
+    if (index < 0)
+        return fixed->lut[0];
+    if (index >= DEEPLEARN_FIXED_LUT_SIZE-1)
+        return fixed->lut[DEEPLEARN_FIXED_LUT_SIZE-1];
+
+    return fixed->lut[index] +
+        (int32_t)(((fixed->lut[index+1] - fixed->lut[index]) *
+                   (int32_t)(t & ((1 << DEEPLEARN_FIXED_LUT_FRACTION)-1))) >>
+                  DEEPLEARN_FIXED_LUT_FRACTION);
+}
+
+/**
+ * @brief Returns the number of values within the widest of the inputs
+ *        and the layers. Hidden layers taper towards the number of
+ *        outputs, so later layers can be wider than the first
+ * @param fixed Fixed point network
+ * @returns number of values
+ */
+int deeplearn_fixed_widest(deeplearn_fixed * fixed)
+{
+    int widest = fixed->no_of_inputs[0];
+
+    COUNTDOWN(l, fixed->no_of_layers) {
+        if (fixed->units[l] > widest)
+            widest = fixed->units[l];
+    }
+    return widest;
+}
+
+/**
+ * @brief Feeds inputs forward through the fixed point network.
+ *        Activations are kept within the buffers of the network, so
+ *        each network should only be used by one thread at a time.
+ * @param fixed Fixed point network
+ * @param inputs Normalised input values, as within the input units
+ * @param outputs Returned output values within the same range as
+ *        the output units
+ */
+void deeplearn_fixed_feed_forward(deeplearn_fixed * fixed,
+                                  float inputs[], float outputs[])
+{
+    int last = fixed->no_of_layers-1;
+    int32_t * prev = fixed->prev;
+    int32_t * curr = fixed->curr;
+
+    COUNTDOWN(i, fixed->no_of_inputs[0])
+        prev[i] = deeplearn_fixed_input(fixed, inputs[i]);
+
+    COUNTUP(l, fixed->no_of_layers) {
+        int no_of_inputs = fixed->no_of_inputs[l];
+
+        COUNTDOWN(i, fixed->units[l]) {
+            int32_t * w = &fixed->weights[l][i*no_of_inputs];
+            int64_t sum = fixed->bias[l][i];
+
+            COUNTUP(j, no_of_inputs)
+                sum += (int64_t)w[j] * prev[j];
+
+            if (l < last)
+                curr[i] = deeplearn_fixed_activation(fixed, sum, l);
+            else if (fixed->softmax)
+                outputs[i] = (float)ldexp((double)sum,
+                                          -(fixed->weight_shift[l] +
+                                            fixed->activation_bits));
+            else
+                outputs[i] = (float)ldexp(deeplearn_fixed_activation(fixed,
+                                                                    sum, l),
+                                          -fixed->activation_bits);
+        }
+
+        if (l < last) {
+            COUNTDOWN(i, fixed->units[l])
+                prev[i] = curr[i];
+        }
+    }
+
+    if (fixed->softmax)
+        bp_softmax(outputs, fixed->units[last]);
+}
+
+/**
+ * @brief Returns the performance of the fixed point network on the test
+ *        data set of a learner, calculated in the same way as
+ *        deeplearndata_get_performance
+ * @param fixed Fixed point network
+ * @param learner Deep learner object which owns the test data
+ * @return Test performance in the range 0 to 100%
+ */
+float deeplearn_fixed_get_performance(deeplearn_fixed * fixed,
+                                      deeplearn * learner)
+{
+    float hits = 0;
+    float error_percent, total_error = 0, average_error;
+    float * inputs, * outputs;
+
+    FLOATALLOC(inputs, learner->net->no_of_inputs);
+    if (!inputs)
+        return -1;
+
+    FLOATALLOC(outputs, learner->net->no_of_outputs);
+    if (!outputs) {
+        free(inputs);
+        return -1;
+    }
+
+    COUNTUP(index, learner->test_data_samples) {
+        deeplearndata * sample = deeplearndata_get_test(learner, index);
+        deeplearn_set_inputs(learner, sample);
+        COUNTDOWN(i, learner->net->no_of_inputs)
+            inputs[i] = bp_get_input(learner->net, i);
+
+        deeplearn_fixed_feed_forward(fixed, inputs, outputs);
+
+        COUNTUP(i, learner->net->no_of_outputs) {
+            float range =
+                learner->output_range_max[i] - learner->output_range_min[i];
+            if (range > 0)
+                outputs[i] =
+                    (((outputs[i] - NEURON_LOW)/NEURON_RANGE)*range) +
+                    learner->output_range_min[i];
+
+            if (sample->outputs[i] != 0) {
+                error_percent =
+                    (sample->outputs[i] - outputs[i]) / sample->outputs[i];
+                total_error += error_percent*error_percent*sample->weight;
+                hits += sample->weight;
+            }
+        }
+    }
+    free(inputs);
+    free(outputs);
+
+    if (hits > 0) {
+        average_error = (float)sqrt(total_error / hits) * 100;
+        if (average_error > 100) average_error = 100;
+        return 100 - average_error;
+    }
+    return 0;
+}
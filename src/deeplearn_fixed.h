@@ -0,0 +1,101 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_FIXED_H
+#define DEEPLEARN_FIXED_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include "globals.h"
+#include "backprop.h"
+#include "deeplearn.h"
+#include "deeplearndata.h"
+
+/* number of bits per weight */
+#define DEEPLEARN_FIXED_Q7    8
+#define DEEPLEARN_FIXED_Q15   16
+
+/* the sigmoid lookup table covers inputs from -DEEPLEARN_FIXED_LUT_RANGE
+   to DEEPLEARN_FIXED_LUT_RANGE, with DEEPLEARN_FIXED_LUT_STEPS entries
+   per unit */
+#define DEEPLEARN_FIXED_LUT_RANGE  8
+#define DEEPLEARN_FIXED_LUT_STEPS  16
+#define DEEPLEARN_FIXED_LUT_SIZE   (DEEPLEARN_FIXED_LUT_RANGE*2*DEEPLEARN_FIXED_LUT_STEPS + 1)
+
+/* fractional bits used to interpolate between table entries */
+#define DEEPLEARN_FIXED_LUT_FRACTION  8
+
+typedef struct {
+    /* DEEPLEARN_FIXED_Q7 or DEEPLEARN_FIXED_Q15 */
+    int bits;
+
+    /* activations are unsigned with this many fractional bits,
+       so that 1.0 is 1 << activation_bits */
+    int activation_bits;
+
+    /* hidden layers followed by the output layer */
+    int no_of_layers;
+    int * units;
+    int * no_of_inputs;
+
+    /* weights of each layer are scaled by 2^weight_shift */
+    int * weight_shift;
+
+    /* shift which converts the sum of a layer into a table position */
+    int * lut_shift;
+
+    int32_t ** weights;
+
+    /* biases within the scale of the sums */
+    int64_t ** bias;
+
+    int32_t lut[DEEPLEARN_FIXED_LUT_SIZE];
+
+    /* activations of the previous and current layers, sized for the
+       widest layer */
+    int32_t * prev;
+    int32_t * curr;
+
+    int softmax;
+} deeplearn_fixed;
+
+int deeplearn_fixed_init(deeplearn_fixed * fixed, bp * net, int bits);
+void deeplearn_fixed_free(deeplearn_fixed * fixed);
+int32_t deeplearn_fixed_input(deeplearn_fixed * fixed, float value);
+int32_t deeplearn_fixed_activation(deeplearn_fixed * fixed,
+                                   int64_t sum, int layer);
+int deeplearn_fixed_widest(deeplearn_fixed * fixed);
+void deeplearn_fixed_feed_forward(deeplearn_fixed * fixed,
+                                  float inputs[], float outputs[]);
+float deeplearn_fixed_get_performance(deeplearn_fixed * fixed,
+                                      deeplearn * learner);
+
+#endif
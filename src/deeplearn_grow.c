@@ -0,0 +1,403 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_grow.h"
+
+/* Describes how the units of a layer within the grown network relate to
+   the units of the corresponding layer of the original network */
+typedef struct {
+    int no_of_units;
+
+    /* the original unit which each unit represents */
+    int * unit;
+
+    /* the number of units which represent each original unit */
+    int * copies;
+    int no_of_original_units;
+
+    /* the original value is recovered from a unit's value as
+       offset + (scale * value) */
+    float offset;
+    float scale;
+} deeplearn_grow_layer;
+
+/**
+ * @brief Creates the mapping between the units of a grown layer and
+ *        the original units. The first units are the originals and any
+ *        additional units are copies of randomly chosen originals
+ * @param layer Grown layer mapping
+ * @param no_of_units Number of units within the grown layer
+ * @param no_of_original_units Number of units within the original layer
+ * @param random_seed Random number generator seed
+ * @returns zero on success
+ */
+static int deeplearn_grow_layer_init(deeplearn_grow_layer * layer,
+                                     int no_of_units,
+                                     int no_of_original_units,
+                                     unsigned int * random_seed)
+{
+    layer->no_of_units = no_of_units;
+    layer->no_of_original_units = no_of_original_units;
+    layer->offset = 0;
+    layer->scale = 1;
+
+    INTALLOC(layer->unit, no_of_units);
+    if (!layer->unit)
+        return -1;
+
+    INTALLOC(layer->copies, no_of_original_units);
+    if (!layer->copies) {
+        free(layer->unit);
+        return -2;
+    }
+
+    memset(layer->copies, '\0', no_of_original_units*sizeof(int));
+    COUNTUP(i, no_of_units) {
+        if (i < no_of_original_units)
+            layer->unit[i] = i;
+        else
+            layer->unit[i] =
+                (int)(rand_num(random_seed)%no_of_original_units);
+        layer->copies[layer->unit[i]]++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Frees memory for a grown layer mapping
+ * @param layer Grown layer mapping
+ */
+static void deeplearn_grow_layer_free(deeplearn_grow_layer * layer)
+{
+    free(layer->unit);
+    free(layer->copies);
+}
+
+/**
+ * @brief Sets the weights of a unit within the grown network so that it
+ *        computes the same sum as the original weights applied to the
+ *        original units of the previous layer. The weight to each original
+ *        unit is split between its copies
+ * @param n Unit within the grown network
+ * @param bias Original bias
+ * @param weights Original weights, one per original unit of the
+ *        previous layer
+ * @param prev Mapping for the previous layer of the grown network
+ */
+static void deeplearn_grow_set_weights(bp_neuron * n,
+                                       float bias, float weights[],
+                                       deeplearn_grow_layer * prev)
+{
+    n->bias = bias;
+    n->min_weight = 9999;
+    n->max_weight = -9999;
+
+    COUNTDOWN(i, n->no_of_inputs) {
+        int u = prev->unit[i];
+        float w = weights[u] / (float)prev->copies[u];
+
+        n->weights[i] = w * prev->scale;
+        n->bias += w * prev->offset;
+
+        if (n->weights[i] < n->min_weight)
+            n->min_weight = n->weights[i];
+
+        if (n->weights[i] > n->max_weight)
+            n->max_weight = n->weights[i];
+    }
+
+    FLOATCLEAR(n->last_weight_change, n->no_of_inputs);
+    n->last_bias_change = 0;
+}
+
+/**
+ * @brief Moves the data set of one learner to another
+ * @param src Deep learner object which owns the data set
+ * @param dst Deep learner object to move the data set to
+ */
+static void deeplearn_grow_move_data(deeplearn * src, deeplearn * dst)
+{
+    dst->data = src->data;
+    dst->data_samples = src->data_samples;
+    dst->indexed_data = src->indexed_data;
+    dst->indexed_data_samples = src->indexed_data_samples;
+    dst->training_data = src->training_data;
+    dst->training_data_samples = src->training_data_samples;
+    dst->indexed_training_data = src->indexed_training_data;
+    dst->indexed_training_data_samples = src->indexed_training_data_samples;
+    dst->training_data_labeled = src->training_data_labeled;
+    dst->training_data_labeled_samples = src->training_data_labeled_samples;
+    dst->indexed_training_data_labeled = src->indexed_training_data_labeled;
+    dst->indexed_training_data_labeled_samples =
+        src->indexed_training_data_labeled_samples;
+    dst->test_data = src->test_data;
+    dst->test_data_samples = src->test_data_samples;
+    dst->indexed_test_data = src->indexed_test_data;
+    dst->indexed_test_data_samples = src->indexed_test_data_samples;
+    dst->stream = src->stream;
+    dst->sampler = src->sampler;
+    dst->mean_sample_weight = src->mean_sample_weight;
+    dst->inputs_quantised = src->inputs_quantised;
+    dst->inputs_quantised_bytes = src->inputs_quantised_bytes;
+
+    src->data = 0;
+    src->data_samples = 0;
+    src->indexed_data = 0;
+    src->indexed_data_samples = 0;
+    src->training_data = 0;
+    src->training_data_samples = 0;
+    src->indexed_training_data = 0;
+    src->indexed_training_data_samples = 0;
+    src->training_data_labeled = 0;
+    src->training_data_labeled_samples = 0;
+    src->indexed_training_data_labeled = 0;
+    src->indexed_training_data_labeled_samples = 0;
+    src->test_data = 0;
+    src->test_data_samples = 0;
+    src->indexed_test_data = 0;
+    src->indexed_test_data_samples = 0;
+    src->stream = 0;
+    src->sampler = 0;
+    src->inputs_quantised = 0;
+    src->inputs_quantised_bytes = 0;
+}
+
+/**
+ * @brief Returns the smallest number of hidden units within the first
+ *        layer for which a learner can be grown to the given number of
+ *        hidden layers. Since hidden layers become narrower with depth,
+ *        adding layers without also adding units usually makes the
+ *        inserted layers narrower than the final original layer
+ * @param src Trained deep learner object
+ * @param hidden_layers Number of hidden layers of the grown learner
+ * @returns number of hidden units, or -1 if fewer layers were requested
+ */
+int deeplearn_grow_min_hiddens(deeplearn * src, int hidden_layers)
+{
+    bp * net = src->net;
+    bp grown;
+
+    if (hidden_layers < net->hidden_layers)
+        return -1;
+
+    grown.no_of_hiddens = net->no_of_hiddens;
+    grown.hidden_layers = hidden_layers;
+    grown.no_of_outputs = net->no_of_outputs;
+
+    /* the widths of all layers increase with the width of the first */
+    while (1) {
+        int wide_enough = 1;
+
+        COUNTUP(l, hidden_layers) {
+            int original = (l < net->hidden_layers) ? l : net->hidden_layers-1;
+            if (HIDDENS_IN_LAYER(&grown,l) < HIDDENS_IN_LAYER(net,original)) {
+                wide_enough = 0;
+                break;
+            }
+        }
+        if (wide_enough != 0)
+            break;
+
+        grown.no_of_hiddens++;
+    }
+    return grown.no_of_hiddens;
+}
+
+/**
+ * @brief Creates a wider and/or deeper learner which computes the same
+ *        function as a trained one, so that training can continue with
+ *        more capacity rather than starting again. Extra units in a layer
+ *        are copies of existing units, with the outgoing weights of each
+ *        unit split between its copies. Extra layers are inserted after
+ *        the original hidden layers and are close to an identity.
+ *        Any data set and prioritised sampler belonging to the original
+ *        learner are moved to the grown one. To only add layers use
+ *        deeplearn_grow_min_hiddens to find the number of hidden units.
+ * @param src Trained deep learner object
+ * @param no_of_hiddens Number of hidden units within the first layer of
+ *        the grown learner
+ * @param hidden_layers Number of hidden layers of the grown learner
+ * @param dst Returned grown learner
+ * @returns zero on success, or -4 if a layer of the grown learner would
+ *          be narrower than the layer it represents
+ */
+int deeplearn_grow(deeplearn * src,
+                   int no_of_hiddens, int hidden_layers,
+                   deeplearn * dst)
+{
+    bp * net = src->net;
+    bp * grown;
+    float * error_threshold;
+    float * weights;
+    float slope, identity_scale = DEEPLEARN_GROW_IDENTITY_SCALE;
+    deeplearn_grow_layer * layer;
+    deeplearn_grow_layer inputs;
+    unsigned int random_seed = net->random_seed;
+    int retval = 0;
+
+    if ((no_of_hiddens < net->no_of_hiddens) ||
+        (hidden_layers < net->hidden_layers))
+        return -1;
+
+    FLOATALLOC(error_threshold, hidden_layers+1);
+    if (!error_threshold)
+        return -2;
+
+    COUNTUP(l, hidden_layers) {
+        if (l < net->hidden_layers)
+            error_threshold[l] = src->error_threshold[l];
+        else
+            error_threshold[l] = src->error_threshold[net->hidden_layers-1];
+    }
+    error_threshold[hidden_layers] = src->error_threshold[net->hidden_layers];
+
+    if (deeplearn_init(dst, net->no_of_inputs, no_of_hiddens,
+                       hidden_layers, net->no_of_outputs,
+                       error_threshold, &random_seed) != 0) {
+        free(error_threshold);
+        return -3;
+    }
+    free(error_threshold);
+    grown = dst->net;
+    grown->output_activation = net->output_activation;
+
+    /* each layer must be at least as wide as the layer it represents */
+    COUNTUP(l, hidden_layers) {
+        int original = (l < net->hidden_layers) ? l : net->hidden_layers-1;
+        if (HIDDENS_IN_LAYER(grown,l) < HIDDENS_IN_LAYER(net,original)) {
+            deeplearn_free(dst);
+            return -4;
+        }
+    }
+
+    if (deeplearn_copy_fields(src, dst) != 0) {
+        deeplearn_free(dst);
+        return -5;
+    }
+
+    layer = (deeplearn_grow_layer*)
+        malloc(hidden_layers*sizeof(deeplearn_grow_layer));
+    if (!layer) {
+        deeplearn_free(dst);
+        return -6;
+    }
+
+    /* room for the weights of a single unit */
+    FLOATALLOC(weights, bp_widest_layer(grown) + net->no_of_inputs);
+    if (!weights) {
+        free(layer);
+        deeplearn_free(dst);
+        return -7;
+    }
+
+    /* the slope of the activation function at zero, used to recover
+       values from the units of inserted layers */
+    slope = (AF(0.001f) - AF(-0.001f)) / 0.002f;
+
+    /* the input units are unchanged */
+    if (deeplearn_grow_layer_init(&inputs, net->no_of_inputs,
+                                  net->no_of_inputs, &random_seed) != 0) {
+        free(weights);
+        free(layer);
+        deeplearn_free(dst);
+        return -9;
+    }
+
+    COUNTUP(l, hidden_layers) {
+        deeplearn_grow_layer * prev = (l == 0) ? &inputs : &layer[l-1];
+        int original = (l < net->hidden_layers) ? l : net->hidden_layers-1;
+
+        if (deeplearn_grow_layer_init(&layer[l], HIDDENS_IN_LAYER(grown,l),
+                                      HIDDENS_IN_LAYER(net,original),
+                                      &random_seed) != 0) {
+            hidden_layers = l;
+            retval = -8;
+            break;
+        }
+
+        COUNTUP(i, HIDDENS_IN_LAYER(grown,l)) {
+            int u = layer[l].unit[i];
+
+            if (l < net->hidden_layers) {
+                /* a copy of an original unit */
+                bp_neuron * n = net->hiddens[l][u];
+                deeplearn_grow_set_weights(grown->hiddens[l][i],
+                                           n->bias, n->weights, prev);
+            }
+            else {
+                /* a unit of an inserted layer, having a small input
+                   from the unit which it passes on, centred so that the
+                   activation function is close to linear */
+                FLOATCLEAR(weights, prev->no_of_original_units);
+                weights[u] = identity_scale;
+                deeplearn_grow_set_weights(grown->hiddens[l][i],
+                                           -identity_scale*NEURON_UNKNOWN,
+                                           weights, prev);
+            }
+        }
+
+        if (l >= net->hidden_layers) {
+            /* value = 0.5 + slope*scale*(original - 0.5) */
+            layer[l].scale = 1.0f / (slope*identity_scale);
+            layer[l].offset = NEURON_UNKNOWN - (NEURON_UNKNOWN*layer[l].scale);
+        }
+    }
+
+    if (retval == 0) {
+        COUNTUP(i, net->no_of_outputs) {
+            bp_neuron * n = net->outputs[i];
+            deeplearn_grow_set_weights(grown->outputs[i],
+                                       n->bias, n->weights,
+                                       &layer[hidden_layers-1]);
+        }
+
+        grown->learning_rate = net->learning_rate;
+        grown->dropout_percent = net->dropout_percent;
+        grown->noise = net->noise;
+        grown->itterations = net->itterations;
+
+        /* continue from the same stage of training */
+        dst->current_hidden_layer = src->current_hidden_layer;
+        if (src->current_hidden_layer >= net->hidden_layers)
+            dst->current_hidden_layer = grown->hidden_layers;
+        dst->training_ctr = src->training_ctr;
+
+        deeplearn_grow_move_data(src, dst);
+    }
+
+    COUNTDOWN(l, hidden_layers)
+        deeplearn_grow_layer_free(&layer[l]);
+    deeplearn_grow_layer_free(&inputs);
+    free(layer);
+    free(weights);
+
+    if (retval != 0)
+        deeplearn_free(dst);
+    return retval;
+}
@@ -346,9 +346,14 @@ int deeplearn_history_phosphene(deeplearn_history * history,
 int deeplearn_history_plot(deeplearn_history * history,
                            int img_width, int img_height)
 {
+    int retval;
+
+    deeplearn_trace_begin("deeplearn_history_plot");
 #ifdef PLOT_WITH_GNUPLOT
-    return deeplearn_history_gnuplot(history, img_width, img_height);
+    retval = deeplearn_history_gnuplot(history, img_width, img_height);
 #else
-    return deeplearn_history_phosphene(history, img_width, img_height);
+    retval = deeplearn_history_phosphene(history, img_width, img_height);
 #endif
+    deeplearn_trace_end("deeplearn_history_plot");
+    return retval;
 }
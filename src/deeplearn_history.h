@@ -36,6 +36,7 @@
 #include <string.h>
 #include "globals.h"
 #include "phosphene.h"
+#include "deeplearn_trace.h"
 
 #define HISTORY_DIMENSIONS 16
 
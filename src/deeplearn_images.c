@@ -238,7 +238,9 @@ void deeplearn_downsample_colour(unsigned char img[],
  *        classification numbers
  * @param images_directory The directory to search for images
  * @param images Array which will be used to store the images (1 byte/pixel)
- * @param classifications Description of each image, taken from the filename
+ * @param labels Returned table of classification descriptions, taken from
+ *        the filenames. Each description is stored once and its index
+ *        within the table is the class number
  * @param classification_number Class number of each image
  * @param width Standardised width of the images in pixels
  * @param height Standardised height of the images in pixels
@@ -248,7 +250,7 @@ void deeplearn_downsample_colour(unsigned char img[],
  */
 int deeplearn_load_training_images(char * images_directory,
                                    unsigned char *** images,
-                                   char *** classifications,
+                                   deeplearn_labels * labels,
                                    int ** classification_number,
                                    int width, int height,
                                    int extra_synthetic_images)
@@ -261,7 +263,7 @@ int deeplearn_load_training_images(char * images_directory,
     unsigned char * img, * img2, * downsampled;
     char * extension = "png";
     char filename[512];
-    char * classification;
+    int class_number, start, length;
     unsigned int random_seed = 763528;
     float scale;
 
@@ -278,9 +280,8 @@ int deeplearn_load_training_images(char * images_directory,
     if (!images)
         return -1;
 
-    /* allocate memory for the classifications */
-    CHARPTRALLOC(*classifications, no_of_images);
-    if (!classifications)
+    /* table of unique classifications */
+    if (deeplearn_labels_init(labels, 0) != 0)
         return -2;
 
     /* allocate memory for the class number assigned to each image */
@@ -305,14 +306,18 @@ int deeplearn_load_training_images(char * images_directory,
                 if (string_ends_with_extension(filename, extension)) {
                     downsampled = NULL;
 
-                    /* obtain an image from the filename */
+                    /* obtain an image from the filename. The original
+                       image is kept until any synthetic images have
+                       been created from it */
                     if (deeplearn_read_png_file(filename,
                                                 &im_width, &im_height,
                                                 &im_bitsperpixel, &img) == 0) {
                         /* create a fixed size image */
                         UCHARALLOC(downsampled, width*height);
-                        if (!downsampled)
+                        if (!downsampled) {
+                            free(img);
                             return -4;
+                        }
 
                         deeplearn_downsample_colour_to_mono(img, (int)im_width,
                                                             (int)im_height,
@@ -320,23 +325,24 @@ int deeplearn_load_training_images(char * images_directory,
                                                             width, height);
 
                         (*images)[no_of_images] = downsampled;
-
-                        /* free the original image */
-                        free(img);
                     }
                     else {
                         (*images)[no_of_images] = NULL;
                     }
 
-                    /* allocate memory for the classification */
-                    CHARALLOC(classification, 256);
-                    if (!classification)
+                    /* get the class number from the name of the
+                       classification within the filename */
+                    start = bp_classification_within_filename(filename,
+                                                              &length);
+                    class_number = deeplearn_labels_intern(labels,
+                                                           &filename[start],
+                                                           length);
+                    if (class_number < 0) {
+                        if (downsampled != NULL)
+                            free(img);
                         return -5;
-
-                    /* get the name of the classification */
-                    bp_get_classification_from_filename(filename,
-                                                        classification);
-                    (*classifications)[no_of_images] = classification;
+                    }
+                    (*classification_number)[no_of_images] = class_number;
 
                     no_of_images++;
 
@@ -347,8 +353,10 @@ int deeplearn_load_training_images(char * images_directory,
 
                     COUNTDOWN(s, extra_synthetic_images) {
                         UCHARALLOC(img2, width*height);
-                        if (!img2)
+                        if (!img2) {
+                            free(img);
                             return -6;
+                        }
                         if (img2 != NULL) {
                             /* scaling factor 0.5 -> 1.0 */
                             scale = 0.5f +
@@ -371,14 +379,14 @@ int deeplearn_load_training_images(char * images_directory,
                             (*images)[no_of_images] = img2;
                         }
 
-                        CHARALLOC(classification, 256);
-                        if (!classification)
-                            return -7;
-
-                        (*classifications)[no_of_images] = classification;
+                        (*classification_number)[no_of_images] =
+                            class_number;
 
                         no_of_images++;
                     }
+
+                    /* free the original image */
+                    free(img);
                 }
             }
             free(namelist[ctr]);
@@ -386,11 +394,6 @@ int deeplearn_load_training_images(char * images_directory,
         free(namelist);
     }
 
-    /* assign a class number to each image */
-    bp_classifications_to_numbers(no_of_images,
-                                  *classifications,
-                                  (*classification_number));
-
     return no_of_images;
 }
 
@@ -43,6 +43,7 @@
 #include <stdarg.h>
 
 #include "lodepng.h"
+#include "deeplearn_labels.h"
 #include "backprop.h"
 #include "utils.h"
 
@@ -57,7 +58,7 @@ int deeplearn_write_png_file(char * filename,
                              unsigned char buffer[]);
 int deeplearn_load_training_images(char * images_directory,
                                    unsigned char *** images,
-                                   char *** classifications,
+                                   deeplearn_labels * labels,
                                    int ** classification_number,
                                    int width, int height,
                                    int extra_synthetic_images);
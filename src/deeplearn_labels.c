@@ -0,0 +1,258 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_labels.h"
+#include "utils.h"
+
+/**
+ * @brief Places a label into the bucket for its hash
+ * @param labels Label table
+ * @param index Class number of the label
+ */
+static void deeplearn_labels_link(deeplearn_labels * labels, int index)
+{
+    int b = (int)(labels->hash[index] & (uint64_t)(labels->no_of_buckets-1));
+
+    labels->chain[index] = labels->bucket[b];
+    labels->bucket[b] = index;
+}
+
+/**
+ * @brief Doubles the number of labels which can be stored, and the
+ *        number of hash buckets
+ * @param labels Label table
+ * @returns zero on success
+ */
+static int deeplearn_labels_grow(deeplearn_labels * labels)
+{
+    int max_labels = labels->max_labels*2;
+    int * offset, * chain, * bucket;
+    uint64_t * hash;
+
+    offset = (int*)realloc(labels->offset, max_labels*sizeof(int));
+    if (!offset)
+        return -1;
+    labels->offset = offset;
+
+    chain = (int*)realloc(labels->chain, max_labels*sizeof(int));
+    if (!chain)
+        return -2;
+    labels->chain = chain;
+
+    hash = (uint64_t*)realloc(labels->hash, max_labels*sizeof(uint64_t));
+    if (!hash)
+        return -3;
+    labels->hash = hash;
+
+    INTALLOC(bucket, max_labels);
+    if (!bucket)
+        return -4;
+    free(labels->bucket);
+    labels->bucket = bucket;
+    labels->no_of_buckets = max_labels;
+    labels->max_labels = max_labels;
+
+    /* rehash the existing labels */
+    COUNTDOWN(b, labels->no_of_buckets)
+        labels->bucket[b] = -1;
+    COUNTUP(i, labels->no_of_labels)
+        deeplearn_labels_link(labels, i);
+
+    return 0;
+}
+
+/**
+ * @brief Creates a table which assigns a class number to each unique
+ *        label, storing each label once
+ * @param labels Label table
+ * @param expected_labels Expected number of unique labels. The table
+ *        grows if more than this are seen
+ * @returns zero on success
+ */
+int deeplearn_labels_init(deeplearn_labels * labels, int expected_labels)
+{
+    labels->no_of_labels = 0;
+    labels->arena_used = 0;
+
+    /* the number of buckets is a power of two */
+    labels->max_labels = 16;
+    while (labels->max_labels < expected_labels)
+        labels->max_labels <<= 1;
+    labels->no_of_buckets = labels->max_labels;
+
+    INTALLOC(labels->offset, labels->max_labels);
+    if (!labels->offset)
+        return -1;
+
+    INTALLOC(labels->chain, labels->max_labels);
+    if (!labels->chain)
+        return -2;
+
+    labels->hash = (uint64_t*)malloc(labels->max_labels*sizeof(uint64_t));
+    if (!labels->hash)
+        return -3;
+
+    INTALLOC(labels->bucket, labels->no_of_buckets);
+    if (!labels->bucket)
+        return -4;
+
+    COUNTDOWN(b, labels->no_of_buckets)
+        labels->bucket[b] = -1;
+
+    labels->arena_size = labels->max_labels*16;
+    CHARALLOC(labels->arena, labels->arena_size);
+    if (!labels->arena)
+        return -5;
+
+    return 0;
+}
+
+/**
+ * @brief Frees memory for a label table
+ * @param labels Label table
+ */
+void deeplearn_labels_free(deeplearn_labels * labels)
+{
+    free(labels->offset);
+    free(labels->chain);
+    free(labels->hash);
+    free(labels->bucket);
+    free(labels->arena);
+    labels->no_of_labels = 0;
+}
+
+/**
+ * @brief Searches a bucket for the given label
+ * @param labels Label table
+ * @param label The label, which need not be null terminated
+ * @param length Length of the label
+ * @param hash Hash of the label
+ * @returns class number, or -1 if not found
+ */
+static int deeplearn_labels_search(deeplearn_labels * labels,
+                                   const char * label, int length,
+                                   uint64_t hash)
+{
+    int index =
+        labels->bucket[hash & (uint64_t)(labels->no_of_buckets-1)];
+
+    while (index != -1) {
+        if (labels->hash[index] == hash) {
+            char * str = &labels->arena[labels->offset[index]];
+            if ((strncmp(str, label, length) == 0) && (str[length] == 0))
+                return index;
+        }
+        index = labels->chain[index];
+    }
+    return -1;
+}
+
+/**
+ * @brief Returns the class number for a label
+ * @param labels Label table
+ * @param label The label, which need not be null terminated
+ * @param length Length of the label, or -1 if it is null terminated
+ * @returns class number, or -1 if the label has not been seen
+ */
+int deeplearn_labels_find(deeplearn_labels * labels,
+                          const char * label, int length)
+{
+    if (length < 0)
+        length = strlen(label);
+
+    return deeplearn_labels_search(labels, label, length,
+                                   deeplearn_hash64(label, length, 0));
+}
+
+/**
+ * @brief Returns the class number for a label, assigning the next
+ *        class number if the label has not been seen before
+ * @param labels Label table
+ * @param label The label, which need not be null terminated
+ * @param length Length of the label, or -1 if it is null terminated
+ * @returns class number, or a negative value on error
+ */
+int deeplearn_labels_intern(deeplearn_labels * labels,
+                            const char * label, int length)
+{
+    uint64_t hash;
+    int index;
+
+    if (length < 0)
+        length = strlen(label);
+
+    hash = deeplearn_hash64(label, length, 0);
+    index = deeplearn_labels_search(labels, label, length, hash);
+    if (index != -1)
+        return index;
+
+    if (labels->no_of_labels == labels->max_labels) {
+        if (deeplearn_labels_grow(labels) != 0)
+            return -1;
+    }
+
+    if (labels->arena_used + length + 1 > labels->arena_size) {
+        char * arena;
+        int arena_size = labels->arena_size*2;
+
+        while (labels->arena_used + length + 1 > arena_size)
+            arena_size *= 2;
+
+        arena = (char*)realloc(labels->arena, arena_size);
+        if (!arena)
+            return -2;
+        labels->arena = arena;
+        labels->arena_size = arena_size;
+    }
+
+    index = labels->no_of_labels++;
+    labels->offset[index] = labels->arena_used;
+    labels->hash[index] = hash;
+    memcpy(&labels->arena[labels->arena_used], label, length);
+    labels->arena[labels->arena_used + length] = 0;
+    labels->arena_used += length + 1;
+
+    deeplearn_labels_link(labels, index);
+    return index;
+}
+
+/**
+ * @brief Returns the label for a class number. The label remains valid
+ *        until another label is added or the table is freed
+ * @param labels Label table
+ * @param class_number The class number
+ * @returns label, or NULL if the class number is not known
+ */
+char * deeplearn_labels_get(deeplearn_labels * labels, int class_number)
+{
+    if ((class_number < 0) || (class_number >= labels->no_of_labels))
+        return NULL;
+
+    return &labels->arena[labels->offset[class_number]];
+}
@@ -0,0 +1,68 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_LABELS_H
+#define DEEPLEARN_LABELS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "globals.h"
+
+typedef struct {
+    /* number of unique labels, which are numbered 0 upwards */
+    int no_of_labels;
+    int max_labels;
+
+    /* position of each label within the arena, and its hash */
+    int * offset;
+    uint64_t * hash;
+
+    /* next label within the same hash bucket */
+    int * chain;
+
+    int no_of_buckets;
+    int * bucket;
+
+    /* null terminated labels stored one after another */
+    char * arena;
+    int arena_used;
+    int arena_size;
+} deeplearn_labels;
+
+int deeplearn_labels_init(deeplearn_labels * labels, int expected_labels);
+void deeplearn_labels_free(deeplearn_labels * labels);
+int deeplearn_labels_find(deeplearn_labels * labels,
+                          const char * label, int length);
+int deeplearn_labels_intern(deeplearn_labels * labels,
+                            const char * label, int length);
+char * deeplearn_labels_get(deeplearn_labels * labels, int class_number);
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_memory.h"
+
+/* bytes held by objects which have been initialised but not freed */
+static size_t memory_used = 0;
+
+/* maximum number of bytes, or zero for no limit */
+static size_t memory_budget = 0;
+
+static pthread_mutex_t memory_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Sets the maximum number of bytes which may be held by
+ *        libdeep objects within this process. Once the budget
+ *        would be exceeded the creation of further objects fails
+ *        before any memory is allocated for them.
+ * @param bytes Budget in bytes, or zero for no limit
+ */
+void deeplearn_memory_set_budget(size_t bytes)
+{
+    pthread_mutex_lock(&memory_lock);
+    memory_budget = bytes;
+    pthread_mutex_unlock(&memory_lock);
+}
+
+/**
+ * @brief Returns the memory budget
+ * @returns Budget in bytes, or zero if there is no limit
+ */
+size_t deeplearn_memory_get_budget(void)
+{
+    size_t bytes;
+
+    pthread_mutex_lock(&memory_lock);
+    bytes = memory_budget;
+    pthread_mutex_unlock(&memory_lock);
+    return bytes;
+}
+
+/**
+ * @brief Returns the number of bytes held by libdeep objects which
+ *        have been initialised and not yet freed
+ * @returns Number of bytes
+ */
+size_t deeplearn_memory_used(void)
+{
+    size_t bytes;
+
+    pthread_mutex_lock(&memory_lock);
+    bytes = memory_used;
+    pthread_mutex_unlock(&memory_lock);
+    return bytes;
+}
+
+/**
+ * @brief Returns the number of bytes remaining within the budget
+ * @returns Number of bytes, or SIZE_MAX if there is no limit
+ */
+size_t deeplearn_memory_available(void)
+{
+    size_t bytes = SIZE_MAX;
+
+    pthread_mutex_lock(&memory_lock);
+    if (memory_budget > 0) {
+        bytes = 0;
+        if (memory_used < memory_budget)
+            bytes = memory_budget - memory_used;
+    }
+    pthread_mutex_unlock(&memory_lock);
+    return bytes;
+}
+
+/**
+ * @brief Reserves memory for an object which is about to be created
+ * @param bytes Number of bytes
+ * @returns zero on success, or -1 if the budget would be exceeded
+ */
+int deeplearn_memory_reserve(size_t bytes)
+{
+    int retval = 0;
+
+    pthread_mutex_lock(&memory_lock);
+    if ((memory_budget > 0) &&
+        ((bytes > memory_budget) || (memory_used > memory_budget - bytes)))
+        retval = -1;
+    else
+        memory_used += bytes;
+    pthread_mutex_unlock(&memory_lock);
+    return retval;
+}
+
+/**
+ * @brief Releases memory which was reserved for an object
+ * @param bytes Number of bytes
+ */
+void deeplearn_memory_release(size_t bytes)
+{
+    pthread_mutex_lock(&memory_lock);
+    if (bytes > memory_used)
+        memory_used = 0;
+    else
+        memory_used -= bytes;
+    pthread_mutex_unlock(&memory_lock);
+}
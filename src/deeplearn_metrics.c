@@ -0,0 +1,496 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* needed for clock_gettime */
+#define _POSIX_C_SOURCE 200112L
+
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "deeplearn_metrics.h"
+
+/* counters for a single thread. These are only written by the thread
+   which owns them, so no locking or atomic operations are needed */
+struct deeplearn_metrics_thread {
+    deeplearn_metric metric[DEEPLEARN_METRICS];
+
+    /* maximum latencies are only valid if this equals metrics_epoch */
+    unsigned int epoch;
+
+    struct deeplearn_metrics_thread * prev;
+    struct deeplearn_metrics_thread * next;
+};
+typedef struct deeplearn_metrics_thread deeplearn_metrics_thread;
+
+static volatile int metrics_enabled = 0;
+static double metrics_ns_per_tick = 1.0;
+
+/* incremented on each reset */
+static volatile unsigned int metrics_epoch = 0;
+
+static pthread_once_t metrics_once = PTHREAD_ONCE_INIT;
+static pthread_key_t metrics_key;
+static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* list of counters for running threads */
+static deeplearn_metrics_thread * metrics_threads = NULL;
+
+/* counters from threads which have exited */
+static deeplearn_metrics_snapshot metrics_retired;
+
+/* totals at the time of the last reset */
+static deeplearn_metrics_snapshot metrics_baseline;
+
+static const char * metrics_names[] = {
+    "deeplearn_feed_forward",
+    "deeplearn_feed_forward_batch",
+    "deeplearn_update",
+    "deepconvnet_test_img"
+};
+
+/**
+ * @brief Returns the current time in ticks. On x86 this is the time
+ *        stamp counter, otherwise nanoseconds from the monotonic clock
+ * @returns ticks
+ */
+static uint64_t deeplearn_metrics_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint64_t)__rdtsc();
+#else
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((uint64_t)t.tv_sec*1000000000ULL) + (uint64_t)t.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Returns the monotonic clock time in nanoseconds
+ * @returns nanoseconds
+ */
+static uint64_t deeplearn_metrics_ns(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((uint64_t)t.tv_sec*1000000000ULL) + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * @brief Adds or subtracts the counters of one metric to another.
+ *        Maximum latencies are handled separately
+ * @param dest Metric to be altered
+ * @param src Metric to add or subtract
+ * @param sign 1 to add, -1 to subtract
+ */
+static void deeplearn_metrics_add(deeplearn_metric * dest,
+                                  deeplearn_metric * src, int sign)
+{
+    if (sign < 0) {
+        dest->calls -= src->calls;
+        dest->samples -= src->samples;
+        dest->total_ticks -= src->total_ticks;
+        COUNTDOWN(i, DEEPLEARN_METRICS_BUCKETS)
+            dest->histogram[i] -= src->histogram[i];
+        return;
+    }
+
+    dest->calls += src->calls;
+    dest->samples += src->samples;
+    dest->total_ticks += src->total_ticks;
+    COUNTDOWN(i, DEEPLEARN_METRICS_BUCKETS)
+        dest->histogram[i] += src->histogram[i];
+}
+
+/**
+ * @brief Called when a thread exits, so that its counters are kept
+ * @param arg Counters for the thread
+ */
+static void deeplearn_metrics_thread_exit(void * arg)
+{
+    deeplearn_metrics_thread * t = (deeplearn_metrics_thread*)arg;
+
+    pthread_mutex_lock(&metrics_lock);
+    COUNTDOWN(m, DEEPLEARN_METRICS) {
+        deeplearn_metrics_add(&metrics_retired.metric[m], &t->metric[m], 1);
+        if ((t->epoch == metrics_epoch) &&
+            (t->metric[m].max_ticks > metrics_retired.metric[m].max_ticks))
+            metrics_retired.metric[m].max_ticks = t->metric[m].max_ticks;
+    }
+
+    if (t->prev)
+        t->prev->next = t->next;
+    else
+        metrics_threads = t->next;
+    if (t->next)
+        t->next->prev = t->prev;
+    pthread_mutex_unlock(&metrics_lock);
+
+    free(t);
+}
+
+/**
+ * @brief Creates the key used to find the counters for each thread
+ */
+static void deeplearn_metrics_create_key(void)
+{
+    pthread_key_create(&metrics_key, deeplearn_metrics_thread_exit);
+}
+
+/**
+ * @brief Returns the counters for the calling thread, creating them
+ *        if necessary
+ * @returns counters for the thread
+ */
+static deeplearn_metrics_thread * deeplearn_metrics_thread_get(void)
+{
+    deeplearn_metrics_thread * t;
+
+    pthread_once(&metrics_once, deeplearn_metrics_create_key);
+    t = (deeplearn_metrics_thread*)pthread_getspecific(metrics_key);
+    if (t)
+        return t;
+
+    t = (deeplearn_metrics_thread*)calloc(1, sizeof(deeplearn_metrics_thread));
+    if (!t)
+        return NULL;
+
+    pthread_mutex_lock(&metrics_lock);
+    t->epoch = metrics_epoch;
+    t->next = metrics_threads;
+    if (metrics_threads)
+        metrics_threads->prev = t;
+    metrics_threads = t;
+    pthread_mutex_unlock(&metrics_lock);
+
+    pthread_setspecific(metrics_key, t);
+    return t;
+}
+
+/**
+ * @brief Returns the histogram bucket for a number of ticks
+ * @param ticks Number of ticks
+ * @returns bucket index
+ */
+static int deeplearn_metrics_bucket(uint64_t ticks)
+{
+    int msb = 0;
+
+    if (ticks < (1 << DEEPLEARN_METRICS_SUB_BITS))
+        return (int)ticks;
+
+    while ((ticks >> msb) > 1)
+        msb++;
+
+    return ((msb - DEEPLEARN_METRICS_SUB_BITS + 1) <<
+            DEEPLEARN_METRICS_SUB_BITS) +
+        (int)((ticks >> (msb - DEEPLEARN_METRICS_SUB_BITS)) &
+              ((1 << DEEPLEARN_METRICS_SUB_BITS) - 1));
+}
+
+/**
+ * @brief Returns the middle of the range of ticks covered by a bucket
+ * @param bucket Bucket index
+ * @returns number of ticks
+ */
+static double deeplearn_metrics_bucket_ticks(int bucket)
+{
+    int msb, sub;
+    double width;
+
+    if (bucket < (1 << DEEPLEARN_METRICS_SUB_BITS))
+        return bucket;
+
+    msb = (bucket >> DEEPLEARN_METRICS_SUB_BITS) +
+        DEEPLEARN_METRICS_SUB_BITS - 1;
+    sub = bucket & ((1 << DEEPLEARN_METRICS_SUB_BITS) - 1);
+    width = (double)((uint64_t)1 << (msb - DEEPLEARN_METRICS_SUB_BITS));
+    return ((double)((uint64_t)1 << msb)) + (sub*width) + (width*0.5);
+}
+
+/**
+ * @brief Enables or disables measurements. When first enabled the
+ *        time stamp counter is calibrated against the monotonic clock
+ * @param enable Non-zero to enable
+ */
+void deeplearn_metrics_enable(int enable)
+{
+    if ((enable != 0) && (metrics_enabled == 0)) {
+        uint64_t start_ns = deeplearn_metrics_ns();
+        uint64_t start_ticks = deeplearn_metrics_ticks();
+        uint64_t ns;
+
+        /* wait for 10mS */
+        do {
+            ns = deeplearn_metrics_ns();
+        } while (ns - start_ns < 10000000ULL);
+
+        metrics_ns_per_tick =
+            (ns - start_ns) / (double)(deeplearn_metrics_ticks() - start_ticks);
+    }
+    metrics_enabled = enable;
+}
+
+/**
+ * @brief Returns non-zero if measurements are enabled
+ * @returns non-zero if enabled
+ */
+int deeplearn_metrics_enabled(void)
+{
+    return metrics_enabled;
+}
+
+/**
+ * @brief Begins measuring a call
+ * @returns the current time in ticks, or zero if measurement is disabled
+ */
+uint64_t deeplearn_metrics_start(void)
+{
+    if (metrics_enabled == 0)
+        return 0;
+
+    return deeplearn_metrics_ticks();
+}
+
+/**
+ * @brief Finishes measuring a call
+ * @param metric The entry point being measured
+ * @param start Value returned by deeplearn_metrics_start
+ * @param samples The number of samples processed by the call
+ */
+void deeplearn_metrics_stop(int metric, uint64_t start, int samples)
+{
+    deeplearn_metrics_thread * t;
+    deeplearn_metric * m;
+    uint64_t ticks;
+
+    if (start == 0)
+        return;
+
+    ticks = deeplearn_metrics_ticks() - start;
+
+    t = deeplearn_metrics_thread_get();
+    if (!t)
+        return;
+
+    /* a reset has happened since this thread last recorded a call */
+    if (t->epoch != metrics_epoch) {
+        COUNTDOWN(i, DEEPLEARN_METRICS)
+            t->metric[i].max_ticks = 0;
+        t->epoch = metrics_epoch;
+    }
+
+    m = &t->metric[metric];
+    m->calls++;
+    m->samples += samples;
+    m->total_ticks += ticks;
+    if (ticks > m->max_ticks)
+        m->max_ticks = ticks;
+    m->histogram[deeplearn_metrics_bucket(ticks)]++;
+}
+
+/**
+ * @brief Merges the counters of all threads since the last reset
+ * @param snapshot Returned counters
+ */
+void deeplearn_metrics_get_snapshot(deeplearn_metrics_snapshot * snapshot)
+{
+    deeplearn_metrics_thread * t;
+
+    pthread_mutex_lock(&metrics_lock);
+    memcpy(snapshot, &metrics_retired, sizeof(deeplearn_metrics_snapshot));
+    for (t = metrics_threads; t != NULL; t = t->next) {
+        COUNTDOWN(m, DEEPLEARN_METRICS) {
+            deeplearn_metrics_add(&snapshot->metric[m], &t->metric[m], 1);
+
+            /* ignore maximums from before the last reset */
+            if ((t->epoch == metrics_epoch) &&
+                (t->metric[m].max_ticks > snapshot->metric[m].max_ticks))
+                snapshot->metric[m].max_ticks = t->metric[m].max_ticks;
+        }
+    }
+    COUNTDOWN(m, DEEPLEARN_METRICS)
+        deeplearn_metrics_add(&snapshot->metric[m],
+                              &metrics_baseline.metric[m], -1);
+    pthread_mutex_unlock(&metrics_lock);
+
+    snapshot->ns_per_tick = metrics_ns_per_tick;
+}
+
+/**
+ * @brief Resets all counters. The counters of each thread are not
+ *        altered, instead the current totals are remembered and
+ *        subtracted from later snapshots
+ */
+void deeplearn_metrics_reset(void)
+{
+    deeplearn_metrics_thread * t;
+
+    pthread_mutex_lock(&metrics_lock);
+    memcpy(&metrics_baseline, &metrics_retired,
+           sizeof(deeplearn_metrics_snapshot));
+    for (t = metrics_threads; t != NULL; t = t->next) {
+        COUNTDOWN(m, DEEPLEARN_METRICS)
+            deeplearn_metrics_add(&metrics_baseline.metric[m],
+                                  &t->metric[m], 1);
+    }
+    COUNTDOWN(m, DEEPLEARN_METRICS)
+        metrics_retired.metric[m].max_ticks = 0;
+    metrics_epoch++;
+    pthread_mutex_unlock(&metrics_lock);
+}
+
+/**
+ * @brief Returns the average latency of an entry point
+ * @param snapshot Counters returned by deeplearn_metrics_get_snapshot
+ * @param metric The entry point
+ * @returns average latency in microseconds
+ */
+double deeplearn_metrics_mean_us(deeplearn_metrics_snapshot * snapshot,
+                                 int metric)
+{
+    deeplearn_metric * m = &snapshot->metric[metric];
+
+    if (m->calls == 0)
+        return 0;
+
+    return m->total_ticks * snapshot->ns_per_tick / (m->calls * 1000.0);
+}
+
+/**
+ * @brief Returns a latency percentile for an entry point
+ * @param snapshot Counters returned by deeplearn_metrics_get_snapshot
+ * @param metric The entry point
+ * @param percentile The percentile in the range 0 to 100
+ * @returns latency in microseconds
+ */
+double deeplearn_metrics_percentile_us(deeplearn_metrics_snapshot * snapshot,
+                                       int metric, double percentile)
+{
+    deeplearn_metric * m = &snapshot->metric[metric];
+    uint64_t count = 0, target;
+
+    if (m->calls == 0)
+        return 0;
+
+    target = (uint64_t)((percentile / 100.0) * m->calls);
+    if (target >= m->calls)
+        target = m->calls - 1;
+
+    COUNTUP(i, DEEPLEARN_METRICS_BUCKETS) {
+        count += m->histogram[i];
+        if (count > target) {
+            double ticks = deeplearn_metrics_bucket_ticks(i);
+
+            /* the middle of the bucket may be beyond the maximum */
+            if ((m->max_ticks > 0) && (ticks > m->max_ticks))
+                ticks = m->max_ticks;
+            return ticks * snapshot->ns_per_tick / 1000.0;
+        }
+    }
+    return m->max_ticks * snapshot->ns_per_tick / 1000.0;
+}
+
+/**
+ * @brief Returns the name of an entry point
+ * @param metric The entry point
+ * @returns name
+ */
+const char * deeplearn_metrics_name(int metric)
+{
+    if ((metric < 0) || (metric >= DEEPLEARN_METRICS))
+        return "unknown";
+
+    return metrics_names[metric];
+}
+
+/**
+ * @brief Writes the current counters as either text or JSON
+ * @param fp File to write to
+ * @param json Non-zero for JSON
+ * @returns zero on success
+ */
+int deeplearn_metrics_dump(FILE * fp, int json)
+{
+    deeplearn_metrics_snapshot * snapshot;
+
+    snapshot = (deeplearn_metrics_snapshot*)
+        malloc(sizeof(deeplearn_metrics_snapshot));
+    if (!snapshot)
+        return -1;
+
+    deeplearn_metrics_get_snapshot(snapshot);
+
+    if (json != 0)
+        fprintf(fp, "{\n");
+    else
+        fprintf(fp, "%-30s %10s %12s %10s %10s %10s %10s %10s\n",
+                "entry point", "calls", "samples", "mean us",
+                "p50 us", "p99 us", "p99.9 us", "max us");
+
+    COUNTUP(m, DEEPLEARN_METRICS) {
+        deeplearn_metric * metric = &snapshot->metric[m];
+        double max_us = metric->max_ticks * snapshot->ns_per_tick / 1000.0;
+
+        if (json != 0) {
+            fprintf(fp, "  \"%s\": {\"calls\": %llu, \"samples\": %llu, " \
+                    "\"mean_us\": %.3f, \"p50_us\": %.3f, " \
+                    "\"p90_us\": %.3f, \"p99_us\": %.3f, " \
+                    "\"p999_us\": %.3f, \"max_us\": %.3f}%s\n",
+                    metrics_names[m],
+                    (unsigned long long)metric->calls,
+                    (unsigned long long)metric->samples,
+                    deeplearn_metrics_mean_us(snapshot, m),
+                    deeplearn_metrics_percentile_us(snapshot, m, 50),
+                    deeplearn_metrics_percentile_us(snapshot, m, 90),
+                    deeplearn_metrics_percentile_us(snapshot, m, 99),
+                    deeplearn_metrics_percentile_us(snapshot, m, 99.9),
+                    max_us, (m < DEEPLEARN_METRICS-1) ? "," : "");
+            continue;
+        }
+
+        fprintf(fp, "%-30s %10llu %12llu %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+                metrics_names[m],
+                (unsigned long long)metric->calls,
+                (unsigned long long)metric->samples,
+                deeplearn_metrics_mean_us(snapshot, m),
+                deeplearn_metrics_percentile_us(snapshot, m, 50),
+                deeplearn_metrics_percentile_us(snapshot, m, 99),
+                deeplearn_metrics_percentile_us(snapshot, m, 99.9),
+                max_us);
+    }
+
+    if (json != 0)
+        fprintf(fp, "}\n");
+
+    free(snapshot);
+    return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_METRICS_H
+#define DEEPLEARN_METRICS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "globals.h"
+
+/* API entry points which are measured */
+enum {
+    DEEPLEARN_METRIC_FEED_FORWARD = 0,
+    DEEPLEARN_METRIC_FEED_FORWARD_BATCH,
+    DEEPLEARN_METRIC_UPDATE,
+    DEEPLEARN_METRIC_CONVNET_TEST,
+    DEEPLEARN_METRICS
+};
+
+/* Latencies are recorded within log-linear buckets. Each power of two
+   is divided into 2^DEEPLEARN_METRICS_SUB_BITS buckets, so that the
+   relative error of a percentile is at most 12.5% */
+#define DEEPLEARN_METRICS_SUB_BITS  3
+#define DEEPLEARN_METRICS_BUCKETS   (64 << DEEPLEARN_METRICS_SUB_BITS)
+
+typedef struct {
+    uint64_t calls;
+    uint64_t samples;
+    uint64_t total_ticks;
+    uint64_t max_ticks;
+    uint64_t histogram[DEEPLEARN_METRICS_BUCKETS];
+} deeplearn_metric;
+
+typedef struct {
+    deeplearn_metric metric[DEEPLEARN_METRICS];
+
+    /* conversion from ticks to nanoseconds */
+    double ns_per_tick;
+} deeplearn_metrics_snapshot;
+
+void deeplearn_metrics_enable(int enable);
+int deeplearn_metrics_enabled(void);
+uint64_t deeplearn_metrics_start(void);
+void deeplearn_metrics_stop(int metric, uint64_t start, int samples);
+void deeplearn_metrics_get_snapshot(deeplearn_metrics_snapshot * snapshot);
+void deeplearn_metrics_reset(void);
+double deeplearn_metrics_mean_us(deeplearn_metrics_snapshot * snapshot,
+                                 int metric);
+double deeplearn_metrics_percentile_us(deeplearn_metrics_snapshot * snapshot,
+                                       int metric, double percentile);
+const char * deeplearn_metrics_name(int metric);
+int deeplearn_metrics_dump(FILE * fp, int json);
+
+#endif
@@ -0,0 +1,483 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* needed for syscall and clock_gettime */
+#define _GNU_SOURCE
+
+#include <time.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#endif
+#include "deeplearn_perf.h"
+#include "deeplearn_executor.h"
+
+/* counters opened for a single thread */
+typedef struct {
+    int leader;
+    int fd[DEEPLEARN_PERF_COUNTERS];
+
+    /* position of each counter within a group read, or -1 */
+    int index[DEEPLEARN_PERF_COUNTERS];
+    int no_of_counters;
+} deeplearn_perf_group;
+
+/* counter values at the beginning of each phase on a thread */
+typedef struct {
+    uint64_t ns[DEEPLEARN_PERF_PHASES];
+    uint64_t counter[DEEPLEARN_PERF_PHASES][DEEPLEARN_PERF_COUNTERS];
+    int registered;
+} deeplearn_perf_thread;
+
+static volatile int perf_enabled = 0;
+static int perf_available[DEEPLEARN_PERF_COUNTERS];
+static double perf_peak_gflops = 0;
+static double perf_peak_bandwidth = 0;
+
+static pthread_mutex_t perf_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t perf_once = PTHREAD_ONCE_INIT;
+static pthread_key_t perf_key;
+
+static deeplearn_perf_group perf_group[DEEPLEARN_PERF_MAX_THREADS];
+static int perf_groups = 0;
+static deeplearn_perf_phase perf_phase[DEEPLEARN_PERF_PHASES];
+
+static const char * perf_phase_names[] = {
+    "bp_update",
+    "autocoder_update",
+    "convolve_image",
+    "learn_features"
+};
+
+/**
+ * @brief Returns the monotonic clock time in nanoseconds
+ * @returns nanoseconds
+ */
+static uint64_t deeplearn_perf_ns(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((uint64_t)t.tv_sec*1000000000ULL) + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * @brief Creates the key used to find the phase start values of a thread
+ */
+static void deeplearn_perf_create_key(void)
+{
+    pthread_key_create(&perf_key, free);
+}
+
+/**
+ * @brief Opens a group of hardware counters for the calling thread.
+ *        Counters which are not permitted or not supported are skipped
+ * @returns zero on success
+ */
+static int deeplearn_perf_open_group(void)
+{
+#ifdef __linux__
+    static const uint64_t config[DEEPLEARN_PERF_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_REFERENCES,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+    deeplearn_perf_group group;
+    struct perf_event_attr attr;
+
+    group.leader = -1;
+    group.no_of_counters = 0;
+
+    COUNTUP(c, DEEPLEARN_PERF_COUNTERS) {
+        group.fd[c] = -1;
+        group.index[c] = -1;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config[c];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP |
+            PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled = (group.leader == -1);
+
+        group.fd[c] = (int)syscall(__NR_perf_event_open, &attr, 0, -1,
+                                   group.leader, 0);
+        if (group.fd[c] < 0) {
+            group.fd[c] = -1;
+            continue;
+        }
+
+        if (group.leader == -1)
+            group.leader = group.fd[c];
+        group.index[c] = group.no_of_counters++;
+    }
+
+    if (group.leader == -1)
+        return -1;
+
+    ioctl(group.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(group.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    pthread_mutex_lock(&perf_lock);
+    if (perf_groups >= DEEPLEARN_PERF_MAX_THREADS) {
+        pthread_mutex_unlock(&perf_lock);
+        COUNTUP(c, DEEPLEARN_PERF_COUNTERS)
+            if (group.fd[c] != -1) close(group.fd[c]);
+        return -2;
+    }
+    COUNTUP(c, DEEPLEARN_PERF_COUNTERS) {
+        if (group.fd[c] != -1)
+            perf_available[c] = 1;
+    }
+    perf_group[perf_groups++] = group;
+    pthread_mutex_unlock(&perf_lock);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * @brief Returns the start values for the calling thread, opening its
+ *        counters if this is the first time it has been seen
+ * @returns start values, or NULL on failure
+ */
+static deeplearn_perf_thread * deeplearn_perf_thread_get(void)
+{
+    deeplearn_perf_thread * t;
+
+    pthread_once(&perf_once, deeplearn_perf_create_key);
+    t = (deeplearn_perf_thread*)pthread_getspecific(perf_key);
+    if (t)
+        return t;
+
+    t = (deeplearn_perf_thread*)calloc(1, sizeof(deeplearn_perf_thread));
+    if (!t)
+        return NULL;
+    pthread_setspecific(perf_key, t);
+    return t;
+}
+
+/**
+ * @brief Reads and sums the counters of all threads. Counter values are
+ *        scaled if the kernel had to multiplex them
+ * @param values Returned counter values
+ */
+static void deeplearn_perf_read(uint64_t values[])
+{
+    memset(values, 0, DEEPLEARN_PERF_COUNTERS*sizeof(uint64_t));
+
+#ifdef __linux__
+    uint64_t data[3 + DEEPLEARN_PERF_COUNTERS];
+
+    pthread_mutex_lock(&perf_lock);
+    COUNTUP(g, perf_groups) {
+        deeplearn_perf_group * group = &perf_group[g];
+        double scale = 1.0;
+
+        if (read(group->leader, data, sizeof(data)) <= 0)
+            continue;
+
+        /* data[0] is the number of counters, followed by the
+           time enabled and time running */
+        if ((data[2] > 0) && (data[2] < data[1]))
+            scale = data[1] / (double)data[2];
+
+        COUNTUP(c, DEEPLEARN_PERF_COUNTERS) {
+            if (group->index[c] >= 0)
+                values[c] += (uint64_t)(data[3 + group->index[c]]*scale);
+        }
+    }
+    pthread_mutex_unlock(&perf_lock);
+#endif
+}
+
+/**
+ * @brief Opens counters for the calling thread if they are not
+ *        already open
+ */
+static void deeplearn_perf_register(void)
+{
+    deeplearn_perf_thread * t = deeplearn_perf_thread_get();
+
+    if ((t) && (t->registered == 0)) {
+        t->registered = 1;
+        deeplearn_perf_open_group();
+    }
+}
+
+/**
+ * @brief Opens counters for the calling thread while measurement is
+ *        enabled. This is called by threads which are not part of the
+ *        OpenMP team, such as those of a thread pool executor, before
+ *        they run a parallel loop
+ */
+void deeplearn_perf_register_thread(void)
+{
+    if (perf_enabled == 0)
+        return;
+
+    deeplearn_perf_register();
+}
+
+/**
+ * @brief Opens counters for the thread which runs a part of a loop
+ * @param start Not used
+ * @param end Not used
+ * @param context Not used
+ */
+static void deeplearn_perf_register_rows(int start, int end, void * context)
+{
+    deeplearn_perf_register();
+}
+
+/**
+ * @brief Enables measurement of phases. Counters are opened for the
+ *        calling thread and for the threads of the current executor,
+ *        since the work within a phase is mostly done by those threads.
+ *        Threads which only join later, such as those of a thread pool
+ *        executor set afterwards, open their counters when they next
+ *        run a loop.
+ *        If hardware counters are not permitted then only time and
+ *        estimated floating point operations are recorded
+ * @returns the number of hardware counters which are available
+ */
+int deeplearn_perf_enable(void)
+{
+    int available = 0;
+
+    if (perf_enabled == 0) {
+        deeplearn_perf_register();
+        deeplearn_parallel_for_tasks(DEEPLEARN_THREADS, DEEPLEARN_THREADS,
+                                     deeplearn_perf_register_rows, NULL);
+        perf_enabled = 1;
+    }
+
+    COUNTUP(c, DEEPLEARN_PERF_COUNTERS)
+        available += perf_available[c];
+    return available;
+}
+
+/**
+ * @brief Disables measurement. Counters remain open so that measurement
+ *        can be enabled again
+ */
+void deeplearn_perf_disable(void)
+{
+    perf_enabled = 0;
+}
+
+/**
+ * @brief Returns non-zero if the given hardware counter could be opened
+ * @param counter The counter
+ * @returns non-zero if available
+ */
+int deeplearn_perf_counter_available(int counter)
+{
+    if ((counter < 0) || (counter >= DEEPLEARN_PERF_COUNTERS))
+        return 0;
+
+    return perf_available[counter];
+}
+
+/**
+ * @brief Marks the beginning of a phase
+ * @param phase The phase. Unknown phases are ignored
+ */
+void deeplearn_perf_begin(int phase)
+{
+    deeplearn_perf_thread * t;
+
+    if ((perf_enabled == 0) ||
+        (phase < 0) || (phase >= DEEPLEARN_PERF_PHASES))
+        return;
+
+    t = deeplearn_perf_thread_get();
+    if (!t)
+        return;
+
+    deeplearn_perf_read(t->counter[phase]);
+    t->ns[phase] = deeplearn_perf_ns();
+}
+
+/**
+ * @brief Marks the end of a phase. Counts are attributed correctly
+ *        provided that phases are not run concurrently from several threads
+ * @param phase The phase. Unknown phases are ignored
+ * @param flops Estimated number of floating point operations
+ */
+void deeplearn_perf_end(int phase, uint64_t flops)
+{
+    deeplearn_perf_thread * t;
+    uint64_t values[DEEPLEARN_PERF_COUNTERS];
+    uint64_t ns;
+
+    if ((perf_enabled == 0) ||
+        (phase < 0) || (phase >= DEEPLEARN_PERF_PHASES))
+        return;
+
+    t = deeplearn_perf_thread_get();
+    if ((!t) || (t->ns[phase] == 0))
+        return;
+
+    ns = deeplearn_perf_ns();
+    deeplearn_perf_read(values);
+
+    pthread_mutex_lock(&perf_lock);
+    perf_phase[phase].calls++;
+    perf_phase[phase].ns += ns - t->ns[phase];
+    perf_phase[phase].flops += flops;
+    COUNTUP(c, DEEPLEARN_PERF_COUNTERS) {
+        if (values[c] > t->counter[phase][c])
+            perf_phase[phase].counter[c] += values[c] - t->counter[phase][c];
+    }
+    pthread_mutex_unlock(&perf_lock);
+
+    t->ns[phase] = 0;
+}
+
+/**
+ * @brief Returns the totals for a phase
+ * @param phase The phase
+ * @param result Returned totals, which are zero for an unknown phase
+ */
+void deeplearn_perf_get_phase(int phase, deeplearn_perf_phase * result)
+{
+    if ((phase < 0) || (phase >= DEEPLEARN_PERF_PHASES)) {
+        memset(result, 0, sizeof(deeplearn_perf_phase));
+        return;
+    }
+
+    pthread_mutex_lock(&perf_lock);
+    memcpy(result, &perf_phase[phase], sizeof(deeplearn_perf_phase));
+    pthread_mutex_unlock(&perf_lock);
+}
+
+/**
+ * @brief Resets the totals for all phases
+ */
+void deeplearn_perf_reset(void)
+{
+    pthread_mutex_lock(&perf_lock);
+    memset(perf_phase, 0, sizeof(perf_phase));
+    pthread_mutex_unlock(&perf_lock);
+}
+
+/**
+ * @brief Sets the peak capabilities of the machine, which are used to
+ *        place each phase on a roofline model
+ * @param peak_gflops Peak floating point operations per second, in billions
+ * @param peak_bandwidth_gbytes Peak memory bandwidth in GB/sec
+ */
+void deeplearn_perf_set_roofline(double peak_gflops,
+                                 double peak_bandwidth_gbytes)
+{
+    perf_peak_gflops = peak_gflops;
+    perf_peak_bandwidth = peak_bandwidth_gbytes;
+}
+
+/**
+ * @brief Writes the totals and derived metrics for each phase.
+ *        Memory traffic is estimated from the number of cache misses
+ * @param fp File to write to
+ * @returns zero on success
+ */
+int deeplearn_perf_report(FILE * fp)
+{
+    deeplearn_perf_phase phase;
+
+    if (perf_available[DEEPLEARN_PERF_CYCLES] == 0)
+        fprintf(fp, "Hardware counters are not available, " \
+                "only times and estimated FLOPs are shown\n");
+
+    COUNTUP(p, DEEPLEARN_PERF_PHASES) {
+        double gflops, bytes, intensity;
+        uint64_t * c = phase.counter;
+
+        deeplearn_perf_get_phase(p, &phase);
+        if (phase.calls == 0)
+            continue;
+
+        gflops = (phase.ns > 0) ? phase.flops / (double)phase.ns : 0;
+        fprintf(fp, "%s: calls %llu  time %.3f ms  FLOPs %llu  GFLOP/s %.3f\n",
+                perf_phase_names[p],
+                (unsigned long long)phase.calls, phase.ns/1000000.0,
+                (unsigned long long)phase.flops, gflops);
+
+        if (perf_available[DEEPLEARN_PERF_CYCLES] &&
+            perf_available[DEEPLEARN_PERF_INSTRUCTIONS] &&
+            (c[DEEPLEARN_PERF_CYCLES] > 0))
+            fprintf(fp, "  IPC %.3f\n",
+                    c[DEEPLEARN_PERF_INSTRUCTIONS] /
+                    (double)c[DEEPLEARN_PERF_CYCLES]);
+
+        if (perf_available[DEEPLEARN_PERF_CACHE_MISSES] &&
+            (c[DEEPLEARN_PERF_CACHE_REFERENCES] > 0))
+            fprintf(fp, "  cache misses %llu (%.2f%%)\n",
+                    (unsigned long long)c[DEEPLEARN_PERF_CACHE_MISSES],
+                    c[DEEPLEARN_PERF_CACHE_MISSES]*100.0/
+                    c[DEEPLEARN_PERF_CACHE_REFERENCES]);
+
+        if (perf_available[DEEPLEARN_PERF_BRANCH_MISSES] &&
+            (c[DEEPLEARN_PERF_BRANCHES] > 0))
+            fprintf(fp, "  branch misses %llu (%.2f%%)\n",
+                    (unsigned long long)c[DEEPLEARN_PERF_BRANCH_MISSES],
+                    c[DEEPLEARN_PERF_BRANCH_MISSES]*100.0/
+                    c[DEEPLEARN_PERF_BRANCHES]);
+
+        if ((perf_available[DEEPLEARN_PERF_CACHE_MISSES] == 0) ||
+            (phase.flops == 0) || (c[DEEPLEARN_PERF_CACHE_MISSES] == 0))
+            continue;
+
+        bytes = c[DEEPLEARN_PERF_CACHE_MISSES] * (double)DEEPLEARN_PERF_CACHE_LINE;
+        intensity = phase.flops / bytes;
+        fprintf(fp, "  bytes/FLOP %.4f  arithmetic intensity %.3f FLOP/byte\n",
+                bytes / phase.flops, intensity);
+
+        if ((perf_peak_gflops > 0) && (perf_peak_bandwidth > 0)) {
+            double ridge = perf_peak_gflops / perf_peak_bandwidth;
+            double attainable = intensity * perf_peak_bandwidth;
+
+            if (attainable > perf_peak_gflops)
+                attainable = perf_peak_gflops;
+            fprintf(fp, "  roofline: %s bound, %.1f%% of attainable " \
+                    "%.3f GFLOP/s\n",
+                    (intensity < ridge) ? "memory" : "compute",
+                    gflops*100.0/attainable, attainable);
+        }
+    }
+    return 0;
+}
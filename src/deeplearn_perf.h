@@ -0,0 +1,88 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_PERF_H
+#define DEEPLEARN_PERF_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "globals.h"
+
+/* phases to which hardware counts are attributed */
+enum {
+    DEEPLEARN_PERF_BP_UPDATE = 0,
+    DEEPLEARN_PERF_AUTOCODER_UPDATE,
+    DEEPLEARN_PERF_CONVOLVE_IMAGE,
+    DEEPLEARN_PERF_LEARN_FEATURES,
+    DEEPLEARN_PERF_PHASES
+};
+
+/* hardware counters */
+enum {
+    DEEPLEARN_PERF_CYCLES = 0,
+    DEEPLEARN_PERF_INSTRUCTIONS,
+    DEEPLEARN_PERF_CACHE_REFERENCES,
+    DEEPLEARN_PERF_CACHE_MISSES,
+    DEEPLEARN_PERF_BRANCHES,
+    DEEPLEARN_PERF_BRANCH_MISSES,
+    DEEPLEARN_PERF_COUNTERS
+};
+
+/* maximum number of threads whose counters can be opened */
+#define DEEPLEARN_PERF_MAX_THREADS  256
+
+/* bytes transferred from memory for each cache miss */
+#define DEEPLEARN_PERF_CACHE_LINE   64
+
+typedef struct {
+    uint64_t calls;
+    uint64_t ns;
+
+    /* estimated number of floating point operations */
+    uint64_t flops;
+
+    uint64_t counter[DEEPLEARN_PERF_COUNTERS];
+} deeplearn_perf_phase;
+
+int deeplearn_perf_enable(void);
+void deeplearn_perf_register_thread(void);
+void deeplearn_perf_disable(void);
+int deeplearn_perf_counter_available(int counter);
+void deeplearn_perf_begin(int phase);
+void deeplearn_perf_end(int phase, uint64_t flops);
+void deeplearn_perf_get_phase(int phase, deeplearn_perf_phase * result);
+void deeplearn_perf_reset(void);
+void deeplearn_perf_set_roofline(double peak_gflops,
+                                 double peak_bandwidth_gbytes);
+int deeplearn_perf_report(FILE * fp);
+
+#endif
@@ -0,0 +1,246 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_sampler.h"
+
+/**
+ * @brief Sets the priority of a sample and updates the sums and minimums
+ *        of the nodes above it
+ * @param sampler Prioritised sampler
+ * @param index Index of the sample
+ * @param priority New priority
+ */
+static void deeplearn_sampler_set(deeplearn_sampler * sampler,
+                                  int index, float priority)
+{
+    int node = sampler->leaves + index;
+
+    sampler->sum_tree[node] = priority;
+    sampler->min_tree[node] = priority;
+    if (sampler->weight != 0)
+        sampler->sum_tree[node] *= sampler->weight[index];
+
+    for (node >>= 1; node > 0; node >>= 1) {
+        float * sum = &sampler->sum_tree[node*2];
+        float * min = &sampler->min_tree[node*2];
+
+        sampler->sum_tree[node] = sum[0] + sum[1];
+        sampler->min_tree[node] = (min[0] < min[1] ? min[0] : min[1]);
+    }
+}
+
+/**
+ * @brief Creates a sampler which draws samples in proportion to their
+ *        loss, so that training concentrates on the examples which are
+ *        handled least well. Sampling and updates take O(log n) time
+ * @param sampler Prioritised sampler
+ * @param no_of_samples The number of samples to choose from
+ * @param alpha Priority exponent. Zero gives uniform sampling
+ * @param beta Importance weight exponent in the range 0.0 to 1.0
+ * @returns zero on success
+ */
+int deeplearn_sampler_init(deeplearn_sampler * sampler, int no_of_samples,
+                           float alpha, float beta)
+{
+    if (no_of_samples < 1)
+        return -1;
+
+    sampler->no_of_samples = no_of_samples;
+    sampler->alpha = alpha;
+    sampler->beta = beta;
+    sampler->max_priority = 1.0f;
+    sampler->weight = 0;
+
+    sampler->leaves = 1;
+    while (sampler->leaves < no_of_samples)
+        sampler->leaves <<= 1;
+
+    FLOATALLOC(sampler->sum_tree, sampler->leaves*2);
+    if (!sampler->sum_tree)
+        return -2;
+
+    FLOATALLOC(sampler->min_tree, sampler->leaves*2);
+    if (!sampler->min_tree) {
+        free(sampler->sum_tree);
+        sampler->sum_tree = 0;
+        return -3;
+    }
+
+    /* unused leaves are never drawn, and don't alter the minimum */
+    COUNTDOWN(i, sampler->leaves*2) {
+        sampler->sum_tree[i] = 0;
+        sampler->min_tree[i] = FLT_MAX;
+    }
+
+    /* every sample is seen at least once before its loss is known */
+    COUNTDOWN(i, no_of_samples) {
+        sampler->sum_tree[sampler->leaves + i] = sampler->max_priority;
+        sampler->min_tree[sampler->leaves + i] = sampler->max_priority;
+    }
+
+    for (int node = sampler->leaves-1; node > 0; node--) {
+        float * min = &sampler->min_tree[node*2];
+
+        sampler->sum_tree[node] =
+            sampler->sum_tree[node*2] + sampler->sum_tree[node*2+1];
+        sampler->min_tree[node] = (min[0] < min[1] ? min[0] : min[1]);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Frees memory for a prioritised sampler
+ * @param sampler Prioritised sampler
+ */
+void deeplearn_sampler_free(deeplearn_sampler * sampler)
+{
+    free(sampler->sum_tree);
+    free(sampler->min_tree);
+    free(sampler->weight);
+    sampler->sum_tree = 0;
+    sampler->min_tree = 0;
+    sampler->weight = 0;
+}
+
+/**
+ * @brief Draws a sample with probability in proportion to its priority
+ * @param sampler Prioritised sampler
+ * @param random_seed Random number generator seed
+ * @returns index of the sample
+ */
+int deeplearn_sampler_sample(deeplearn_sampler * sampler,
+                             unsigned int * random_seed)
+{
+    float r = (rand_num(random_seed)%1000000/1000000.0f)*
+        sampler->sum_tree[1];
+    int node = 1;
+
+    /* descend the tree towards the leaf containing r */
+    while (node < sampler->leaves) {
+        node *= 2;
+        if (r >= sampler->sum_tree[node]) {
+            r -= sampler->sum_tree[node];
+            node++;
+        }
+    }
+
+    /* rounding can leave r just beyond the last sample */
+    if (node - sampler->leaves >= sampler->no_of_samples)
+        return sampler->no_of_samples-1;
+
+    return node - sampler->leaves;
+}
+
+/**
+ * @brief Updates the priority of a sample after it has been trained on
+ * @param sampler Prioritised sampler
+ * @param index Index of the sample
+ * @param loss Training error for the sample
+ * @returns zero on success
+ */
+int deeplearn_sampler_update(deeplearn_sampler * sampler,
+                             int index, float loss)
+{
+    float priority;
+
+    if ((index < 0) || (index >= sampler->no_of_samples))
+        return -1;
+
+    priority = (float)pow(fabs(loss) + DEEPLEARN_SAMPLER_EPSILON,
+                          sampler->alpha);
+    if (priority > sampler->max_priority)
+        sampler->max_priority = priority;
+
+    deeplearn_sampler_set(sampler, index, priority);
+    return 0;
+}
+
+/**
+ * @brief Sets the weight of a sample, such as the number of identical
+ *        rows which it represents. Samples are drawn in proportion to
+ *        their weight multiplied by their priority
+ * @param sampler Prioritised sampler
+ * @param index Index of the sample
+ * @param weight Sample weight, greater than zero
+ * @returns zero on success
+ */
+int deeplearn_sampler_set_weight(deeplearn_sampler * sampler,
+                                 int index, float weight)
+{
+    if ((index < 0) || (index >= sampler->no_of_samples) || !(weight > 0))
+        return -1;
+
+    if (sampler->weight == 0) {
+        if (weight == 1.0f)
+            return 0;
+
+        FLOATALLOC(sampler->weight, sampler->no_of_samples);
+        if (!sampler->weight)
+            return -2;
+
+        COUNTDOWN(i, sampler->no_of_samples)
+            sampler->weight[i] = 1.0f;
+    }
+
+    sampler->weight[index] = weight;
+    deeplearn_sampler_set(sampler, index,
+                          sampler->min_tree[sampler->leaves + index]);
+    return 0;
+}
+
+/**
+ * @brief Returns the importance weight of a sample, which corrects for
+ *        it being drawn more or less often than with uniform sampling
+ *        in proportion to the sample weights.
+ *        Weights are scaled so that the largest is one
+ * @param sampler Prioritised sampler
+ * @param index Index of the sample
+ * @returns importance weight in the range 0.0 to 1.0
+ */
+float deeplearn_sampler_weight(deeplearn_sampler * sampler, int index)
+{
+    float min = sampler->min_tree[1];
+    float priority = sampler->min_tree[sampler->leaves + index];
+
+    /* (n P(i) / w(i))^-beta divided by the maximum weight, that of
+       the sample with the lowest priority */
+    return (float)pow(min / priority, sampler->beta);
+}
+
+/**
+ * @brief Returns the current priority of a sample
+ * @param sampler Prioritised sampler
+ * @param index Index of the sample
+ * @returns priority
+ */
+float deeplearn_sampler_priority(deeplearn_sampler * sampler, int index)
+{
+    return sampler->min_tree[sampler->leaves + index];
+}
@@ -0,0 +1,87 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_SAMPLER_H
+#define DEEPLEARN_SAMPLER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include "globals.h"
+#include "deeplearn_random.h"
+
+/* default exponents for prioritised sampling */
+#define DEEPLEARN_SAMPLER_ALPHA    0.6f
+#define DEEPLEARN_SAMPLER_BETA     0.4f
+
+/* added to each loss so that no sample has zero priority */
+#define DEEPLEARN_SAMPLER_EPSILON  0.01f
+
+typedef struct {
+    int no_of_samples;
+
+    /* number of leaves, which is a power of two */
+    int leaves;
+
+    /* binary trees stored as arrays with the root at index 1 and the
+       priority of sample i at index leaves+i. Each node of the sum tree
+       is the sum of its children, and of the min tree the minimum.
+       The sum tree holds priorities multiplied by the sample weights,
+       and the min tree the priorities alone */
+    float * sum_tree;
+    float * min_tree;
+
+    /* weight of each sample, or zero if all samples have a weight of one */
+    float * weight;
+
+    /* priority exponent. Zero gives uniform sampling */
+    float alpha;
+
+    /* importance weight exponent. One fully corrects for the bias
+       introduced by prioritised sampling */
+    float beta;
+
+    /* priority given to samples which have not yet been seen */
+    float max_priority;
+} deeplearn_sampler;
+
+int deeplearn_sampler_init(deeplearn_sampler * sampler, int no_of_samples,
+                           float alpha, float beta);
+void deeplearn_sampler_free(deeplearn_sampler * sampler);
+int deeplearn_sampler_sample(deeplearn_sampler * sampler,
+                             unsigned int * random_seed);
+int deeplearn_sampler_update(deeplearn_sampler * sampler,
+                             int index, float loss);
+int deeplearn_sampler_set_weight(deeplearn_sampler * sampler,
+                                 int index, float weight);
+float deeplearn_sampler_weight(deeplearn_sampler * sampler, int index);
+float deeplearn_sampler_priority(deeplearn_sampler * sampler, int index);
+
+#endif
@@ -0,0 +1,287 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* needed for clock_gettime */
+#define _POSIX_C_SOURCE 200112L
+
+#include <time.h>
+#include "deeplearn_trace.h"
+
+/* the buffer belonging to each thread for the current trace */
+typedef struct {
+    unsigned int session;
+    deeplearn_trace_thread * thread;
+} deeplearn_trace_handle;
+
+static volatile int trace_enabled = 0;
+static unsigned int trace_session = 0;
+static uint64_t trace_start_ns = 0;
+static char * trace_filename = NULL;
+static int trace_threads = 0;
+
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static deeplearn_trace_thread * trace_thread_list = NULL;
+
+/**
+ * @brief Returns the monotonic clock time in nanoseconds
+ * @returns nanoseconds
+ */
+static uint64_t deeplearn_trace_ns(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((uint64_t)t.tv_sec*1000000000ULL) + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * @brief Creates the key used to find the buffer for each thread.
+ *        The handle is freed when the thread exits, but its events
+ *        are kept until the trace is written
+ */
+static void deeplearn_trace_create_key(void)
+{
+    pthread_key_create(&trace_key, free);
+}
+
+/**
+ * @brief Returns the buffer of the calling thread for the current trace,
+ *        creating it if necessary
+ * @returns thread buffer, or NULL on failure
+ */
+static deeplearn_trace_thread * deeplearn_trace_thread_get(void)
+{
+    deeplearn_trace_handle * handle;
+    deeplearn_trace_thread * t;
+
+    pthread_once(&trace_once, deeplearn_trace_create_key);
+    handle = (deeplearn_trace_handle*)pthread_getspecific(trace_key);
+    if (!handle) {
+        handle = (deeplearn_trace_handle*)
+            calloc(1, sizeof(deeplearn_trace_handle));
+        if (!handle)
+            return NULL;
+        pthread_setspecific(trace_key, handle);
+    }
+
+    if ((handle->thread != NULL) && (handle->session == trace_session))
+        return handle->thread;
+
+    t = (deeplearn_trace_thread*)calloc(1, sizeof(deeplearn_trace_thread));
+    if (!t)
+        return NULL;
+
+    pthread_mutex_lock(&trace_lock);
+    t->tid = ++trace_threads;
+    t->next = trace_thread_list;
+    trace_thread_list = t;
+    pthread_mutex_unlock(&trace_lock);
+
+    handle->session = trace_session;
+    handle->thread = t;
+    return t;
+}
+
+/**
+ * @brief Appends an event to the buffer of the calling thread
+ * @param name Name of the event
+ * @param phase 'B' for begin or 'E' for end
+ * @param layer Layer index, or -1
+ */
+static void deeplearn_trace_add(const char * name, char phase, int layer)
+{
+    deeplearn_trace_thread * t;
+    deeplearn_trace_event * e;
+    uint64_t ns = deeplearn_trace_ns();
+
+    t = deeplearn_trace_thread_get();
+    if (!t)
+        return;
+
+    if ((!t->last) || (t->last->used == DEEPLEARN_TRACE_CHUNK_EVENTS)) {
+        deeplearn_trace_chunk * chunk =
+            (deeplearn_trace_chunk*)malloc(sizeof(deeplearn_trace_chunk));
+        if (!chunk)
+            return;
+        chunk->used = 0;
+        chunk->next = NULL;
+        if (t->last)
+            t->last->next = chunk;
+        else
+            t->first = chunk;
+        t->last = chunk;
+    }
+
+    e = &t->last->event[t->last->used++];
+    e->name = name;
+    e->ns = ns;
+    e->layer = layer;
+    e->phase = phase;
+}
+
+/**
+ * @brief Begins recording a trace which will be written as trace event
+ *        JSON, viewable within chrome://tracing or Perfetto
+ * @param filename File to write the trace to when it is stopped
+ * @returns zero on success
+ */
+int deeplearn_trace_start(char * filename)
+{
+    if (trace_enabled != 0)
+        return -1;
+
+    CHARALLOC(trace_filename, strlen(filename)+1);
+    if (!trace_filename)
+        return -2;
+    strcpy(trace_filename, filename);
+
+    pthread_mutex_lock(&trace_lock);
+    trace_session++;
+    trace_threads = 0;
+    trace_thread_list = NULL;
+    trace_start_ns = deeplearn_trace_ns();
+    pthread_mutex_unlock(&trace_lock);
+
+    trace_enabled = 1;
+    return 0;
+}
+
+/**
+ * @brief Stops recording and writes the trace. This should be called
+ *        once the work being traced has finished
+ * @returns zero on success
+ */
+int deeplearn_trace_stop(void)
+{
+    deeplearn_trace_thread * t, * next_thread;
+    deeplearn_trace_chunk * chunk, * next_chunk;
+    FILE * fp;
+    int first = 1, retval = 0;
+
+    if (trace_enabled == 0)
+        return -1;
+
+    trace_enabled = 0;
+
+    pthread_mutex_lock(&trace_lock);
+
+    fp = fopen(trace_filename, "w");
+    if (fp) {
+        fprintf(fp, "{\"traceEvents\":[\n");
+        for (t = trace_thread_list; t != NULL; t = t->next) {
+            fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\"," \
+                    "\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                    first ? "" : ",\n", t->tid, t->tid);
+            first = 0;
+
+            for (chunk = t->first; chunk != NULL; chunk = chunk->next) {
+                COUNTUP(i, chunk->used) {
+                    deeplearn_trace_event * e = &chunk->event[i];
+
+                    fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"%c\"," \
+                            "\"ts\":%.3f,\"pid\":1,\"tid\":%d",
+                            e->name, e->phase,
+                            (e->ns - trace_start_ns)/1000.0, t->tid);
+                    if (e->layer >= 0)
+                        fprintf(fp, ",\"args\":{\"layer\":%d}", e->layer);
+                    fprintf(fp, "}");
+                }
+            }
+        }
+        fprintf(fp, "\n],\n\"displayTimeUnit\":\"ms\"}\n");
+        fclose(fp);
+    }
+    else
+        retval = -2;
+
+    /* release the buffers */
+    for (t = trace_thread_list; t != NULL; t = next_thread) {
+        next_thread = t->next;
+        for (chunk = t->first; chunk != NULL; chunk = next_chunk) {
+            next_chunk = chunk->next;
+            free(chunk);
+        }
+        free(t);
+    }
+    trace_thread_list = NULL;
+
+    pthread_mutex_unlock(&trace_lock);
+
+    free(trace_filename);
+    trace_filename = NULL;
+    return retval;
+}
+
+/**
+ * @brief Returns non-zero if a trace is being recorded
+ * @returns non-zero if tracing
+ */
+int deeplearn_trace_enabled(void)
+{
+    return trace_enabled;
+}
+
+/**
+ * @brief Records the beginning of an event
+ * @param name Name of the event, which must be a string constant
+ */
+void deeplearn_trace_begin(const char * name)
+{
+    if (trace_enabled == 0)
+        return;
+
+    deeplearn_trace_add(name, 'B', -1);
+}
+
+/**
+ * @brief Records the beginning of an event for a layer
+ * @param name Name of the event, which must be a string constant
+ * @param layer Index of the layer
+ */
+void deeplearn_trace_begin_layer(const char * name, int layer)
+{
+    if (trace_enabled == 0)
+        return;
+
+    deeplearn_trace_add(name, 'B', layer);
+}
+
+/**
+ * @brief Records the end of an event
+ * @param name Name of the event, which must be a string constant
+ */
+void deeplearn_trace_end(const char * name)
+{
+    if (trace_enabled == 0)
+        return;
+
+    deeplearn_trace_add(name, 'E', -1);
+}
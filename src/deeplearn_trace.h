@@ -0,0 +1,75 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_TRACE_H
+#define DEEPLEARN_TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "globals.h"
+
+/* number of events within each block of a thread's buffer */
+#define DEEPLEARN_TRACE_CHUNK_EVENTS 4096
+
+typedef struct {
+    /* names must be string constants, since only the pointer is kept */
+    const char * name;
+    uint64_t ns;
+    int layer;
+    char phase;
+} deeplearn_trace_event;
+
+struct deeplearn_trace_chunk {
+    deeplearn_trace_event event[DEEPLEARN_TRACE_CHUNK_EVENTS];
+    int used;
+    struct deeplearn_trace_chunk * next;
+};
+typedef struct deeplearn_trace_chunk deeplearn_trace_chunk;
+
+/* events recorded by a single thread. Only that thread appends to
+   the buffer, so no locking is needed */
+struct deeplearn_trace_thread {
+    int tid;
+    deeplearn_trace_chunk * first;
+    deeplearn_trace_chunk * last;
+    struct deeplearn_trace_thread * next;
+};
+typedef struct deeplearn_trace_thread deeplearn_trace_thread;
+
+int deeplearn_trace_start(char * filename);
+int deeplearn_trace_stop(void);
+int deeplearn_trace_enabled(void);
+void deeplearn_trace_begin(const char * name);
+void deeplearn_trace_begin_layer(const char * name, int layer);
+void deeplearn_trace_end(const char * name);
+
+#endif
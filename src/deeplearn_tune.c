@@ -0,0 +1,481 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* needed for clock_gettime */
+#define _GNU_SOURCE
+
+#include <time.h>
+#include "deeplearn_tune.h"
+
+static volatile int tune_enabled = 0;
+static char tune_filename[256];
+static pthread_mutex_t tune_lock = PTHREAD_MUTEX_INITIALIZER;
+static deeplearn_tune_entry tune_entry[DEEPLEARN_TUNE_MAX_ENTRIES];
+static int tune_entries = 0;
+
+static const char * tune_kernel_names[] = {
+    "convolve_image",
+    "feed_forward",
+    "backprop",
+    "learn_features"
+};
+
+/**
+ * @brief Returns the monotonic clock time in seconds
+ * @returns seconds
+ */
+static double deeplearn_tune_seconds(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + ((double)t.tv_nsec / 1000000000.0);
+}
+
+/**
+ * @brief Returns the name of the cpu, which decisions are stored against
+ *        since the fastest choice depends upon the cache sizes and
+ *        number of cores
+ * @param model Returned cpu model name
+ * @param max_length Size of the model array
+ */
+void deeplearn_tune_cpu_model(char * model, int max_length)
+{
+    FILE * fp;
+    char line[DEEPLEARN_TUNE_MAX_CPU];
+
+    strncpy(model, "unknown", max_length - 1);
+    model[max_length - 1] = 0;
+
+    fp = fopen("/proc/cpuinfo", "r");
+    if (!fp)
+        return;
+
+    while (fgets(line, DEEPLEARN_TUNE_MAX_CPU, fp)) {
+        char * value;
+
+        if (strncmp(line, "model name", 10) != 0)
+            continue;
+
+        value = strchr(line, ':');
+        if (!value)
+            continue;
+
+        value++;
+        while (*value == ' ')
+            value++;
+
+        value[strcspn(value, "\r\n")] = 0;
+        if (value[0] == 0)
+            continue;
+
+        strncpy(model, value, max_length - 1);
+        model[max_length - 1] = 0;
+        break;
+    }
+    fclose(fp);
+}
+
+/**
+ * @brief Returns the choices which are timed for a kernel
+ * @param kernel The kernel, eg. DEEPLEARN_TUNE_CONVOLVE
+ * @param candidate Returned array of DEEPLEARN_TUNE_MAX_CANDIDATES choices
+ * @returns The number of candidates
+ */
+int deeplearn_tune_candidates(int kernel, deeplearn_tune_choice * candidate)
+{
+    int no_of_candidates = 0;
+    int algorithms = 1;
+
+    /* only convolution has an alternative algorithm */
+    if (kernel == DEEPLEARN_TUNE_CONVOLVE)
+        algorithms = DEEPLEARN_TUNE_ALGORITHMS;
+
+    COUNTUP(a, algorithms) {
+        /* from a single task on the calling thread, up to several
+           tasks per thread so that the load is balanced */
+        for (int tasks = 1; tasks <= DEEPLEARN_THREADS*4; tasks *= 2) {
+            if ((tasks > DEEPLEARN_THREADS) &&
+                (tasks != DEEPLEARN_THREADS*4))
+                continue;
+
+            if (no_of_candidates >= DEEPLEARN_TUNE_MAX_CANDIDATES)
+                return no_of_candidates;
+
+            candidate[no_of_candidates].algorithm = a;
+            candidate[no_of_candidates].tasks = tasks;
+            no_of_candidates++;
+        }
+    }
+    return no_of_candidates;
+}
+
+/**
+ * @brief Returns the table index for the given kernel and shape.
+ *        Must be called with the lock held.
+ * @param kernel The kernel
+ * @param shape Array of DEEPLEARN_TUNE_SHAPE dimensions
+ * @param create Whether to create a new entry if none exists
+ * @returns table index, or -1 if not found or the table is full
+ */
+static int deeplearn_tune_find(int kernel, int shape[], int create)
+{
+    deeplearn_tune_entry * e;
+
+    COUNTUP(i, tune_entries) {
+        if ((tune_entry[i].kernel == kernel) &&
+            (memcmp(tune_entry[i].shape, shape,
+                    DEEPLEARN_TUNE_SHAPE*sizeof(int)) == 0))
+            return i;
+    }
+
+    if ((!create) || (tune_entries >= DEEPLEARN_TUNE_MAX_ENTRIES))
+        return -1;
+
+    e = &tune_entry[tune_entries];
+    memset(e, 0, sizeof(deeplearn_tune_entry));
+    e->kernel = kernel;
+    memcpy(e->shape, shape, DEEPLEARN_TUNE_SHAPE*sizeof(int));
+    COUNTUP(c, DEEPLEARN_TUNE_MAX_CANDIDATES)
+        e->best_time[c] = -1;
+
+    return tune_entries++;
+}
+
+/**
+ * @brief Saves decisions. Must be called with the lock held.
+ * @param filename Filename to save as
+ * @returns zero on success
+ */
+static int deeplearn_tune_save_entries(char * filename)
+{
+    FILE * fp;
+    char model[DEEPLEARN_TUNE_MAX_CPU];
+
+    fp = fopen(filename, "w");
+    if (!fp)
+        return -1;
+
+    deeplearn_tune_cpu_model(model, DEEPLEARN_TUNE_MAX_CPU);
+    fprintf(fp, "libdeep tune\n");
+    fprintf(fp, "cpu %s\n", model);
+
+    COUNTUP(i, tune_entries) {
+        deeplearn_tune_entry * e = &tune_entry[i];
+
+        if (!e->decided)
+            continue;
+
+        fprintf(fp, "%s", tune_kernel_names[e->kernel]);
+        COUNTUP(s, DEEPLEARN_TUNE_SHAPE)
+            fprintf(fp, " %d", e->shape[s]);
+
+        fprintf(fp, " %d %d\n", e->choice.algorithm, e->choice.tasks);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * @brief Saves the decisions which have been made so far
+ * @param filename Filename to save as
+ * @returns zero on success
+ */
+int deeplearn_tune_save(char * filename)
+{
+    int retval;
+
+    pthread_mutex_lock(&tune_lock);
+    retval = deeplearn_tune_save_entries(filename);
+    pthread_mutex_unlock(&tune_lock);
+    return retval;
+}
+
+/**
+ * @brief Loads previously saved decisions. Decisions which were made
+ *        on a different cpu are ignored.
+ * @param filename Filename to load from
+ * @returns zero on success, -1 if the file could not be opened,
+ *          -2 if it is not a tuning file, -3 if it was made on
+ *          a different cpu
+ */
+int deeplearn_tune_load(char * filename)
+{
+    FILE * fp;
+    char line[DEEPLEARN_TUNE_MAX_CPU + 8];
+    char model[DEEPLEARN_TUNE_MAX_CPU];
+
+    fp = fopen(filename, "r");
+    if (!fp)
+        return -1;
+
+    if ((!fgets(line, DEEPLEARN_TUNE_MAX_CPU + 8, fp)) ||
+        (strncmp(line, "libdeep tune", 12) != 0)) {
+        fclose(fp);
+        return -2;
+    }
+
+    if ((!fgets(line, DEEPLEARN_TUNE_MAX_CPU + 8, fp)) ||
+        (strncmp(line, "cpu ", 4) != 0)) {
+        fclose(fp);
+        return -2;
+    }
+
+    line[strcspn(line, "\r\n")] = 0;
+    deeplearn_tune_cpu_model(model, DEEPLEARN_TUNE_MAX_CPU);
+    if (strcmp(&line[4], model) != 0) {
+        fclose(fp);
+        return -3;
+    }
+
+    pthread_mutex_lock(&tune_lock);
+    while (fgets(line, DEEPLEARN_TUNE_MAX_CPU + 8, fp)) {
+        char name[64];
+        int shape[DEEPLEARN_TUNE_SHAPE];
+        deeplearn_tune_choice choice;
+        int kernel = -1, index;
+
+        if (sscanf(line, "%63s %d %d %d %d %d %d %d %d", name,
+                   &shape[0], &shape[1], &shape[2], &shape[3],
+                   &shape[4], &shape[5],
+                   &choice.algorithm, &choice.tasks) != 9)
+            continue;
+
+        COUNTUP(k, DEEPLEARN_TUNE_KERNELS) {
+            if (strcmp(name, tune_kernel_names[k]) == 0) {
+                kernel = k;
+                break;
+            }
+        }
+
+        if ((kernel < 0) ||
+            (choice.algorithm < 0) ||
+            (choice.algorithm >= DEEPLEARN_TUNE_ALGORITHMS))
+            continue;
+
+        index = deeplearn_tune_find(kernel, shape, 1);
+        if (index < 0)
+            break;
+
+        tune_entry[index].choice = choice;
+        tune_entry[index].decided = 1;
+    }
+    pthread_mutex_unlock(&tune_lock);
+
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * @brief Turns on tuning. The first calls to each kernel with a new
+ *        shape try each of the candidates in turn, after which the
+ *        fastest is used.
+ * @param filename Optional file in which decisions are kept between
+ *        runs, so that tuning only happens once for each shape.
+ *        May be NULL.
+ * @returns zero on success, or the error from deeplearn_tune_load
+ *          if the file exists but could not be used
+ */
+int deeplearn_tune_enable(char * filename)
+{
+    int retval = 0;
+
+    tune_filename[0] = 0;
+    if (filename != NULL) {
+        FILE * fp;
+
+        strncpy(tune_filename, filename, 255);
+        tune_filename[255] = 0;
+
+        fp = fopen(filename, "r");
+        if (fp) {
+            fclose(fp);
+            retval = deeplearn_tune_load(filename);
+        }
+    }
+
+    tune_enabled = 1;
+    return retval;
+}
+
+/**
+ * @brief Turns off tuning, after which kernels use their defaults
+ */
+void deeplearn_tune_disable(void)
+{
+    tune_enabled = 0;
+}
+
+/**
+ * @brief Returns whether tuning is turned on
+ * @returns non-zero if tuning is on
+ */
+int deeplearn_tune_enabled(void)
+{
+    return tune_enabled;
+}
+
+/**
+ * @brief Forgets all decisions
+ */
+void deeplearn_tune_clear(void)
+{
+    pthread_mutex_lock(&tune_lock);
+    tune_entries = 0;
+    pthread_mutex_unlock(&tune_lock);
+}
+
+/**
+ * @brief Called before a kernel runs to find out which choice to use.
+ *        When tuning is off this returns the default of the direct
+ *        algorithm with the division of loops left to the executor.
+ * @param kernel The kernel, eg. DEEPLEARN_TUNE_CONVOLVE
+ * @param shape Array of DEEPLEARN_TUNE_SHAPE dimensions
+ * @param trial Returned choice, to be passed to deeplearn_tune_end
+ */
+void deeplearn_tune_begin(int kernel, int shape[],
+                          deeplearn_tune_trial * trial)
+{
+    deeplearn_tune_choice candidate[DEEPLEARN_TUNE_MAX_CANDIDATES];
+    deeplearn_tune_entry * e;
+    int index, no_of_candidates;
+
+    trial->choice.algorithm = DEEPLEARN_TUNE_DIRECT;
+    trial->choice.tasks = 0;
+    trial->entry = -1;
+
+    if (!tune_enabled)
+        return;
+
+    pthread_mutex_lock(&tune_lock);
+
+    index = deeplearn_tune_find(kernel, shape, 1);
+    if (index < 0) {
+        pthread_mutex_unlock(&tune_lock);
+        return;
+    }
+
+    e = &tune_entry[index];
+    if (e->decided) {
+        trial->choice = e->choice;
+        pthread_mutex_unlock(&tune_lock);
+        return;
+    }
+
+    no_of_candidates = deeplearn_tune_candidates(kernel, candidate);
+    trial->entry = index;
+    trial->candidate = e->trials % no_of_candidates;
+    trial->choice = candidate[trial->candidate];
+    e->trials++;
+
+    pthread_mutex_unlock(&tune_lock);
+
+    trial->start = deeplearn_tune_seconds();
+}
+
+/**
+ * @brief Called after a kernel has run. Once every candidate has been
+ *        timed the fastest is chosen and saved.
+ * @param trial The choice returned by deeplearn_tune_begin
+ */
+void deeplearn_tune_end(deeplearn_tune_trial * trial)
+{
+    deeplearn_tune_choice candidate[DEEPLEARN_TUNE_MAX_CANDIDATES];
+    deeplearn_tune_entry * e;
+    double elapsed;
+    int no_of_candidates, best = -1;
+
+    if (trial->entry < 0)
+        return;
+
+    elapsed = deeplearn_tune_seconds() - trial->start;
+
+    pthread_mutex_lock(&tune_lock);
+
+    e = &tune_entry[trial->entry];
+    if ((trial->entry >= tune_entries) || (e->decided)) {
+        pthread_mutex_unlock(&tune_lock);
+        return;
+    }
+
+    if ((e->best_time[trial->candidate] < 0) ||
+        (elapsed < e->best_time[trial->candidate]))
+        e->best_time[trial->candidate] = elapsed;
+
+    e->timed++;
+
+    no_of_candidates = deeplearn_tune_candidates(e->kernel, candidate);
+    if (e->timed < no_of_candidates*DEEPLEARN_TUNE_TRIALS) {
+        pthread_mutex_unlock(&tune_lock);
+        return;
+    }
+
+    COUNTUP(c, no_of_candidates) {
+        if (e->best_time[c] < 0)
+            continue;
+
+        if ((best == -1) || (e->best_time[c] < e->best_time[best]))
+            best = c;
+    }
+
+    if (best > -1) {
+        e->choice = candidate[best];
+        e->decided = 1;
+
+        if (tune_filename[0] != 0)
+            deeplearn_tune_save_entries(tune_filename);
+    }
+
+    pthread_mutex_unlock(&tune_lock);
+}
+
+/**
+ * @brief Returns the decision for a kernel and shape
+ * @param kernel The kernel
+ * @param shape Array of DEEPLEARN_TUNE_SHAPE dimensions
+ * @param choice Returned choice
+ * @returns zero if a decision has been made, otherwise -1
+ */
+int deeplearn_tune_get(int kernel, int shape[],
+                       deeplearn_tune_choice * choice)
+{
+    int index, retval = -1;
+
+    pthread_mutex_lock(&tune_lock);
+    index = deeplearn_tune_find(kernel, shape, 0);
+    if (index > -1) {
+        if (tune_entry[index].decided) {
+            *choice = tune_entry[index].choice;
+            retval = 0;
+        }
+    }
+    pthread_mutex_unlock(&tune_lock);
+    return retval;
+}
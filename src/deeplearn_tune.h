@@ -0,0 +1,115 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_TUNE_H
+#define DEEPLEARN_TUNE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "globals.h"
+
+/* kernels which can be tuned */
+enum {
+    DEEPLEARN_TUNE_CONVOLVE = 0,
+    DEEPLEARN_TUNE_FEED_FORWARD,
+    DEEPLEARN_TUNE_BACKPROP,
+    DEEPLEARN_TUNE_LEARN_FEATURES,
+    DEEPLEARN_TUNE_KERNELS
+};
+
+/* algorithms */
+enum {
+    DEEPLEARN_TUNE_DIRECT = 0,
+    DEEPLEARN_TUNE_SUMMED_AREA,
+    DEEPLEARN_TUNE_ALGORITHMS
+};
+
+/* number of dimensions which describe the shape of a kernel call */
+#define DEEPLEARN_TUNE_SHAPE          6
+
+/* maximum number of shapes which can be tuned */
+#define DEEPLEARN_TUNE_MAX_ENTRIES    256
+
+/* maximum number of candidates for a single shape */
+#define DEEPLEARN_TUNE_MAX_CANDIDATES 32
+
+/* number of times that each candidate is timed. The fastest time
+   is used, so that occasional interruptions don't matter */
+#define DEEPLEARN_TUNE_TRIALS         3
+
+/* maximum length of the cpu model name */
+#define DEEPLEARN_TUNE_MAX_CPU        256
+
+typedef struct {
+    int algorithm;
+
+    /* number of tasks which loops are divided into,
+       or zero to leave it to the executor */
+    int tasks;
+} deeplearn_tune_choice;
+
+typedef struct {
+    int kernel;
+    int shape[DEEPLEARN_TUNE_SHAPE];
+
+    /* number of calls which have started and finished timing */
+    int trials;
+    int timed;
+    int decided;
+    double best_time[DEEPLEARN_TUNE_MAX_CANDIDATES];
+    deeplearn_tune_choice choice;
+} deeplearn_tune_entry;
+
+/* a single timed call of a kernel */
+typedef struct {
+    deeplearn_tune_choice choice;
+
+    /* the entry and candidate being timed, or -1 */
+    int entry;
+    int candidate;
+    double start;
+} deeplearn_tune_trial;
+
+int deeplearn_tune_enable(char * filename);
+void deeplearn_tune_disable(void);
+int deeplearn_tune_enabled(void);
+void deeplearn_tune_clear(void);
+int deeplearn_tune_save(char * filename);
+int deeplearn_tune_load(char * filename);
+void deeplearn_tune_cpu_model(char * model, int max_length);
+int deeplearn_tune_candidates(int kernel, deeplearn_tune_choice * candidate);
+void deeplearn_tune_begin(int kernel, int shape[],
+                          deeplearn_tune_trial * trial);
+void deeplearn_tune_end(deeplearn_tune_trial * trial);
+int deeplearn_tune_get(int kernel, int shape[],
+                       deeplearn_tune_choice * choice);
+
+#endif
@@ -28,6 +28,109 @@
 */
 
 #include "deeplearndata.h"
+#include "utils.h"
+#include "deeplearndata_stream.h"
+
+/* if non-zero then identical rows are merged into weighted samples
+   when a data set is loaded */
+static int deeplearndata_collapse = 0;
+
+/* open addressing hash table of the samples loaded so far, used to
+   find rows which are duplicates of earlier ones */
+typedef struct {
+    deeplearndata ** sample;
+    uint64_t * hash;
+
+    /* number of slots, which is a power of two */
+    int size;
+    int used;
+} deeplearndata_rows;
+
+/**
+* @brief Returns the number of bytes held by a sample, other than any
+*        quantised input values which are held within a single block
+* @param inputs_text Text fields of the sample, or NULL
+* @param has_inputs Non-zero if the sample has an array of input values
+* @param no_of_input_fields The number of input fields
+* @param no_of_outputs The number of output fields
+* @returns number of bytes
+*/
+size_t deeplearndata_sample_memory(char ** inputs_text, int has_inputs,
+                                   int no_of_input_fields, int no_of_outputs)
+{
+    size_t bytes = sizeof(deeplearndata) +
+        ((size_t)no_of_outputs*sizeof(float));
+
+    if (has_inputs != 0)
+        bytes += (size_t)no_of_input_fields*sizeof(float);
+
+    if (inputs_text != 0) {
+        bytes += (size_t)no_of_input_fields*sizeof(char*);
+        COUNTDOWN(i, no_of_input_fields) {
+            if (inputs_text[i] != 0)
+                bytes += strlen(inputs_text[i]) + 1;
+        }
+    }
+    return bytes;
+}
+
+/**
+* @brief Frees a partially created sample when an allocation fails
+* @param data The sample
+* @param no_of_input_fields The number of input fields
+* @param bytes The number of bytes reserved for the sample
+* @param retval The error to return
+* @returns retval
+*/
+static int deeplearndata_add_failed(deeplearndata * data,
+                                    int no_of_input_fields,
+                                    size_t bytes, int retval)
+{
+    if (data->inputs_text != 0) {
+        COUNTDOWN(i, no_of_input_fields)
+            free(data->inputs_text[i]);
+        free(data->inputs_text);
+    }
+    free(data->inputs);
+    free(data->outputs);
+    free(data);
+    deeplearn_memory_release(bytes);
+    return retval;
+}
+
+/**
+* @brief Frees a list of data samples, other than those appended to a
+*        learner while training which are held within chunks
+* @param data List of data samples
+* @param no_of_input_fields The number of input fields
+* @param no_of_outputs The number of output fields
+*/
+void deeplearndata_free_samples(deeplearndata * data,
+                                int no_of_input_fields, int no_of_outputs)
+{
+    deeplearndata * next;
+    size_t bytes = 0;
+
+    while (data != 0) {
+        next = data->next;
+        bytes += deeplearndata_sample_memory(data->inputs_text,
+                                             data->inputs != 0,
+                                             no_of_input_fields,
+                                             no_of_outputs);
+        if (data->inputs_text != 0) {
+            COUNTDOWN(i, no_of_input_fields) {
+                if (data->inputs_text[i] != 0)
+                    free(data->inputs_text[i]);
+            }
+            free(data->inputs_text);
+        }
+        free(data->inputs);
+        free(data->outputs);
+        free(data);
+        data = next;
+    }
+    deeplearn_memory_release(bytes);
+}
 
 /**
 * @brief Adds a training or test sample to the data set
@@ -41,7 +144,7 @@
 * @param input_range_max Maximum value for each input field
 * @param output_range_min Minimum value for each output field
 * @param output_range_max Maximum value for each output field
-* @returns 0 on success
+* @returns 0 on success, or -6 if the memory budget would be exceeded
 */
 int deeplearndata_add(deeplearndata ** datalist,
                       int data_samples[],
@@ -56,35 +159,54 @@ int deeplearndata_add(deeplearndata ** datalist,
                       float output_range_max[])
 {
     deeplearndata * data;
+    size_t bytes = deeplearndata_sample_memory(inputs_text, 1,
+                                               no_of_input_fields,
+                                               no_of_outputs);
+
+    if (deeplearn_memory_reserve(bytes) != 0)
+        return -6;
+
     data = (deeplearndata*)malloc(sizeof(deeplearndata));
-    if (!data)
+    if (!data) {
+        deeplearn_memory_release(bytes);
         return -1;
+    }
+
+    /* nothing allocated yet, so that a partially created sample
+       can be freed if any of the allocations below fail */
+    data->inputs_text = 0;
+    data->inputs_quantised = 0;
+    data->outputs = 0;
 
     /* create arrays to store the data */
     FLOATALLOC(data->inputs, no_of_input_fields);
     if (!data->inputs)
-        return -2;
+        return deeplearndata_add_failed(data, no_of_input_fields,
+                                        bytes, -2);
 
-    data->inputs_text = 0;
     if (inputs_text != 0) {
         CHARPTRALLOC(data->inputs_text, no_of_input_fields);
         if (!data->inputs_text)
-            return -3;
+            return deeplearndata_add_failed(data, no_of_input_fields,
+                                            bytes, -3);
+        memset(data->inputs_text, '\0', no_of_input_fields*sizeof(char*));
 
         COUNTUP(i, no_of_input_fields) {
-            data->inputs_text[i] = 0;
             if (inputs_text[i] != 0) {
                 /* copy the string */
                 CHARALLOC(data->inputs_text[i], strlen(inputs_text[i])+1);
                 if (!data->inputs_text[i])
-                    return -4;
+                    return deeplearndata_add_failed(data,
+                                                    no_of_input_fields,
+                                                    bytes, -4);
                 strcpy(data->inputs_text[i], inputs_text[i]);
             }
         }
     }
     FLOATALLOC(data->outputs, no_of_outputs);
     if (!data->outputs)
-        return -5;
+        return deeplearndata_add_failed(data, no_of_input_fields,
+                                        bytes, -5);
 
     /* copy the data */
     memcpy((void*)data->inputs, inputs, no_of_input_fields*sizeof(float));
@@ -99,6 +221,7 @@ int deeplearndata_add(deeplearndata ** datalist,
             input_range_max[i] = inputs[i];
     }
 
+    data->weight = 1.0f;
     data->labeled = 1;
     COUNTUP(i, no_of_outputs) {
         if ((int)outputs[i] != DEEPLEARN_UNKNOWN_VALUE) {
@@ -310,6 +433,15 @@ static void deeplearndata_free_datasets(deeplearn * learner)
     free(learner->indexed_test_data);
     learner->indexed_test_data = 0;
     learner->indexed_test_data_samples = 0;
+
+    /* sampler priorities and weights belong to the previous
+       training set */
+    if ((learner->sampler != 0) && (learner->sampler->no_of_samples > 0)) {
+        deeplearn_sampler_free(learner->sampler);
+        learner->sampler->no_of_samples = 0;
+    }
+
+    deeplearndata_stream_reindexed(learner);
 }
 
 /**
@@ -490,6 +622,318 @@ int deeplearndata_create_datasets(deeplearn * learner,
     return 0;
 }
 
+/**
+* @brief Creates a deep learner for a list of data samples and attaches
+*        the samples to it. Training and test sets are not created.
+* @param learner Deep learner object
+* @param data List of data samples
+* @param data_samples The number of data samples
+* @param no_of_input_fields The number of input fields
+* @param field_length Array storing the field lengths in input neurons
+* @param no_of_inputs The number of input units
+* @param no_of_outputs The number of output units
+* @param input_range_min Minimum value for each input field
+* @param input_range_max Maximum value for each input field
+* @param output_range_min Minimum value for each output
+* @param output_range_max Maximum value for each output
+* @param no_of_hiddens The number of hidden units per layer
+* @param hidden_layers The number of hidden layers
+* @param error_threshold Training error thresholds for each hidden layer
+* @param random_seed Random number seed
+* @returns zero on success
+*/
+int deeplearndata_create_learner(deeplearn * learner,
+                                 deeplearndata * data, int data_samples,
+                                 int no_of_input_fields, int field_length[],
+                                 int no_of_inputs, int no_of_outputs,
+                                 float input_range_min[],
+                                 float input_range_max[],
+                                 float output_range_min[],
+                                 float output_range_max[],
+                                 int no_of_hiddens, int hidden_layers,
+                                 float error_threshold[],
+                                 unsigned int * random_seed)
+{
+    if (deeplearn_init(learner,
+                       no_of_inputs, no_of_hiddens,
+                       hidden_layers, no_of_outputs,
+                       error_threshold, random_seed) != 0)
+        return -1;
+
+    /* set the input fields */
+    learner->no_of_input_fields = no_of_input_fields;
+
+    INTALLOC(learner->field_length, no_of_input_fields);
+    if (!learner->field_length)
+        return -2;
+
+    memcpy((void*)learner->field_length, field_length,
+           no_of_input_fields*sizeof(int));
+
+    if (deeplearn_resize_input_ranges(learner) != 0)
+        return -3;
+
+    /* attach the data samples */
+    learner->data = data;
+    learner->data_samples = data_samples;
+    if (data_samples > 0) {
+        float total_weight = 0;
+
+        for (deeplearndata * sample = data; sample != 0;
+             sample = sample->next)
+            total_weight += sample->weight;
+        learner->mean_sample_weight = total_weight / data_samples;
+    }
+
+    /* create the indexed array for fast access */
+    deeplearndata_index_data(learner->data, learner->data_samples,
+                             &learner->indexed_data,
+                             &learner->indexed_data_samples);
+
+    /* set the field ranges */
+    COUNTDOWN(i, no_of_input_fields) {
+        learner->input_range_min[i] = input_range_min[i];
+        learner->input_range_max[i] = input_range_max[i];
+    }
+
+    COUNTDOWN(i, no_of_outputs) {
+        learner->output_range_min[i] = output_range_min[i];
+        learner->output_range_max[i] = output_range_max[i];
+    }
+
+    return 0;
+}
+
+/**
+* @brief Sets whether identical rows are merged when a data set is loaded.
+*        Each merged sample has a weight equal to the number of rows which
+*        it represents, and is trained on in proportion to its weight
+* @param collapse Non-zero to merge duplicate rows
+*/
+void deeplearndata_set_collapse_duplicates(int collapse)
+{
+    deeplearndata_collapse = (collapse != 0);
+}
+
+/**
+* @brief Returns non-zero if identical rows are merged when a data set
+*        is loaded
+* @returns 1 if duplicate rows are merged, 0 otherwise
+*/
+int deeplearndata_get_collapse_duplicates(void)
+{
+    return deeplearndata_collapse;
+}
+
+/**
+* @brief Returns the weight of a sample within the loss, relative to the
+*        mean sample weight. Since samples are drawn with equal
+*        probability this keeps the average size of the training steps
+*        the same as without weights
+* @param learner Deep learner object which owns the sample
+* @param sample Data sample
+* @returns weight, which is one on average
+*/
+float deeplearndata_sample_weight(deeplearn * learner, deeplearndata * sample)
+{
+    return sample->weight / learner->mean_sample_weight;
+}
+
+/**
+* @brief Returns a hash of the values within a row
+* @param inputs Input values
+* @param inputs_text Text values of the inputs, which may be zero
+* @param outputs Output values
+* @param no_of_input_fields The number of input fields
+* @param no_of_outputs The number of outputs
+* @returns hash of the row
+*/
+static uint64_t deeplearndata_row_hash(float inputs[], char ** inputs_text,
+                                       float outputs[],
+                                       int no_of_input_fields,
+                                       int no_of_outputs)
+{
+    uint64_t hash = 0;
+
+    COUNTUP(i, no_of_input_fields) {
+        if ((inputs_text != 0) && (inputs_text[i] != 0))
+            hash = deeplearn_hash64(inputs_text[i], strlen(inputs_text[i]),
+                                    hash ^ 1);
+        else
+            hash = deeplearn_hash64(&inputs[i], sizeof(float), hash);
+    }
+    return deeplearn_hash64(outputs, no_of_outputs*sizeof(float), hash);
+}
+
+/**
+* @brief Returns non-zero if a sample has exactly the values of a row
+* @param sample Data sample
+* @param inputs Input values
+* @param inputs_text Text values of the inputs, which may be zero
+* @param outputs Output values
+* @param no_of_input_fields The number of input fields
+* @param no_of_outputs The number of outputs
+* @returns 1 if the values are the same, 0 otherwise
+*/
+static int deeplearndata_row_equal(deeplearndata * sample,
+                                   float inputs[], char ** inputs_text,
+                                   float outputs[],
+                                   int no_of_input_fields,
+                                   int no_of_outputs)
+{
+    COUNTUP(i, no_of_input_fields) {
+        char * text1 =
+            (sample->inputs_text != 0 ? sample->inputs_text[i] : 0);
+        char * text2 = (inputs_text != 0 ? inputs_text[i] : 0);
+
+        if ((text1 != 0) && (text2 != 0)) {
+            if (strcmp(text1, text2) != 0)
+                return 0;
+        }
+        else if ((text1 != 0) || (text2 != 0))
+            return 0;
+
+        if (sample->inputs[i] != inputs[i])
+            return 0;
+    }
+
+    COUNTUP(i, no_of_outputs) {
+        if (sample->outputs[i] != outputs[i])
+            return 0;
+    }
+    return 1;
+}
+
+/**
+* @brief Frees the hash table of loaded rows
+* @param rows Hash table
+*/
+static void deeplearndata_rows_free(deeplearndata_rows * rows)
+{
+    free(rows->sample);
+    free(rows->hash);
+    rows->sample = 0;
+    rows->hash = 0;
+    rows->size = 0;
+    rows->used = 0;
+}
+
+/**
+* @brief Returns a previously loaded sample which has exactly the values
+*        of a row
+* @param rows Hash table
+* @param hash Hash of the row
+* @param inputs Input values
+* @param inputs_text Text values of the inputs
+* @param outputs Output values
+* @param no_of_input_fields The number of input fields
+* @param no_of_outputs The number of outputs
+* @returns the duplicate sample, or zero if the row is new
+*/
+static deeplearndata * deeplearndata_rows_find(deeplearndata_rows * rows,
+                                               uint64_t hash,
+                                               float inputs[],
+                                               char ** inputs_text,
+                                               float outputs[],
+                                               int no_of_input_fields,
+                                               int no_of_outputs)
+{
+    int slot;
+
+    if (rows->size == 0)
+        return 0;
+
+    /* rows with the same hash may still differ */
+    slot = (int)(hash & (rows->size - 1));
+    while (rows->sample[slot] != 0) {
+        if ((rows->hash[slot] == hash) &&
+            deeplearndata_row_equal(rows->sample[slot],
+                                    inputs, inputs_text, outputs,
+                                    no_of_input_fields, no_of_outputs))
+            return rows->sample[slot];
+
+        slot = (slot + 1) & (rows->size - 1);
+    }
+    return 0;
+}
+
+/**
+* @brief Adds a sample to the hash table of loaded rows, doubling its
+*        size when it becomes half full
+* @param rows Hash table
+* @param hash Hash of the sample
+* @param sample Data sample
+* @returns zero on success
+*/
+static int deeplearndata_rows_insert(deeplearndata_rows * rows,
+                                     uint64_t hash, deeplearndata * sample)
+{
+    if ((rows->used+1)*2 > rows->size) {
+        deeplearndata_rows grown;
+
+        grown.size = (rows->size == 0 ? 256 : rows->size*2);
+        grown.used = 0;
+        grown.sample =
+            (deeplearndata**)calloc(grown.size, sizeof(deeplearndata*));
+        grown.hash = (uint64_t*)malloc(grown.size*sizeof(uint64_t));
+        if ((!grown.sample) || (!grown.hash)) {
+            deeplearndata_rows_free(&grown);
+            return -1;
+        }
+
+        COUNTUP(i, rows->size) {
+            if (rows->sample[i] != 0)
+                deeplearndata_rows_insert(&grown, rows->hash[i],
+                                          rows->sample[i]);
+        }
+        deeplearndata_rows_free(rows);
+        *rows = grown;
+    }
+
+    int slot = (int)(hash & (rows->size - 1));
+    while (rows->sample[slot] != 0)
+        slot = (slot + 1) & (rows->size - 1);
+
+    rows->sample[slot] = sample;
+    rows->hash[slot] = hash;
+    rows->used++;
+    return 0;
+}
+
+/**
+* @brief Frees whatever has been loaded when reading a csv file fails
+* @param fp csv file, or NULL if it has already been closed
+* @param rows Hash table of rows
+* @param data List of data samples loaded so far
+* @param no_of_input_fields The number of input fields of each sample
+* @param no_of_outputs The number of outputs of each sample
+* @param inputs_text Text fields of the row being read
+* @param text_fields The number of text fields set within the row
+* @param retval The error to return
+* @returns retval
+*/
+static int deeplearndata_read_csv_failed(FILE * fp,
+                                         deeplearndata_rows * rows,
+                                         deeplearndata * data,
+                                         int no_of_input_fields,
+                                         int no_of_outputs,
+                                         char ** inputs_text,
+                                         int text_fields,
+                                         int retval)
+{
+    if (fp != 0)
+        fclose(fp);
+    deeplearndata_rows_free(rows);
+    deeplearndata_free_samples(data, no_of_input_fields, no_of_outputs);
+    COUNTDOWN(i, text_fields) {
+        if (inputs_text[i] != 0) {
+            free(inputs_text[i]);
+            inputs_text[i] = 0;
+        }
+    }
+    return retval;
+}
+
 /**
 * @brief Loads a data set from a csv file and creates a deep learner
 * @param filename csv filename
@@ -502,7 +946,8 @@ int deeplearndata_create_datasets(deeplearn * learner,
 *        data set is a single integer value
 * @param error_threshold Training error thresholds for each hidden layer
 * @param random_seed Random number seed
-* @returns The number of data samples loaded
+* @returns The number of data samples loaded. If duplicate rows are being
+*          merged then this is the number of distinct rows
 */
 int deeplearndata_read_csv(char * filename,
                            deeplearn * learner,
@@ -532,6 +977,9 @@ int deeplearndata_read_csv(char * filename,
     float output_range_min[DEEPLEARN_MAX_CSV_OUTPUTS];
     float output_range_max[DEEPLEARN_MAX_CSV_OUTPUTS];
     int field_length[DEEPLEARN_MAX_CSV_INPUTS];
+    deeplearndata_rows rows = { 0, 0, 0, 0 };
+    deeplearndata * duplicate;
+    uint64_t hash = 0;
 
     COUNTDOWN(i, DEEPLEARN_MAX_CSV_INPUTS) {
         input_range_min[i] = 9999;
@@ -637,7 +1085,9 @@ int deeplearndata_read_csv(char * filename,
                     CHARALLOC(inputs_text[input_index],
                               strlen(valuestr)+1);
                     if (!inputs_text[input_index])
-                        return -2;
+                        return deeplearndata_read_csv_failed(
+                            fp, &rows, data, no_of_input_fields,
+                            network_outputs, inputs_text, input_index, -2);
 
                     /* copy it */
                     strcpy(inputs_text[input_index],
@@ -656,19 +1106,45 @@ int deeplearndata_read_csv(char * filename,
         if (samples_loaded == 0)
             no_of_input_fields = input_index;
 
-        /* add a data sample */
-        if (deeplearndata_add(&data,
-                              &data_samples,
-                              inputs, inputs_text,
-                              outputs,
-                              no_of_input_fields,
-                              network_outputs,
-                              input_range_min,
-                              input_range_max,
-                              output_range_min,
-                              output_range_max) != 0) {
-            fclose(fp);
-            return -3;
+        /* a row identical to an earlier one adds to its weight */
+        duplicate = 0;
+        if (deeplearndata_collapse != 0) {
+            hash = deeplearndata_row_hash(inputs, inputs_text, outputs,
+                                          no_of_input_fields,
+                                          network_outputs);
+            duplicate = deeplearndata_rows_find(&rows, hash,
+                                                inputs, inputs_text, outputs,
+                                                no_of_input_fields,
+                                                network_outputs);
+        }
+
+        if (duplicate != 0)
+            duplicate->weight += 1.0f;
+        else {
+            /* add a data sample */
+            if (deeplearndata_add(&data,
+                                  &data_samples,
+                                  inputs, inputs_text,
+                                  outputs,
+                                  no_of_input_fields,
+                                  network_outputs,
+                                  input_range_min,
+                                  input_range_max,
+                                  output_range_min,
+                                  output_range_max) != 0)
+                return deeplearndata_read_csv_failed(fp, &rows, data,
+                                                     no_of_input_fields,
+                                                     network_outputs,
+                                                     inputs_text,
+                                                     input_index, -3);
+
+            if ((deeplearndata_collapse != 0) &&
+                (deeplearndata_rows_insert(&rows, hash, data) != 0))
+                return deeplearndata_read_csv_failed(fp, &rows, data,
+                                                     no_of_input_fields,
+                                                     network_outputs,
+                                                     inputs_text,
+                                                     input_index, -3);
         }
 
         /* free memory for any text strings */
@@ -686,58 +1162,44 @@ int deeplearndata_read_csv(char * filename,
     }
 
     fclose(fp);
+    deeplearndata_rows_free(&rows);
 
-    /* calculate field lengths */
+    /* calculate field lengths, leaving out any constant or
+       duplicated fields */
     no_of_inputs =
-        deeplearndata_update_field_lengths(no_of_input_fields,
-                                           field_length, data);
-
-    /* create the deep learner */
-    deeplearn_init(learner,
-                   no_of_inputs, no_of_hiddens,
-                   hidden_layers, network_outputs,
-                   error_threshold, random_seed);
-
-    /* set the input fields */
-    learner->no_of_input_fields = no_of_input_fields;
-
-    INTALLOC(learner->field_length, no_of_input_fields);
-    if (!learner->field_length)
-        return -4;
+        deeplearndata_drop_redundant_fields(no_of_input_fields,
+                                            field_length, data);
 
     COUNTDOWN(i, no_of_input_fields) {
-        learner->field_length[i] = field_length[i];
         if (field_length[i] > 0) {
             input_range_min[i] = NEURON_LOW;
             input_range_max[i] = NEURON_HIGH;
         }
     }
 
-    /* attach the data samples */
-    learner->data = data;
-    learner->data_samples = data_samples;
-
-    /* create the indexed array for fast access */
-    deeplearndata_index_data(learner->data, learner->data_samples,
-                             &learner->indexed_data,
-                             &learner->indexed_data_samples);
-
-    /* set the field ranges */
-    COUNTDOWN(i, no_of_input_fields) {
-        learner->input_range_min[i] = input_range_min[i];
-        learner->input_range_max[i] = input_range_max[i];
-    }
-
-    COUNTDOWN(i, network_outputs) {
-        learner->output_range_min[i] = output_range_min[i];
-        learner->output_range_max[i] = output_range_max[i];
+    /* create the deep learner and attach the data samples */
+    ctr = deeplearndata_create_learner(learner, data, data_samples,
+                                       no_of_input_fields, field_length,
+                                       no_of_inputs, network_outputs,
+                                       input_range_min, input_range_max,
+                                       output_range_min, output_range_max,
+                                       no_of_hiddens, hidden_layers,
+                                       error_threshold, random_seed);
+    if (ctr != 0) {
+        /* the learner was created, but without the data attached */
+        if (ctr != -1)
+            deeplearn_free(learner);
+        return deeplearndata_read_csv_failed(0, &rows, data,
+                                             no_of_input_fields,
+                                             network_outputs,
+                                             inputs_text, 0, -4);
     }
 
     /* create training and test data sets */
     if (deeplearndata_create_datasets(learner, 20) != 0)
         return -5;
 
-    return samples_loaded;
+    return data_samples;
 }
 
 /**
@@ -759,10 +1221,64 @@ static void deeplearndata_update_training_history(deeplearn * learner)
     learner->training_ctr++;
 }
 
+/**
+* @brief Performs a single final training step with a labeled sample drawn
+*        by the prioritised sampler. Samples are drawn in proportion to
+*        their weight, so the loss is not weighted
+* @param learner Deep learner object
+* @returns 2 on success, or -2 if the sampler could not be created
+*/
+static int deeplearndata_training_prioritised(deeplearn * learner)
+{
+    deeplearn_sampler * sampler = learner->sampler;
+    float learning_rate = learner->net->learning_rate;
+    int index;
+
+    /* the number of samples has changed */
+    if (sampler->no_of_samples != learner->training_data_labeled_samples) {
+        if (sampler->no_of_samples > 0)
+            deeplearn_sampler_free(sampler);
+
+        sampler->no_of_samples = 0;
+        if (deeplearn_sampler_init(sampler,
+                                   learner->training_data_labeled_samples,
+                                   sampler->alpha, sampler->beta) != 0)
+            return -2;
+
+        COUNTUP(i, sampler->no_of_samples) {
+            deeplearndata * sample =
+                deeplearndata_get_training_labeled(learner, i);
+            if (deeplearn_sampler_set_weight(sampler, i,
+                                             sample->weight) != 0) {
+                deeplearn_sampler_free(sampler);
+                sampler->no_of_samples = 0;
+                return -2;
+            }
+        }
+    }
+
+    index = deeplearn_sampler_sample(sampler, &learner->net->random_seed);
+    deeplearndata * sample =
+        deeplearndata_get_training_labeled(learner, index);
+    deeplearn_set_inputs(learner, sample);
+    deeplearn_set_outputs(learner, sample);
+
+    /* correct for the sample being drawn more or less often than
+       it would be with uniform sampling */
+    learner->net->learning_rate *= deeplearn_sampler_weight(sampler, index);
+    deeplearn_update(learner);
+    learner->net->learning_rate = learning_rate;
+
+    deeplearn_sampler_update(sampler, index,
+                             bp_get_output_error(learner->net));
+    return 2;
+}
+
 /**
 * @brief Performs a single training step
 * @param learner Deep learner object
-* @returns 1=pretraining,2=final training,0=training complete,-1=no training data
+* @returns 1=pretraining,2=final training,0=training complete,-1=no training data,
+*          -2=the prioritised sampler could not be created
 */
 int deeplearndata_training(deeplearn * learner)
 {
@@ -785,6 +1301,9 @@ int deeplearndata_training(deeplearn * learner)
     }
 
     if (learner->training_complete == 0) {
+        if (learner->sampler != 0)
+            return deeplearndata_training_prioritised(learner);
+
         /* index number of a random training sample */
         int index = rand_num(&learner->net->random_seed)%
             learner->training_data_labeled_samples;
@@ -793,20 +1312,28 @@ int deeplearndata_training(deeplearn * learner)
             deeplearndata_get_training_labeled(learner, index);
         deeplearn_set_inputs(learner, sample);
         deeplearn_set_outputs(learner, sample);
+
+        /* each distinct sample is equally likely to be drawn, so a sample
+           which stands for several rows has a larger weight in the loss */
+        bp_set_sample_weight(learner->net,
+                             deeplearndata_sample_weight(learner, sample));
         deeplearn_update(learner);
+        bp_set_sample_weight(learner->net, 1.0f);
         return 2;
     }
     return 0;
 }
 
 /**
-* @brief Returns the performance on the test data set as a percentage value
+* @brief Returns the performance on the test data set as a percentage value.
+*        Each sample counts as many times as the number of rows which it
+*        represents
 * @param learner Deep learner object
 * @return Training or test performance on the given data, in the range 0 to 100%
 */
 float deeplearndata_get_performance(deeplearn * learner)
 {
-    int hits=0;
+    float hits=0;
     float error_percent, total_error=0, average_error;
     float * outputs;
 
@@ -824,8 +1351,8 @@ float deeplearndata_get_performance(deeplearn * learner)
             if (sample->outputs[i] != 0) {
                 error_percent =
                     (sample->outputs[i] - outputs[i]) / sample->outputs[i];
-                total_error += error_percent*error_percent;
-                hits++;
+                total_error += error_percent*error_percent*sample->weight;
+                hits += sample->weight;
             }
         }
     }
@@ -884,3 +1411,171 @@ int deeplearndata_update_field_lengths(int no_of_input_fields,
     }
     return no_of_inputs;
 }
+
+/**
+* @brief Returns the text value of a field within a data sample
+* @param sample Data sample
+* @param field_index Index number of the input field
+* @returns text value, or zero if the value is numeric
+*/
+static char * deeplearndata_field_text(deeplearndata * sample, int field_index)
+{
+    if (sample->inputs_text == 0)
+        return 0;
+
+    return sample->inputs_text[field_index];
+}
+
+/**
+* @brief Returns non-zero if two field values are exactly the same
+* @param sample1 First data sample
+* @param field1 Index number of the field within the first sample
+* @param sample2 Second data sample
+* @param field2 Index number of the field within the second sample
+* @returns 1 if the values are the same, 0 otherwise
+*/
+static int deeplearndata_field_values_equal(deeplearndata * sample1,
+                                            int field1,
+                                            deeplearndata * sample2,
+                                            int field2)
+{
+    char * text1 = deeplearndata_field_text(sample1, field1);
+    char * text2 = deeplearndata_field_text(sample2, field2);
+
+    if ((text1 != 0) && (text2 != 0))
+        return (strcmp(text1, text2) == 0);
+
+    if ((text1 != 0) || (text2 != 0))
+        return 0;
+
+    return (sample1->inputs[field1] == sample2->inputs[field2]);
+}
+
+/**
+* @brief Returns a hash of all values of a field over the data samples.
+*        Fields with different hashes can't be duplicates of each other
+* @param data List containing data samples
+* @param field_index Index number of the input field
+* @returns hash of the field values
+*/
+static uint64_t deeplearndata_field_hash(deeplearndata * data, int field_index)
+{
+    uint64_t hash = 0;
+    char * text;
+
+    while (data != 0) {
+        text = deeplearndata_field_text(data, field_index);
+        if (text != 0)
+            hash = deeplearn_hash64(text, strlen(text), hash ^ 1);
+        else
+            hash = deeplearn_hash64(&data->inputs[field_index],
+                                    sizeof(float), hash);
+        data = (deeplearndata *)data->next;
+    }
+    return hash;
+}
+
+/**
+* @brief Returns non-zero if a field has the same value in every sample
+* @param data List containing data samples
+* @param field_index Index number of the input field
+* @returns 1 if the field is constant, 0 otherwise
+*/
+static int deeplearndata_field_constant(deeplearndata * data, int field_index)
+{
+    deeplearndata * sample = (deeplearndata *)data->next;
+
+    while (sample != 0) {
+        if (!deeplearndata_field_values_equal(data, field_index,
+                                              sample, field_index))
+            return 0;
+        sample = (deeplearndata *)sample->next;
+    }
+    return 1;
+}
+
+/**
+* @brief Returns non-zero if two fields have the same values in every sample
+* @param data List containing data samples
+* @param field1 Index number of the first input field
+* @param field2 Index number of the second input field
+* @returns 1 if the fields are duplicates, 0 otherwise
+*/
+static int deeplearndata_fields_duplicate(deeplearndata * data,
+                                          int field1, int field2)
+{
+    while (data != 0) {
+        if (!deeplearndata_field_values_equal(data, field1, data, field2))
+            return 0;
+        data = (deeplearndata *)data->next;
+    }
+    return 1;
+}
+
+/**
+* @brief Marks input fields which are constant over all data samples, or
+*        which are exact duplicates of an earlier field, as dropped so that
+*        no input units are allocated for them. The fields remain within
+*        the data samples, so the original field indexes can still be used
+* @param no_of_input_fields The number of input fields
+* @param field_length Array storing the field lengths in input neurons (bits).
+*        Dropped fields are given a length of DEEPLEARN_FIELD_DROPPED
+* @param data List containing data samples
+* @returns The total number of input neurons needed
+*/
+int deeplearndata_drop_redundant_fields(int no_of_input_fields,
+                                        int field_length[],
+                                        deeplearndata * data)
+{
+    int no_of_inputs, kept = 0;
+    uint64_t * hash;
+
+    no_of_inputs =
+        deeplearndata_update_field_lengths(no_of_input_fields,
+                                           field_length, data);
+
+    /* with fewer than two samples every field would appear constant */
+    if ((data == 0) || (data->next == 0) || (no_of_input_fields < 1))
+        return no_of_inputs;
+
+    hash = (uint64_t*)malloc(no_of_input_fields*sizeof(uint64_t));
+    if (!hash)
+        return no_of_inputs;
+
+    COUNTUP(i, no_of_input_fields) {
+        hash[i] = deeplearndata_field_hash(data, i);
+
+        if (deeplearndata_field_constant(data, i)) {
+            field_length[i] = DEEPLEARN_FIELD_DROPPED;
+            continue;
+        }
+
+        COUNTUP(j, i) {
+            if ((field_length[j] == DEEPLEARN_FIELD_DROPPED) ||
+                (hash[j] != hash[i]))
+                continue;
+
+            if (deeplearndata_fields_duplicate(data, j, i)) {
+                field_length[i] = DEEPLEARN_FIELD_DROPPED;
+                break;
+            }
+        }
+    }
+    free(hash);
+
+    no_of_inputs = 0;
+    COUNTUP(i, no_of_input_fields) {
+        if (field_length[i] == DEEPLEARN_FIELD_DROPPED)
+            continue;
+        no_of_inputs += (field_length[i] > 0 ? field_length[i] : 1);
+        kept++;
+    }
+
+    /* keep at least one input */
+    if ((kept == 0) && (no_of_input_fields > 0)) {
+        field_length[0] = deeplearndata_get_field_length(data, 0);
+        no_of_inputs = (field_length[0] > 0 ? field_length[0] : 1);
+    }
+
+    return no_of_inputs;
+}
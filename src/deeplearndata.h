@@ -39,6 +39,10 @@
 #include "deeplearn.h"
 #include "deeplearn_images.h"
 
+size_t deeplearndata_sample_memory(char ** inputs_text, int has_inputs,
+                                   int no_of_input_fields, int no_of_outputs);
+void deeplearndata_free_samples(deeplearndata * data,
+                                int no_of_input_fields, int no_of_outputs);
 int deeplearndata_add(deeplearndata ** datalist,
                       int data_samples[],
                       float inputs[],
@@ -78,6 +82,24 @@ int deeplearndata_get_field_length(deeplearndata * data, int field_index);
 int deeplearndata_update_field_lengths(int no_of_input_fields,
                                        int field_length[],
                                        deeplearndata * data);
+int deeplearndata_drop_redundant_fields(int no_of_input_fields,
+                                        int field_length[],
+                                        deeplearndata * data);
+int deeplearndata_create_learner(deeplearn * learner,
+                                 deeplearndata * data, int data_samples,
+                                 int no_of_input_fields, int field_length[],
+                                 int no_of_inputs, int no_of_outputs,
+                                 float input_range_min[],
+                                 float input_range_max[],
+                                 float output_range_min[],
+                                 float output_range_max[],
+                                 int no_of_hiddens, int hidden_layers,
+                                 float error_threshold[],
+                                 unsigned int * random_seed);
+void deeplearndata_set_collapse_duplicates(int collapse);
+int deeplearndata_get_collapse_duplicates(void);
+float deeplearndata_sample_weight(deeplearn * learner,
+                                  deeplearndata * sample);
 int deeplearndata_read_csv(char * filename,
                            deeplearn * learner,
                            int no_of_hiddens, int hidden_layers,
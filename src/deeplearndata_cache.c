@@ -0,0 +1,1059 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* needed for mmap, fstat and the nanosecond modification time */
+#define _POSIX_C_SOURCE 200809L
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "deeplearndata_cache.h"
+#include "utils.h"
+#include "deeplearndata_quantise.h"
+
+/* round up to the next eight byte boundary */
+#define CACHE_ALIGN(n) (((n) + 7) & ~((uint64_t)7))
+
+/* byte offsets of each section within the cache file */
+typedef struct {
+    uint64_t output_field_index;
+    uint64_t field_length;
+    uint64_t input_range_min;
+    uint64_t input_range_max;
+    uint64_t output_range_min;
+    uint64_t output_range_max;
+    uint64_t inputs;
+    uint64_t outputs;
+    uint64_t weight;
+    uint64_t flags;
+    uint64_t has_text;
+    uint64_t text_offset;
+    uint64_t training;
+    uint64_t labeled;
+    uint64_t test;
+    uint64_t text;
+    uint64_t end;
+} deeplearndata_cache_layout;
+
+/* pairs a sample with its position within the data list */
+typedef struct {
+    deeplearndata * sample;
+    int index;
+} deeplearndata_cache_position;
+
+/**
+ * @brief Calculates the position of each section from the dimensions
+ *        given within the header
+ * @param header Cache header
+ * @param layout Returned section offsets
+ */
+static void deeplearndata_cache_get_layout(deeplearndata_cache_header * header,
+                                           deeplearndata_cache_layout * layout)
+{
+    uint64_t fields = (uint64_t)header->no_of_input_fields;
+    uint64_t outputs = (uint64_t)header->network_outputs;
+    uint64_t samples = (uint64_t)header->data_samples;
+    uint64_t offset = CACHE_ALIGN(sizeof(deeplearndata_cache_header));
+
+    layout->output_field_index = offset;
+    offset = CACHE_ALIGN(offset + header->no_of_outputs*sizeof(int32_t));
+    layout->field_length = offset;
+    offset = CACHE_ALIGN(offset + fields*sizeof(int32_t));
+    layout->input_range_min = offset;
+    offset = CACHE_ALIGN(offset + fields*sizeof(float));
+    layout->input_range_max = offset;
+    offset = CACHE_ALIGN(offset + fields*sizeof(float));
+    layout->output_range_min = offset;
+    offset = CACHE_ALIGN(offset + outputs*sizeof(float));
+    layout->output_range_max = offset;
+    offset = CACHE_ALIGN(offset + outputs*sizeof(float));
+    layout->inputs = offset;
+    offset = CACHE_ALIGN(offset + samples*fields*sizeof(float));
+    layout->outputs = offset;
+    offset = CACHE_ALIGN(offset + samples*outputs*sizeof(float));
+    layout->weight = offset;
+    offset = CACHE_ALIGN(offset + samples*sizeof(float));
+    layout->flags = offset;
+    offset = CACHE_ALIGN(offset + samples*sizeof(uint32_t));
+    layout->has_text = offset;
+    offset = CACHE_ALIGN(offset + samples*sizeof(uint32_t));
+    layout->text_offset = offset;
+    offset = CACHE_ALIGN(offset + samples*fields*sizeof(uint32_t));
+    layout->training = offset;
+    offset = CACHE_ALIGN(offset + header->training_samples*sizeof(uint32_t));
+    layout->labeled = offset;
+    offset = CACHE_ALIGN(offset + header->labeled_samples*sizeof(uint32_t));
+    layout->test = offset;
+    offset = CACHE_ALIGN(offset + header->test_samples*sizeof(uint32_t));
+    layout->text = offset;
+    offset = CACHE_ALIGN(offset + header->text_bytes);
+    layout->end = offset;
+}
+
+/**
+ * @brief Returns the size, modification time and hash of a csv file
+ * @param filename csv filename
+ * @param size Returned file size in bytes
+ * @param mtime Returned modification time in nanoseconds
+ * @param hash Returned hash of the file contents, or NULL if not needed
+ * @returns zero on success
+ */
+static int deeplearndata_cache_source(char * filename,
+                                      uint64_t * size, int64_t * mtime,
+                                      uint64_t * hash)
+{
+    struct stat st;
+    unsigned char buffer[65536];
+    size_t bytes;
+    FILE * fp;
+
+    if (stat(filename, &st) != 0)
+        return -1;
+
+    *size = (uint64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtim.tv_sec*1000000000LL +
+        (int64_t)st.st_mtim.tv_nsec;
+
+    if (hash == NULL)
+        return 0;
+
+    fp = fopen(filename, "rb");
+    if (!fp)
+        return -2;
+
+    /* chain the hash over blocks of the file */
+    *hash = 0;
+    while ((bytes = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        *hash = deeplearn_hash64(buffer, (int)bytes, *hash);
+
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * @brief Pads a section of the cache file to the next eight byte boundary
+ * @param fp File pointer
+ * @param bytes Number of bytes within the section
+ * @returns zero on success
+ */
+static int deeplearndata_cache_pad(FILE * fp, uint64_t bytes)
+{
+    const char padding[8] = { 0 };
+    uint64_t padding_bytes = CACHE_ALIGN(bytes) - bytes;
+
+    if (padding_bytes == 0)
+        return 0;
+
+    if (fwrite(padding, 1, (size_t)padding_bytes, fp) != padding_bytes)
+        return -1;
+
+    return 0;
+}
+
+/**
+ * @brief Writes a section to the cache file, padded to the next eight
+ *        byte boundary
+ * @param fp File pointer
+ * @param data Section data
+ * @param bytes Number of bytes of data
+ * @returns zero on success
+ */
+static int deeplearndata_cache_write(FILE * fp, const void * data,
+                                     uint64_t bytes)
+{
+    if (bytes > 0)
+        if (fwrite(data, 1, (size_t)bytes, fp) != bytes)
+            return -1;
+
+    return deeplearndata_cache_pad(fp, bytes);
+}
+
+/**
+ * @brief Orders positions by sample address, for bsearch
+ */
+static int deeplearndata_cache_compare(const void * a, const void * b)
+{
+    const deeplearndata_cache_position * pa =
+        (const deeplearndata_cache_position*)a;
+    const deeplearndata_cache_position * pb =
+        (const deeplearndata_cache_position*)b;
+
+    if ((uintptr_t)pa->sample < (uintptr_t)pb->sample)
+        return -1;
+    if ((uintptr_t)pa->sample > (uintptr_t)pb->sample)
+        return 1;
+    return 0;
+}
+
+/**
+ * @brief Writes the positions within the data list of the samples
+ *        belonging to a training or test set
+ * @param fp File pointer
+ * @param list Training or test set
+ * @param samples The number of samples in the set
+ * @param position Sample positions sorted by address
+ * @param data_samples The number of data samples
+ * @returns zero on success
+ */
+static int deeplearndata_cache_write_set(FILE * fp,
+                                         deeplearndata_meta * list,
+                                         int samples,
+                                         deeplearndata_cache_position * position,
+                                         int data_samples)
+{
+    deeplearndata_cache_position key, * found;
+    uint32_t * index;
+    int i = 0, retval;
+
+    if (samples == 0)
+        return 0;
+
+    index = (uint32_t*)malloc(samples*sizeof(uint32_t));
+    if (!index)
+        return -1;
+
+    while ((list != 0) && (i < samples)) {
+        key.sample = list->sample;
+        found = (deeplearndata_cache_position*)
+            bsearch(&key, position, data_samples,
+                    sizeof(deeplearndata_cache_position),
+                    deeplearndata_cache_compare);
+        if (!found) {
+            free(index);
+            return -2;
+        }
+        index[i++] = (uint32_t)found->index;
+        list = list->next;
+    }
+
+    retval = -3;
+    if (i == samples)
+        retval = deeplearndata_cache_write(fp, index,
+                                           samples*sizeof(uint32_t));
+    free(index);
+    return retval;
+}
+
+/**
+ * @brief Returns the name of the cache file which is stored alongside
+ *        a csv file
+ * @param csv_filename csv filename
+ * @param cache_filename Returned cache filename
+ * @param max_length Size of the cache filename buffer
+ * @returns zero on success
+ */
+int deeplearndata_cache_filename(char * csv_filename,
+                                 char * cache_filename, int max_length)
+{
+    if (strlen(csv_filename) + strlen(DEEPLEARNDATA_CACHE_EXTENSION) + 1 >
+        (size_t)max_length)
+        return -1;
+
+    sprintf(cache_filename, "%s%s", csv_filename,
+            DEEPLEARNDATA_CACHE_EXTENSION);
+    return 0;
+}
+
+/**
+ * @brief Saves the parsed data set of a deep learner, together with its
+ *        training and test sets, so that the csv file it was loaded
+ *        from doesn't need to be parsed again. This should be called
+ *        before training begins, on a learner created by
+ *        deeplearndata_read_csv.
+ * @param filename Cache filename
+ * @param csv_filename csv file from which the data was loaded
+ * @param learner Deep learner object
+ * @param no_of_outputs The number of output fields given to
+ *        deeplearndata_read_csv
+ * @param output_field_index Indexes of the output fields
+ * @param output_classes The number of output classes
+ * @param random_seed Random number seed given to deeplearndata_read_csv
+ *        (its value before the call)
+ * @returns zero on success
+ */
+int deeplearndata_cache_save(char * filename, char * csv_filename,
+                             deeplearn * learner,
+                             int no_of_outputs, int * output_field_index,
+                             int output_classes,
+                             unsigned int random_seed)
+{
+    deeplearndata_cache_header header;
+    deeplearndata_cache_layout layout;
+    deeplearndata_cache_position * position;
+    deeplearndata * sample;
+    char temp_filename[DEEPLEARN_MAX_FIELD_LENGTH_CHARS];
+    int32_t * values;
+    float * row;
+    uint32_t * text_offset;
+    uint64_t text_bytes = 0;
+    int fields = learner->no_of_input_fields;
+    int outputs = learner->net->no_of_outputs;
+    int samples = learner->data_samples;
+    int i, retval = 0;
+    FILE * fp;
+
+    if ((learner->data == 0) || (learner->field_length == 0))
+        return -1;
+
+    if ((no_of_outputs <= 0) || (no_of_outputs > DEEPLEARN_MAX_CSV_OUTPUTS))
+        return -2;
+
+    if (strlen(filename) + 5 > sizeof(temp_filename))
+        return -3;
+
+    /* total length of the text strings */
+    for (sample = learner->data; sample != 0; sample = sample->next) {
+        if (sample->inputs_text == 0)
+            continue;
+        COUNTUP(f, fields) {
+            if (sample->inputs_text[f] != 0)
+                text_bytes += strlen(sample->inputs_text[f]) + 1;
+        }
+    }
+
+    /* text offsets are 32 bit */
+    if (text_bytes >= DEEPLEARNDATA_CACHE_NO_TEXT)
+        return -4;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DEEPLEARNDATA_CACHE_MAGIC, 8);
+    header.version = DEEPLEARNDATA_CACHE_VERSION;
+    header.byte_order = DEEPLEARNDATA_CACHE_BYTE_ORDER;
+    if (deeplearndata_cache_source(csv_filename, &header.csv_size,
+                                   &header.csv_mtime, &header.csv_hash) != 0)
+        return -5;
+
+    header.no_of_outputs = no_of_outputs;
+    header.output_classes = output_classes;
+    header.collapse_duplicates = deeplearndata_get_collapse_duplicates();
+    header.random_seed = random_seed;
+    header.split_random_seed = learner->net->random_seed;
+    header.no_of_input_fields = fields;
+    header.no_of_inputs = learner->net->no_of_inputs;
+    header.network_outputs = outputs;
+    header.data_samples = samples;
+    header.training_samples = learner->training_data_samples;
+    header.indexed_training_samples = learner->indexed_training_data_samples;
+    header.labeled_samples = learner->training_data_labeled_samples;
+    header.test_samples = learner->test_data_samples;
+    header.text_bytes = text_bytes;
+    deeplearndata_cache_get_layout(&header, &layout);
+    header.file_size = layout.end;
+
+    /* positions of each sample within the data list, ordered by
+       address so that training and test samples can be looked up */
+    position = (deeplearndata_cache_position*)
+        malloc(samples*sizeof(deeplearndata_cache_position));
+    if (!position)
+        return -6;
+
+    COUNTUP(s, samples) {
+        position[s].sample = learner->indexed_data[s];
+        position[s].index = s;
+    }
+    qsort(position, samples, sizeof(deeplearndata_cache_position),
+          deeplearndata_cache_compare);
+
+    /* write to a temporary file, which replaces any existing cache
+       once complete */
+    sprintf(temp_filename, "%s.tmp", filename);
+    fp = fopen(temp_filename, "wb");
+    if (!fp) {
+        free(position);
+        return -7;
+    }
+
+    if (deeplearndata_cache_write(fp, &header, sizeof(header)) != 0)
+        retval = -8;
+
+    /* parameters and ranges */
+    if (retval == 0) {
+        values = (int32_t*)malloc((no_of_outputs > fields ?
+                                  no_of_outputs : fields)*sizeof(int32_t));
+        if (!values)
+            retval = -9;
+        else {
+            COUNTUP(j, no_of_outputs)
+                values[j] = output_field_index[j];
+            if (deeplearndata_cache_write(fp, values,
+                                          no_of_outputs*sizeof(int32_t)) != 0)
+                retval = -10;
+
+            COUNTUP(f, fields)
+                values[f] = learner->field_length[f];
+            if ((retval == 0) &&
+                (deeplearndata_cache_write(fp, values,
+                                           fields*sizeof(int32_t)) != 0))
+                retval = -11;
+            free(values);
+        }
+    }
+
+    if ((retval == 0) &&
+        ((deeplearndata_cache_write(fp, learner->input_range_min,
+                                    fields*sizeof(float)) != 0) ||
+         (deeplearndata_cache_write(fp, learner->input_range_max,
+                                    fields*sizeof(float)) != 0) ||
+         (deeplearndata_cache_write(fp, learner->output_range_min,
+                                    outputs*sizeof(float)) != 0) ||
+         (deeplearndata_cache_write(fp, learner->output_range_max,
+                                    outputs*sizeof(float)) != 0)))
+        retval = -12;
+
+    /* inputs and outputs of each sample, padded once per section.
+       Quantised inputs are saved as the values which they represent */
+    if (retval == 0) {
+        FLOATALLOC(row, fields);
+        if (!row)
+            retval = -13;
+        COUNTUP(s, samples) {
+            if (retval != 0)
+                break;
+            deeplearndata_get_inputs(learner, learner->indexed_data[s], row);
+            if (fwrite(row, sizeof(float), fields, fp) != (size_t)fields)
+                retval = -13;
+        }
+        free(row);
+        if ((retval == 0) &&
+            (deeplearndata_cache_pad(fp,
+                                     (uint64_t)samples*fields*
+                                     sizeof(float)) != 0))
+            retval = -13;
+    }
+
+    if (retval == 0) {
+        COUNTUP(s, samples) {
+            if (fwrite(learner->indexed_data[s]->outputs, sizeof(float),
+                       outputs, fp) != (size_t)outputs) {
+                retval = -14;
+                break;
+            }
+        }
+        if ((retval == 0) &&
+            (deeplearndata_cache_pad(fp,
+                                     (uint64_t)samples*outputs*
+                                     sizeof(float)) != 0))
+            retval = -14;
+    }
+
+    /* number of rows which each sample represents */
+    if (retval == 0) {
+        COUNTUP(s, samples) {
+            if (fwrite(&learner->indexed_data[s]->weight, sizeof(float),
+                       1, fp) != 1) {
+                retval = -24;
+                break;
+            }
+        }
+        if ((retval == 0) &&
+            (deeplearndata_cache_pad(fp,
+                                     (uint64_t)samples*sizeof(float)) != 0))
+            retval = -24;
+    }
+
+    /* flags, and whether each sample has text fields */
+    if (retval == 0) {
+        values = (int32_t*)malloc(samples*sizeof(int32_t));
+        if (!values)
+            retval = -15;
+        else {
+            COUNTUP(s, samples)
+                values[s] = (int32_t)learner->indexed_data[s]->flags;
+            if (deeplearndata_cache_write(fp, values,
+                                          samples*sizeof(int32_t)) != 0)
+                retval = -16;
+
+            COUNTUP(s, samples)
+                values[s] = (learner->indexed_data[s]->inputs_text != 0);
+            if ((retval == 0) &&
+                (deeplearndata_cache_write(fp, values,
+                                           samples*sizeof(int32_t)) != 0))
+                retval = -17;
+            free(values);
+        }
+    }
+
+    /* offsets of the text strings */
+    if (retval == 0) {
+        text_offset = (uint32_t*)malloc(fields*sizeof(uint32_t));
+        if (!text_offset)
+            retval = -18;
+        else {
+            text_bytes = 0;
+            COUNTUP(s, samples) {
+                sample = learner->indexed_data[s];
+                COUNTUP(f, fields) {
+                    text_offset[f] = DEEPLEARNDATA_CACHE_NO_TEXT;
+                    if ((sample->inputs_text != 0) &&
+                        (sample->inputs_text[f] != 0)) {
+                        text_offset[f] = (uint32_t)text_bytes;
+                        text_bytes += strlen(sample->inputs_text[f]) + 1;
+                    }
+                }
+                if (fwrite(text_offset, sizeof(uint32_t),
+                           fields, fp) != (size_t)fields) {
+                    retval = -19;
+                    break;
+                }
+            }
+            free(text_offset);
+            if ((retval == 0) &&
+                (deeplearndata_cache_pad(fp,
+                                         (uint64_t)samples*fields*
+                                         sizeof(uint32_t)) != 0))
+                retval = -19;
+        }
+    }
+
+    /* training and test sets */
+    if ((retval == 0) &&
+        ((deeplearndata_cache_write_set(fp, learner->training_data,
+                                        header.training_samples,
+                                        position, samples) != 0) ||
+         (deeplearndata_cache_write_set(fp, learner->training_data_labeled,
+                                        header.labeled_samples,
+                                        position, samples) != 0) ||
+         (deeplearndata_cache_write_set(fp, learner->test_data,
+                                        header.test_samples,
+                                        position, samples) != 0)))
+        retval = -20;
+
+    /* text strings */
+    if (retval == 0) {
+        COUNTUP(s, samples) {
+            sample = learner->indexed_data[s];
+            if (sample->inputs_text == 0)
+                continue;
+            COUNTUP(f, fields) {
+                if (sample->inputs_text[f] == 0)
+                    continue;
+                i = strlen(sample->inputs_text[f]) + 1;
+                if (fwrite(sample->inputs_text[f], 1, i, fp) != (size_t)i)
+                    retval = -21;
+            }
+        }
+        if ((retval == 0) &&
+            (deeplearndata_cache_pad(fp, text_bytes) != 0))
+            retval = -21;
+    }
+
+    free(position);
+    if (fclose(fp) != 0)
+        retval = -22;
+
+    if ((retval == 0) && (rename(temp_filename, filename) != 0))
+        retval = -23;
+
+    if (retval != 0)
+        remove(temp_filename);
+
+    return retval;
+}
+
+/**
+ * @brief Maps a cache file into memory, or reads it if it can't be mapped
+ * @param filename Cache filename
+ * @param size Returned size of the file in bytes
+ * @param mapped Returned non-zero if the file was mapped
+ * @returns Contents of the file, or NULL on failure
+ */
+static unsigned char * deeplearndata_cache_map(char * filename,
+                                               uint64_t * size, int * mapped)
+{
+    struct stat st;
+    unsigned char * base;
+    FILE * fp;
+
+    fp = fopen(filename, "rb");
+    if (!fp)
+        return NULL;
+
+    if ((fstat(fileno(fp), &st) != 0) ||
+        (st.st_size < (off_t)sizeof(deeplearndata_cache_header))) {
+        fclose(fp);
+        return NULL;
+    }
+    *size = (uint64_t)st.st_size;
+
+    *mapped = 1;
+    base = (unsigned char*)mmap(NULL, (size_t)*size, PROT_READ,
+                                MAP_PRIVATE, fileno(fp), 0);
+    if (base == (unsigned char*)MAP_FAILED) {
+        *mapped = 0;
+        UCHARALLOC(base, *size);
+        if (base) {
+            if (fread(base, 1, (size_t)*size, fp) != *size) {
+                free(base);
+                base = NULL;
+            }
+        }
+    }
+
+    fclose(fp);
+    return base;
+}
+
+/**
+ * @brief Releases a cache file returned by deeplearndata_cache_map
+ * @param base Contents of the file
+ * @param size Size of the file in bytes
+ * @param mapped Whether the file was mapped
+ */
+static void deeplearndata_cache_unmap(unsigned char * base, uint64_t size,
+                                      int mapped)
+{
+    if (mapped != 0)
+        munmap(base, (size_t)size);
+    else
+        free(base);
+}
+
+/**
+ * @brief Checks that a cache file is consistent with its header, and
+ *        that it was created from the current version of the csv file
+ *        with the same parameters
+ * @param base Contents of the cache file
+ * @param size Size of the cache file in bytes
+ * @param csv_filename csv filename
+ * @param no_of_outputs The number of output fields
+ * @param output_field_index Indexes of the output fields
+ * @param output_classes The number of output classes
+ * @returns zero if the cache is valid
+ */
+static int deeplearndata_cache_valid(unsigned char * base, uint64_t size,
+                                     char * csv_filename,
+                                     int no_of_outputs,
+                                     int * output_field_index,
+                                     int output_classes)
+{
+    deeplearndata_cache_header * header = (deeplearndata_cache_header*)base;
+    deeplearndata_cache_layout layout;
+    uint64_t csv_size, csv_hash;
+    int64_t csv_mtime;
+    int32_t * values;
+    uint32_t * index;
+    uint64_t entries;
+    float * weight;
+
+    if ((memcmp(header->magic, DEEPLEARNDATA_CACHE_MAGIC, 8) != 0) ||
+        (header->version != DEEPLEARNDATA_CACHE_VERSION) ||
+        (header->byte_order != DEEPLEARNDATA_CACHE_BYTE_ORDER) ||
+        (header->file_size != size))
+        return -1;
+
+    /* parameters */
+    if ((header->no_of_outputs != no_of_outputs) ||
+        (header->output_classes != output_classes) ||
+        (header->collapse_duplicates !=
+         deeplearndata_get_collapse_duplicates()))
+        return -2;
+
+    /* dimensions */
+    if ((header->no_of_input_fields < 1) ||
+        (header->no_of_input_fields > DEEPLEARN_MAX_CSV_INPUTS) ||
+        (header->no_of_inputs < 1) ||
+        (header->network_outputs < 1) ||
+        (header->network_outputs > DEEPLEARN_MAX_CSV_OUTPUTS) ||
+        (header->no_of_outputs < 1) ||
+        (header->no_of_outputs > DEEPLEARN_MAX_CSV_OUTPUTS) ||
+        (header->data_samples < 1) ||
+        (header->training_samples < 0) ||
+        (header->indexed_training_samples < 0) ||
+        (header->labeled_samples < 0) ||
+        (header->test_samples < 0) ||
+        (header->indexed_training_samples > header->training_samples) ||
+        (header->labeled_samples > header->training_samples) ||
+        ((int64_t)header->training_samples + header->test_samples >
+         header->data_samples) ||
+        (header->text_bytes >= DEEPLEARNDATA_CACHE_NO_TEXT))
+        return -3;
+
+    deeplearndata_cache_get_layout(header, &layout);
+    if (layout.end != size)
+        return -4;
+
+    values = (int32_t*)(base + layout.output_field_index);
+    COUNTUP(j, no_of_outputs) {
+        if (values[j] != output_field_index[j])
+            return -5;
+    }
+
+    /* the csv file must not have changed since the cache was created */
+    if ((deeplearndata_cache_source(csv_filename, &csv_size,
+                                    &csv_mtime, NULL) != 0) ||
+        (csv_size != header->csv_size) ||
+        (csv_mtime != header->csv_mtime))
+        return -6;
+
+    /* every sample represents at least one row */
+    weight = (float*)(base + layout.weight);
+    COUNTUP(s, header->data_samples) {
+        if (!(weight[s] >= 1.0f))
+            return -11;
+    }
+
+    /* training and test sets refer to samples which exist */
+    index = (uint32_t*)(base + layout.training);
+    COUNTUP(i, header->training_samples) {
+        if (index[i] >= (uint32_t)header->data_samples)
+            return -7;
+    }
+    index = (uint32_t*)(base + layout.labeled);
+    COUNTUP(i, header->labeled_samples) {
+        if (index[i] >= (uint32_t)header->data_samples)
+            return -7;
+    }
+    index = (uint32_t*)(base + layout.test);
+    COUNTUP(i, header->test_samples) {
+        if (index[i] >= (uint32_t)header->data_samples)
+            return -7;
+    }
+
+    /* text strings are within the text section and terminated */
+    if (header->text_bytes > 0)
+        if (base[layout.text + header->text_bytes - 1] != 0)
+            return -8;
+
+    index = (uint32_t*)(base + layout.text_offset);
+    entries = (uint64_t)header->data_samples*header->no_of_input_fields;
+    for (uint64_t i = 0; i < entries; i++) {
+        if ((index[i] != DEEPLEARNDATA_CACHE_NO_TEXT) &&
+            (index[i] >= header->text_bytes))
+            return -9;
+    }
+
+    /* finally compare the contents of the csv file */
+    if ((deeplearndata_cache_source(csv_filename, &csv_size,
+                                    &csv_mtime, &csv_hash) != 0) ||
+        (csv_hash != header->csv_hash))
+        return -10;
+
+    return 0;
+}
+
+/**
+ * @brief Recreates the training and test sets as they were when the
+ *        cache was saved. Samples are added in reverse so that each list
+ *        has the same order, and the indexed training set covers the same
+ *        samples as it did after deeplearndata_create_datasets.
+ * @param learner Deep learner object
+ * @param base Contents of the cache file
+ * @param layout Section offsets
+ * @returns zero on success
+ */
+static int deeplearndata_cache_restore_sets(deeplearn * learner,
+                                            unsigned char * base,
+                                            deeplearndata_cache_layout * layout)
+{
+    deeplearndata_cache_header * header = (deeplearndata_cache_header*)base;
+    uint32_t * training = (uint32_t*)(base + layout->training);
+    uint32_t * labeled = (uint32_t*)(base + layout->labeled);
+    uint32_t * test = (uint32_t*)(base + layout->test);
+    uint32_t * flags = (uint32_t*)(base + layout->flags);
+    int indexed_from =
+        header->training_samples - header->indexed_training_samples;
+
+    for (int i = header->training_samples-1; i >= indexed_from; i--)
+        if (deeplearndata_add_training_sample(learner,
+                deeplearndata_get(learner, training[i])) != 0)
+            return -1;
+
+    COUNTDOWN(i, header->labeled_samples)
+        if (deeplearndata_add_labeled_training_sample(learner,
+                deeplearndata_get(learner, labeled[i])) != 0)
+            return -2;
+
+    deeplearndata_index_meta(learner->training_data,
+                             learner->training_data_samples,
+                             &learner->indexed_training_data,
+                             &learner->indexed_training_data_samples);
+    deeplearndata_index_meta(learner->training_data_labeled,
+                             learner->training_data_labeled_samples,
+                             &learner->indexed_training_data_labeled,
+                             &learner->indexed_training_data_labeled_samples);
+
+    /* unlabeled samples added to the training set after indexing */
+    COUNTDOWN(i, indexed_from)
+        if (deeplearndata_add_training_sample(learner,
+                deeplearndata_get(learner, training[i])) != 0)
+            return -3;
+
+    COUNTDOWN(i, header->test_samples)
+        if (deeplearndata_add_test_sample(learner,
+                deeplearndata_get(learner, test[i])) != 0)
+            return -4;
+
+    deeplearndata_index_meta(learner->test_data, learner->test_data_samples,
+                             &learner->indexed_test_data,
+                             &learner->indexed_test_data_samples);
+
+    COUNTUP(s, header->data_samples)
+        deeplearndata_get(learner, s)->flags = flags[s];
+
+    learner->net->random_seed = header->split_random_seed;
+    return 0;
+}
+
+/**
+ * @brief Frees temporary arrays used while creating a deep learner from
+ *        a cache file, together with any samples not yet attached to it
+ * @param data List of data samples
+ * @param no_of_input_fields The number of input fields
+ * @param no_of_outputs The number of outputs
+ * @param text Text fields of a sample
+ * @param range_min Temporary minimum ranges
+ * @param range_max Temporary maximum ranges
+ * @param retval Value to be returned
+ * @returns retval
+ */
+static int deeplearndata_cache_create_done(deeplearndata * data,
+                                           int no_of_input_fields,
+                                           int no_of_outputs,
+                                           char ** text,
+                                           float * range_min,
+                                           float * range_max,
+                                           int retval)
+{
+    deeplearndata_free_samples(data, no_of_input_fields, no_of_outputs);
+    free(text);
+    free(range_min);
+    free(range_max);
+    return retval;
+}
+
+/**
+ * @brief Creates a deep learner from the contents of a valid cache file
+ * @param learner Deep learner object
+ * @param base Contents of the cache file
+ * @param no_of_hiddens The number of hidden units
+ * @param hidden_layers The number of hidden layers
+ * @param error_threshold Training error thresholds for each hidden layer
+ * @param random_seed Random number seed
+ * @returns zero on success
+ */
+static int deeplearndata_cache_create(deeplearn * learner,
+                                      unsigned char * base,
+                                      int no_of_hiddens, int hidden_layers,
+                                      float error_threshold[],
+                                      unsigned int * random_seed)
+{
+    deeplearndata_cache_header * header = (deeplearndata_cache_header*)base;
+    deeplearndata_cache_layout layout;
+    int fields = header->no_of_input_fields;
+    int outputs = header->network_outputs;
+    unsigned int initial_seed = *random_seed;
+    uint32_t * has_text, * text_offset;
+    float * inputs, * targets, * weight;
+    float * range_min, * range_max;
+    char ** text;
+    deeplearndata * data = 0;
+    int data_samples = 0, retval;
+
+    deeplearndata_cache_get_layout(header, &layout);
+    inputs = (float*)(base + layout.inputs);
+    targets = (float*)(base + layout.outputs);
+    weight = (float*)(base + layout.weight);
+    has_text = (uint32_t*)(base + layout.has_text);
+    text_offset = (uint32_t*)(base + layout.text_offset);
+
+    /* deeplearndata_add updates ranges, but the saved ranges are used */
+    CHARPTRALLOC(text, fields);
+    FLOATALLOC(range_min, fields > outputs ? fields : outputs);
+    FLOATALLOC(range_max, fields > outputs ? fields : outputs);
+    if ((!text) || (!range_min) || (!range_max))
+        return deeplearndata_cache_create_done(data, fields, outputs, text,
+                                               range_min, range_max, -1);
+
+    /* samples are prepended, so add them from the tail of the list */
+    for (int s = header->data_samples-1; s >= 0; s--) {
+        COUNTUP(f, fields) {
+            uint32_t offset = text_offset[(uint64_t)s*fields + f];
+            text[f] = 0;
+            if (offset != DEEPLEARNDATA_CACHE_NO_TEXT)
+                text[f] = (char*)(base + layout.text + offset);
+        }
+
+        if (deeplearndata_add(&data, &data_samples,
+                              &inputs[(uint64_t)s*fields],
+                              has_text[s] != 0 ? text : 0,
+                              &targets[(uint64_t)s*outputs],
+                              fields, outputs,
+                              range_min, range_max,
+                              range_min, range_max) != 0)
+            return deeplearndata_cache_create_done(data, fields, outputs, text,
+                                                   range_min, range_max, -2);
+        data->weight = weight[s];
+    }
+
+    retval =
+        deeplearndata_create_learner(learner, data, data_samples, fields,
+                                     (int*)(base + layout.field_length),
+                                     header->no_of_inputs, outputs,
+                                     (float*)(base + layout.input_range_min),
+                                     (float*)(base + layout.input_range_max),
+                                     (float*)(base + layout.output_range_min),
+                                     (float*)(base + layout.output_range_max),
+                                     no_of_hiddens, hidden_layers,
+                                     error_threshold, random_seed);
+    if (retval != 0) {
+        /* the learner was created, but without the data attached */
+        if (retval != -1)
+            deeplearn_free(learner);
+        return deeplearndata_cache_create_done(data, fields, outputs, text,
+                                               range_min, range_max, -3);
+    }
+
+    if (header->random_seed == initial_seed)
+        retval = deeplearndata_cache_restore_sets(learner, base, &layout);
+    else
+        retval = deeplearndata_create_datasets(learner, 20);
+
+    if (retval != 0) {
+        deeplearn_free(learner);
+        retval = -4;
+    }
+
+    return deeplearndata_cache_create_done(0, fields, outputs, text,
+                                           range_min, range_max, retval);
+}
+
+/**
+ * @brief Creates a deep learner from a cache file previously saved with
+ *        deeplearndata_cache_save. The result is the same as calling
+ *        deeplearndata_read_csv on the csv file. If the random seed
+ *        differs from the one the cache was saved with then the parsed
+ *        data is still used, but new training and test sets are created.
+ * @param filename Cache filename
+ * @param csv_filename csv file from which the cache was created
+ * @param learner Deep learner object
+ * @param no_of_hiddens The number of hidden units
+ * @param hidden_layers The number of hidden layers
+ * @param no_of_outputs The number of output fields
+ * @param output_field_index Indexes of the output fields
+ * @param output_classes The number of output classes
+ * @param error_threshold Training error thresholds for each hidden layer
+ * @param random_seed Random number seed
+ * @returns The number of data samples loaded, or negative if the cache
+ *          is missing, out of date or invalid
+ */
+int deeplearndata_cache_load(char * filename, char * csv_filename,
+                             deeplearn * learner,
+                             int no_of_hiddens, int hidden_layers,
+                             int no_of_outputs, int * output_field_index,
+                             int output_classes,
+                             float error_threshold[],
+                             unsigned int * random_seed)
+{
+    unsigned char * base;
+    uint64_t size;
+    int mapped, retval;
+
+    if ((no_of_outputs < 1) || (no_of_outputs > DEEPLEARN_MAX_CSV_OUTPUTS))
+        return -1;
+
+    base = deeplearndata_cache_map(filename, &size, &mapped);
+    if (!base)
+        return -2;
+
+    if (deeplearndata_cache_valid(base, size, csv_filename,
+                                  no_of_outputs, output_field_index,
+                                  output_classes) != 0) {
+        deeplearndata_cache_unmap(base, size, mapped);
+        return -3;
+    }
+
+    retval = ((deeplearndata_cache_header*)base)->data_samples;
+    if (deeplearndata_cache_create(learner, base,
+                                   no_of_hiddens, hidden_layers,
+                                   error_threshold, random_seed) != 0)
+        retval = -4;
+
+    deeplearndata_cache_unmap(base, size, mapped);
+    return retval;
+}
+
+/**
+ * @brief Loads a data set from a csv file and creates a deep learner,
+ *        in the same way as deeplearndata_read_csv. The parsed data set
+ *        is cached in a file alongside the csv file, and while the csv
+ *        file is unchanged later calls load from the cache instead of
+ *        parsing it again.
+ * @param filename csv filename
+ * @param learner Deep learner object
+ * @param no_of_hiddens The number of hidden units
+ * @param hidden_layers The number of hidden layers
+ * @param no_of_outputs The number of output fields
+ * @param output_field_index Indexes of the output fields
+ * @param output_classes The number of output classes
+ * @param error_threshold Training error thresholds for each hidden layer
+ * @param random_seed Random number seed
+ * @returns The number of data samples loaded
+ */
+int deeplearndata_read_csv_cached(char * filename,
+                                  deeplearn * learner,
+                                  int no_of_hiddens, int hidden_layers,
+                                  int no_of_outputs, int * output_field_index,
+                                  int output_classes,
+                                  float error_threshold[],
+                                  unsigned int * random_seed)
+{
+    char cache_filename[DEEPLEARN_MAX_FIELD_LENGTH_CHARS];
+    unsigned int initial_seed = *random_seed;
+    int samples;
+
+    if (deeplearndata_cache_filename(filename, cache_filename,
+                                     DEEPLEARN_MAX_FIELD_LENGTH_CHARS) != 0)
+        return deeplearndata_read_csv(filename, learner,
+                                      no_of_hiddens, hidden_layers,
+                                      no_of_outputs, output_field_index,
+                                      output_classes,
+                                      error_threshold, random_seed);
+
+    samples = deeplearndata_cache_load(cache_filename, filename, learner,
+                                       no_of_hiddens, hidden_layers,
+                                       no_of_outputs, output_field_index,
+                                       output_classes,
+                                       error_threshold, random_seed);
+    if (samples > 0)
+        return samples;
+
+    /* parse the csv file and create a new cache */
+    *random_seed = initial_seed;
+    samples = deeplearndata_read_csv(filename, learner,
+                                     no_of_hiddens, hidden_layers,
+                                     no_of_outputs, output_field_index,
+                                     output_classes,
+                                     error_threshold, random_seed);
+    if (samples > 0)
+        deeplearndata_cache_save(cache_filename, filename, learner,
+                                 no_of_outputs, output_field_index,
+                                 output_classes, initial_seed);
+
+    return samples;
+}
@@ -0,0 +1,109 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARNDATA_CACHE_H
+#define DEEPLEARNDATA_CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "globals.h"
+#include "deeplearn.h"
+#include "deeplearndata.h"
+
+#define DEEPLEARNDATA_CACHE_MAGIC     "LIBDEEPD"
+#define DEEPLEARNDATA_CACHE_VERSION   2
+#define DEEPLEARNDATA_CACHE_EXTENSION ".ldc"
+
+/* byte order marker, so that caches are not shared between
+   machines of different endianness */
+#define DEEPLEARNDATA_CACHE_BYTE_ORDER 0x01020304
+
+/* text offset used for fields which have no text */
+#define DEEPLEARNDATA_CACHE_NO_TEXT   0xFFFFFFFF
+
+/* The cache file begins with this header. All sections which follow
+   it start on eight byte boundaries, so that the file can be mapped
+   into memory and its arrays used in place. */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+
+    /* the csv file from which the data was parsed */
+    uint64_t csv_size;
+    int64_t csv_mtime;
+    uint64_t csv_hash;
+
+    /* parameters with which the csv file was parsed */
+    int32_t no_of_outputs;
+    int32_t output_classes;
+    int32_t collapse_duplicates;
+    uint32_t random_seed;
+
+    /* random seed after the training and test sets were created */
+    uint32_t split_random_seed;
+
+    /* dimensions of the parsed data */
+    int32_t no_of_input_fields;
+    int32_t no_of_inputs;
+    int32_t network_outputs;
+    int32_t data_samples;
+    int32_t training_samples;
+    int32_t indexed_training_samples;
+    int32_t labeled_samples;
+    int32_t test_samples;
+    uint64_t text_bytes;
+} deeplearndata_cache_header;
+
+int deeplearndata_cache_filename(char * csv_filename,
+                                 char * cache_filename, int max_length);
+int deeplearndata_cache_save(char * filename, char * csv_filename,
+                             deeplearn * learner,
+                             int no_of_outputs, int * output_field_index,
+                             int output_classes,
+                             unsigned int random_seed);
+int deeplearndata_cache_load(char * filename, char * csv_filename,
+                             deeplearn * learner,
+                             int no_of_hiddens, int hidden_layers,
+                             int no_of_outputs, int * output_field_index,
+                             int output_classes,
+                             float error_threshold[],
+                             unsigned int * random_seed);
+int deeplearndata_read_csv_cached(char * filename,
+                                  deeplearn * learner,
+                                  int no_of_hiddens, int hidden_layers,
+                                  int no_of_outputs, int * output_field_index,
+                                  int output_classes,
+                                  float error_threshold[],
+                                  unsigned int * random_seed);
+
+#endif
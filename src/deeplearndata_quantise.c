@@ -0,0 +1,376 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearndata_quantise.h"
+
+/**
+ * @brief Converts a single precision value to half precision, rounding
+ *        to the nearest representable value
+ * @param value Value to be converted
+ * @returns half precision bits
+ */
+uint16_t deeplearndata_float_to_half(float value)
+{
+    uint32_t bits, mantissa;
+    uint16_t sign;
+    int exponent, shift;
+
+    memcpy(&bits, &value, sizeof(uint32_t));
+    sign = (uint16_t)((bits >> 16) & 0x8000);
+    exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    mantissa = bits & 0x7fffff;
+
+    /* infinity or not a number */
+    if (((bits >> 23) & 0xff) == 0xff)
+        return sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0);
+
+    /* too large, so becomes infinity */
+    if (exponent >= 31)
+        return sign | 0x7c00;
+
+    /* too small for a normal value, so becomes subnormal or zero */
+    if (exponent <= 0) {
+        if (exponent < -10)
+            return sign;
+
+        mantissa |= 0x800000;
+        shift = 14 - exponent;
+        return sign | (uint16_t)((mantissa + (1u << (shift-1))) >> shift);
+    }
+
+    /* a carry from rounding correctly moves into the exponent */
+    return sign | (uint16_t)(((uint32_t)exponent << 10) +
+                             ((mantissa + 0x1000) >> 13));
+}
+
+/**
+ * @brief Converts a half precision value to single precision
+ * @param value half precision bits
+ * @returns single precision value
+ */
+float deeplearndata_half_to_float(uint16_t value)
+{
+    uint32_t sign = ((uint32_t)value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+    uint32_t bits;
+    float result;
+
+    if (exponent == 0) {
+        /* zero or subnormal */
+        result = mantissa / 16777216.0f;
+        return (sign != 0 ? -result : result);
+    }
+
+    if (exponent == 31)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+    memcpy(&result, &bits, sizeof(float));
+    return result;
+}
+
+/**
+ * @brief Returns the number of bytes used to store each input value
+ * @param storage DEEPLEARNDATA_STORE_FLOAT32, DEEPLEARNDATA_STORE_FLOAT16
+ *        or DEEPLEARNDATA_STORE_UINT8
+ * @returns bytes per value, or -1 if the format is not known
+ */
+int deeplearndata_store_bytes(int storage)
+{
+    switch(storage) {
+    case DEEPLEARNDATA_STORE_FLOAT32: return sizeof(float);
+    case DEEPLEARNDATA_STORE_FLOAT16: return sizeof(uint16_t);
+    case DEEPLEARNDATA_STORE_UINT8: return sizeof(uint8_t);
+    }
+    return -1;
+}
+
+/**
+ * @brief Returns the position of a value within the range of its field
+ * @param learner Deep learner object
+ * @param field Index number of the input field
+ * @param value Input value
+ * @returns position in the range 0.0 to 1.0
+ */
+static float deeplearndata_range_position(deeplearn * learner,
+                                          int field, float value)
+{
+    float range =
+        learner->input_range_max[field] - learner->input_range_min[field];
+    float position;
+
+    if (range <= 0)
+        return 0;
+
+    position = (value - learner->input_range_min[field]) / range;
+    if (position < 0)
+        return 0;
+    if (position > 1)
+        return 1;
+    return position;
+}
+
+/**
+ * @brief Returns the position of an input value of a quantised sample
+ *        within the range of its field
+ * @param learner Deep learner object which owns the sample
+ * @param sample Data sample whose inputs are quantised
+ * @param field Index number of the input field
+ * @returns position in the range 0.0 to 1.0
+ */
+float deeplearndata_quantised_position(deeplearn * learner,
+                                       deeplearndata * sample, int field)
+{
+    if (learner->input_storage == DEEPLEARNDATA_STORE_UINT8)
+        return sample->inputs_quantised[field] / 255.0f;
+
+    return deeplearndata_half_to_float(
+        ((uint16_t*)sample->inputs_quantised)[field]);
+}
+
+/**
+ * @brief Returns an input value of a sample, in whichever format it is
+ *        stored. Quantised values are approximations of the original ones
+ * @param learner Deep learner object which owns the sample
+ * @param sample Data sample
+ * @param field Index number of the input field
+ * @returns input value
+ */
+float deeplearndata_get_input(deeplearn * learner,
+                              deeplearndata * sample, int field)
+{
+    float min = learner->input_range_min[field];
+    float range = learner->input_range_max[field] - min;
+
+    if (sample->inputs != 0)
+        return sample->inputs[field];
+
+    if (range <= 0)
+        return min;
+
+    return min +
+        deeplearndata_quantised_position(learner, sample, field)*range;
+}
+
+/**
+ * @brief Returns all input values of a sample
+ * @param learner Deep learner object which owns the sample
+ * @param sample Data sample
+ * @param values Returned values, one per input field
+ */
+void deeplearndata_get_inputs(deeplearn * learner,
+                              deeplearndata * sample, float values[])
+{
+    if (sample->inputs != 0) {
+        memcpy(values, sample->inputs,
+               learner->no_of_input_fields*sizeof(float));
+        return;
+    }
+
+    COUNTDOWN(i, learner->no_of_input_fields)
+        values[i] = deeplearndata_get_input(learner, sample, i);
+}
+
+/**
+ * @brief Returns the number of samples within the data list of a learner
+ * @param learner Deep learner object
+ * @returns number of samples
+ */
+static int deeplearndata_quantise_samples(deeplearn * learner)
+{
+    deeplearndata * sample = learner->data;
+    int samples = 0;
+
+    while (sample != 0) {
+        samples++;
+        sample = sample->next;
+    }
+    return samples;
+}
+
+/**
+ * @brief Frees the quantised input values of a learner. The samples
+ *        which referred to them are not altered
+ * @param learner Deep learner object
+ */
+void deeplearndata_quantise_free(deeplearn * learner)
+{
+    if (learner->inputs_quantised == 0)
+        return;
+
+    free(learner->inputs_quantised);
+    deeplearn_memory_release(learner->inputs_quantised_bytes);
+    learner->inputs_quantised = 0;
+    learner->inputs_quantised_bytes = 0;
+}
+
+/**
+ * @brief Returns the input values of all samples to single precision,
+ *        with each sample having its own array as when it was loaded
+ * @param learner Deep learner object
+ * @returns zero on success
+ */
+static int deeplearndata_quantise_restore(deeplearn * learner)
+{
+    int fields = learner->no_of_input_fields;
+    int samples = deeplearndata_quantise_samples(learner);
+    deeplearndata * sample;
+    float ** values;
+    size_t bytes;
+    int s = 0;
+
+    bytes = (size_t)samples*fields*sizeof(float);
+    if (deeplearn_memory_reserve(bytes) != 0)
+        return -4;
+
+    values = (float**)calloc(samples, sizeof(float*));
+    if (!values) {
+        deeplearn_memory_release(bytes);
+        return -5;
+    }
+
+    /* allocate everything first, so that nothing changes on failure */
+    COUNTUP(i, samples) {
+        FLOATALLOC(values[i], fields);
+        if (!values[i]) {
+            COUNTDOWN(j, i)
+                free(values[j]);
+            free(values);
+            deeplearn_memory_release(bytes);
+            return -5;
+        }
+    }
+
+    for (sample = learner->data; sample != 0; sample = sample->next, s++) {
+        deeplearndata_get_inputs(learner, sample, values[s]);
+        sample->inputs = values[s];
+        sample->inputs_quantised = 0;
+    }
+    free(values);
+
+    deeplearndata_quantise_free(learner);
+    learner->input_storage = DEEPLEARNDATA_STORE_FLOAT32;
+    learner->model_version++;
+    return 0;
+}
+
+/**
+ * @brief Sets the format in which the numeric input values of the samples
+ *        of a learner are stored. Quantised values are the position of
+ *        each value within the range of its field, stored as half
+ *        precision or as eight bits, and all samples are kept within a
+ *        single block. They are converted to input unit values as each
+ *        sample is presented to the network. Since the input ranges must
+ *        not change afterwards, samples can't then be streamed. Converting
+ *        from a quantised format starts from the quantised values, so the
+ *        original values are only kept with DEEPLEARNDATA_STORE_FLOAT32.
+ * @param learner Deep learner object
+ * @param storage DEEPLEARNDATA_STORE_FLOAT32, DEEPLEARNDATA_STORE_FLOAT16
+ *        or DEEPLEARNDATA_STORE_UINT8
+ * @returns zero on success
+ */
+int deeplearndata_set_input_storage(deeplearn * learner, int storage)
+{
+    int fields = learner->no_of_input_fields;
+    int bytes_per_value = deeplearndata_store_bytes(storage);
+    size_t sample_bytes, bytes;
+    deeplearndata * sample;
+    unsigned char * block;
+    float * values;
+    int samples, s = 0;
+
+    if (bytes_per_value < 0)
+        return -1;
+
+    if (storage == learner->input_storage)
+        return 0;
+
+    /* quantised values can't follow changes to the input ranges */
+    if (learner->stream != 0)
+        return -2;
+
+    samples = deeplearndata_quantise_samples(learner);
+    if ((fields < 1) || (samples < 1))
+        return -3;
+
+    if (storage == DEEPLEARNDATA_STORE_FLOAT32)
+        return deeplearndata_quantise_restore(learner);
+
+    sample_bytes = (size_t)fields*bytes_per_value;
+    bytes = (size_t)samples*sample_bytes;
+    if (deeplearn_memory_reserve(bytes) != 0)
+        return -4;
+
+    block = (unsigned char*)malloc(bytes);
+    FLOATALLOC(values, fields);
+    if ((!block) || (!values)) {
+        free(block);
+        free(values);
+        deeplearn_memory_release(bytes);
+        return -5;
+    }
+
+    /* convert from the current format before anything is freed */
+    for (sample = learner->data; sample != 0; sample = sample->next, s++) {
+        unsigned char * dest = &block[s*sample_bytes];
+
+        deeplearndata_get_inputs(learner, sample, values);
+        COUNTUP(i, fields) {
+            float position = deeplearndata_range_position(learner, i,
+                                                          values[i]);
+            if (storage == DEEPLEARNDATA_STORE_UINT8)
+                dest[i] = (unsigned char)(position*255 + 0.5f);
+            else
+                ((uint16_t*)dest)[i] = deeplearndata_float_to_half(position);
+        }
+    }
+    free(values);
+
+    /* the single precision values are released from the budget */
+    s = 0;
+    for (sample = learner->data; sample != 0; sample = sample->next, s++) {
+        if (sample->inputs != 0) {
+            free(sample->inputs);
+            sample->inputs = 0;
+            deeplearn_memory_release((size_t)fields*sizeof(float));
+        }
+        sample->inputs_quantised = &block[s*sample_bytes];
+    }
+
+    deeplearndata_quantise_free(learner);
+    learner->inputs_quantised = block;
+    learner->inputs_quantised_bytes = bytes;
+    learner->input_storage = storage;
+
+    /* the values presented to the network have changed slightly */
+    learner->model_version++;
+    return 0;
+}
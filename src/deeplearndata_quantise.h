@@ -0,0 +1,62 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARNDATA_QUANTISE_H
+#define DEEPLEARNDATA_QUANTISE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "globals.h"
+#include "deeplearn.h"
+#include "deeplearn_memory.h"
+
+/* formats in which the numeric input values of samples can be stored.
+   Quantised values are the position of each value within the range of
+   its field, so they are only valid while the ranges are unchanged */
+enum {
+    DEEPLEARNDATA_STORE_FLOAT32 = 0,
+    DEEPLEARNDATA_STORE_FLOAT16,
+    DEEPLEARNDATA_STORE_UINT8
+};
+
+uint16_t deeplearndata_float_to_half(float value);
+float deeplearndata_half_to_float(uint16_t value);
+int deeplearndata_store_bytes(int storage);
+int deeplearndata_set_input_storage(deeplearn * learner, int storage);
+float deeplearndata_quantised_position(deeplearn * learner,
+                                       deeplearndata * sample, int field);
+float deeplearndata_get_input(deeplearn * learner,
+                              deeplearndata * sample, int field);
+void deeplearndata_get_inputs(deeplearn * learner,
+                              deeplearndata * sample, float values[]);
+void deeplearndata_quantise_free(deeplearn * learner);
+
+#endif
@@ -0,0 +1,572 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearndata_stream.h"
+#include "deeplearndata_quantise.h"
+
+/**
+ * @brief Returns the capacity of an indexed array. If the array has
+ *        been replaced since it was last grown by the stream then it is
+ *        assumed to be full.
+ * @param array Current array
+ * @param samples Current number of entries
+ * @param grown Array as it was last grown
+ * @param grown_samples Number of entries when last grown
+ * @param capacity Capacity when last grown
+ * @returns Capacity of the array
+ */
+static int deeplearndata_stream_capacity(void * array, int samples,
+                                         void * grown, int grown_samples,
+                                         int capacity)
+{
+    if ((array != grown) || (samples != grown_samples))
+        return samples;
+    return capacity;
+}
+
+/**
+ * @brief Returns a capacity large enough for one more entry, doubling
+ *        so that appending is amortised constant time
+ * @param samples Current number of entries
+ * @param capacity Current capacity
+ * @returns New capacity
+ */
+static int deeplearndata_stream_grow(int samples, int capacity)
+{
+    if (samples < capacity)
+        return capacity;
+
+    capacity *= 2;
+    if (capacity < DEEPLEARNDATA_STREAM_MIN_CAPACITY)
+        capacity = DEEPLEARNDATA_STREAM_MIN_CAPACITY;
+    return capacity;
+}
+
+/**
+ * @brief Ensures that there is room for one more data sample within the
+ *        indexed data array
+ * @param learner Deep learner object
+ * @returns zero on success
+ */
+static int deeplearndata_stream_reserve_data(deeplearn * learner)
+{
+    deeplearndata_stream * stream = learner->stream;
+    deeplearndata ** array;
+    int capacity =
+        deeplearndata_stream_capacity(learner->indexed_data,
+                                      learner->indexed_data_samples,
+                                      stream->indexed_data,
+                                      stream->indexed_data_samples,
+                                      stream->indexed_data_capacity);
+    int new_capacity =
+        deeplearndata_stream_grow(learner->indexed_data_samples, capacity);
+
+    if (new_capacity > capacity) {
+        array = (deeplearndata**)realloc(learner->indexed_data,
+                                         new_capacity*sizeof(deeplearndata*));
+        if (!array)
+            return -1;
+        learner->indexed_data = array;
+    }
+
+    stream->indexed_data = learner->indexed_data;
+    stream->indexed_data_samples = learner->indexed_data_samples;
+    stream->indexed_data_capacity = new_capacity;
+    return 0;
+}
+
+/**
+ * @brief Ensures that there is room for one more entry within an indexed
+ *        training or test set
+ * @param indexed Indexed set of the learner
+ * @param samples Number of entries within the indexed set
+ * @param grown Indexed set as it was last grown by the stream
+ * @param grown_samples Number of entries when last grown
+ * @param capacity Capacity when last grown
+ * @returns zero on success
+ */
+static int deeplearndata_stream_reserve_meta(deeplearndata_meta *** indexed,
+                                             int samples,
+                                             deeplearndata_meta *** grown,
+                                             int * grown_samples,
+                                             int * capacity)
+{
+    deeplearndata_meta ** array;
+    int current =
+        deeplearndata_stream_capacity(*indexed, samples,
+                                      *grown, *grown_samples, *capacity);
+    int new_capacity = deeplearndata_stream_grow(samples, current);
+
+    if (new_capacity > current) {
+        array = (deeplearndata_meta**)
+            realloc(*indexed, new_capacity*sizeof(deeplearndata_meta*));
+        if (!array)
+            return -1;
+        *indexed = array;
+    }
+
+    *grown = *indexed;
+    *grown_samples = samples;
+    *capacity = new_capacity;
+    return 0;
+}
+
+/**
+ * @brief Adds a new chunk of samples
+ * @param learner Deep learner object
+ * @returns zero on success
+ */
+static int deeplearndata_stream_add_chunk(deeplearn * learner)
+{
+    deeplearndata_stream * stream = learner->stream;
+    deeplearndata_stream_chunk * chunk;
+    int samples = stream->chunk_samples;
+    size_t bytes = sizeof(deeplearndata_stream_chunk) +
+        (size_t)samples*(sizeof(deeplearndata) +
+                         ((size_t)learner->no_of_input_fields +
+                          learner->net->no_of_outputs)*sizeof(float));
+
+    if (deeplearn_memory_reserve(bytes) != 0)
+        return -1;
+
+    chunk = (deeplearndata_stream_chunk*)
+        malloc(sizeof(deeplearndata_stream_chunk));
+    if (!chunk) {
+        deeplearn_memory_release(bytes);
+        return -2;
+    }
+
+    chunk->sample = (deeplearndata*)malloc(samples*sizeof(deeplearndata));
+    FLOATALLOC(chunk->inputs, samples*learner->no_of_input_fields);
+    FLOATALLOC(chunk->outputs, samples*learner->net->no_of_outputs);
+    if ((!chunk->sample) || (!chunk->inputs) || (!chunk->outputs)) {
+        free(chunk->sample);
+        free(chunk->inputs);
+        free(chunk->outputs);
+        free(chunk);
+        deeplearn_memory_release(bytes);
+        return -3;
+    }
+
+    chunk->used = 0;
+    chunk->next = stream->chunk;
+    stream->chunk = chunk;
+    stream->memory += bytes;
+    return 0;
+}
+
+/**
+ * @brief Copies the text fields of a sample
+ * @param sample Data sample
+ * @param inputs_text Text fields, or NULL
+ * @param no_of_input_fields The number of input fields
+ * @returns zero on success
+ */
+static int deeplearndata_stream_copy_text(deeplearndata * sample,
+                                          char ** inputs_text,
+                                          int no_of_input_fields)
+{
+    sample->inputs_text = 0;
+    if (inputs_text == 0)
+        return 0;
+
+    CHARPTRALLOC(sample->inputs_text, no_of_input_fields);
+    if (!sample->inputs_text)
+        return -1;
+
+    COUNTUP(i, no_of_input_fields) {
+        sample->inputs_text[i] = 0;
+        if (inputs_text[i] == 0)
+            continue;
+
+        CHARALLOC(sample->inputs_text[i], strlen(inputs_text[i])+1);
+        if (!sample->inputs_text[i]) {
+            COUNTDOWN(j, i)
+                free(sample->inputs_text[j]);
+            free(sample->inputs_text);
+            sample->inputs_text = 0;
+            return -2;
+        }
+        strcpy(sample->inputs_text[i], inputs_text[i]);
+    }
+    return 0;
+}
+
+/**
+ * @brief Extends the ranges of the numeric input fields and outputs to
+ *        include a new sample, calling the renormalisation callback for
+ *        each range which changes
+ * @param learner Deep learner object
+ * @param sample The new data sample
+ */
+static void deeplearndata_stream_update_ranges(deeplearn * learner,
+                                               deeplearndata * sample)
+{
+    deeplearndata_stream * stream = learner->stream;
+    float previous_min, previous_max;
+    int changed = 0;
+
+    COUNTUP(i, learner->no_of_input_fields) {
+        /* text fields have a fixed range and dropped fields none */
+        if (learner->field_length[i] != 0)
+            continue;
+
+        previous_min = learner->input_range_min[i];
+        previous_max = learner->input_range_max[i];
+        if ((sample->inputs[i] >= previous_min) &&
+            (sample->inputs[i] <= previous_max))
+            continue;
+
+        if (sample->inputs[i] < previous_min)
+            learner->input_range_min[i] = sample->inputs[i];
+        if (sample->inputs[i] > previous_max)
+            learner->input_range_max[i] = sample->inputs[i];
+        changed = 1;
+
+        if (stream->renormalise != 0)
+            (*stream->renormalise)(learner, DEEPLEARNDATA_STREAM_INPUT, i,
+                                   previous_min, previous_max,
+                                   stream->renormalise_data);
+    }
+
+    COUNTUP(i, learner->net->no_of_outputs) {
+        if ((int)sample->outputs[i] == DEEPLEARN_UNKNOWN_VALUE)
+            continue;
+
+        previous_min = learner->output_range_min[i];
+        previous_max = learner->output_range_max[i];
+        if ((sample->outputs[i] >= previous_min) &&
+            (sample->outputs[i] <= previous_max))
+            continue;
+
+        if (sample->outputs[i] < previous_min)
+            learner->output_range_min[i] = sample->outputs[i];
+        if (sample->outputs[i] > previous_max)
+            learner->output_range_max[i] = sample->outputs[i];
+        changed = 1;
+
+        if (stream->renormalise != 0)
+            (*stream->renormalise)(learner, DEEPLEARNDATA_STREAM_OUTPUT, i,
+                                   previous_min, previous_max,
+                                   stream->renormalise_data);
+    }
+
+    /* normalised values have changed, so cached predictions are stale */
+    if (changed != 0)
+        learner->model_version++;
+}
+
+/**
+ * @brief Allows data samples to be appended to a deep learner while it
+ *        is being trained. Samples are stored in chunks, and the indexed
+ *        arrays are grown geometrically, so that each append takes
+ *        amortised constant time rather than re-indexing the data set.
+ *        If the learner has no input fields, as when it was created with
+ *        deeplearn_init rather than from a csv file, then each input
+ *        is treated as a numeric field.
+ * @param learner Deep learner object
+ * @param test_data_percentage Percentage of appended labeled samples
+ *        which are assigned to the test set
+ * @param chunk_samples Number of samples per chunk, or zero for the default
+ * @returns zero on success
+ */
+int deeplearndata_stream_init(deeplearn * learner,
+                              int test_data_percentage,
+                              int chunk_samples)
+{
+    deeplearndata_stream * stream;
+
+    if ((test_data_percentage < 0) || (test_data_percentage > 100))
+        return -1;
+
+    if (chunk_samples <= 0)
+        chunk_samples = DEEPLEARNDATA_STREAM_CHUNK_SAMPLES;
+
+    /* quantised inputs can't follow changes to the input ranges */
+    if (learner->input_storage != DEEPLEARNDATA_STORE_FLOAT32)
+        return -5;
+
+    if (learner->stream != 0) {
+        learner->stream->test_data_percentage = test_data_percentage;
+        learner->stream->chunk_samples = chunk_samples;
+        return 0;
+    }
+
+    if (learner->field_length == 0) {
+        if (learner->data != 0)
+            return -2;
+
+        learner->no_of_input_fields = learner->net->no_of_inputs;
+        INTALLOC(learner->field_length, learner->no_of_input_fields);
+        if (!learner->field_length)
+            return -3;
+        memset(learner->field_length, 0,
+               learner->no_of_input_fields*sizeof(int));
+    }
+
+    stream = (deeplearndata_stream*)malloc(sizeof(deeplearndata_stream));
+    if (!stream)
+        return -4;
+
+    memset(stream, 0, sizeof(deeplearndata_stream));
+    stream->chunk_samples = chunk_samples;
+    stream->test_data_percentage = test_data_percentage;
+    learner->stream = stream;
+    return 0;
+}
+
+/**
+ * @brief Frees the chunks of samples appended to a deep learner. Those
+ *        samples are removed from the data list, but the caller is
+ *        responsible for the training and test sets which refer to them.
+ * @param learner Deep learner object
+ */
+void deeplearndata_stream_free(deeplearn * learner)
+{
+    deeplearndata_stream * stream = learner->stream;
+    deeplearndata_stream_chunk * chunk, * next;
+    deeplearndata * sample;
+
+    if (stream == 0)
+        return;
+
+    chunk = stream->chunk;
+    while (chunk != 0) {
+        COUNTUP(s, chunk->used) {
+            sample = &chunk->sample[s];
+
+            /* unlink from the data list */
+            if (sample->prev != 0)
+                sample->prev->next = sample->next;
+            else
+                learner->data = sample->next;
+            if (sample->next != 0)
+                sample->next->prev = sample->prev;
+
+            if (sample->inputs_text != 0) {
+                COUNTDOWN(i, learner->no_of_input_fields) {
+                    if (sample->inputs_text[i] != 0)
+                        free(sample->inputs_text[i]);
+                }
+                free(sample->inputs_text);
+            }
+        }
+
+        next = chunk->next;
+        free(chunk->sample);
+        free(chunk->inputs);
+        free(chunk->outputs);
+        free(chunk);
+        chunk = next;
+    }
+
+    deeplearn_memory_release(stream->memory);
+    free(stream);
+    learner->stream = 0;
+}
+
+/**
+ * @brief Should be called whenever the indexed training and test sets
+ *        are recreated, so that their previous capacities are forgotten
+ * @param learner Deep learner object
+ */
+void deeplearndata_stream_reindexed(deeplearn * learner)
+{
+    deeplearndata_stream * stream = learner->stream;
+
+    if (stream == 0)
+        return;
+
+    stream->indexed_training_data = 0;
+    stream->indexed_training_data_samples = 0;
+    stream->indexed_training_data_capacity = 0;
+    stream->indexed_training_data_labeled = 0;
+    stream->indexed_training_data_labeled_samples = 0;
+    stream->indexed_training_data_labeled_capacity = 0;
+    stream->indexed_test_data = 0;
+    stream->indexed_test_data_samples = 0;
+    stream->indexed_test_data_capacity = 0;
+}
+
+/**
+ * @brief Sets a function to be called whenever an appended sample
+ *        extends the range of an input field or output
+ * @param learner Deep learner object
+ * @param callback Function to be called, or NULL
+ * @param user_data Passed to the callback
+ */
+void deeplearndata_stream_set_renormalise(deeplearn * learner,
+                                          deeplearndata_stream_callback callback,
+                                          void * user_data)
+{
+    if (learner->stream == 0)
+        return;
+
+    learner->stream->renormalise = callback;
+    learner->stream->renormalise_data = user_data;
+}
+
+/**
+ * @brief Appends a data sample to a deep learner and assigns it to the
+ *        training or test set. This can be called between training
+ *        iterations, and the sample is used by the next one.
+ * @param learner Deep learner object
+ * @param inputs Value of each input field
+ * @param inputs_text Text of each input field, or NULL
+ * @param outputs Output values, or DEEPLEARN_UNKNOWN_VALUE if unlabeled
+ * @returns DEEPLEARNDATA_STREAM_TRAINING or DEEPLEARNDATA_STREAM_TEST,
+ *          or negative on failure
+ */
+int deeplearndata_stream_append(deeplearn * learner,
+                                float inputs[], char ** inputs_text,
+                                float outputs[])
+{
+    deeplearndata_stream * stream = learner->stream;
+    deeplearndata_stream_chunk * chunk;
+    deeplearndata * sample;
+    int fields, outputs_per_sample, assigned, test;
+
+    if ((stream == 0) || (inputs == 0) || (outputs == 0))
+        return -1;
+
+    fields = learner->no_of_input_fields;
+    outputs_per_sample = learner->net->no_of_outputs;
+
+    /* make room for the sample within the indexed arrays */
+    if (deeplearndata_stream_reserve_data(learner) != 0)
+        return -2;
+
+    if ((deeplearndata_stream_reserve_meta(
+             &learner->indexed_training_data,
+             learner->indexed_training_data_samples,
+             &stream->indexed_training_data,
+             &stream->indexed_training_data_samples,
+             &stream->indexed_training_data_capacity) != 0) ||
+        (deeplearndata_stream_reserve_meta(
+             &learner->indexed_training_data_labeled,
+             learner->indexed_training_data_labeled_samples,
+             &stream->indexed_training_data_labeled,
+             &stream->indexed_training_data_labeled_samples,
+             &stream->indexed_training_data_labeled_capacity) != 0) ||
+        (deeplearndata_stream_reserve_meta(
+             &learner->indexed_test_data,
+             learner->indexed_test_data_samples,
+             &stream->indexed_test_data,
+             &stream->indexed_test_data_samples,
+             &stream->indexed_test_data_capacity) != 0))
+        return -3;
+
+    if ((stream->chunk == 0) ||
+        (stream->chunk->used == stream->chunk_samples))
+        if (deeplearndata_stream_add_chunk(learner) != 0)
+            return -4;
+
+    chunk = stream->chunk;
+    sample = &chunk->sample[chunk->used];
+    if (deeplearndata_stream_copy_text(sample, inputs_text, fields) != 0)
+        return -5;
+
+    sample->inputs = &chunk->inputs[chunk->used*fields];
+    sample->inputs_quantised = 0;
+    sample->outputs = &chunk->outputs[chunk->used*outputs_per_sample];
+    memcpy((void*)sample->inputs, inputs, fields*sizeof(float));
+    memcpy((void*)sample->outputs, outputs,
+           outputs_per_sample*sizeof(float));
+    chunk->used++;
+
+    sample->weight = 1.0f;
+    sample->labeled = 1;
+    COUNTUP(i, outputs_per_sample) {
+        if ((int)outputs[i] == DEEPLEARN_UNKNOWN_VALUE)
+            sample->labeled = 0;
+    }
+
+    /* append to the end of the data list */
+    if (stream->tail == 0) {
+        stream->tail = learner->data;
+        while ((stream->tail != 0) && (stream->tail->next != 0))
+            stream->tail = stream->tail->next;
+    }
+    sample->prev = stream->tail;
+    sample->next = 0;
+    if (stream->tail != 0)
+        stream->tail->next = sample;
+    else
+        learner->data = sample;
+    stream->tail = sample;
+    learner->data_samples++;
+    learner->mean_sample_weight +=
+        (sample->weight - learner->mean_sample_weight) /
+        learner->data_samples;
+    learner->indexed_data[learner->indexed_data_samples++] = sample;
+    stream->indexed_data_samples = learner->indexed_data_samples;
+
+    /* assign to the training or test set */
+    test = 0;
+    if ((sample->labeled != 0) && (stream->test_data_percentage > 0))
+        test = ((int)(rand_num(&learner->net->random_seed)%100) <
+                stream->test_data_percentage);
+
+    if (test != 0) {
+        sample->flags = 0;
+        if (deeplearndata_add_test_sample(learner, sample) != 0)
+            return -6;
+        learner->indexed_test_data[learner->indexed_test_data_samples++] =
+            learner->test_data;
+        stream->indexed_test_data_samples =
+            learner->indexed_test_data_samples;
+        assigned = DEEPLEARNDATA_STREAM_TEST;
+    }
+    else {
+        sample->flags = 1;
+        if (deeplearndata_add_training_sample(learner, sample) != 0)
+            return -7;
+        learner->indexed_training_data[
+            learner->indexed_training_data_samples++] =
+            learner->training_data;
+        stream->indexed_training_data_samples =
+            learner->indexed_training_data_samples;
+
+        if (sample->labeled != 0) {
+            if (deeplearndata_add_labeled_training_sample(learner,
+                                                          sample) != 0)
+                return -8;
+            learner->indexed_training_data_labeled[
+                learner->indexed_training_data_labeled_samples++] =
+                learner->training_data_labeled;
+            stream->indexed_training_data_labeled_samples =
+                learner->indexed_training_data_labeled_samples;
+        }
+        assigned = DEEPLEARNDATA_STREAM_TRAINING;
+    }
+
+    deeplearndata_stream_update_ranges(learner, sample);
+    stream->appended++;
+    return assigned;
+}
@@ -0,0 +1,124 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARNDATA_STREAM_H
+#define DEEPLEARNDATA_STREAM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+#include "deeplearn.h"
+#include "deeplearn_memory.h"
+#include "deeplearn_random.h"
+#include "deeplearndata.h"
+
+/* default number of samples stored within each chunk */
+#define DEEPLEARNDATA_STREAM_CHUNK_SAMPLES 256
+
+/* smallest capacity of the indexed arrays once they are grown */
+#define DEEPLEARNDATA_STREAM_MIN_CAPACITY  16
+
+/* the set to which an appended sample was assigned */
+enum {
+    DEEPLEARNDATA_STREAM_TRAINING = 0,
+    DEEPLEARNDATA_STREAM_TEST
+};
+
+/* types of range passed to the renormalisation callback */
+enum {
+    DEEPLEARNDATA_STREAM_INPUT = 0,
+    DEEPLEARNDATA_STREAM_OUTPUT
+};
+
+/* Called when an appended sample extends the range of an input field
+   or output. The new range is within the range arrays of the learner,
+   and the previous one is given */
+typedef void (*deeplearndata_stream_callback)(deeplearn * learner,
+                                              int type, int index,
+                                              float previous_min,
+                                              float previous_max,
+                                              void * user_data);
+
+/* a block of samples whose values are stored contiguously */
+typedef struct deeplearndata_stream_chunk {
+    deeplearndata * sample;
+    float * inputs;
+    float * outputs;
+    int used;
+    struct deeplearndata_stream_chunk * next;
+} deeplearndata_stream_chunk;
+
+struct deeplearndata_stream {
+    int chunk_samples;
+    int test_data_percentage;
+
+    /* chunks with the most recent at the head, and the bytes
+       reserved for them against the memory budget */
+    deeplearndata_stream_chunk * chunk;
+    size_t memory;
+
+    /* last sample in the data list */
+    deeplearndata * tail;
+
+    /* indexed arrays as they were last grown, together with their
+       capacities. Arrays which have since been replaced are taken
+       to be full */
+    deeplearndata ** indexed_data;
+    int indexed_data_samples;
+    int indexed_data_capacity;
+    deeplearndata_meta ** indexed_training_data;
+    int indexed_training_data_samples;
+    int indexed_training_data_capacity;
+    deeplearndata_meta ** indexed_training_data_labeled;
+    int indexed_training_data_labeled_samples;
+    int indexed_training_data_labeled_capacity;
+    deeplearndata_meta ** indexed_test_data;
+    int indexed_test_data_samples;
+    int indexed_test_data_capacity;
+
+    deeplearndata_stream_callback renormalise;
+    void * renormalise_data;
+
+    unsigned long appended;
+};
+
+int deeplearndata_stream_init(deeplearn * learner,
+                              int test_data_percentage,
+                              int chunk_samples);
+void deeplearndata_stream_free(deeplearn * learner);
+void deeplearndata_stream_reindexed(deeplearn * learner);
+void deeplearndata_stream_set_renormalise(deeplearn * learner,
+                                          deeplearndata_stream_callback callback,
+                                          void * user_data);
+int deeplearndata_stream_append(deeplearn * learner,
+                                float inputs[], char ** inputs_text,
+                                float outputs[]);
+
+#endif
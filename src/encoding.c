@@ -77,3 +77,48 @@ int enc_text_to_binary(char * text,
     }
     return pos;
 }
+
+/**
+* @brief Encodes text into an array of input values rather than into
+*        input neurons. This can be used to prepare inputs for batch
+*        processing without altering the state of a network.
+* @param text The text string to be encoded
+* @param inputs Array of input values
+* @param no_of_inputs The number of input values
+* @param offset The index of the input value to begin inserting the text
+* @param max_field_length_chars The maximum length of a text field in characters
+* @returns current inputs index
+*/
+int enc_text_to_float(char * text,
+                      float inputs[], int no_of_inputs,
+                      int offset,
+                      int max_field_length_chars)
+{
+    int pos = offset, max_chars = strlen(text);
+
+    if (max_chars > (no_of_inputs-offset)/CHAR_BITS)
+        max_chars = ((no_of_inputs-offset)/CHAR_BITS);
+
+    if (max_chars > max_field_length_chars)
+        max_chars = max_field_length_chars;
+
+    COUNTUP(c, max_chars) {
+        COUNTUP(bit, CHAR_BITS) {
+            if (text[c] & (1<<bit))
+                inputs[pos++] = NEURON_HIGH;
+            else
+                inputs[pos++] = NEURON_LOW;
+        }
+    }
+
+    FOR(i, max_chars, max_field_length_chars) {
+        COUNTUP(bit, CHAR_BITS) {
+            if (pos >= no_of_inputs) {
+                i = max_field_length_chars;
+                break;
+            }
+            inputs[pos++] = NEURON_UNKNOWN;
+        }
+    }
+    return pos;
+}
@@ -44,6 +44,10 @@
 #define DEEPLEARN_MAX_CSV_INPUTS          2048
 #define DEEPLEARN_MAX_CSV_OUTPUTS         1024
 
+/* Field length of an input field which was constant or a duplicate of
+   another field when the data was loaded, and so has no input units */
+#define DEEPLEARN_FIELD_DROPPED          -1
+
 /* The number of bits per character in a text string */
 #define CHAR_BITS               (sizeof(char)*8)
 
@@ -77,6 +81,7 @@
 #define COUNTDOWN(i, end) for (int (i) = (end-1); (i) >= 0; (i)--)
 
 #define FLOATALLOC(m, size) m = (float*)malloc((size)*sizeof(float))
+#define DOUBLEALLOC(m, size) m = (double*)malloc((size)*sizeof(double))
 #define FLOATCLEAR(m, size) memset((void*)m, '\0', size*sizeof(float))
 
 #define CHARALLOC(m, size) m = (char*)malloc((size)*sizeof(char))
@@ -29,6 +29,9 @@
 
 #include "utils.h"
 
+#define DEEPLEARN_HASH_PRIME1 0x9E3779B185EBCA87ULL
+#define DEEPLEARN_HASH_PRIME2 0xC2B2AE3D27D4EB4FULL
+
 /**
  * @brief Returns true if the given string ends with the given extension
  * @param str The string to be tested
@@ -46,3 +49,52 @@ int string_ends_with_extension(char str[], char extension[])
 
     return (1==0);
 }
+
+/**
+ * @brief Final mixing of a 64 bit hash, so that every input bit
+ *        affects every output bit
+ * @param h Hash value
+ * @returns mixed hash value
+ */
+static uint64_t deeplearn_hash64_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * @brief Returns a 64 bit hash of the given data. Eight bytes are
+ *        consumed at a time, so this is fast for arrays of values
+ * @param data The data to be hashed
+ * @param length Length of the data in bytes
+ * @param seed Initial value, which can be a previous hash in order to
+ *        hash several pieces of data in sequence
+ * @returns hash value
+ */
+uint64_t deeplearn_hash64(const void * data, int length, uint64_t seed)
+{
+    const unsigned char * bytes = (const unsigned char*)data;
+    uint64_t h = seed ^ ((uint64_t)length * DEEPLEARN_HASH_PRIME1);
+    uint64_t word;
+    int i = 0;
+
+    while (i + 8 <= length) {
+        memcpy(&word, &bytes[i], 8);
+        h ^= word * DEEPLEARN_HASH_PRIME2;
+        h = ((h << 31) | (h >> 33)) * DEEPLEARN_HASH_PRIME1;
+        i += 8;
+    }
+
+    if (i < length) {
+        word = 0;
+        memcpy(&word, &bytes[i], length - i);
+        h ^= word * DEEPLEARN_HASH_PRIME2;
+        h = ((h << 31) | (h >> 33)) * DEEPLEARN_HASH_PRIME1;
+    }
+
+    return deeplearn_hash64_mix(h);
+}
@@ -33,7 +33,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 int string_ends_with_extension(char str[], char extension[]);
+uint64_t deeplearn_hash64(const void * data, int length, uint64_t seed);
 
 #endif
@@ -0,0 +1,402 @@
+/*
+ libdeep-score: scores the rows of a CSV file using a saved model
+ Copyright (C) 2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ The CSV file is memory mapped and processed in blocks of rows.
+ Within each block the rows are parsed, scored and formatted in parallel,
+ then written out in their original order.
+
+ Usage:
+
+   libdeep-score -m model.net -i data.csv [-o scores.csv] [--classes]
+                 [--skip 4,5] [--batch 256] [--block 65536] [--threads 8]
+
+ --skip gives the zero based indexes of any columns which are not inputs
+ to the model, such as the output fields of a labeled data set.
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include "libdeep/globals.h"
+#include "libdeep/deeplearn.h"
+
+#define SCORE_DEFAULT_BATCH_SIZE   256
+#define SCORE_DEFAULT_BLOCK_ROWS   65536
+#define SCORE_WRITE_BUFFER_BYTES   (4*1024*1024)
+
+/* maximum number of characters needed to format one output value */
+#define SCORE_VALUE_CHARS          24
+
+deeplearn learner;
+
+/**
+* @brief Parses a comma separated list of column indexes to be skipped
+* @param list The comma separated list
+* @param skip Array of flags, one per column
+* @param max_columns The size of the skip array
+*/
+static void parse_skip_columns(char * list, unsigned char * skip,
+                               int max_columns)
+{
+    char * end;
+
+    while (*list != 0) {
+        long index = strtol(list, &end, 10);
+        if (end == list)
+            break;
+        if ((index >= 0) && (index < max_columns))
+            skip[index] = 1;
+        list = end;
+        if (*list == ',')
+            list++;
+    }
+}
+
+/**
+* @brief Splits a line of the CSV file into the fields used by the model
+*        and converts them into network input values.
+*        Fields are separated in the same way as within deeplearndata_read_csv
+* @param line Start of the line
+* @param length Length of the line, excluding the newline
+* @param newline Non-zero if the line was terminated by a newline
+* @param skip Flags for columns which are not model inputs
+* @param max_columns The size of the skip array
+* @param no_of_fields The number of input fields expected by the model
+* @param fields Returned numeric field values
+* @param fields_text Buffers for text field values
+* @param inputs Returned network input values
+*/
+static void parse_row(char * line, int length, int newline,
+                      unsigned char * skip, int max_columns,
+                      int no_of_fields,
+                      float * fields, char ** fields_text,
+                      float * inputs)
+{
+    char valuestr[DEEPLEARN_MAX_FIELD_LENGTH_CHARS];
+    int column = 0, field = 0, ctr = 0;
+
+    COUNTDOWN(i, no_of_fields) {
+        fields[i] = 0;
+        if (fields_text)
+            fields_text[i][0] = 0;
+    }
+
+    COUNTUP(i, length+1) {
+        if ((i < length) && (line[i] != ',') && (line[i] != ';')) {
+            if (ctr < DEEPLEARN_MAX_FIELD_LENGTH_CHARS-2)
+                valuestr[ctr++] = line[i];
+            continue;
+        }
+
+        /* the newline remains part of the last field when training,
+           so do the same here in order for text encodings to match */
+        if ((i == length) && (newline != 0))
+            valuestr[ctr++] = '\n';
+        valuestr[ctr] = 0;
+        ctr = 0;
+
+        if ((column < max_columns) && (skip[column] != 0)) {
+            column++;
+            continue;
+        }
+        column++;
+
+        if (field >= no_of_fields)
+            break;
+
+        if ((learner.no_of_input_fields > 0) &&
+            (learner.field_length[field] > 0)) {
+            if (fields_text)
+                strcpy(fields_text[field], valuestr);
+        }
+        else if (valuestr[0] != '?') {
+            fields[field] = strtof(valuestr, NULL);
+        }
+        field++;
+    }
+
+    deeplearn_fields_to_inputs(&learner, fields, fields_text, inputs);
+}
+
+/**
+* @brief Formats the result for a row of the CSV file
+* @param values Network output values for the row
+* @param classes Non-zero if the class number should be returned
+* @param str Returned text
+* @param max_length Maximum length of the returned text
+* @return length of the returned text
+*/
+static int format_row(float * values, int classes,
+                      char * str, int max_length)
+{
+    float outputs[DEEPLEARN_MAX_CSV_OUTPUTS];
+    int length = 0;
+
+    if (classes != 0)
+        return snprintf(str, max_length, "%d\n",
+                        deeplearn_class_from_values(&learner, values));
+
+    deeplearn_outputs_from_values(&learner, values, outputs);
+    COUNTUP(i, learner.net->no_of_outputs) {
+        length += snprintf(&str[length], max_length - length,
+                           (i > 0) ? ",%g" : "%g", outputs[i]);
+    }
+    length += snprintf(&str[length], max_length - length, "\n");
+    return length;
+}
+
+/**
+* @brief Main function
+*/
+int main(int argc, char* argv[])
+{
+    char * model_filename = NULL, * input_filename = NULL;
+    char * output_filename = NULL;
+    int classes = 0, threads = omp_get_num_procs();
+    int batch_size = SCORE_DEFAULT_BATCH_SIZE;
+    int block_rows = SCORE_DEFAULT_BLOCK_ROWS;
+    unsigned char skip[DEEPLEARN_MAX_CSV_INPUTS];
+    int no_of_fields, no_of_inputs, no_of_outputs, slot_length, rows;
+    int fd, has_text = 0;
+    struct stat st;
+    char * data, * out_buffer, * write_buffer;
+    long * row_start;
+    int * row_length, * out_length;
+    unsigned char * row_newline;
+    float * inputs, * values;
+    size_t pos = 0, size;
+    long total_rows = 0;
+    FILE * fp, * out;
+
+    memset(skip, 0, sizeof(skip));
+
+    FOR(i, 1, argc) {
+        if ((strcmp(argv[i], "-m") == 0) && (i+1 < argc))
+            model_filename = argv[++i];
+        else if ((strcmp(argv[i], "-i") == 0) && (i+1 < argc))
+            input_filename = argv[++i];
+        else if ((strcmp(argv[i], "-o") == 0) && (i+1 < argc))
+            output_filename = argv[++i];
+        else if (strcmp(argv[i], "--classes") == 0)
+            classes = 1;
+        else if ((strcmp(argv[i], "--skip") == 0) && (i+1 < argc))
+            parse_skip_columns(argv[++i], skip, DEEPLEARN_MAX_CSV_INPUTS);
+        else if ((strcmp(argv[i], "--batch") == 0) && (i+1 < argc))
+            batch_size = atoi(argv[++i]);
+        else if ((strcmp(argv[i], "--block") == 0) && (i+1 < argc))
+            block_rows = atoi(argv[++i]);
+        else if ((strcmp(argv[i], "--threads") == 0) && (i+1 < argc))
+            threads = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if ((!model_filename) || (!input_filename)) {
+        fprintf(stderr, "Usage: libdeep-score -m model -i data.csv " \
+                "[-o scores.csv] [--classes] [--skip 4,5] [--batch 256] " \
+                "[--block 65536] [--threads 8]\n");
+        return 1;
+    }
+    if (batch_size < 1) batch_size = 1;
+    if (block_rows < batch_size) block_rows = batch_size;
+    if (threads < 1) threads = 1;
+
+    /* load the model */
+    fp = fopen(model_filename, "rb");
+    if (!fp) {
+        fprintf(stderr, "Unable to open model %s\n", model_filename);
+        return 2;
+    }
+    if (deeplearn_load(fp, &learner) != 0) {
+        fprintf(stderr, "Unable to load model %s\n", model_filename);
+        fclose(fp);
+        return 2;
+    }
+    fclose(fp);
+
+    no_of_inputs = learner.net->no_of_inputs;
+    no_of_outputs = learner.net->no_of_outputs;
+    no_of_fields = learner.no_of_input_fields;
+    if (no_of_fields == 0)
+        no_of_fields = no_of_inputs;
+    COUNTDOWN(i, learner.no_of_input_fields) {
+        if (learner.field_length[i] > 0)
+            has_text = 1;
+    }
+
+    /* map the input file */
+    fd = open(input_filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Unable to open %s\n", input_filename);
+        return 3;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 3;
+    }
+    size = (size_t)st.st_size;
+    data = NULL;
+    if (size > 0) {
+        data = (char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "Unable to map %s\n", input_filename);
+            close(fd);
+            return 3;
+        }
+        posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+    }
+
+    out = stdout;
+    if (output_filename) {
+        out = fopen(output_filename, "w");
+        if (!out) {
+            fprintf(stderr, "Unable to write to %s\n", output_filename);
+            return 4;
+        }
+    }
+    CHARALLOC(write_buffer, SCORE_WRITE_BUFFER_BYTES);
+    if (write_buffer)
+        setvbuf(out, write_buffer, _IOFBF, SCORE_WRITE_BUFFER_BYTES);
+
+    /* buffers for a block of rows */
+    slot_length = (no_of_outputs * SCORE_VALUE_CHARS) + 2;
+    row_start = (long*)malloc(block_rows*sizeof(long));
+    INTALLOC(row_length, block_rows);
+    INTALLOC(out_length, block_rows);
+    UCHARALLOC(row_newline, block_rows);
+    FLOATALLOC(inputs, block_rows*no_of_inputs);
+    FLOATALLOC(values, block_rows*no_of_outputs);
+    CHARALLOC(out_buffer, block_rows*slot_length);
+    if ((!row_start) || (!row_length) || (!out_length) || (!row_newline) ||
+        (!inputs) || (!values) || (!out_buffer)) {
+        fprintf(stderr, "Unable to allocate memory\n");
+        return 5;
+    }
+
+    while (pos < size) {
+        /* find the start of each row within the block */
+        rows = 0;
+        while ((rows < block_rows) && (pos < size)) {
+            char * eol = (char*)memchr(&data[pos], '\n', size - pos);
+            size_t length = eol ? (size_t)(eol - &data[pos]) : size - pos;
+
+            /* skip empty lines and comments */
+            if ((length > 0) && (data[pos] != '"') && (data[pos] != '#') &&
+                (data[pos] != '\r')) {
+                row_start[rows] = (long)pos;
+                row_length[rows] = (int)length;
+                row_newline[rows] = (eol != NULL);
+                rows++;
+            }
+            pos += length + 1;
+        }
+
+        /* parse the rows */
+#pragma omp parallel num_threads(threads)
+        {
+            float * fields;
+            char ** fields_text = NULL;
+            char * text = NULL;
+
+            FLOATALLOC(fields, no_of_fields);
+            if (has_text) {
+                fields_text = (char**)malloc(no_of_fields*sizeof(char*));
+                CHARALLOC(text,
+                          no_of_fields*DEEPLEARN_MAX_FIELD_LENGTH_CHARS);
+                COUNTDOWN(i, no_of_fields)
+                    fields_text[i] = &text[i*DEEPLEARN_MAX_FIELD_LENGTH_CHARS];
+            }
+
+#pragma omp for schedule(static)
+            COUNTDOWN(r, rows)
+                parse_row(&data[row_start[r]], row_length[r], row_newline[r],
+                          skip, DEEPLEARN_MAX_CSV_INPUTS, no_of_fields,
+                          fields, fields_text, &inputs[r*no_of_inputs]);
+
+            free(fields);
+            if (has_text) {
+                free(fields_text);
+                free(text);
+            }
+        }
+
+        /* score the rows in batches */
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+        COUNTDOWN(b, (rows + batch_size - 1) / batch_size) {
+            int start = b*batch_size;
+            int n = rows - start;
+            if (n > batch_size) n = batch_size;
+            deeplearn_feed_forward_batch(&learner, n,
+                                         &inputs[start*no_of_inputs],
+                                         &values[start*no_of_outputs]);
+        }
+
+        /* format the results */
+#pragma omp parallel for schedule(static) num_threads(threads)
+        COUNTDOWN(r, rows)
+            out_length[r] = format_row(&values[r*no_of_outputs], classes,
+                                       &out_buffer[r*slot_length],
+                                       slot_length);
+
+        /* write them in their original order */
+        COUNTUP(r, rows)
+            fwrite(&out_buffer[r*slot_length], 1, out_length[r], out);
+
+        total_rows += rows;
+    }
+
+    fflush(out);
+    if (out != stdout)
+        fclose(out);
+    fprintf(stderr, "%ld rows scored\n", total_rows);
+
+    if (data)
+        munmap(data, size);
+    close(fd);
+    free(row_start);
+    free(row_length);
+    free(out_length);
+    free(row_newline);
+    free(inputs);
+    free(values);
+    free(out_buffer);
+    deeplearn_free(&learner);
+    free(write_buffer);
+    return 0;
+}
@@ -40,6 +40,24 @@
 #include "tests_conv.h"
 #include "tests_deepconvnet.h"
 #include "tests_autocoder.h"
+#include "tests_ensemble.h"
+#include "tests_async.h"
+#include "tests_cache.h"
+#include "tests_metrics.h"
+#include "tests_trace.h"
+#include "tests_perf.h"
+#include "tests_delta.h"
+#include "tests_labels.h"
+#include "tests_grow.h"
+#include "tests_sampler.h"
+#include "tests_fixed.h"
+#include "tests_executor.h"
+#include "tests_tune.h"
+#include "tests_memory.h"
+#include "tests_datacache.h"
+#include "tests_stream.h"
+#include "tests_crossval.h"
+#include "tests_quantise.h"
 
 int main(int argc, char* argv[])
 {
@@ -55,6 +73,24 @@ int main(int argc, char* argv[])
     run_tests_features();
     run_tests_conv();
     run_tests_deepconvnet();
+    run_tests_ensemble();
+    run_tests_async();
+    run_tests_cache();
+    run_tests_metrics();
+    run_tests_trace();
+    run_tests_perf();
+    run_tests_delta();
+    run_tests_labels();
+    run_tests_grow();
+    run_tests_sampler();
+    run_tests_fixed();
+    run_tests_executor();
+    run_tests_tune();
+    run_tests_memory();
+    run_tests_datacache();
+    run_tests_stream();
+    run_tests_crossval();
+    run_tests_quantise();
 
     printf("\nAll tests completed\n");
 
@@ -0,0 +1,152 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_async.h"
+
+#define ASYNC_TEST_REQUESTS 200
+
+struct async_test_result {
+    int calls;
+    int status;
+    float outputs[4];
+};
+
+static void test_async_callback(long id, int status,
+                                float outputs[], int no_of_outputs,
+                                void * user_data)
+{
+    struct async_test_result * result = (struct async_test_result*)user_data;
+
+    result->calls++;
+    result->status = status;
+    if (status == DEEPLEARN_ASYNC_COMPLETE)
+        memcpy(result->outputs, outputs, no_of_outputs*sizeof(float));
+}
+
+static void test_async_predict()
+{
+    deeplearn learner;
+    deeplearn_async handle;
+    int no_of_inputs=6;
+    int no_of_hiddens=8;
+    int hidden_layers=2;
+    int no_of_outputs=4;
+    float error_threshold[] = { 0.01f, 0.01f, 0.01f };
+    unsigned int random_seed = 123;
+    float inputs[ASYNC_TEST_REQUESTS*6];
+    float outputs[ASYNC_TEST_REQUESTS*4];
+    struct async_test_result results[ASYNC_TEST_REQUESTS];
+    long id[ASYNC_TEST_REQUESTS];
+    int cancelled[ASYNC_TEST_REQUESTS];
+    int refused = 0;
+
+    printf("test_async_predict...");
+
+    assert(deeplearn_init(&learner,
+                          no_of_inputs, no_of_hiddens,
+                          hidden_layers,
+                          no_of_outputs,
+                          error_threshold,
+                          &random_seed) == 0);
+
+    for (int i = 0; i < ASYNC_TEST_REQUESTS*no_of_inputs; i++)
+        inputs[i] = NEURON_LOW +
+            ((rand_num(&random_seed)%10000)/10000.0f)*NEURON_RANGE;
+
+    /* expected outputs */
+    assert(deeplearn_feed_forward_batch(&learner, ASYNC_TEST_REQUESTS,
+                                        inputs, outputs) == 0);
+
+    assert(deeplearn_async_init(&handle, &learner, 3, 8,
+                                ASYNC_TEST_REQUESTS) == 0);
+
+    memset(results, 0, sizeof(results));
+    for (int i = 0; i < ASYNC_TEST_REQUESTS; i++) {
+        id[i] = deeplearn_predict_async(&handle, &inputs[i*no_of_inputs],
+                                        test_async_callback, &results[i]);
+        assert(id[i] > 0);
+    }
+
+    /* try to cancel the later requests. Some may already have
+       been processed */
+    for (int i = 0; i < ASYNC_TEST_REQUESTS; i++) {
+        cancelled[i] = 0;
+        if (i >= ASYNC_TEST_REQUESTS/2)
+            cancelled[i] = (deeplearn_async_cancel(&handle, id[i]) == 0);
+    }
+
+    deeplearn_async_wait(&handle);
+    assert(deeplearn_async_pending(&handle) == 0);
+
+    /* cancelling a completed request fails */
+    assert(deeplearn_async_cancel(&handle, id[0]) != 0);
+
+    for (int i = 0; i < ASYNC_TEST_REQUESTS; i++) {
+        /* every callback is invoked exactly once */
+        assert(results[i].calls == 1);
+        if (cancelled[i] != 0) {
+            assert(results[i].status == DEEPLEARN_ASYNC_CANCELLED);
+            continue;
+        }
+        assert(results[i].status == DEEPLEARN_ASYNC_COMPLETE);
+        for (int j = 0; j < no_of_outputs; j++)
+            assert(fabs(results[i].outputs[j] -
+                        outputs[i*no_of_outputs + j]) < 0.0001f);
+    }
+
+    deeplearn_async_free(&handle);
+
+    /* with a small queue some requests are refused */
+    assert(deeplearn_async_init(&handle, &learner, 1, 1, 2) == 0);
+    memset(results, 0, sizeof(results));
+    for (int i = 0; i < ASYNC_TEST_REQUESTS; i++) {
+        if (deeplearn_predict_async(&handle, &inputs[i*no_of_inputs],
+                                    test_async_callback, &results[i]) < 0)
+            refused++;
+    }
+    deeplearn_async_free(&handle);
+
+    for (int i = 0; i < ASYNC_TEST_REQUESTS; i++)
+        refused += results[i].calls;
+    assert(refused == ASYNC_TEST_REQUESTS);
+
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+int run_tests_async()
+{
+    printf("\nRunning async tests\n");
+
+    test_async_predict();
+
+    printf("All async tests completed\n");
+    return 0;
+}
@@ -187,6 +187,273 @@ static void test_backprop_feed_forward()
     printf("Ok\n");
 }
 
+static void test_backprop_feed_forward_batch()
+{
+    bp net;
+    int no_of_inputs=10;
+    int no_of_hiddens=4;
+    int hidden_layers=3;
+    int no_of_outputs=5;
+    int batch_size=7;
+    int i, b;
+    unsigned int random_seed = 123;
+    float inputs[7*10], outputs[7*5];
+
+    printf("test_backprop_feed_forward_batch...");
+
+    bp_init(&net,
+            no_of_inputs, no_of_hiddens,
+            hidden_layers,
+            no_of_outputs, &random_seed);
+
+    for (i = 0; i < batch_size*no_of_inputs; i++)
+        inputs[i] = NEURON_LOW +
+            ((rand_num(&random_seed)%10000)/10000.0f)*NEURON_RANGE;
+
+    assert(bp_feed_forward_batch(&net, 0, inputs, outputs) != 0);
+    assert(bp_feed_forward_batch(&net, batch_size, inputs, outputs) == 0);
+
+    /* each sample should give the same result as a single feed forward */
+    for (b = 0; b < batch_size; b++) {
+        for (i = 0; i < no_of_inputs; i++)
+            bp_set_input(&net, i, inputs[b*no_of_inputs + i]);
+
+        bp_feed_forward(&net);
+
+        for (i = 0; i < no_of_outputs; i++)
+            assert(fabs(bp_get_output(&net, i) -
+                        outputs[b*no_of_outputs + i]) < 0.0001f);
+    }
+
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+static void test_backprop_reproject_layer()
+{
+    bp net;
+    int no_of_inputs=10;
+    int no_of_hiddens=8;
+    int hidden_layers=3;
+    int no_of_outputs=5;
+    int i, l, u;
+    unsigned int random_seed = 123;
+    float reprojected[8*10];
+
+    printf("test_backprop_reproject_layer...");
+
+    bp_init(&net,
+            no_of_inputs, no_of_hiddens,
+            hidden_layers,
+            no_of_outputs, &random_seed);
+
+    assert(bp_reproject_layer(&net, -1, reprojected) != 0);
+    assert(bp_reproject_layer(&net, hidden_layers, reprojected) != 0);
+
+    /* every unit should give the same result as reprojecting it alone */
+    for (l = 0; l < hidden_layers; l++) {
+        assert(bp_reproject_layer(&net, l, reprojected) == 0);
+
+        for (u = 0; u < HIDDENS_IN_LAYER(&net,l); u++) {
+            bp_reproject(&net, l, u);
+
+            for (i = 0; i < no_of_inputs; i++)
+                assert(fabs(net.inputs[i]->value_reprojected -
+                            reprojected[u*no_of_inputs + i]) < 0.0001f);
+        }
+    }
+
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+static void test_backprop_reproject_layer_widening()
+{
+    bp net;
+    int no_of_inputs=4;
+    int no_of_hiddens=6;
+    int hidden_layers=4;
+    int no_of_outputs=30;
+    int i, l, u;
+    unsigned int random_seed = 123;
+    float reprojected[30*4];
+
+    printf("test_backprop_reproject_layer_widening...");
+
+    bp_init(&net,
+            no_of_inputs, no_of_hiddens,
+            hidden_layers,
+            no_of_outputs, &random_seed);
+
+    /* hidden layers widen towards the outputs */
+    assert(HIDDENS_IN_LAYER(&net, hidden_layers-1) > no_of_hiddens);
+    assert(HIDDENS_IN_LAYER(&net, hidden_layers-1) > no_of_inputs);
+    for (l = 0; l < hidden_layers; l++) {
+        assert(bp_reproject_layer(&net, l, reprojected) == 0);
+
+        for (u = 0; u < HIDDENS_IN_LAYER(&net,l); u++) {
+            bp_reproject(&net, l, u);
+
+            for (i = 0; i < no_of_inputs; i++)
+                assert(fabs(net.inputs[i]->value_reprojected -
+                            reprojected[u*no_of_inputs + i]) < 0.0001f);
+        }
+    }
+
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+static void test_backprop_freeze()
+{
+    bp net;
+    int no_of_inputs=10;
+    int no_of_hiddens=8;
+    int hidden_layers=3;
+    int no_of_outputs=3;
+    int i, l, t;
+    unsigned int random_seed = 123;
+    float weights[2][8*10];
+    float top_weight;
+
+    printf("test_backprop_freeze...");
+
+    bp_init(&net,
+            no_of_inputs, no_of_hiddens,
+            hidden_layers,
+            no_of_outputs, &random_seed);
+
+    assert(bp_freeze_layer(&net, hidden_layers, 1) != 0);
+    assert(bp_freeze_layer(&net, 0, 1) == 0);
+    assert(bp_freeze_layer(&net, 1, 1) == 0);
+    assert(bp_layer_frozen(&net, 0) != 0);
+    assert(bp_layer_frozen(&net, 2) == 0);
+
+    for (l = 0; l < 2; l++)
+        for (i = 0; i < HIDDENS_IN_LAYER(&net,l); i++)
+            memcpy(&weights[l][i*no_of_inputs], net.hiddens[l][i]->weights,
+                   net.hiddens[l][i]->no_of_inputs*sizeof(float));
+    top_weight = net.hiddens[2][0]->weights[0];
+
+    for (t = 0; t < 20; t++) {
+        for (i = 0; i < no_of_inputs; i++)
+            bp_set_input(&net, i, (rand_num(&random_seed)%10000)/10000.0f);
+        for (i = 0; i < no_of_outputs; i++)
+            bp_set_output(&net, i, (rand_num(&random_seed)%10000)/10000.0f);
+        bp_update(&net, 0);
+    }
+
+    /* frozen layers are unchanged and receive no errors */
+    for (l = 0; l < 2; l++) {
+        for (i = 0; i < HIDDENS_IN_LAYER(&net,l); i++) {
+            assert(memcmp(&weights[l][i*no_of_inputs],
+                          net.hiddens[l][i]->weights,
+                          net.hiddens[l][i]->no_of_inputs*sizeof(float)) == 0);
+            assert(net.hiddens[l][i]->backprop_error == 0);
+        }
+    }
+
+    /* the layer above is still trained */
+    assert(net.hiddens[2][0]->weights[0] != top_weight);
+
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+static void test_backprop_softmax()
+{
+    bp net, loaded;
+    int no_of_inputs=6;
+    int no_of_hiddens=8;
+    int hidden_layers=1;
+    int no_of_outputs=4;
+    int i, t, c, hits = 0;
+    unsigned int random_seed = 123;
+    float outputs[4], buffer[16], total;
+    char filename[256];
+    FILE * fp;
+
+    printf("test_backprop_softmax...");
+
+    bp_init(&net,
+            no_of_inputs, no_of_hiddens,
+            hidden_layers,
+            no_of_outputs, &random_seed);
+
+    assert(bp_set_output_activation(&net, 5) != 0);
+    assert(bp_set_output_activation(&net, BP_OUTPUT_SOFTMAX) == 0);
+    net.dropout_percent = 0;
+
+    /* the outputs are probabilities within the neuron range */
+    for (i = 0; i < no_of_inputs; i++)
+        bp_set_input(&net, i, (rand_num(&random_seed)%10000)/10000.0f);
+    bp_feed_forward(&net);
+
+    total = 0;
+    for (i = 0; i < no_of_outputs; i++) {
+        assert(bp_get_output(&net, i) > NEURON_LOW);
+        assert(bp_get_output(&net, i) < NEURON_HIGH);
+        total += (bp_get_output(&net, i) - NEURON_LOW) / NEURON_RANGE;
+    }
+    assert(fabs(total - 1.0f) < 0.0001f);
+
+    /* the stateless version gives the same outputs */
+    {
+        float inputs[6];
+        for (i = 0; i < no_of_inputs; i++)
+            inputs[i] = bp_get_input(&net, i);
+        bp_feed_forward_sample(&net, inputs, outputs, buffer);
+        for (i = 0; i < no_of_outputs; i++)
+            assert(fabs(outputs[i] - bp_get_output(&net, i)) < 0.0001f);
+    }
+
+    /* learn to classify which of the first four inputs is active */
+    for (t = 0; t < 12000; t++) {
+        c = t % no_of_outputs;
+        for (i = 0; i < no_of_inputs; i++)
+            bp_set_input(&net, i, (i == c) ? NEURON_HIGH : NEURON_LOW);
+        for (i = 0; i < no_of_outputs; i++)
+            bp_set_output(&net, i, (i == c) ? NEURON_HIGH : NEURON_LOW);
+        bp_update(&net, 0);
+    }
+
+    for (c = 0; c < no_of_outputs; c++) {
+        int winner = 0;
+        for (i = 0; i < no_of_inputs; i++)
+            bp_set_input(&net, i, (i == c) ? NEURON_HIGH : NEURON_LOW);
+        bp_feed_forward(&net);
+        for (i = 1; i < no_of_outputs; i++) {
+            if (bp_get_output(&net, i) > bp_get_output(&net, winner))
+                winner = i;
+        }
+        if (winner == c) hits++;
+    }
+    assert(hits == no_of_outputs);
+
+    /* the output activation is saved */
+    sprintf(filename,"%stemp_deep_softmax.dat",DEEPLEARN_TEMP_DIRECTORY);
+    fp = fopen(filename,"wb");
+    assert(fp!=0);
+    assert(bp_save(fp, &net) == 0);
+    fclose(fp);
+
+    fp = fopen(filename,"rb");
+    assert(fp!=0);
+    assert(bp_load(fp, &loaded) == 0);
+    fclose(fp);
+    assert(loaded.output_activation == BP_OUTPUT_SOFTMAX);
+    assert(bp_compare(&net, &loaded) == 1);
+
+    bp_free(&net);
+    bp_free(&loaded);
+
+    printf("Ok\n");
+}
+
 static void test_backprop2()
 {
     bp net;
@@ -337,6 +604,62 @@ static void test_backprop_update()
     printf("Ok\n");
 }
 
+static void test_backprop_sample_weight()
+{
+    bp net1, net2;
+    int no_of_inputs=10;
+    int no_of_hiddens=4;
+    int hidden_layers=2;
+    int no_of_outputs=3;
+    unsigned int random_seed1 = 123, random_seed2 = 123;
+
+    printf("test_backprop_sample_weight...");
+
+    assert(bp_init(&net1, no_of_inputs, no_of_hiddens, hidden_layers,
+                   no_of_outputs, &random_seed1) == 0);
+    assert(bp_init(&net2, no_of_inputs, no_of_hiddens, hidden_layers,
+                   no_of_outputs, &random_seed2) == 0);
+    assert(net1.sample_weight == 1.0f);
+    assert(bp_set_sample_weight(&net2, 0) != 0);
+    assert(bp_set_sample_weight(&net2, 0.5f) == 0);
+
+    for (int i = 0; i < no_of_inputs; i++) {
+        bp_set_input(&net1, i, i/(float)no_of_inputs);
+        bp_set_input(&net2, i, i/(float)no_of_inputs);
+    }
+    for (int i = 0; i < no_of_outputs; i++) {
+        bp_set_output(&net1, i, 0.8f);
+        bp_set_output(&net2, i, 0.8f);
+    }
+
+    bp_feed_forward(&net1);
+    bp_feed_forward(&net2);
+    bp_backprop(&net1, hidden_layers);
+    bp_backprop(&net2, hidden_layers);
+
+    /* the gradient is weighted, but not the reported error */
+    for (int i = 0; i < no_of_outputs; i++)
+        assert(fabs(net2.outputs[i]->backprop_error -
+                    net1.outputs[i]->backprop_error*0.5f) < 0.0001f);
+    for (int i = 0; i < no_of_hiddens; i++)
+        assert(fabs(net2.hiddens[hidden_layers-1][i]->backprop_error -
+                    net1.hiddens[hidden_layers-1][i]->backprop_error*0.5f) <
+               0.0001f);
+    assert(fabs(bp_get_output_error(&net2) -
+                bp_get_output_error(&net1)) < 0.0001f);
+    assert(fabs(net2.backprop_error - net1.backprop_error) < 0.0001f);
+
+    /* the error of the last step remains once the weight is reset */
+    assert(bp_set_sample_weight(&net2, 1.0f) == 0);
+    assert(fabs(bp_get_output_error(&net2) -
+                bp_get_output_error(&net1)) < 0.0001f);
+
+    bp_free(&net1);
+    bp_free(&net2);
+
+    printf("Ok\n");
+}
+
 static void test_backprop_training()
 {
     bp * net;
@@ -572,6 +895,70 @@ static void test_backprop_save_load()
     printf("Ok\n");
 }
 
+static void test_backprop_load_unversioned()
+{
+    bp net1, net2;
+    int no_of_inputs=10, no_of_hiddens=4, no_of_outputs=3, hidden_layers=3;
+    int version = BP_FILE_VERSION + 1;
+    unsigned int random_seed = 5172;
+    char filename[256];
+    FILE * fp;
+
+    printf("test_backprop_load_unversioned...");
+
+    bp_init(&net1, no_of_inputs, no_of_hiddens,
+            hidden_layers, no_of_outputs, &random_seed);
+    net1.itterations = 42;
+
+    /* the layout used before saved networks had a version */
+    sprintf(filename,"%stemp_deep_unversioned.dat",DEEPLEARN_TEMP_DIRECTORY);
+    fp = fopen(filename,"wb");
+    assert(fp!=0);
+    assert(fwrite(&net1.itterations, sizeof(unsigned int), 1, fp) == 1);
+    assert(fwrite(&net1.no_of_inputs, sizeof(int), 1, fp) == 1);
+    assert(fwrite(&net1.no_of_hiddens, sizeof(int), 1, fp) == 1);
+    assert(fwrite(&net1.no_of_outputs, sizeof(int), 1, fp) == 1);
+    assert(fwrite(&net1.hidden_layers, sizeof(int), 1, fp) == 1);
+    assert(fwrite(&net1.learning_rate, sizeof(float), 1, fp) == 1);
+    assert(fwrite(&net1.noise, sizeof(float), 1, fp) == 1);
+    assert(fwrite(&net1.backprop_error_average, sizeof(float), 1, fp) == 1);
+    assert(fwrite(&net1.dropout_percent, sizeof(float), 1, fp) == 1);
+    assert(fwrite(&net1.random_seed, sizeof(unsigned int), 1, fp) == 1);
+    for (int l = 0; l < hidden_layers; l++)
+        for (int i = 0; i < HIDDENS_IN_LAYER(&net1,l); i++)
+            assert(bp_neuron_save(fp, net1.hiddens[l][i]) == 0);
+    for (int i = 0; i < no_of_outputs; i++)
+        assert(bp_neuron_save(fp, net1.outputs[i]) == 0);
+    fclose(fp);
+
+    /* it loads with sigmoid outputs */
+    fp = fopen(filename,"rb");
+    assert(fp!=0);
+    assert(bp_load(fp, &net2) == 0);
+    fclose(fp);
+    assert(bp_compare(&net1, &net2) == 1);
+    assert(net2.itterations == 42);
+    assert(net2.output_activation == BP_OUTPUT_SIGMOID);
+    bp_free(&net2);
+
+    /* networks from a later version of the format are rejected */
+    fp = fopen(filename,"wb");
+    assert(fp!=0);
+    assert(bp_save(fp, &net1) == 0);
+    fseek(fp, sizeof(unsigned int), SEEK_SET);
+    assert(fwrite(&version, sizeof(int), 1, fp) == 1);
+    fclose(fp);
+    fp = fopen(filename,"rb");
+    assert(fp!=0);
+    assert(bp_load(fp, &net2) == -16);
+    fclose(fp);
+
+    bp_free(&net1);
+    remove(filename);
+
+    printf("Ok\n");
+}
+
 static void test_backprop_classification_from_filename()
 {
     char classification[256];
@@ -614,12 +1001,19 @@ int run_tests_backprop()
     test_backprop_neuron_copy();
     test_backprop_init();
     test_backprop_feed_forward();
+    test_backprop_feed_forward_batch();
+    test_backprop_reproject_layer();
+    test_backprop_reproject_layer_widening();
     test_backprop1();
     test_backprop2();
     test_backprop_update();
+    test_backprop_freeze();
+    test_backprop_softmax();
+    test_backprop_sample_weight();
     test_backprop_training();
     test_backprop_neuron_save_load();
     test_backprop_save_load();
+    test_backprop_load_unversioned();
     test_backprop_inputs_from_image();
     test_backprop_autocoder();
     test_backprop_classification_from_filename();
@@ -0,0 +1,317 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_cache.h"
+
+static void test_cache_hash()
+{
+    float a[] = { 1.0f, 2.0f, 3.0f };
+    float b[] = { 1.0f, 2.0f, 3.5f };
+
+    printf("test_cache_hash...");
+
+    assert(deeplearn_hash64(a, sizeof(a), 0) ==
+           deeplearn_hash64(a, sizeof(a), 0));
+    assert(deeplearn_hash64(a, sizeof(a), 0) !=
+           deeplearn_hash64(b, sizeof(b), 0));
+    assert(deeplearn_hash64(a, sizeof(a), 0) !=
+           deeplearn_hash64(a, sizeof(a), 1));
+    assert(deeplearn_hash64("abc", 3, 0) != deeplearn_hash64("abd", 3, 0));
+
+    printf("Ok\n");
+}
+
+static void test_cache_numeric()
+{
+    deeplearn learner;
+    deeplearn_cache cache;
+    deeplearn_cache_stats stats;
+    int no_of_inputs=4;
+    int no_of_hiddens=8;
+    int hidden_layers=2;
+    int no_of_outputs=3;
+    float error_threshold[] = { 0.01f, 0.01f, 0.01f };
+    unsigned int random_seed = 123;
+    float fields[6][4];
+    float inputs[4];
+    float outputs[3], expected[3];
+    char * filename = "/tmp/libdeep_cache_model.dat";
+    FILE * fp;
+
+    printf("test_cache_numeric...");
+
+    assert(deeplearn_init(&learner,
+                          no_of_inputs, no_of_hiddens,
+                          hidden_layers,
+                          no_of_outputs,
+                          error_threshold,
+                          &random_seed) == 0);
+
+    for (int i = 0; i < no_of_inputs; i++) {
+        learner.input_range_min[i] = 0;
+        learner.input_range_max[i] = 10;
+    }
+
+    for (int s = 0; s < 6; s++)
+        for (int i = 0; i < no_of_inputs; i++)
+            fields[s][i] = (rand_num(&random_seed)%1000)/100.0f;
+
+    /* a single shard holding four predictions */
+    assert(deeplearn_cache_init(&cache, &learner, 4, 1) == 0);
+
+    assert(deeplearn_cache_predict(&cache, fields[0], NULL, outputs) == 0);
+    assert(deeplearn_cache_predict(&cache, fields[0], NULL, outputs) == 1);
+
+    /* the cached prediction is the same as the network output */
+    deeplearn_fields_to_inputs(&learner, fields[0], NULL, inputs);
+    deeplearn_feed_forward_batch(&learner, 1, inputs, expected);
+    for (int i = 0; i < no_of_outputs; i++)
+        assert(fabs(outputs[i] - expected[i]) < 0.0001f);
+
+    /* fill the cache, so that the least recently used entry is evicted */
+    for (int s = 1; s < 5; s++)
+        assert(deeplearn_cache_predict(&cache, fields[s], NULL, outputs) == 0);
+    assert(deeplearn_cache_predict(&cache, fields[4], NULL, outputs) == 1);
+    assert(deeplearn_cache_predict(&cache, fields[0], NULL, outputs) == 0);
+
+    deeplearn_cache_get_stats(&cache, &stats);
+    assert(stats.hits == 2);
+    assert(stats.misses == 6);
+    assert(stats.evictions == 2);
+    assert(stats.entries == 4);
+    assert(fabs(deeplearn_cache_hit_rate(&cache) - 0.25f) < 0.0001f);
+
+    /* training changes the model, which invalidates the cache */
+    learner.current_hidden_layer = hidden_layers;
+    for (int i = 0; i < no_of_inputs; i++)
+        deeplearn_set_input(&learner, i, NEURON_UNKNOWN);
+    deeplearn_update(&learner);
+    assert(deeplearn_cache_predict(&cache, fields[4], NULL, outputs) == 0);
+    deeplearn_cache_get_stats(&cache, &stats);
+    assert(stats.invalidations == 1);
+    assert(stats.entries == 1);
+
+    deeplearn_cache_invalidate(&cache);
+    assert(deeplearn_cache_predict(&cache, fields[4], NULL, outputs) == 0);
+
+    deeplearn_cache_reset_stats(&cache);
+    deeplearn_cache_get_stats(&cache, &stats);
+    assert(stats.hits + stats.misses == 0);
+    assert(stats.entries == 1);
+
+    /* a model loaded into the learner starts from the first version,
+       so the cache is invalidated explicitly */
+    fp = fopen(filename, "wb");
+    assert(fp);
+    assert(deeplearn_save(fp, &learner) == 0);
+    fclose(fp);
+    deeplearn_free(&learner);
+    fp = fopen(filename, "rb");
+    assert(fp);
+    assert(deeplearn_load(fp, &learner) == 0);
+    fclose(fp);
+    assert(learner.model_version == 0);
+    deeplearn_cache_invalidate(&cache);
+    assert(deeplearn_cache_predict(&cache, fields[4], NULL, outputs) == 0);
+    deeplearn_cache_get_stats(&cache, &stats);
+    assert(stats.invalidations == 1);
+
+    /* as does changing the output activation */
+    assert(deeplearn_cache_predict(&cache, fields[4], NULL, outputs) == 1);
+    assert(deeplearn_set_output_activation(&learner,
+                                           BP_OUTPUT_SOFTMAX) == 0);
+    assert(deeplearn_cache_predict(&cache, fields[4], NULL, outputs) == 0);
+    deeplearn_fields_to_inputs(&learner, fields[4], NULL, inputs);
+    deeplearn_feed_forward_batch(&learner, 1, inputs, expected);
+    for (int i = 0; i < no_of_outputs; i++)
+        assert(fabs(outputs[i] - expected[i]) < 0.0001f);
+
+    deeplearn_cache_free(&cache);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+/* predictions made from several threads at once */
+typedef struct {
+    deeplearn_cache * cache;
+    float (*fields)[4];
+    float (*outputs)[3];
+    int * retval;
+} test_cache_predictions;
+
+static void test_cache_predict_rows(int start, int end, void * context)
+{
+    test_cache_predictions * p = (test_cache_predictions*)context;
+
+    for (int i = start; i < end; i++)
+        p->retval[i] = deeplearn_cache_predict(p->cache, p->fields[i%20],
+                                               NULL, p->outputs[i]);
+}
+
+static void test_cache_threads()
+{
+    deeplearn learner;
+    deeplearn_cache cache;
+    deeplearn_cache_stats stats;
+    deeplearn_executor executor, previous;
+    deeplearn_pool pool;
+    test_cache_predictions p;
+    float error_threshold[] = { 0.01f, 0.01f, 0.01f };
+    unsigned int random_seed = 123;
+    float fields[20][4], inputs[4], expected[3];
+    float outputs[200][3];
+    int retval[200];
+
+    printf("test_cache_threads...");
+
+    assert(deeplearn_init(&learner, 4, 8, 2, 3,
+                          error_threshold, &random_seed) == 0);
+    for (int i = 0; i < 4; i++) {
+        learner.input_range_min[i] = 0;
+        learner.input_range_max[i] = 10;
+    }
+    for (int s = 0; s < 20; s++)
+        for (int i = 0; i < 4; i++)
+            fields[s][i] = (rand_num(&random_seed)%1000)/100.0f;
+
+    assert(deeplearn_cache_init(&cache, &learner, 64, 4) == 0);
+
+    assert(deeplearn_pool_init(&pool, 4) == 0);
+    deeplearn_get_executor(&previous);
+    deeplearn_pool_executor(&pool, &executor);
+    assert(deeplearn_set_executor(&executor) == 0);
+
+    p.cache = &cache;
+    p.fields = fields;
+    p.outputs = outputs;
+    p.retval = retval;
+    deeplearn_parallel_for(200, test_cache_predict_rows, &p);
+
+    assert(deeplearn_set_executor(&previous) == 0);
+    deeplearn_pool_free(&pool);
+
+    /* misses which share the scratch space of a shard give the same
+       predictions as the network */
+    for (int i = 0; i < 200; i++) {
+        assert(retval[i] >= 0);
+        deeplearn_fields_to_inputs(&learner, fields[i%20], NULL, inputs);
+        deeplearn_feed_forward_batch(&learner, 1, inputs, expected);
+        for (int j = 0; j < 3; j++)
+            assert(fabs(outputs[i][j] - expected[j]) < 0.0001f);
+    }
+
+    deeplearn_cache_get_stats(&cache, &stats);
+    assert(stats.hits + stats.misses == 200);
+    assert(stats.entries == 20);
+
+    deeplearn_cache_free(&cache);
+    assert(cache.shard == 0);
+    assert(cache.no_of_shards == 0);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_cache_text()
+{
+    deeplearn learner;
+    deeplearn_cache cache;
+    int no_of_hiddens=16;
+    int hidden_layers=2;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 2 };
+    float error_threshold_percent[] = { 1.6f, 1.6f, 3.0f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_cache.csv";
+    float fields[] = { 4.2f, 0, 62.1f };
+    char text1[] = "three", text2[] = "three", text3[] = "threes";
+    char text4[] = "thre";
+    char * fields_text[3];
+    float outputs[1];
+    FILE * fp;
+
+    printf("test_cache_text...");
+
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    fprintf(fp,"%f,%s,%f,%f\n",4.2,"one",62.1,1.0);
+    fprintf(fp,"%f,%s,%f,%f\n",8.1,"two",57.6,2.0);
+    fprintf(fp,"%f,%s,%f,%f\n",9.4,"three",63.2,3.0);
+    fprintf(fp,"%f,%s,%f,%f\n",1.7,"four",68.3,4.0);
+    fclose(fp);
+
+    deeplearndata_read_csv(csv_filename,
+                           &learner,
+                           no_of_hiddens, hidden_layers,
+                           no_of_outputs,
+                           output_field_index, 0,
+                           error_threshold_percent,
+                           &random_seed);
+    assert(learner.field_length[1] == 5*CHAR_BITS);
+
+    assert(deeplearn_cache_init(&cache, &learner, 16, 4) == 0);
+    assert(cache.text_fields == 1);
+
+    fields_text[0] = NULL;
+    fields_text[2] = NULL;
+    assert(deeplearn_cache_predict(&cache, fields, NULL, outputs) < 0);
+
+    fields_text[1] = text1;
+    assert(deeplearn_cache_predict(&cache, fields, fields_text, outputs) == 0);
+
+    /* the same text in a different string */
+    fields_text[1] = text2;
+    assert(deeplearn_cache_predict(&cache, fields, fields_text, outputs) == 1);
+
+    /* characters beyond the field length are not encoded */
+    fields_text[1] = text3;
+    assert(deeplearn_cache_predict(&cache, fields, fields_text, outputs) == 1);
+
+    fields_text[1] = text4;
+    assert(deeplearn_cache_predict(&cache, fields, fields_text, outputs) == 0);
+
+    deeplearn_cache_free(&cache);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+int run_tests_cache()
+{
+    printf("\nRunning cache tests\n");
+
+    test_cache_hash();
+    test_cache_numeric();
+    test_cache_threads();
+    test_cache_text();
+
+    printf("All cache tests completed\n");
+    return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_crossval.h"
+
+static void test_crossval_folds()
+{
+    deeplearn learner;
+    deeplearn_crossval_params params;
+    deeplearn_crossval_result serial, parallel;
+    deeplearn_executor executor, previous;
+    deeplearn_pool pool;
+    int output_field_index[] = { 3 };
+    float error_threshold[] = { 5.0f, 5.0f, 5.0f };
+    unsigned int random_seed = 3792;
+    char * csv_filename = "/tmp/libdeep_crossval.csv";
+    int test_samples = 0, labeled = 0;
+    FILE * fp;
+
+    printf("test_crossval_folds...");
+
+    /* the last rows have missing outputs and a field is constant */
+    fp = fopen(csv_filename, "w");
+    assert(fp);
+    for (int i = 0; i < 100; i++) {
+        float x = (i%10)*0.1f, y = (i/10)*0.1f;
+        if (i >= 94)
+            fprintf(fp, "%f,%f,%f,?\n", x, y, 1.0f);
+        else
+            fprintf(fp, "%f,%f,%f,%f\n", x, y, 1.0f, x > y ? 1.0f : 0.0f);
+    }
+    fclose(fp);
+
+    assert(deeplearndata_read_csv(csv_filename, &learner, 6, 2,
+                                  1, output_field_index, 0,
+                                  error_threshold, &random_seed) == 100);
+    assert(learner.no_of_input_fields > learner.net->no_of_inputs);
+    for (int i = 0; i < learner.indexed_data_samples; i++)
+        if (learner.indexed_data[i]->labeled != 0)
+            labeled++;
+    assert(labeled > 0);
+
+    deeplearn_crossval_init_params(&params, 6, 2, error_threshold, 5621);
+    params.max_iterations = 1000;
+    assert(deeplearn_cross_validate(&params, &learner, 1, &serial) != 0);
+
+    params.fold_threads = 1;
+    assert(deeplearn_cross_validate(&params, &learner, 5, &serial) == 0);
+    assert(serial.no_of_folds == 5);
+
+    /* each labeled sample is held out exactly once */
+    for (int f = 0; f < 5; f++) {
+        assert(serial.fold[f].test_samples >= labeled/5);
+        assert(serial.fold[f].test_samples <= (labeled+4)/5);
+        assert(serial.fold[f].training_samples ==
+               labeled - serial.fold[f].test_samples);
+        assert(serial.fold[f].iterations > 0);
+        assert(serial.fold[f].iterations <= 1000);
+        assert((serial.fold[f].performance >= 0) &&
+               (serial.fold[f].performance <= 100));
+        assert(serial.fold[f].rms_error >= 0);
+        test_samples += serial.fold[f].test_samples;
+    }
+    assert(test_samples == labeled);
+    assert(serial.performance_std >= 0);
+
+    /* the results don't depend upon the number of threads */
+    params.fold_threads = 5;
+    params.nested = 1;
+    assert(deeplearn_cross_validate(&params, &learner, 5, &parallel) == 0);
+    for (int f = 0; f < 5; f++) {
+        assert(parallel.fold[f].iterations == serial.fold[f].iterations);
+        assert(parallel.fold[f].performance == serial.fold[f].performance);
+        assert(parallel.fold[f].rms_error == serial.fold[f].rms_error);
+    }
+    assert(parallel.mean_performance == serial.mean_performance);
+    deeplearn_crossval_free(&parallel);
+
+    /* folds are run by the current executor */
+    assert(deeplearn_pool_init(&pool, 3) == 0);
+    deeplearn_get_executor(&previous);
+    deeplearn_pool_executor(&pool, &executor);
+    assert(deeplearn_set_executor(&executor) == 0);
+    assert(deeplearn_cross_validate(&params, &learner, 5, &parallel) == 0);
+    assert(deeplearn_set_executor(&previous) == 0);
+    deeplearn_pool_free(&pool);
+    for (int f = 0; f < 5; f++) {
+        assert(parallel.fold[f].iterations == serial.fold[f].iterations);
+        assert(parallel.fold[f].performance == serial.fold[f].performance);
+        assert(parallel.fold[f].rms_error == serial.fold[f].rms_error);
+    }
+
+    /* the data set belonging to the learner is unchanged */
+    assert(learner.data_samples == 100);
+
+    deeplearn_crossval_free(&serial);
+    deeplearn_crossval_free(&parallel);
+    deeplearn_free(&learner);
+    remove(csv_filename);
+
+    printf("Ok\n");
+}
+
+int run_tests_crossval()
+{
+    printf("\nRunning cross validation tests\n");
+
+    test_crossval_folds();
+
+    printf("All cross validation tests completed\n");
+    return 1;
+}
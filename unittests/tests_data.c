@@ -221,12 +221,99 @@ static void test_data_training_test()
     printf("Ok\n");
 }
 
+static void test_data_collapse_duplicates()
+{
+    deeplearn learner;
+    int no_of_hiddens=4;
+    int hidden_layers=2;
+    int output_field_index[] = { 2 };
+    float error_threshold[] = { 5.0f, 5.0f, 5.0f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_duplicates.csv";
+    float total_weight = 0, loss_weight = 0;
+    FILE * fp;
+
+    printf("test_data_collapse_duplicates...");
+
+    /* ten distinct rows, the r'th of which appears r+1 times */
+    fp = fopen(csv_filename, "w");
+    assert(fp);
+    for (int t = 0; t < 10; t++) {
+        for (int r = t; r < 10; r++)
+            fprintf(fp, "%f,name%d,%f\n", r*0.1f, r%3, (float)(r%2));
+    }
+    fclose(fp);
+
+    assert(deeplearndata_get_collapse_duplicates() == 0);
+    assert(deeplearndata_read_csv(csv_filename, &learner,
+                                  no_of_hiddens, hidden_layers,
+                                  1, output_field_index, 0,
+                                  error_threshold, &random_seed) == 55);
+    assert(learner.mean_sample_weight == 1.0f);
+    deeplearn_free(&learner);
+
+    deeplearndata_set_collapse_duplicates(1);
+    assert(deeplearndata_get_collapse_duplicates() == 1);
+    random_seed = 123;
+    assert(deeplearndata_read_csv(csv_filename, &learner,
+                                  no_of_hiddens, hidden_layers,
+                                  1, output_field_index, 0,
+                                  error_threshold, &random_seed) == 10);
+    deeplearndata_set_collapse_duplicates(0);
+
+    /* each sample counts the rows which it represents */
+    assert(learner.data_samples == 10);
+    assert(learner.mean_sample_weight == 5.5f);
+    for (int s = 0; s < learner.indexed_data_samples; s++) {
+        deeplearndata * sample = deeplearndata_get(&learner, s);
+        int r = (int)(sample->inputs[0]*10 + 0.5f);
+        assert(sample->weight == (float)(r+1));
+        char name[16];
+        sprintf(name, "name%d", r%3);
+        assert(strcmp(sample->inputs_text[1], name) == 0);
+        assert(fabs(deeplearndata_sample_weight(&learner, sample) -
+                    (r+1)/5.5f) < 0.0001f);
+        total_weight += sample->weight;
+        loss_weight += deeplearndata_sample_weight(&learner, sample);
+    }
+    assert(total_weight == 55.0f);
+
+    /* weighted steps are on average the same size as unweighted ones */
+    assert(fabs(loss_weight/learner.data_samples - 1.0f) < 0.0001f);
+
+    /* training restores the weight of the network afterwards */
+    learner.history.interval = 1000000;
+    learner.current_hidden_layer = hidden_layers;
+    for (int t = 0; t < 50; t++)
+        assert(deeplearndata_training(&learner) == 2);
+    assert(learner.net->sample_weight == 1.0f);
+
+    /* the prioritised sampler also uses the sample weights */
+    assert(deeplearn_set_prioritised_sampling(&learner,
+                                              DEEPLEARN_SAMPLER_ALPHA,
+                                              DEEPLEARN_SAMPLER_BETA) == 0);
+    assert(deeplearndata_training(&learner) == 2);
+    for (int i = 0; i < learner.sampler->no_of_samples; i++) {
+        deeplearndata * sample =
+            deeplearndata_get_training_labeled(&learner, i);
+        if (sample->weight != 1.0f)
+            assert(learner.sampler->weight[i] == sample->weight);
+    }
+    assert(deeplearndata_get_performance(&learner) >= 0);
+
+    deeplearn_free(&learner);
+    remove(csv_filename);
+
+    printf("Ok\n");
+}
+
 int run_tests_data()
 {
     printf("\nRunning data tests\n");
 
     test_data_add();
     test_data_training_test();
+    test_data_collapse_duplicates();
 
     printf("All data tests completed\n");
     return 0;
@@ -0,0 +1,379 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_datacache.h"
+
+static char * datacache_csv = "/tmp/libdeep_datacache.csv";
+
+/**
+ * @brief Writes a csv file containing a text field, a constant field
+ *        and some unlabeled samples
+ * @param rows The number of rows
+ */
+static void datacache_write_csv(int rows)
+{
+    const char * names[] = { "red", "green", "blue", "yellow" };
+    FILE * fp = fopen(datacache_csv, "w");
+
+    assert(fp);
+    for (int i = 0; i < rows; i++) {
+        if (i%9 == 4)
+            fprintf(fp, "%f,%s,%f,%f,?\n",
+                    (i%7)*0.5f, names[i%4], 3.0f, (i%5)*1.5f);
+        else
+            fprintf(fp, "%f,%s,%f,%f,%f\n",
+                    (i%7)*0.5f, names[i%4], 3.0f, (i%5)*1.5f,
+                    (i%3)*0.25f);
+    }
+    fclose(fp);
+}
+
+/**
+ * @brief Returns the position of a sample within the data list
+ */
+static int datacache_position(deeplearn * learner, deeplearndata * sample)
+{
+    for (int i = 0; i < learner->data_samples; i++)
+        if (learner->indexed_data[i] == sample)
+            return i;
+    return -1;
+}
+
+/**
+ * @brief Asserts that two sets of indexed samples contain the samples at
+ *        the same positions
+ */
+static void datacache_compare_sets(deeplearn * a, deeplearndata_meta ** set_a,
+                                   deeplearn * b, deeplearndata_meta ** set_b,
+                                   int samples)
+{
+    for (int i = 0; i < samples; i++)
+        assert(datacache_position(a, set_a[i]->sample) ==
+               datacache_position(b, set_b[i]->sample));
+}
+
+/**
+ * @brief Asserts that two deep learners have identical data sets
+ */
+static void datacache_compare(deeplearn * a, deeplearn * b)
+{
+    deeplearndata_meta * meta_a, * meta_b;
+    int fields = a->no_of_input_fields;
+    int outputs = a->net->no_of_outputs;
+
+    assert(b->no_of_input_fields == fields);
+    assert(b->net->no_of_inputs == a->net->no_of_inputs);
+    assert(b->net->no_of_outputs == outputs);
+    assert(b->net->random_seed == a->net->random_seed);
+    assert(b->data_samples == a->data_samples);
+    assert(b->mean_sample_weight == a->mean_sample_weight);
+
+    for (int f = 0; f < fields; f++) {
+        assert(b->field_length[f] == a->field_length[f]);
+        assert(b->input_range_min[f] == a->input_range_min[f]);
+        assert(b->input_range_max[f] == a->input_range_max[f]);
+    }
+    for (int j = 0; j < outputs; j++) {
+        assert(b->output_range_min[j] == a->output_range_min[j]);
+        assert(b->output_range_max[j] == a->output_range_max[j]);
+    }
+
+    for (int s = 0; s < a->data_samples; s++) {
+        deeplearndata * sa = deeplearndata_get(a, s);
+        deeplearndata * sb = deeplearndata_get(b, s);
+
+        assert(memcmp(sa->inputs, sb->inputs, fields*sizeof(float)) == 0);
+        assert(memcmp(sa->outputs, sb->outputs, outputs*sizeof(float)) == 0);
+        assert(sb->flags == sa->flags);
+        assert(sb->labeled == sa->labeled);
+        assert(sb->weight == sa->weight);
+        assert((sa->inputs_text == 0) == (sb->inputs_text == 0));
+        if (sa->inputs_text == 0)
+            continue;
+        for (int f = 0; f < fields; f++) {
+            assert((sa->inputs_text[f] == 0) == (sb->inputs_text[f] == 0));
+            if (sa->inputs_text[f] != 0)
+                assert(strcmp(sa->inputs_text[f], sb->inputs_text[f]) == 0);
+        }
+    }
+
+    assert(b->training_data_samples == a->training_data_samples);
+    assert(b->indexed_training_data_samples ==
+           a->indexed_training_data_samples);
+    assert(b->training_data_labeled_samples ==
+           a->training_data_labeled_samples);
+    assert(b->test_data_samples == a->test_data_samples);
+
+    datacache_compare_sets(a, a->indexed_training_data,
+                           b, b->indexed_training_data,
+                           a->indexed_training_data_samples);
+    datacache_compare_sets(a, a->indexed_training_data_labeled,
+                           b, b->indexed_training_data_labeled,
+                           a->indexed_training_data_labeled_samples);
+    datacache_compare_sets(a, a->indexed_test_data,
+                           b, b->indexed_test_data,
+                           a->indexed_test_data_samples);
+
+    /* the training lists are in the same order */
+    meta_a = a->training_data;
+    meta_b = b->training_data;
+    while (meta_a != 0) {
+        assert(meta_b != 0);
+        assert(datacache_position(a, meta_a->sample) ==
+               datacache_position(b, meta_b->sample));
+        meta_a = meta_a->next;
+        meta_b = meta_b->next;
+    }
+    assert(meta_b == 0);
+}
+
+static void test_datacache_load()
+{
+    deeplearn parsed, cached;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 4 };
+    float error_threshold[] = { 1.0f, 1.0f, 1.0f };
+    unsigned int parsed_seed = 462, cached_seed = 462;
+    char cache_filename[256];
+    FILE * fp;
+
+    printf("test_datacache_load...");
+
+    datacache_write_csv(60);
+    assert(deeplearndata_cache_filename(datacache_csv, cache_filename,
+                                        256) == 0);
+    assert(strcmp(cache_filename, "/tmp/libdeep_datacache.csv.ldc") == 0);
+    remove(cache_filename);
+
+    assert(deeplearndata_read_csv(datacache_csv, &parsed, 8, 2,
+                                  no_of_outputs, output_field_index, 0,
+                                  error_threshold, &parsed_seed) == 60);
+
+    /* the constant field is dropped */
+    assert(parsed.no_of_input_fields == 4);
+    assert(parsed.field_length[2] == DEEPLEARN_FIELD_DROPPED);
+
+    /* no cache yet */
+    assert(deeplearndata_cache_load(cache_filename, datacache_csv, &cached,
+                                    8, 2, no_of_outputs,
+                                    output_field_index, 0,
+                                    error_threshold, &cached_seed) < 0);
+
+    /* parsed and then cached */
+    assert(deeplearndata_read_csv_cached(datacache_csv, &cached, 8, 2,
+                                         no_of_outputs, output_field_index, 0,
+                                         error_threshold, &cached_seed) == 60);
+    fp = fopen(cache_filename, "rb");
+    assert(fp);
+    fclose(fp);
+    assert(cached_seed == parsed_seed);
+    datacache_compare(&parsed, &cached);
+    deeplearn_free(&cached);
+
+    /* loaded from the cache */
+    cached_seed = 462;
+    assert(deeplearndata_cache_load(cache_filename, datacache_csv, &cached,
+                                    8, 2, no_of_outputs,
+                                    output_field_index, 0,
+                                    error_threshold, &cached_seed) == 60);
+    assert(cached_seed == parsed_seed);
+    datacache_compare(&parsed, &cached);
+
+    /* the same network is created */
+    for (int i = 0; i < parsed.net->no_of_hiddens; i++)
+        assert(memcmp(parsed.net->hiddens[0][i]->weights,
+                      cached.net->hiddens[0][i]->weights,
+                      parsed.net->no_of_inputs*sizeof(float)) == 0);
+    deeplearn_free(&cached);
+    deeplearn_free(&parsed);
+
+    /* with a different seed new training and test sets are created */
+    parsed_seed = 17;
+    cached_seed = 17;
+    assert(deeplearndata_read_csv(datacache_csv, &parsed, 8, 2,
+                                  no_of_outputs, output_field_index, 0,
+                                  error_threshold, &parsed_seed) == 60);
+    assert(deeplearndata_cache_load(cache_filename, datacache_csv, &cached,
+                                    8, 2, no_of_outputs,
+                                    output_field_index, 0,
+                                    error_threshold, &cached_seed) == 60);
+    datacache_compare(&parsed, &cached);
+    deeplearn_free(&cached);
+    deeplearn_free(&parsed);
+
+    remove(cache_filename);
+
+    printf("Ok\n");
+}
+
+static void test_datacache_invalidate()
+{
+    deeplearn learner;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 4 };
+    int other_field_index[] = { 3 };
+    float error_threshold[] = { 1.0f, 1.0f, 1.0f };
+    unsigned int random_seed = 462;
+    char cache_filename[256];
+    unsigned char header[200];
+    FILE * fp;
+
+    printf("test_datacache_invalidate...");
+
+    datacache_write_csv(30);
+    assert(deeplearndata_cache_filename(datacache_csv, cache_filename,
+                                        256) == 0);
+    remove(cache_filename);
+    assert(deeplearndata_read_csv_cached(datacache_csv, &learner, 8, 2,
+                                         no_of_outputs, output_field_index, 0,
+                                         error_threshold, &random_seed) == 30);
+    deeplearn_free(&learner);
+
+    /* parsed with different parameters */
+    random_seed = 462;
+    assert(deeplearndata_cache_load(cache_filename, datacache_csv, &learner,
+                                    8, 2, no_of_outputs,
+                                    other_field_index, 0,
+                                    error_threshold, &random_seed) < 0);
+    assert(deeplearndata_cache_load(cache_filename, datacache_csv, &learner,
+                                    8, 2, no_of_outputs,
+                                    output_field_index, 3,
+                                    error_threshold, &random_seed) < 0);
+
+    /* the csv file changes */
+    datacache_write_csv(40);
+    random_seed = 462;
+    assert(deeplearndata_cache_load(cache_filename, datacache_csv, &learner,
+                                    8, 2, no_of_outputs,
+                                    output_field_index, 0,
+                                    error_threshold, &random_seed) < 0);
+    random_seed = 462;
+    assert(deeplearndata_read_csv_cached(datacache_csv, &learner, 8, 2,
+                                         no_of_outputs, output_field_index, 0,
+                                         error_threshold, &random_seed) == 40);
+    deeplearn_free(&learner);
+    random_seed = 462;
+    assert(deeplearndata_cache_load(cache_filename, datacache_csv, &learner,
+                                    8, 2, no_of_outputs,
+                                    output_field_index, 0,
+                                    error_threshold, &random_seed) == 40);
+    deeplearn_free(&learner);
+
+    /* a truncated cache is rejected */
+    fp = fopen(cache_filename, "rb");
+    assert(fp);
+    assert(fread(header, 1, 200, fp) == 200);
+    fclose(fp);
+    fp = fopen(cache_filename, "wb");
+    assert(fp);
+    assert(fwrite(header, 1, 200, fp) == 200);
+    fclose(fp);
+    random_seed = 462;
+    assert(deeplearndata_cache_load(cache_filename, datacache_csv, &learner,
+                                    8, 2, no_of_outputs,
+                                    output_field_index, 0,
+                                    error_threshold, &random_seed) < 0);
+
+    remove(cache_filename);
+    remove(datacache_csv);
+
+    printf("Ok\n");
+}
+
+static void test_datacache_weights()
+{
+    deeplearn parsed, cached;
+    int output_field_index[] = { 2 };
+    float error_threshold[] = { 1.0f, 1.0f, 1.0f };
+    unsigned int parsed_seed = 83, cached_seed = 83;
+    char cache_filename[256];
+    FILE * fp;
+
+    printf("test_datacache_weights...");
+
+    /* each of 20 distinct rows appears three times */
+    fp = fopen(datacache_csv, "w");
+    assert(fp);
+    for (int i = 0; i < 60; i++)
+        fprintf(fp, "%f,%s,%f\n", (i%20)*0.5f, (i%2 ? "on" : "off"),
+                (i%4)*0.25f);
+    fclose(fp);
+    assert(deeplearndata_cache_filename(datacache_csv, cache_filename,
+                                        256) == 0);
+    remove(cache_filename);
+
+    deeplearndata_set_collapse_duplicates(1);
+    assert(deeplearndata_read_csv(datacache_csv, &parsed, 8, 2,
+                                  1, output_field_index, 0,
+                                  error_threshold, &parsed_seed) == 20);
+    assert(parsed.mean_sample_weight == 3.0f);
+
+    assert(deeplearndata_read_csv_cached(datacache_csv, &cached, 8, 2,
+                                         1, output_field_index, 0,
+                                         error_threshold, &cached_seed) == 20);
+    deeplearn_free(&cached);
+
+    cached_seed = 83;
+    assert(deeplearndata_cache_load(cache_filename, datacache_csv, &cached,
+                                    8, 2, 1, output_field_index, 0,
+                                    error_threshold, &cached_seed) == 20);
+    datacache_compare(&parsed, &cached);
+    deeplearn_free(&cached);
+
+    /* the cache isn't used if duplicates are no longer merged */
+    deeplearndata_set_collapse_duplicates(0);
+    cached_seed = 83;
+    assert(deeplearndata_cache_load(cache_filename, datacache_csv, &cached,
+                                    8, 2, 1, output_field_index, 0,
+                                    error_threshold, &cached_seed) < 0);
+    cached_seed = 83;
+    assert(deeplearndata_read_csv_cached(datacache_csv, &cached, 8, 2,
+                                         1, output_field_index, 0,
+                                         error_threshold, &cached_seed) == 60);
+    assert(cached.mean_sample_weight == 1.0f);
+    deeplearn_free(&cached);
+    deeplearn_free(&parsed);
+
+    remove(cache_filename);
+    remove(datacache_csv);
+
+    printf("Ok\n");
+}
+
+int run_tests_datacache()
+{
+    printf("\nRunning data cache tests\n");
+
+    test_datacache_load();
+    test_datacache_invalidate();
+    test_datacache_weights();
+
+    printf("All data cache tests completed\n");
+    return 1;
+}
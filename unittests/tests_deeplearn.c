@@ -257,6 +257,81 @@ static void test_deeplearn_save_load()
     printf("Ok\n");
 }
 
+static void test_deeplearn_transplant()
+{
+    deeplearn base, learner, other;
+    int no_of_inputs=10;
+    int no_of_hiddens=8;
+    int no_of_outputs=3;
+    float error_threshold[] = { 0.01f, 0.01f, 0.01f, 0.01f };
+    unsigned int random_seed = 123;
+    char filename[256];
+    FILE * fp;
+
+    printf("test_deeplearn_transplant...");
+
+    /* a base learner whose first layer has been pretrained */
+    assert(deeplearn_init(&base,
+                          no_of_inputs, no_of_hiddens,
+                          3, no_of_outputs,
+                          error_threshold,
+                          &random_seed) == 0);
+    for (int t = 0; t < 10; t++) {
+        for (int i = 0; i < no_of_inputs; i++)
+            deeplearn_set_input(&base, i,
+                                (rand_num(&random_seed)%10000)/10000.0f);
+        deeplearn_update(&base);
+    }
+    copy_autocoder_to_hidden_layer(&base, 0);
+    base.current_hidden_layer = 1;
+
+    sprintf(filename,"%stemp_transplant.dat",DEEPLEARN_TEMP_DIRECTORY);
+    fp = fopen(filename,"wb");
+    assert(fp!=0);
+    assert(deeplearn_save(fp, &base) == 0);
+    fclose(fp);
+
+    /* a learner with different outputs and depth */
+    assert(deeplearn_init(&learner,
+                          no_of_inputs, no_of_hiddens,
+                          2, 2,
+                          error_threshold,
+                          &random_seed) == 0);
+
+    /* only pretrained layers can be transplanted */
+    fp = fopen(filename,"rb");
+    assert(fp!=0);
+    assert(deeplearn_transplant_load(fp, &learner, 2) != 0);
+    fclose(fp);
+    assert(learner.current_hidden_layer == 0);
+
+    fp = fopen(filename,"rb");
+    assert(fp!=0);
+    assert(deeplearn_transplant_load(fp, &learner, 1) == 0);
+    fclose(fp);
+
+    assert(learner.current_hidden_layer == 1);
+    assert(autocoder_compare(base.autocoder[0], learner.autocoder[0]) == 0);
+    for (int i = 0; i < no_of_hiddens; i++)
+        assert(bp_neuron_compare(base.net->hiddens[0][i],
+                                 learner.net->hiddens[0][i]) == 1);
+
+    /* the shapes must match */
+    assert(deeplearn_init(&other,
+                          no_of_inputs+1, no_of_hiddens,
+                          2, 2,
+                          error_threshold,
+                          &random_seed) == 0);
+    assert(deeplearn_transplant(&base, &other, 1) != 0);
+    assert(other.current_hidden_layer == 0);
+    deeplearn_free(&other);
+
+    deeplearn_free(&base);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
 static void test_deeplearn_export()
 {
     char * filename1 = "/tmp/libdeep_export.c";
@@ -299,6 +374,76 @@ static void test_deeplearn_export()
     printf("Ok\n");
 }
 
+static void test_deeplearn_export_dropped_fields()
+{
+    char * csv_filename = "/tmp/libdeep_export_dropped.csv";
+    char * filename1 = "/tmp/libdeep_export_dropped.c";
+    char * filename2 = "/tmp/libdeep_export_dropped.py";
+    deeplearn learner;
+    int no_of_hiddens=4;
+    int hidden_layers=2;
+    int no_of_outputs=1;
+    int output_field_index[] = { 6 };
+    float error_threshold[] = { 0.01f, 0.01f, 0.01f };
+    unsigned int random_seed = 123;
+    char line[2000];
+    int found = 0;
+    FILE * fp;
+
+    printf("test_deeplearn_export_dropped_fields...");
+
+    /* five constant fields and one varying field */
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    COUNTUP(i, 10)
+        fprintf(fp,"1,2,3,4,5,%d,%d\n", i*3, i%2);
+    fclose(fp);
+
+    assert(deeplearndata_read_csv(csv_filename,
+                                  &learner,
+                                  no_of_hiddens, hidden_layers,
+                                  no_of_outputs,
+                                  output_field_index, 0,
+                                  error_threshold,
+                                  &random_seed) == 10);
+    assert(learner.net->no_of_inputs == 1);
+
+    /* the exported program takes a value for every field, and has
+       the range of each field */
+    assert(deeplearn_export(&learner, filename1) == 0);
+    fp = fopen(filename1,"r");
+    assert(fp);
+    while (fgets(line, 2000, fp) != NULL) {
+        if (strstr(line, "float inputs[6];") != NULL)
+            found |= 1;
+        if (strstr(line, "if (i > 6) return -2;") != NULL)
+            found |= 2;
+        if (strstr(line, "27.0000000000") != NULL)
+            found |= 4;
+    }
+    fclose(fp);
+    assert(found == 7);
+
+    found = 0;
+    assert(deeplearn_export(&learner, filename2) == 0);
+    fp = fopen(filename2,"r");
+    assert(fp);
+    while (fgets(line, 2000, fp) != NULL) {
+        if (strstr(line, "if len(inputs) < 6:") != NULL)
+            found |= 1;
+        if ((strstr(line, "input_range_max = [") != NULL) &&
+            (strstr(line, "27.0000000000") != NULL))
+            found |= 2;
+    }
+    fclose(fp);
+    assert(found == 3);
+
+    /* free memory */
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
 static void test_deeplearn_csv_with_text()
 {
     deeplearn learner;
@@ -367,6 +512,71 @@ static void test_deeplearn_csv_with_text()
     printf("Ok\n");
 }
 
+static void test_deeplearn_fields_to_inputs()
+{
+    deeplearn learner;
+    int no_of_hiddens=16;
+    int hidden_layers=3;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 2 };
+    float error_threshold_percent[] = { 1.6f, 1.6f, 3.0f, 3.0f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_fields.csv";
+    float inputs[2 + (5*CHAR_BITS)];
+    float outputs[1];
+    deeplearndata * sample;
+    FILE * fp;
+
+    printf("test_deeplearn_fields_to_inputs...");
+
+    /* create a csv file */
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    fprintf(fp,"%f,%s,%f,%f\n",4.2,"one",62.1,1.0);
+    fprintf(fp,"%f,%s,%f,%f\n",8.1,"two",57.6,2.0);
+    fprintf(fp,"%f,%s,%f,%f\n",9.4,"three",63.2,3.0);
+    fprintf(fp,"%f,%s,%f,%f\n",1.7,"four",68.3,4.0);
+    fclose(fp);
+
+    deeplearndata_read_csv(csv_filename,
+                           &learner,
+                           no_of_hiddens, hidden_layers,
+                           no_of_outputs,
+                           output_field_index, 0,
+                           error_threshold_percent,
+                           &random_seed);
+
+    assert(learner.net->no_of_inputs == 2 + (5*CHAR_BITS));
+
+    /* the prepared inputs and batch outputs should be the same as
+       those obtained by setting the inputs of the network */
+    sample = learner.data;
+    while (sample != 0) {
+        deeplearn_set_inputs(&learner, sample);
+        deeplearn_feed_forward(&learner);
+
+        assert(deeplearn_fields_to_inputs(&learner, sample->inputs,
+                                          sample->inputs_text,
+                                          inputs) == 0);
+        for (int i = 0; i < learner.net->no_of_inputs; i++)
+            assert(fabs(inputs[i] - learner.net->inputs[i]->value) < 0.0001f);
+
+        assert(deeplearn_feed_forward_batch(&learner, 1,
+                                            inputs, outputs) == 0);
+        assert(fabs(outputs[0] - deeplearn_get_output(&learner, 0)) <
+               0.0001f);
+        assert(deeplearn_class_from_values(&learner, outputs) ==
+               deeplearn_get_class(&learner));
+
+        sample = sample->next;
+    }
+
+    /* free memory */
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
 static void test_deeplearn_csv_numeric()
 {
     deeplearn learner;
@@ -507,6 +717,103 @@ static void test_deeplearn_set_input_field_text()
     printf("Ok\n");
 }
 
+static void test_deeplearn_csv_drop_fields()
+{
+    deeplearn learner;
+    int no_of_hiddens=16;
+    int hidden_layers=3;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 5 };
+    float error_threshold_percent[] = { 1.6f, 1.6f, 3.0f, 3.0f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_drop_fields.csv";
+    float fields[5];
+    char * fields_text[5];
+    float inputs[1 + (5*CHAR_BITS)];
+    deeplearndata * sample;
+    FILE * fp;
+
+    printf("test_deeplearn_csv_drop_fields...");
+
+    /* create a csv file with a constant numeric field, a constant
+       text field and a duplicate of the first field */
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    fprintf(fp,"%f,%f,%s,%f,%s,%f\n",4.2,3.0,"same",4.2,"one",1.0);
+    fprintf(fp,"%f,%f,%s,%f,%s,%f\n",8.1,3.0,"same",8.1,"two",2.0);
+    fprintf(fp,"%f,%f,%s,%f,%s,%f\n",9.4,3.0,"same",9.4,"three",3.0);
+    fprintf(fp,"%f,%f,%s,%f,%s,%f\n",1.7,3.0,"same",1.7,"four",4.0);
+    fprintf(fp,"%f,%f,%s,%f,%s,%f\n",5.4,3.0,"same",5.4,"five",5.0);
+    fclose(fp);
+
+    /* load the data */
+    deeplearndata_read_csv(csv_filename,
+                           &learner,
+                           no_of_hiddens, hidden_layers,
+                           no_of_outputs,
+                           output_field_index, 0,
+                           error_threshold_percent,
+                           &random_seed);
+
+    /* the original fields remain, but only two of them have inputs */
+    assert(learner.no_of_input_fields == 5);
+    assert(learner.net->no_of_inputs == 1 + (5*CHAR_BITS));
+    assert(learner.field_length[0] == 0);
+    assert(learner.field_length[1] == DEEPLEARN_FIELD_DROPPED);
+    assert(learner.field_length[2] == DEEPLEARN_FIELD_DROPPED);
+    assert(learner.field_length[3] == DEEPLEARN_FIELD_DROPPED);
+    assert(learner.field_length[4] == 5*CHAR_BITS);
+    assert(deeplearn_field_position(&learner, 0) == 0);
+    assert(deeplearn_field_position(&learner, 3) == -1);
+    assert(deeplearn_field_position(&learner, 4) == 1);
+
+    /* dropped fields can still be given values */
+    assert(deeplearn_set_input_field(&learner, 1, 3.0f) == 0);
+    assert(deeplearn_set_input_field_text(&learner, 2, "same") == 0);
+    assert(deeplearn_set_input_field(&learner, 4, 1.0f) == -3);
+
+    /* fields in the original schema give the same inputs as the sample */
+    sample = deeplearndata_get(&learner, 2);
+    assert(sample != 0);
+    COUNTDOWN(i, 5) {
+        fields[i] = sample->inputs[i];
+        fields_text[i] = sample->inputs_text[i];
+    }
+    deeplearn_set_inputs(&learner, sample);
+    assert(deeplearn_fields_to_inputs(&learner, fields, fields_text,
+                                      inputs) == 0);
+    COUNTDOWN(i, learner.net->no_of_inputs)
+        assert(inputs[i] == bp_get_input(learner.net, i));
+
+    /* free memory */
+    deeplearn_free(&learner);
+
+    /* mostly constant fields, so that there are more fields than inputs */
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    COUNTUP(i, 10)
+        fprintf(fp,"1,2,3,4,5,%d,%d\n", i*3, i%2);
+    fclose(fp);
+
+    output_field_index[0] = 6;
+    assert(deeplearndata_read_csv(csv_filename,
+                                  &learner,
+                                  no_of_hiddens, hidden_layers,
+                                  no_of_outputs,
+                                  output_field_index, 0,
+                                  error_threshold_percent,
+                                  &random_seed) == 10);
+    assert(learner.no_of_input_fields == 6);
+    assert(learner.net->no_of_inputs == 1);
+    assert(learner.input_range_min[5] == 0);
+    assert(learner.input_range_max[5] == 27);
+
+    /* free memory */
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
 int run_tests_deeplearn()
 {
     printf("\nRunning deeplearn tests\n");
@@ -514,11 +821,15 @@ int run_tests_deeplearn()
     test_string_ends_with_extension();
     test_deeplearn_init();
     test_deeplearn_save_load();
+    test_deeplearn_transplant();
     test_deeplearn_update();
     test_deeplearn_export();
+    test_deeplearn_export_dropped_fields();
     test_deeplearn_csv_with_text();
+    test_deeplearn_fields_to_inputs();
     test_deeplearn_csv_numeric();
     test_deeplearn_set_input_field_text();
+    test_deeplearn_csv_drop_fields();
 
     printf("All deeplearn tests completed\n");
     return 0;
@@ -0,0 +1,133 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_delta.h"
+
+static void test_delta_feed_forward()
+{
+    deeplearn learner;
+    deeplearn_delta delta;
+    int no_of_hiddens=16;
+    int hidden_layers=3;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 3 };
+    float error_threshold_percent[] = { 1.6f, 1.6f, 3.0f, 3.0f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_delta.csv";
+    float inputs[2 + (5*CHAR_BITS)];
+    float expected[1], outputs[1], base_outputs[1];
+    deeplearndata * base, * sample;
+    FILE * fp;
+
+    printf("test_delta_feed_forward...");
+
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    fprintf(fp,"%f,%s,%f,%f\n",4.2,"one",62.1,1.0);
+    fprintf(fp,"%f,%s,%f,%f\n",8.1,"two",57.6,2.0);
+    fprintf(fp,"%f,%s,%f,%f\n",9.4,"three",63.2,3.0);
+    fprintf(fp,"%f,%s,%f,%f\n",1.7,"four",68.3,4.0);
+    fclose(fp);
+
+    deeplearndata_read_csv(csv_filename,
+                           &learner,
+                           no_of_hiddens, hidden_layers,
+                           no_of_outputs,
+                           output_field_index, 0,
+                           error_threshold_percent,
+                           &random_seed);
+
+    assert(deeplearn_delta_init(&delta, &learner) == 0);
+
+    base = learner.data;
+    assert(deeplearn_delta_set_base(&delta, base->inputs,
+                                    base->inputs_text) == 0);
+    assert(deeplearn_delta_feed_forward(&delta, base_outputs) == 0);
+
+    assert(deeplearn_fields_to_inputs(&learner, base->inputs,
+                                      base->inputs_text, inputs) == 0);
+    assert(deeplearn_feed_forward_batch(&learner, 1, inputs, expected) == 0);
+    assert(fabs(base_outputs[0] - expected[0]) < 0.0001f);
+
+    /* change the fields of the base sample to those of each other sample */
+    sample = base->next;
+    while (sample != 0) {
+        assert(deeplearn_delta_set_field(&delta, 0, sample->inputs[0]) == 0);
+        assert(deeplearn_delta_set_field_text(&delta, 1,
+                                              sample->inputs_text[1]) == 0);
+        assert(deeplearn_delta_set_field(&delta, 2, sample->inputs[2]) == 0);
+        assert(deeplearn_delta_feed_forward(&delta, outputs) == 0);
+
+        assert(deeplearn_fields_to_inputs(&learner, sample->inputs,
+                                          sample->inputs_text, inputs) == 0);
+        assert(deeplearn_feed_forward_batch(&learner, 1,
+                                            inputs, expected) == 0);
+        assert(fabs(outputs[0] - expected[0]) < 0.0001f);
+
+        /* only the inputs which differ should have been updated */
+        assert(delta.changed_inputs < (unsigned long)learner.net->no_of_inputs);
+
+        deeplearn_delta_reset(&delta);
+        assert(deeplearn_delta_feed_forward(&delta, outputs) == 0);
+        assert(fabs(outputs[0] - base_outputs[0]) < 0.0001f);
+
+        sample = sample->next;
+    }
+
+    /* the wrong type of field */
+    assert(deeplearn_delta_set_field(&delta, 1, 1.0f) != 0);
+    assert(deeplearn_delta_set_field_text(&delta, 0, "one") != 0);
+
+    /* after training the sums are recalculated */
+    learner.current_hidden_layer = hidden_layers;
+    deeplearn_update(&learner);
+    assert(learner.model_version != delta.model_version);
+    assert(deeplearn_delta_feed_forward(&delta, outputs) == 0);
+    assert(deeplearn_fields_to_inputs(&learner, base->inputs,
+                                      base->inputs_text, inputs) == 0);
+    assert(deeplearn_feed_forward_batch(&learner, 1, inputs, expected) == 0);
+    assert(fabs(outputs[0] - expected[0]) < 0.0001f);
+
+    deeplearn_delta_free(&delta);
+    assert(delta.weights == 0);
+    assert(delta.buffer == 0);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+int run_tests_delta()
+{
+    printf("\nRunning delta inference tests\n");
+
+    test_delta_feed_forward();
+
+    printf("All delta inference tests completed\n");
+    return 0;
+}
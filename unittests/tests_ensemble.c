@@ -0,0 +1,302 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_ensemble.h"
+
+static void test_ensemble_create_csv(char * csv_filename)
+{
+    FILE * fp;
+    unsigned int random_seed = 6723;
+
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    for (int i = 0; i < 40; i++) {
+        float a = (rand_num(&random_seed)%1000)/100.0f;
+        float b = (rand_num(&random_seed)%1000)/100.0f;
+        float c = (rand_num(&random_seed)%1000)/100.0f;
+        fprintf(fp,"%f,%f,%f,%d\n",a,b,c,(a > b ? 1 : 0));
+    }
+    fclose(fp);
+}
+
+static void test_ensemble_fused_inference()
+{
+    deeplearn source;
+    deeplearn_ensemble ensemble;
+    int no_of_members = 3;
+    int output_field_index[] = { 3 };
+    float error_threshold[] = { 5.0f, 5.0f, 5.0f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_ensemble.csv";
+    float expected[2], diff;
+
+    printf("test_ensemble_fused_inference...");
+
+    test_ensemble_create_csv(csv_filename);
+    assert(deeplearndata_read_csv(csv_filename, &source,
+                                  6, 2, 1, output_field_index, 2,
+                                  error_threshold, &random_seed) == 40);
+    assert(source.net->no_of_outputs == 2);
+
+    assert(deeplearn_ensemble_init(&ensemble, no_of_members, &source,
+                                   6, 2, error_threshold,
+                                   &random_seed) == 0);
+    assert(ensemble.bootstrap_samples == source.training_data_samples);
+
+    /* members start with different weights */
+    assert(bp_compare(ensemble.member[0]->net,
+                      ensemble.member[1]->net) < 1);
+
+    for (int i = 0; i < 500; i++)
+        assert(deeplearn_ensemble_training(&ensemble) >= 0);
+
+    assert(deeplearn_ensemble_pack(&ensemble) == 0);
+    assert(ensemble.packed == 1);
+
+    /* fused result should match averaging each member separately */
+    deeplearn_ensemble_set_inputs(&ensemble,
+                                  deeplearndata_get_test(&source, 0));
+    assert(deeplearn_ensemble_feed_forward(&ensemble) == 0);
+
+    expected[0] = 0;
+    expected[1] = 0;
+    for (int m = 0; m < no_of_members; m++) {
+        deeplearn * learner = ensemble.member[m];
+        for (int i = 0; i < learner->net->no_of_inputs; i++)
+            deeplearn_set_input(learner, i, ensemble.inputs[i]);
+        deeplearn_feed_forward(learner);
+        for (int i = 0; i < 2; i++)
+            expected[i] += deeplearn_get_output(learner, i)/no_of_members;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        diff = fabs(expected[i] - deeplearn_ensemble_get_output(&ensemble, i));
+        assert(diff < 0.0001f);
+    }
+
+    /* voting gives the fraction of members choosing each class */
+    deeplearn_ensemble_set_combine(&ensemble, ENSEMBLE_VOTE);
+    assert(deeplearn_ensemble_feed_forward(&ensemble) == 0);
+    diff = deeplearn_ensemble_get_output(&ensemble, 0) +
+        deeplearn_ensemble_get_output(&ensemble, 1) - (2*NEURON_LOW);
+    assert(fabs(diff - NEURON_RANGE) < 0.0001f);
+    assert(deeplearn_ensemble_get_class(&ensemble) >= 0);
+
+    assert(deeplearn_ensemble_get_performance(&ensemble) >= 0);
+
+    deeplearn_ensemble_free(&ensemble);
+    deeplearn_free(&source);
+
+    printf("Ok\n");
+}
+
+static void test_ensemble_training()
+{
+    deeplearn source;
+    deeplearn_ensemble ensemble, pooled;
+    deeplearn_executor executor, previous;
+    deeplearn_pool pool;
+    int no_of_members = 3, retval = 1, steps = 0;
+    int output_field_index[] = { 3 };
+    float error_threshold[] = { 20.0f, 20.0f, 30.0f };
+    unsigned int random_seed = 851, seed1 = 33, seed2 = 33;
+    char * csv_filename = "/tmp/libdeep_ensemble_training.csv";
+    FILE * fp;
+
+    printf("test_ensemble_training...");
+
+    /* the output depends upon the first field */
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    for (int i = 0; i < 40; i++) {
+        float a = (rand_num(&random_seed)%1000)/100.0f;
+        float b = (rand_num(&random_seed)%1000)/100.0f;
+        float c = (rand_num(&random_seed)%1000)/100.0f;
+        fprintf(fp,"%f,%f,%f,%f\n",a,b,c,0.2f + a*0.05f);
+    }
+    fclose(fp);
+
+    assert(deeplearndata_read_csv(csv_filename, &source,
+                                  6, 2, 1, output_field_index, 0,
+                                  error_threshold, &random_seed) == 40);
+
+    assert(deeplearn_ensemble_init(&ensemble, no_of_members, &source,
+                                   6, 2, error_threshold, &seed1) == 0);
+    assert(deeplearn_ensemble_init(&pooled, no_of_members, &source,
+                                   6, 2, error_threshold, &seed2) == 0);
+
+    /* training on a thread pool gives the same members */
+    assert(deeplearn_pool_init(&pool, 3) == 0);
+    deeplearn_get_executor(&previous);
+    deeplearn_pool_executor(&pool, &executor);
+    for (int i = 0; i < 200; i++) {
+        assert(deeplearn_ensemble_training(&ensemble) == no_of_members);
+        assert(deeplearn_set_executor(&executor) == 0);
+        assert(deeplearn_ensemble_training(&pooled) == no_of_members);
+        assert(deeplearn_set_executor(&previous) == 0);
+    }
+    deeplearn_pool_free(&pool);
+    for (int m = 0; m < no_of_members; m++)
+        assert(bp_compare(ensemble.member[m]->net,
+                          pooled.member[m]->net) == 1);
+    deeplearn_ensemble_free(&pooled);
+
+    /* every member reaches its error thresholds */
+    while ((retval > 0) && (steps < 200000)) {
+        retval = deeplearn_ensemble_training(&ensemble);
+        steps++;
+    }
+    assert(retval == 0);
+    for (int m = 0; m < no_of_members; m++) {
+        assert(ensemble.member[m]->training_complete != 0);
+        assert(ensemble.member[m]->current_hidden_layer == 2);
+    }
+    assert(deeplearn_ensemble_training(&ensemble) == 0);
+    assert(deeplearn_ensemble_get_performance(&ensemble) > 0);
+
+    deeplearn_ensemble_free(&ensemble);
+    deeplearn_free(&source);
+    remove(csv_filename);
+
+    printf("Ok\n");
+}
+
+static void test_ensemble_fused_batch()
+{
+    deeplearn source;
+    deeplearn_ensemble ensemble;
+    int no_of_members = 4, samples, n;
+    int output_field_index[] = { 3 };
+    float error_threshold[] = { 5.0f, 5.0f, 5.0f, 5.0f };
+    unsigned int random_seed = 4410;
+    char * csv_filename = "/tmp/libdeep_ensemble_batch.csv";
+    float * inputs, * outputs, expected;
+
+    printf("test_ensemble_fused_batch...");
+
+    test_ensemble_create_csv(csv_filename);
+    assert(deeplearndata_read_csv(csv_filename, &source,
+                                  8, 3, 1, output_field_index, 2,
+                                  error_threshold, &random_seed) == 40);
+
+    /* three hidden layers which taper towards the outputs */
+    assert(deeplearn_ensemble_init(&ensemble, no_of_members, &source,
+                                   8, 3, error_threshold,
+                                   &random_seed) == 0);
+    for (int i = 0; i < 100; i++)
+        assert(deeplearn_ensemble_training(&ensemble) >= 0);
+
+    samples = source.indexed_test_data_samples;
+    n = source.net->no_of_inputs;
+    assert(samples > 1);
+    inputs = (float*)malloc(samples*n*sizeof(float));
+    outputs = (float*)malloc(samples*2*sizeof(float));
+    assert(inputs && outputs);
+    for (int s = 0; s < samples; s++) {
+        deeplearn_ensemble_set_inputs(&ensemble,
+                                      deeplearndata_get_test(&source, s));
+        memcpy(&inputs[s*n], ensemble.inputs, n*sizeof(float));
+    }
+    assert(deeplearn_ensemble_feed_forward_batch(&ensemble, samples,
+                                                 inputs, outputs) == 0);
+    assert(ensemble.packed == 1);
+
+    /* each output of the batch is the average of running every member
+       separately on that sample */
+    for (int s = 0; s < samples; s++) {
+        for (int i = 0; i < 2; i++) {
+            expected = 0;
+            for (int m = 0; m < no_of_members; m++) {
+                deeplearn * learner = ensemble.member[m];
+                for (int j = 0; j < n; j++)
+                    deeplearn_set_input(learner, j, inputs[s*n + j]);
+                deeplearn_feed_forward(learner);
+                expected += deeplearn_get_output(learner, i)/no_of_members;
+            }
+            assert(fabs(expected - outputs[s*2 + i]) < 0.0001f);
+        }
+    }
+
+    free(inputs);
+    free(outputs);
+    deeplearn_ensemble_free(&ensemble);
+    deeplearn_free(&source);
+    remove(csv_filename);
+
+    printf("Ok\n");
+}
+
+static void test_ensemble_init_failure()
+{
+    deeplearn source;
+    deeplearn_ensemble ensemble;
+    int output_field_index[] = { 3 };
+    float error_threshold[] = { 5.0f, 5.0f, 5.0f };
+    unsigned int random_seed = 97;
+    char * csv_filename = "/tmp/libdeep_ensemble_failure.csv";
+    size_t used;
+
+    printf("test_ensemble_init_failure...");
+
+    test_ensemble_create_csv(csv_filename);
+    assert(deeplearndata_read_csv(csv_filename, &source,
+                                  6, 2, 1, output_field_index, 2,
+                                  error_threshold, &random_seed) == 40);
+
+    /* room for only one member, so the second fails to be created
+       and the first is freed again */
+    used = deeplearn_memory_used();
+    deeplearn_memory_set_budget(used +
+                                deeplearn_estimate_memory(
+                                    source.net->no_of_inputs, 6, 2,
+                                    source.net->no_of_outputs, 0));
+    assert(deeplearn_ensemble_init(&ensemble, 2, &source,
+                                   6, 2, error_threshold,
+                                   &random_seed) == -6);
+    assert(deeplearn_memory_used() == used);
+    deeplearn_memory_set_budget(0);
+
+    deeplearn_free(&source);
+    remove(csv_filename);
+
+    printf("Ok\n");
+}
+
+int run_tests_ensemble()
+{
+    printf("\nRunning ensemble tests\n");
+
+    test_ensemble_fused_inference();
+    test_ensemble_training();
+    test_ensemble_fused_batch();
+    test_ensemble_init_failure();
+
+    printf("All ensemble tests completed\n");
+    return 0;
+}
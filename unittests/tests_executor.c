@@ -0,0 +1,160 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_executor.h"
+
+/* number of times that a custom executor was called */
+static int executor_calls = 0;
+
+static void count_iterations(int start, int end, void * context)
+{
+    int * count = (int*)context;
+
+    for (int i = start; i < end; i++)
+        __sync_fetch_and_add(&count[i], 1);
+}
+
+static void nested_loop(int start, int end, void * context)
+{
+    int * count = (int*)context;
+
+    for (int i = start; i < end; i++)
+        deeplearn_parallel_for(10, count_iterations, &count[i*10]);
+}
+
+static void counting_parallel_for(void * data, int n,
+                                  deeplearn_loop loop, void * context)
+{
+    executor_calls++;
+    loop(0, n, context);
+}
+
+static void test_executor_pool()
+{
+    deeplearn_pool pool;
+    deeplearn_executor executor, current;
+    int count[1000];
+
+    printf("test_executor_pool...");
+
+    assert(deeplearn_pool_init(&pool, 0) != 0);
+    assert(deeplearn_pool_init(&pool, 4) == 0);
+    deeplearn_pool_executor(&pool, &executor);
+    assert(deeplearn_set_executor(&executor) == 0);
+    deeplearn_get_executor(&current);
+    assert(current.data == (void*)&pool);
+
+    /* every iteration is run exactly once, however the
+       iterations are divided between threads */
+    for (int n = 1; n <= 1000; n = n*3 + 1) {
+        for (int t = 0; t < 10; t++) {
+            memset(count, 0, sizeof(count));
+            deeplearn_parallel_for(n, count_iterations, count);
+            for (int i = 0; i < 1000; i++)
+                assert(count[i] == (i < n ? 1 : 0));
+        }
+    }
+
+    /* loops within loops run on the calling thread */
+    memset(count, 0, sizeof(count));
+    deeplearn_parallel_for(100, nested_loop, count);
+    for (int i = 0; i < 1000; i++)
+        assert(count[i] == 1);
+
+    assert(deeplearn_set_executor(NULL) == 0);
+    deeplearn_pool_free(&pool);
+
+    printf("Ok\n");
+}
+
+static void test_executor_custom()
+{
+    deeplearn_executor executor;
+    bp net;
+    ac autocoder;
+    int no_of_inputs = 20;
+    float inputs[4*20], outputs[4*3], expected[4*3];
+    float encoded[10], expected_encoded[10];
+    unsigned int random_seed = 123;
+
+    printf("test_executor_custom...");
+
+    executor.parallel_for = NULL;
+    assert(deeplearn_set_executor(&executor) != 0);
+
+    assert(bp_init(&net, no_of_inputs, 10, 2, 3, &random_seed) == 0);
+    assert(autocoder_init(&autocoder, no_of_inputs, 10, random_seed) == 0);
+    for (int i = 0; i < 4*no_of_inputs; i++)
+        inputs[i] = NEURON_LOW +
+            ((rand_num(&random_seed)%10000)/10000.0f)*NEURON_RANGE;
+    memcpy(autocoder.inputs, inputs, no_of_inputs*sizeof(float));
+
+    /* results with the default executor */
+    assert(bp_feed_forward_batch(&net, 4, inputs, expected) == 0);
+    autocoder.random_seed = 1;
+    autocoder_encode(&autocoder, expected_encoded, 0);
+
+    executor.parallel_for = counting_parallel_for;
+    executor.data = NULL;
+    assert(deeplearn_set_executor(&executor) == 0);
+
+    assert(bp_feed_forward_batch(&net, 4, inputs, outputs) == 0);
+    assert(executor_calls == 1);
+    for (int i = 0; i < 4*3; i++)
+        assert(outputs[i] == expected[i]);
+
+    autocoder.random_seed = 1;
+    autocoder_encode(&autocoder, encoded, 0);
+    assert(executor_calls == 2);
+    for (int i = 0; i < 10; i++)
+        assert(encoded[i] == expected_encoded[i]);
+
+    deeplearn_executor_serial(&executor);
+    assert(deeplearn_set_executor(&executor) == 0);
+    assert(bp_feed_forward_batch(&net, 4, inputs, outputs) == 0);
+    for (int i = 0; i < 4*3; i++)
+        assert(outputs[i] == expected[i]);
+
+    assert(deeplearn_set_executor(NULL) == 0);
+    autocoder_free(&autocoder);
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+int run_tests_executor()
+{
+    printf("\nRunning executor tests\n");
+
+    test_executor_pool();
+    test_executor_custom();
+
+    printf("All executor tests completed\n");
+    return 0;
+}
@@ -0,0 +1,341 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_fixed.h"
+
+static void test_fixed_feed_forward()
+{
+    bp net;
+    deeplearn_fixed fixed;
+    int no_of_inputs=10;
+    int no_of_hiddens=8;
+    int hidden_layers=2;
+    int no_of_outputs=3;
+    int bits[] = { DEEPLEARN_FIXED_Q7, DEEPLEARN_FIXED_Q15 };
+    float tolerance[] = { 0.02f, 0.001f };
+    float inputs[10], outputs[3], fixed_outputs[3], buffer[16];
+    unsigned int random_seed = 123;
+
+    printf("test_fixed_feed_forward...");
+
+    assert(bp_init(&net,
+                   no_of_inputs, no_of_hiddens,
+                   hidden_layers, no_of_outputs,
+                   &random_seed) == 0);
+
+    assert(deeplearn_fixed_init(&fixed, &net, 12) != 0);
+
+    for (int b = 0; b < 2; b++) {
+        int max_weight = (1 << (bits[b]-1)) - 1;
+
+        assert(deeplearn_fixed_init(&fixed, &net, bits[b]) == 0);
+        assert(fixed.no_of_layers == hidden_layers+1);
+        assert(fixed.no_of_inputs[0] == no_of_inputs);
+        assert(fixed.units[hidden_layers] == no_of_outputs);
+
+        /* the lookup table spans the range of activations */
+        for (int i = 1; i < DEEPLEARN_FIXED_LUT_SIZE; i++)
+            assert(fixed.lut[i] >= fixed.lut[i-1]);
+        assert(fixed.lut[DEEPLEARN_FIXED_LUT_SIZE/2] ==
+               1 << (fixed.activation_bits-1));
+        assert(fixed.lut[DEEPLEARN_FIXED_LUT_SIZE-1] <=
+               1 << fixed.activation_bits);
+        assert(fixed.lut[DEEPLEARN_FIXED_LUT_SIZE-1] >
+               (1 << fixed.activation_bits)*0.999f);
+
+        /* weights use most of the available range */
+        for (int l = 0; l < fixed.no_of_layers; l++) {
+            int max = 0;
+            for (int i = 0; i < fixed.units[l]*fixed.no_of_inputs[l]; i++) {
+                assert(abs(fixed.weights[l][i]) <= max_weight);
+                if (abs(fixed.weights[l][i]) > max)
+                    max = abs(fixed.weights[l][i]);
+            }
+            assert(max > max_weight/2);
+        }
+
+        for (int t = 0; t < 20; t++) {
+            for (int i = 0; i < no_of_inputs; i++)
+                inputs[i] = NEURON_LOW +
+                    ((rand_num(&random_seed)%10000)/10000.0f)*NEURON_RANGE;
+
+            bp_feed_forward_sample(&net, inputs, outputs, buffer);
+            deeplearn_fixed_feed_forward(&fixed, inputs, fixed_outputs);
+
+            for (int i = 0; i < no_of_outputs; i++)
+                assert(fabs(outputs[i] - fixed_outputs[i]) < tolerance[b]);
+        }
+
+        deeplearn_fixed_free(&fixed);
+    }
+
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+static void test_fixed_wide_outputs()
+{
+    bp net;
+    deeplearn_fixed fixed;
+    int no_of_inputs=10;
+    int no_of_hiddens=4;
+    int hidden_layers=3;
+    int no_of_outputs=10;
+    float inputs[10], outputs[10], fixed_outputs[10], buffer[20];
+    unsigned int random_seed = 123;
+
+    printf("test_fixed_wide_outputs...");
+
+    /* hidden layers widen towards the outputs */
+    assert(bp_init(&net,
+                   no_of_inputs, no_of_hiddens,
+                   hidden_layers, no_of_outputs,
+                   &random_seed) == 0);
+    assert(HIDDENS_IN_LAYER(&net, hidden_layers-1) > no_of_hiddens);
+
+    assert(deeplearn_fixed_init(&fixed, &net, DEEPLEARN_FIXED_Q15) == 0);
+    assert(deeplearn_fixed_widest(&fixed) == no_of_outputs);
+
+    for (int i = 0; i < no_of_inputs; i++)
+        inputs[i] = NEURON_LOW +
+            ((rand_num(&random_seed)%10000)/10000.0f)*NEURON_RANGE;
+
+    bp_feed_forward_sample(&net, inputs, outputs, buffer);
+    deeplearn_fixed_feed_forward(&fixed, inputs, fixed_outputs);
+    for (int i = 0; i < no_of_outputs; i++)
+        assert(fabs(outputs[i] - fixed_outputs[i]) < 0.001f);
+
+    deeplearn_fixed_free(&fixed);
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+static void test_fixed_overflow()
+{
+    bp net;
+    deeplearn_fixed fixed;
+    float inputs[4], outputs[2], fixed_outputs[2], buffer[8];
+    unsigned int random_seed = 123;
+
+    printf("test_fixed_overflow...");
+
+    assert(bp_init(&net, 4, 4, 1, 2, &random_seed) == 0);
+
+    /* a bias which could overflow the 32 bit sums of a Q7 program */
+    net.hiddens[0][0]->bias = 100000;
+    assert(deeplearn_fixed_init(&fixed, &net, DEEPLEARN_FIXED_Q7) == -3);
+    assert(fixed.weights == 0);
+
+    /* which is within the range of Q15 */
+    assert(deeplearn_fixed_init(&fixed, &net, DEEPLEARN_FIXED_Q15) == 0);
+    for (int i = 0; i < 4; i++)
+        inputs[i] = NEURON_LOW + (i*NEURON_RANGE/4);
+    bp_feed_forward_sample(&net, inputs, outputs, buffer);
+    deeplearn_fixed_feed_forward(&fixed, inputs, fixed_outputs);
+    for (int i = 0; i < 2; i++)
+        assert(fabs(outputs[i] - fixed_outputs[i]) < 0.001f);
+    deeplearn_fixed_free(&fixed);
+
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+/**
+ * @brief Compiles an exported fixed point program and checks that
+ *        it gives the same outputs as the fixed point network for
+ *        each of the test samples
+ */
+static void test_fixed_run_export(deeplearn * learner, int bits)
+{
+    deeplearn_fixed fixed;
+    char * export_filename = "/tmp/libdeep_fixed_run.c";
+    char * program_filename = "/tmp/libdeep_fixed_run";
+    char * result_filename = "/tmp/libdeep_fixed_run.txt";
+    char commandstr[256];
+    float * inputs, * outputs;
+    float result;
+    FILE * fp;
+
+    assert(deeplearn_export_fixed(learner, export_filename, bits) == 0);
+    sprintf(commandstr, "cc -std=c99 -o %s %s -lm",
+            program_filename, export_filename);
+    assert(system(commandstr) == 0);
+
+    assert(deeplearn_fixed_init(&fixed, learner->net, bits) == 0);
+    inputs = (float*)malloc(learner->net->no_of_inputs*sizeof(float));
+    outputs = (float*)malloc(learner->net->no_of_outputs*sizeof(float));
+    assert(inputs);
+    assert(outputs);
+
+    for (int index = 0; index < learner->test_data_samples; index++) {
+        deeplearndata * sample = deeplearndata_get_test(learner, index);
+
+        sprintf(commandstr, "%s", program_filename);
+        for (int i = 0; i < learner->no_of_input_fields; i++)
+            sprintf(&commandstr[strlen(commandstr)], " %f",
+                    sample->inputs[i]);
+        sprintf(&commandstr[strlen(commandstr)], " > %s", result_filename);
+        assert(system(commandstr) == 0);
+
+        deeplearn_set_inputs(learner, sample);
+        for (int i = 0; i < learner->net->no_of_inputs; i++)
+            inputs[i] = bp_get_input(learner->net, i);
+        deeplearn_fixed_feed_forward(&fixed, inputs, outputs);
+
+        fp = fopen(result_filename, "r");
+        assert(fp);
+        for (int i = 0; i < learner->net->no_of_outputs; i++) {
+            float range =
+                learner->output_range_max[i] - learner->output_range_min[i];
+            assert(fscanf(fp, "%f", &result) == 1);
+            outputs[i] = learner->output_range_min[i] +
+                ((outputs[i] - NEURON_LOW)*range/NEURON_RANGE);
+            assert(fabs(result - outputs[i]) < 0.0001f);
+        }
+        fclose(fp);
+    }
+
+    free(inputs);
+    free(outputs);
+    deeplearn_fixed_free(&fixed);
+
+    sprintf(commandstr, "rm -f %s %s %s",
+            export_filename, program_filename, result_filename);
+    system(commandstr);
+}
+
+static void test_fixed_export()
+{
+    deeplearn learner;
+    int no_of_hiddens=16;
+    int hidden_layers=2;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 2 };
+    float error_threshold_percent[] = { 1.6f, 1.6f, 3.0f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_fixed.csv";
+    char * export_filename1 = "/tmp/libdeep_fixed.c";
+    char * export_filename2 = "/tmp/libdeep_fixed_sketch.c";
+    char line[256];
+    int reported = 0;
+    deeplearn_fixed fixed;
+    deeplearndata * sample;
+    float performance, target;
+    FILE * fp;
+
+    printf("test_fixed_export...");
+
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    for (int i = 0; i < 40; i++)
+        fprintf(fp,"%f,%f,%f\n",(i%7)*0.5f,(i%3)*2.0f,(i%7)*0.1f+(i%3));
+    fclose(fp);
+
+    deeplearndata_read_csv(csv_filename,
+                           &learner,
+                           no_of_hiddens, hidden_layers,
+                           no_of_outputs,
+                           output_field_index, 0,
+                           error_threshold_percent,
+                           &random_seed);
+
+    assert(learner.test_data_samples > 0);
+
+    /* the fixed point network performs about as well as the original */
+    assert(deeplearn_fixed_init(&fixed, learner.net,
+                                DEEPLEARN_FIXED_Q15) == 0);
+    performance = deeplearn_fixed_get_performance(&fixed, &learner);
+    assert(fabs(performance - deeplearndata_get_performance(&learner)) < 1);
+
+    /* samples count in proportion to their weights. The first test
+       sample is given the output of the network, so that it has no
+       error, and outweighs all of the others */
+    sample = deeplearndata_get_test(&learner, 0);
+    target = sample->outputs[0];
+    deeplearn_set_inputs(&learner, sample);
+    deeplearn_feed_forward(&learner);
+    deeplearn_get_outputs(&learner, sample->outputs);
+    sample->weight = 1000000;
+    performance = deeplearn_fixed_get_performance(&fixed, &learner);
+    assert(performance > 90);
+    assert(fabs(performance - deeplearndata_get_performance(&learner)) < 1);
+    sample->outputs[0] = target;
+    sample->weight = 1;
+    deeplearn_fixed_free(&fixed);
+
+    assert(deeplearn_export_fixed(&learner, export_filename1, 3) != 0);
+
+    assert(deeplearn_export_fixed(&learner, export_filename1,
+                                  DEEPLEARN_FIXED_Q7) == 0);
+    fp = fopen(export_filename1,"r");
+    assert(fp);
+    while (fgets(line, 255, fp) != NULL) {
+        if (strstr(line, "Test set performance") != NULL)
+            reported = 1;
+        assert(strstr(line, "analogRead") == NULL);
+    }
+    fclose(fp);
+    assert(reported == 1);
+
+    assert(deeplearn_export_fixed(&learner, export_filename2,
+                                  DEEPLEARN_FIXED_Q15) == 0);
+    fp = fopen(export_filename2,"r");
+    assert(fp);
+    reported = 0;
+    while (fgets(line, 255, fp) != NULL) {
+        if (strstr(line, "analogRead") != NULL)
+            reported = 1;
+    }
+    fclose(fp);
+    assert(reported == 1);
+
+    /* exported programs give the same outputs as the fixed point network */
+    test_fixed_run_export(&learner, DEEPLEARN_FIXED_Q7);
+    test_fixed_run_export(&learner, DEEPLEARN_FIXED_Q15);
+
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+int run_tests_fixed()
+{
+    printf("\nRunning fixed point tests\n");
+
+    test_fixed_feed_forward();
+    test_fixed_wide_outputs();
+    test_fixed_overflow();
+    test_fixed_export();
+
+    printf("All fixed point tests completed\n");
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_grow.h"
+
+static void test_grow_same_function()
+{
+    deeplearn learner, grown;
+    int no_of_inputs=10;
+    int no_of_hiddens=8;
+    int hidden_layers=2;
+    int no_of_outputs=3;
+    float error_threshold[] = { 0.01f, 0.01f, 0.01f };
+    unsigned int random_seed = 123;
+    int samples = 20;
+    float inputs[20*10], outputs[20*3], grown_outputs[20*3];
+    int min_hiddens;
+    deeplearn_sampler * sampler;
+
+    printf("test_grow_same_function...");
+
+    assert(deeplearn_init(&learner,
+                          no_of_inputs, no_of_hiddens,
+                          hidden_layers,
+                          no_of_outputs,
+                          error_threshold,
+                          &random_seed) == 0);
+
+    /* train the final layer for a while so that the weights are
+       not only their initial values */
+    learner.current_hidden_layer = hidden_layers;
+    for (int t = 0; t < 100; t++) {
+        for (int i = 0; i < no_of_inputs; i++)
+            deeplearn_set_input(&learner, i,
+                                (rand_num(&random_seed)%10000)/10000.0f);
+        for (int i = 0; i < no_of_outputs; i++)
+            deeplearn_set_output(&learner, i,
+                                 (rand_num(&random_seed)%10000)/10000.0f);
+        deeplearn_update(&learner);
+    }
+
+    /* make the outputs sensitive to the hidden units, so that any
+       difference between the networks is visible */
+    for (int i = 0; i < no_of_outputs; i++)
+        for (int j = 0; j < learner.net->outputs[i]->no_of_inputs; j++)
+            learner.net->outputs[i]->weights[j] *= 20;
+
+    for (int i = 0; i < samples*no_of_inputs; i++)
+        inputs[i] = NEURON_LOW +
+            ((rand_num(&random_seed)%10000)/10000.0f)*NEURON_RANGE;
+    assert(deeplearn_feed_forward_batch(&learner, samples,
+                                        inputs, outputs) == 0);
+
+    /* cannot shrink */
+    assert(deeplearn_grow(&learner, no_of_hiddens-1, hidden_layers,
+                          &grown) != 0);
+    assert(deeplearn_grow(&learner, no_of_hiddens, hidden_layers-1,
+                          &grown) != 0);
+
+    /* wider */
+    assert(deeplearn_grow(&learner, no_of_hiddens*2, hidden_layers,
+                          &grown) == 0);
+    assert(grown.net->no_of_hiddens == no_of_hiddens*2);
+    assert(grown.current_hidden_layer == hidden_layers);
+    assert(deeplearn_feed_forward_batch(&grown, samples,
+                                        inputs, grown_outputs) == 0);
+    for (int i = 0; i < samples*no_of_outputs; i++)
+        assert(fabs(outputs[i] - grown_outputs[i]) < 0.0001f);
+    deeplearn_free(&grown);
+
+    /* wider and deeper */
+    assert(deeplearn_grow(&learner, no_of_hiddens*3, hidden_layers+2,
+                          &grown) == 0);
+    assert(grown.net->hidden_layers == hidden_layers+2);
+    assert(grown.current_hidden_layer == hidden_layers+2);
+    assert(deeplearn_feed_forward_batch(&grown, samples,
+                                        inputs, grown_outputs) == 0);
+    for (int i = 0; i < samples*no_of_outputs; i++)
+        assert(fabs(outputs[i] - grown_outputs[i]) < 0.001f);
+
+    /* training continues */
+    deeplearn_update(&grown);
+    deeplearn_free(&grown);
+
+    /* only deeper, which needs more units for the inserted layers */
+    assert(deeplearn_grow(&learner, no_of_hiddens, hidden_layers+2,
+                          &grown) == -4);
+    min_hiddens = deeplearn_grow_min_hiddens(&learner, hidden_layers+2);
+    assert(min_hiddens > no_of_hiddens);
+    assert(deeplearn_grow_min_hiddens(&learner, hidden_layers) ==
+           no_of_hiddens);
+    assert(deeplearn_set_prioritised_sampling(&learner,
+                                              DEEPLEARN_SAMPLER_ALPHA,
+                                              DEEPLEARN_SAMPLER_BETA) == 0);
+    sampler = learner.sampler;
+    assert(deeplearn_grow(&learner, min_hiddens-1, hidden_layers+2,
+                          &grown) == -4);
+    assert(deeplearn_grow(&learner, min_hiddens, hidden_layers+2,
+                          &grown) == 0);
+    assert(deeplearn_feed_forward_batch(&grown, samples,
+                                        inputs, grown_outputs) == 0);
+    for (int i = 0; i < samples*no_of_outputs; i++)
+        assert(fabs(outputs[i] - grown_outputs[i]) < 0.001f);
+
+    /* the sampler moves with the data */
+    assert(grown.sampler == sampler);
+    assert(learner.sampler == 0);
+    deeplearn_free(&grown);
+
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+int run_tests_grow()
+{
+    printf("\nRunning grow tests\n");
+
+    test_grow_same_function();
+
+    printf("All grow tests completed\n");
+    return 0;
+}
@@ -120,7 +120,7 @@ static void test_load_training_images()
 {
     char filename[256];
     unsigned char ** images=NULL;
-    char ** classifications=NULL;
+    deeplearn_labels labels;
     int * numbers;
     int im;
     int no_of_images2;
@@ -155,7 +155,7 @@ static void test_load_training_images()
     no_of_images2 =
         deeplearn_load_training_images(str,
                                        &images,
-                                       &classifications,
+                                       &labels,
                                        &numbers,
                                        width, height,
                                        extra_synthetic_images);
@@ -165,13 +165,29 @@ static void test_load_training_images()
     assert(no_of_images+(no_of_images*extra_synthetic_images) == no_of_images2);
     assert(images!=NULL);
 
+    /* synthetic images have the same class as the image they came from */
+    assert(labels.no_of_labels == 2);
+    for (im = 0; im < no_of_images2; im++) {
+        assert(numbers[im] ==
+               numbers[im - (im%(1+extra_synthetic_images))]);
+        assert(strncmp(deeplearn_labels_get(&labels, numbers[im]),
+                       "img", 3) == 0);
+    }
+
+    /* synthetic images are taken from the original image */
+    for (im = 0; im < no_of_images2; im++) {
+        int nonzero = 0;
+        for (int i = 0; i < width*height; i++)
+            if (images[im][i] != 0) nonzero = 1;
+        assert(nonzero == 1);
+    }
+
     /* free memory */
-    for (im = 0; im < no_of_images; im++) {
+    for (im = 0; im < no_of_images2; im++) {
         free(images[im]);
-        free(classifications[im]);
     }
     free(images);
-    free(classifications);
+    deeplearn_labels_free(&labels);
     free(numbers);
 
     /* remove the images */
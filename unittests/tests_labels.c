@@ -0,0 +1,80 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_labels.h"
+
+static void test_labels_intern()
+{
+    deeplearn_labels labels;
+    char label[32];
+    int no_of_labels = 10000;
+
+    printf("test_labels_intern...");
+
+    assert(deeplearn_labels_init(&labels, 4) == 0);
+
+    /* class numbers are assigned in order of first appearance */
+    assert(deeplearn_labels_intern(&labels, "face7", -1) == 0);
+    assert(deeplearn_labels_intern(&labels, "face1", -1) == 1);
+    assert(deeplearn_labels_intern(&labels, "face7", -1) == 0);
+    assert(deeplearn_labels_intern(&labels, "face10.png", 6) == 2);
+    assert(deeplearn_labels_intern(&labels, "face1", 4) == 3);
+    assert(deeplearn_labels_find(&labels, "face10", -1) == 2);
+    assert(deeplearn_labels_find(&labels, "face", -1) == 3);
+    assert(deeplearn_labels_find(&labels, "face2", -1) == -1);
+    assert(strcmp(deeplearn_labels_get(&labels, 2), "face10") == 0);
+    assert(deeplearn_labels_get(&labels, 4) == NULL);
+
+    /* the table grows beyond the expected number of labels */
+    for (int i = 0; i < no_of_labels; i++) {
+        sprintf(label, "person%d", i);
+        assert(deeplearn_labels_intern(&labels, label, -1) == 4 + i);
+    }
+    for (int i = no_of_labels-1; i >= 0; i--) {
+        sprintf(label, "person%d", i);
+        assert(deeplearn_labels_find(&labels, label, -1) == 4 + i);
+        assert(strcmp(deeplearn_labels_get(&labels, 4 + i), label) == 0);
+    }
+    assert(labels.no_of_labels == 4 + no_of_labels);
+    assert(deeplearn_labels_find(&labels, "face7", -1) == 0);
+
+    deeplearn_labels_free(&labels);
+
+    printf("Ok\n");
+}
+
+int run_tests_labels()
+{
+    printf("\nRunning labels tests\n");
+
+    test_labels_intern();
+
+    printf("All labels tests completed\n");
+    return 0;
+}
@@ -0,0 +1,300 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_memory.h"
+
+static void test_memory_estimate()
+{
+    bp net;
+    ac autocoder;
+    deeplearn learner;
+    deeplearn_conv conv;
+    deepconvnet convnet;
+    float error_threshold[] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    unsigned int random_seed = 123;
+    size_t used = deeplearn_memory_used();
+    size_t estimate;
+
+    printf("test_memory_estimate...");
+
+    /* estimates match the memory which is actually reserved */
+    estimate = bp_estimate_memory(10, 8, 3, 2);
+    assert(estimate > 8*10*sizeof(float));
+    assert(bp_init(&net, 10, 8, 3, 2, &random_seed) == 0);
+    assert(bp_get_memory(&net) == estimate);
+    assert(deeplearn_memory_used() == used + estimate);
+    bp_free(&net);
+    assert(deeplearn_memory_used() == used);
+
+    estimate = autocoder_estimate_memory(10, 5);
+    assert(estimate == (10*2 + 5*4 + 10*5*2)*sizeof(float));
+    assert(autocoder_init(&autocoder, 10, 5, random_seed) == 0);
+    assert(autocoder_get_memory(&autocoder) == estimate);
+    assert(deeplearn_memory_used() == used + estimate);
+    autocoder_free(&autocoder);
+    assert(deeplearn_memory_used() == used);
+
+    estimate = deeplearn_estimate_memory(20, 10, 3, 4, 0);
+    assert(deeplearn_init(&learner, 20, 10, 3, 4,
+                          error_threshold, &random_seed) == 0);
+    assert(deeplearn_get_memory(&learner) == estimate);
+    assert(deeplearn_memory_used() == used + estimate);
+
+    /* samples are included within the estimate */
+    assert(deeplearn_estimate_memory(20, 10, 3, 4, 100) >
+           estimate + 100*24*sizeof(float));
+    deeplearn_free(&learner);
+    assert(deeplearn_memory_used() == used);
+
+    estimate = conv_estimate_memory(3, 64, 64, 3, 16, 8, 8, 8);
+    assert(estimate > 64*64*3*sizeof(float));
+    assert(conv_init(3, 64, 64, 3, 16, 8, 8, 8, &conv) == 0);
+    assert(conv_get_memory(&conv) == estimate);
+    conv_free(&conv);
+    assert(deeplearn_memory_used() == used);
+
+    /* final layer larger than the image */
+    assert(conv_estimate_memory(3, 64, 64, 3, 16, 8, 128, 128) == 0);
+
+    estimate = deepconvnet_estimate_memory(3, 2, 64, 64, 1, 16, 4, 4, 4,
+                                           3, 0);
+    assert(deepconvnet_init(3, 2, 64, 64, 1, 16, 4, 4, 4, 1000, 3,
+                            &convnet, error_threshold, &random_seed) == 0);
+    assert(deepconvnet_get_memory(&convnet) == estimate);
+    assert(deepconvnet_estimate_memory(3, 2, 64, 64, 1, 16, 4, 4, 4,
+                                       3, 10) >= estimate + 10*64*64);
+    deepconvnet_free(&convnet);
+    assert(deeplearn_memory_used() == used);
+
+    printf("Ok\n");
+}
+
+static void test_memory_budget()
+{
+    bp net;
+    deeplearn learner;
+    deepconvnet convnet;
+    float error_threshold[] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    unsigned int random_seed = 123;
+    size_t used = deeplearn_memory_used();
+    size_t estimate = deeplearn_estimate_memory(20, 10, 3, 4, 0);
+
+    printf("test_memory_budget...");
+
+    assert(deeplearn_memory_get_budget() == 0);
+    assert(deeplearn_memory_available() == SIZE_MAX);
+
+    /* objects which don't fit fail without reserving anything */
+    deeplearn_memory_set_budget(used + estimate - 1);
+    assert(deeplearn_memory_available() == estimate - 1);
+    assert(deeplearn_init(&learner, 20, 10, 3, 4,
+                          error_threshold, &random_seed) != 0);
+    assert(deeplearn_memory_used() == used);
+    assert(bp_init(&net, 1000, 1000, 3, 4, &random_seed) != 0);
+    assert(deeplearn_memory_used() == used);
+    assert(deepconvnet_init(3, 2, 64, 64, 1, 16, 4, 4, 4, 1000, 3,
+                            &convnet, error_threshold, &random_seed) != 0);
+    assert(deeplearn_memory_used() == used);
+
+    /* exactly within the budget */
+    deeplearn_memory_set_budget(used + estimate);
+    assert(deeplearn_init(&learner, 20, 10, 3, 4,
+                          error_threshold, &random_seed) == 0);
+    assert(deeplearn_memory_used() == used + estimate);
+    assert(deeplearn_memory_available() == 0);
+    assert(deeplearn_memory_reserve(1) != 0);
+
+    /* memory becomes available again once freed */
+    deeplearn_free(&learner);
+    assert(deeplearn_memory_available() == estimate);
+    assert(deeplearn_memory_reserve(estimate) == 0);
+    deeplearn_memory_release(estimate);
+
+    deeplearn_memory_set_budget(0);
+    assert(deeplearn_memory_used() == used);
+
+    printf("Ok\n");
+}
+
+static void test_memory_load()
+{
+    deeplearn learner, learner2;
+    float error_threshold[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    unsigned int random_seed = 123;
+    size_t used = deeplearn_memory_used();
+    char * filename = "/tmp/libdeep_memory_load.dat";
+    char * buffer;
+    long length, truncated[2];
+    int expected[] = { -9, -7 };
+    FILE * fp;
+
+    printf("test_memory_load...");
+
+    assert(deeplearn_init(&learner, 10, 8, 2, 3,
+                          error_threshold, &random_seed) == 0);
+    fp = fopen(filename,"wb");
+    assert(fp);
+    assert(deeplearn_save(fp, &learner) == 0);
+    fclose(fp);
+    deeplearn_free(&learner);
+    assert(deeplearn_memory_used() == used);
+
+    fp = fopen(filename,"rb");
+    assert(fp);
+    fseek(fp, 0, SEEK_END);
+    length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    buffer = (char*)malloc(length);
+    assert(buffer);
+    assert(fread(buffer, 1, length, fp) == length);
+    fclose(fp);
+
+    /* a file which ends within the training history. Whatever was
+       reserved for the network and its autocoders is released again */
+    fp = fopen(filename,"wb");
+    assert(fp);
+    assert(fwrite(buffer, 1, length - sizeof(deeplearn_history), fp) ==
+           length - sizeof(deeplearn_history));
+    fclose(fp);
+
+    fp = fopen(filename,"rb");
+    assert(fp);
+    assert(deeplearn_load(fp, &learner2) == -25);
+    fclose(fp);
+    assert(learner2.net == 0);
+    assert(learner2.autocoder == 0);
+    assert(learner2.memory == 0);
+    assert(learner2.model_version == 0);
+    assert(deeplearn_memory_used() == used);
+
+    /* files which end within the last autocoder, before the thresholds
+       and ranges, and within the neurons of the network */
+    truncated[0] = length - (3*sizeof(deeplearn_history)) -
+        ((3 + (2*10) + (2*3) + 1)*sizeof(float));
+    truncated[1] = 200;
+    for (int t = 0; t < 2; t++) {
+        fp = fopen(filename,"wb");
+        assert(fp);
+        assert(fwrite(buffer, 1, truncated[t], fp) == truncated[t]);
+        fclose(fp);
+
+        fp = fopen(filename,"rb");
+        assert(fp);
+        assert(deeplearn_load(fp, &learner2) == expected[t]);
+        fclose(fp);
+        assert(deeplearn_memory_used() == used);
+    }
+    free(buffer);
+
+    printf("Ok\n");
+}
+
+static void test_memory_samples()
+{
+    deeplearn learner;
+    int output_field_index[] = { 2 };
+    float error_threshold[] = { 5.0f, 5.0f, 5.0f };
+    unsigned int random_seed = 392;
+    char * csv_filename = "/tmp/libdeep_memory_samples.csv";
+    size_t used = deeplearn_memory_used();
+    size_t loaded, network, samples_bytes, values_bytes;
+    int samples, inputs;
+    FILE * fp;
+
+    printf("test_memory_samples...");
+
+    fp = fopen(csv_filename, "w");
+    assert(fp);
+    for (int i = 0; i < 100; i++)
+        fprintf(fp, "%d,%s,%d\n", i%17,
+                (i%3 == 0 ? "north" : "south"), i%2);
+    fclose(fp);
+
+    /* loaded samples are reserved, and released when freed */
+    samples = deeplearndata_read_csv(csv_filename, &learner, 4, 2,
+                                     1, output_field_index, 0,
+                                     error_threshold, &random_seed);
+    assert(samples == 100);
+    inputs = learner.net->no_of_inputs;
+    loaded = deeplearn_memory_used();
+    network = deeplearn_estimate_memory(inputs, 4, 2, 1, 0);
+    samples_bytes = loaded - used - network;
+    assert(samples_bytes ==
+           100*deeplearndata_sample_memory(0, 1, 2, 1) +
+           34*(2*sizeof(char*) + strlen("north") + 1) +
+           66*(2*sizeof(char*) + strlen("south") + 1));
+
+    /* quantising releases the single precision input values */
+    values_bytes = (size_t)samples*learner.no_of_input_fields*sizeof(float);
+    assert(deeplearndata_set_input_storage(&learner,
+                                           DEEPLEARNDATA_STORE_UINT8) == 0);
+    assert(deeplearn_memory_used() ==
+           loaded - values_bytes + learner.inputs_quantised_bytes);
+    assert(deeplearndata_set_input_storage(&learner,
+                                           DEEPLEARNDATA_STORE_FLOAT32) == 0);
+    assert(deeplearn_memory_used() == loaded);
+
+    /* converting needs room for both formats at once */
+    deeplearn_memory_set_budget(loaded + values_bytes/4 - 1);
+    assert(deeplearndata_set_input_storage(&learner,
+                                           DEEPLEARNDATA_STORE_UINT8) == -4);
+    assert(deeplearn_memory_used() == loaded);
+    deeplearn_free(&learner);
+    assert(deeplearn_memory_used() == used);
+
+    /* samples which don't fit fail to load without reserving anything */
+    deeplearn_memory_set_budget(used + samples_bytes/2);
+    assert(deeplearndata_read_csv(csv_filename, &learner, 4, 2,
+                                  1, output_field_index, 0,
+                                  error_threshold, &random_seed) == -3);
+    assert(deeplearn_memory_used() == used);
+
+    /* the samples fit, but the network doesn't */
+    deeplearn_memory_set_budget(used + samples_bytes + network - 1);
+    assert(deeplearndata_read_csv(csv_filename, &learner, 4, 2,
+                                  1, output_field_index, 0,
+                                  error_threshold, &random_seed) == -4);
+    assert(deeplearn_memory_used() == used);
+
+    deeplearn_memory_set_budget(0);
+    printf("Ok\n");
+}
+
+int run_tests_memory()
+{
+    printf("\nRunning memory tests\n");
+
+    test_memory_estimate();
+    test_memory_budget();
+    test_memory_load();
+    test_memory_samples();
+
+    printf("All memory tests completed\n");
+    return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_metrics.h"
+
+static void * test_metrics_thread(void * arg)
+{
+    deeplearn * learner = (deeplearn*)arg;
+
+    for (int i = 0; i < 10; i++)
+        deeplearn_feed_forward(learner);
+
+    return NULL;
+}
+
+static void test_metrics_counters()
+{
+    deeplearn learner;
+    deeplearn_metrics_snapshot * snapshot;
+    int no_of_inputs=10;
+    int no_of_hiddens=16;
+    int hidden_layers=2;
+    int no_of_outputs=2;
+    float error_threshold[] = { 0.01f, 0.01f, 0.01f };
+    unsigned int random_seed = 123;
+    float inputs[10*8], outputs[2*8];
+    pthread_t thread;
+    char * filename = "/tmp/libdeep_metrics.json";
+    char line[256];
+    int found = 0;
+    FILE * fp;
+
+    printf("test_metrics_counters...");
+
+    assert(deeplearn_init(&learner,
+                          no_of_inputs, no_of_hiddens,
+                          hidden_layers,
+                          no_of_outputs,
+                          error_threshold,
+                          &random_seed) == 0);
+
+    snapshot = (deeplearn_metrics_snapshot*)
+        malloc(sizeof(deeplearn_metrics_snapshot));
+    assert(snapshot);
+
+    deeplearn_metrics_enable(1);
+    assert(deeplearn_metrics_enabled() != 0);
+    deeplearn_metrics_reset();
+
+    for (int i = 0; i < 100; i++)
+        deeplearn_feed_forward(&learner);
+
+    for (int i = 0; i < 10*8; i++)
+        inputs[i] = NEURON_UNKNOWN;
+    deeplearn_feed_forward_batch(&learner, 8, inputs, outputs);
+
+    /* counters of a thread which has exited are retained */
+    assert(pthread_create(&thread, NULL, test_metrics_thread, &learner) == 0);
+    pthread_join(thread, NULL);
+
+    deeplearn_metrics_get_snapshot(snapshot);
+    assert(snapshot->metric[DEEPLEARN_METRIC_FEED_FORWARD].calls == 110);
+    assert(snapshot->metric[DEEPLEARN_METRIC_FEED_FORWARD].samples == 110);
+    assert(snapshot->metric[DEEPLEARN_METRIC_FEED_FORWARD_BATCH].calls == 1);
+    assert(snapshot->metric[DEEPLEARN_METRIC_FEED_FORWARD_BATCH].samples == 8);
+    assert(snapshot->metric[DEEPLEARN_METRIC_UPDATE].calls == 0);
+
+    assert(deeplearn_metrics_mean_us(snapshot,
+                                     DEEPLEARN_METRIC_FEED_FORWARD) > 0);
+    assert(deeplearn_metrics_percentile_us(snapshot,
+                                           DEEPLEARN_METRIC_FEED_FORWARD,
+                                           50) <=
+           deeplearn_metrics_percentile_us(snapshot,
+                                           DEEPLEARN_METRIC_FEED_FORWARD,
+                                           99.9));
+
+    /* write as JSON */
+    fp = fopen(filename, "w");
+    assert(fp);
+    assert(deeplearn_metrics_dump(fp, 1) == 0);
+    fclose(fp);
+    fp = fopen(filename, "r");
+    assert(fp);
+    while (fgets(line, 255, fp) != NULL) {
+        if (strstr(line, "\"deeplearn_feed_forward\": {\"calls\": 110,"))
+            found = 1;
+    }
+    fclose(fp);
+    assert(found == 1);
+
+    /* after a reset only later calls are counted */
+    deeplearn_metrics_reset();
+    deeplearn_feed_forward(&learner);
+    deeplearn_metrics_get_snapshot(snapshot);
+    assert(snapshot->metric[DEEPLEARN_METRIC_FEED_FORWARD].calls == 1);
+    assert(snapshot->metric[DEEPLEARN_METRIC_FEED_FORWARD_BATCH].calls == 0);
+    assert(snapshot->metric[DEEPLEARN_METRIC_FEED_FORWARD].max_ticks > 0);
+    assert(snapshot->metric[DEEPLEARN_METRIC_FEED_FORWARD_BATCH].max_ticks == 0);
+
+    /* nothing is counted when disabled */
+    deeplearn_metrics_enable(0);
+    deeplearn_feed_forward(&learner);
+    deeplearn_metrics_get_snapshot(snapshot);
+    assert(snapshot->metric[DEEPLEARN_METRIC_FEED_FORWARD].calls == 1);
+
+    free(snapshot);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+int run_tests_metrics()
+{
+    printf("\nRunning metrics tests\n");
+
+    test_metrics_counters();
+
+    printf("All metrics tests completed\n");
+    return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_perf.h"
+
+static void test_perf_phases()
+{
+    deeplearn learner;
+    int no_of_inputs=10;
+    int no_of_hiddens=16;
+    int hidden_layers=2;
+    int no_of_outputs=2;
+    float error_threshold[] = { 0.01f, 0.01f, 0.01f };
+    unsigned int random_seed = 123;
+    int img_width=16, img_depth=3, feature_width=4, no_of_features=4;
+    int layer_width=4;
+    float img[16*16*3];
+    float feature[4*4*4*3];
+    float feature_score[4];
+    float layer[4*4*4*3];
+    int available;
+    deeplearn_perf_phase phase;
+    FILE * fp;
+
+    printf("test_perf_phases...");
+
+    assert(deeplearn_init(&learner,
+                          no_of_inputs, no_of_hiddens,
+                          hidden_layers,
+                          no_of_outputs,
+                          error_threshold,
+                          &random_seed) == 0);
+
+    COUNTDOWN(i, img_width*img_width*img_depth)
+        img[i] = (i%7)/7.0f;
+    COUNTDOWN(i, no_of_features*feature_width*feature_width*img_depth)
+        feature[i] = (i%5)/5.0f;
+
+    /* nothing is recorded until enabled */
+    deeplearn_perf_reset();
+    deeplearn_update(&learner);
+    deeplearn_perf_get_phase(DEEPLEARN_PERF_AUTOCODER_UPDATE, &phase);
+    assert(phase.calls == 0);
+
+    /* counters may not be permitted, in which case
+       only times and FLOPs are recorded */
+    available = deeplearn_perf_enable();
+    assert(available >= 0);
+    assert(available <= DEEPLEARN_PERF_COUNTERS);
+
+    deeplearn_update(&learner);
+    bp_update(learner.net, 0);
+    bp_update(learner.net, 0);
+    convolve_image(img, img_width, img_width, img_depth,
+                   feature_width, no_of_features, 1,
+                   feature, layer, layer_width);
+    learn_features(img, img_width, img_width, img_depth,
+                   feature_width, no_of_features,
+                   feature, feature_score, 10, 0.1f, &random_seed);
+
+    deeplearn_perf_get_phase(DEEPLEARN_PERF_AUTOCODER_UPDATE, &phase);
+    assert(phase.calls == 1);
+    assert(phase.flops > 0);
+
+    deeplearn_perf_get_phase(DEEPLEARN_PERF_BP_UPDATE, &phase);
+    assert(phase.calls == 2);
+    assert(phase.flops > 0);
+    assert(phase.ns > 0);
+    if (deeplearn_perf_counter_available(DEEPLEARN_PERF_INSTRUCTIONS))
+        assert(phase.counter[DEEPLEARN_PERF_INSTRUCTIONS] > 0);
+    else
+        assert(phase.counter[DEEPLEARN_PERF_INSTRUCTIONS] == 0);
+
+    deeplearn_perf_get_phase(DEEPLEARN_PERF_CONVOLVE_IMAGE, &phase);
+    assert(phase.calls == 1);
+    assert(phase.flops == (uint64_t)layer_width*layer_width*no_of_features*
+           feature_width*feature_width*img_depth*2);
+
+    deeplearn_perf_get_phase(DEEPLEARN_PERF_LEARN_FEATURES, &phase);
+    assert(phase.calls == 1);
+
+    /* phases outside of the range are ignored */
+    deeplearn_perf_begin(-1);
+    deeplearn_perf_end(-1, 100);
+    deeplearn_perf_begin(DEEPLEARN_PERF_PHASES);
+    deeplearn_perf_end(DEEPLEARN_PERF_PHASES, 100);
+    deeplearn_perf_get_phase(DEEPLEARN_PERF_PHASES, &phase);
+    assert(phase.calls == 0);
+    assert(phase.flops == 0);
+
+    /* the report can always be produced */
+    deeplearn_perf_set_roofline(100.0, 10.0);
+    fp = fopen("/tmp/libdeep_perf.txt", "w");
+    assert(fp);
+    assert(deeplearn_perf_report(fp) == 0);
+    fclose(fp);
+
+    /* measurement stops when disabled */
+    deeplearn_perf_disable();
+    bp_update(learner.net, 0);
+    deeplearn_perf_get_phase(DEEPLEARN_PERF_BP_UPDATE, &phase);
+    assert(phase.calls == 2);
+
+    deeplearn_perf_reset();
+    deeplearn_perf_get_phase(DEEPLEARN_PERF_BP_UPDATE, &phase);
+    assert(phase.calls == 0);
+    assert(phase.ns == 0);
+
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+int run_tests_perf()
+{
+    printf("\nRunning perf tests\n");
+
+    test_perf_phases();
+
+    printf("All perf tests completed\n");
+    return 0;
+}
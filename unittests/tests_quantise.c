@@ -0,0 +1,217 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_quantise.h"
+
+static void test_quantise_half()
+{
+    float values[] = { 0.0f, 1.0f, 0.5f, 0.333333f, 0.001f, -2.75f };
+
+    printf("test_quantise_half...");
+
+    for (int i = 0; i < 6; i++) {
+        float value = deeplearndata_half_to_float(
+            deeplearndata_float_to_half(values[i]));
+        /* eleven significant bits */
+        assert(fabs(value - values[i]) <= fabs(values[i])/2048.0f);
+    }
+
+    assert(deeplearndata_float_to_half(1.0f) == 0x3c00);
+    assert(deeplearndata_float_to_half(65504.0f) == 0x7bff);
+    assert(deeplearndata_float_to_half(1000000.0f) == 0x7c00);
+    assert(deeplearndata_half_to_float(0x7bff) == 65504.0f);
+
+    /* the smallest subnormal value */
+    assert(deeplearndata_float_to_half(0.0000000596046f) == 0x0001);
+    assert(deeplearndata_half_to_float(0x0001) == 1.0f/16777216.0f);
+    assert(deeplearndata_float_to_half(0.00000001f) == 0);
+
+    assert(deeplearndata_store_bytes(DEEPLEARNDATA_STORE_FLOAT32) == 4);
+    assert(deeplearndata_store_bytes(DEEPLEARNDATA_STORE_FLOAT16) == 2);
+    assert(deeplearndata_store_bytes(DEEPLEARNDATA_STORE_UINT8) == 1);
+    assert(deeplearndata_store_bytes(99) < 0);
+
+    printf("Ok\n");
+}
+
+/**
+ * @brief Presents every sample to the network and stores the values of
+ *        the input units
+ */
+static void quantise_network_inputs(deeplearn * learner, float inputs[])
+{
+    int n = learner->net->no_of_inputs;
+
+    for (int s = 0; s < learner->indexed_data_samples; s++) {
+        deeplearn_set_inputs(learner, deeplearndata_get(learner, s));
+        for (int i = 0; i < n; i++)
+            inputs[s*n + i] = bp_get_input(learner->net, i);
+    }
+}
+
+static void test_quantise_storage()
+{
+    deeplearn learner;
+    int output_field_index[] = { 3 };
+    float error_threshold[] = { 5.0f, 5.0f, 5.0f };
+    unsigned int random_seed = 771;
+    char * csv_filename = "/tmp/libdeep_quantise.csv";
+    char * cache_filename = "/tmp/libdeep_quantise.csv.ldc";
+    float * original, * inputs, * fields;
+    float range;
+    size_t memory;
+    int samples, n;
+    FILE * fp;
+
+    printf("test_quantise_storage...");
+
+    fp = fopen(csv_filename, "w");
+    assert(fp);
+    for (int i = 0; i < 200; i++)
+        fprintf(fp, "%f,%s,%f,%f\n", (i%37)*13.7f - 100.0f,
+                (i%3 == 0 ? "north" : "south"), (i%11)*0.01f,
+                (float)(i%2));
+    fclose(fp);
+
+    samples = deeplearndata_read_csv(csv_filename, &learner, 8, 2,
+                                     1, output_field_index, 0,
+                                     error_threshold, &random_seed);
+    assert(samples == 200);
+    n = learner.net->no_of_inputs;
+    original = (float*)malloc(samples*n*sizeof(float));
+    inputs = (float*)malloc(samples*n*sizeof(float));
+    fields = (float*)malloc(learner.no_of_input_fields*sizeof(float));
+    assert(original && inputs && fields);
+
+    quantise_network_inputs(&learner, original);
+    memory = deeplearn_get_memory(&learner);
+    assert(learner.input_storage == DEEPLEARNDATA_STORE_FLOAT32);
+    assert(deeplearndata_set_input_storage(&learner, 99) != 0);
+
+    /* eight bits per value */
+    assert(deeplearndata_set_input_storage(&learner,
+                                           DEEPLEARNDATA_STORE_UINT8) == 0);
+    assert(learner.input_storage == DEEPLEARNDATA_STORE_UINT8);
+    assert(learner.inputs_quantised_bytes ==
+           (size_t)samples*learner.no_of_input_fields);
+    assert(deeplearndata_get(&learner, 0)->inputs == 0);
+    assert(deeplearn_get_memory(&learner) <
+           memory - (size_t)samples*learner.no_of_input_fields*2);
+
+    quantise_network_inputs(&learner, inputs);
+    for (int i = 0; i < samples*n; i++)
+        assert(fabs(inputs[i] - original[i]) <= NEURON_RANGE/510.0f + 0.0001f);
+
+    range = learner.input_range_max[0] - learner.input_range_min[0];
+    for (int s = 0; s < samples; s++) {
+        deeplearndata * sample = deeplearndata_get(&learner, s);
+        int row = (int)((deeplearndata_get_input(&learner, sample, 0) +
+                         100.0f)/13.7f + 0.5f);
+        assert(fabs(deeplearndata_get_input(&learner, sample, 0) -
+                    (row*13.7f - 100.0f)) <= range/510.0f + 0.001f);
+    }
+
+    /* ranges can't change while the inputs are quantised */
+    assert(deeplearndata_stream_init(&learner, 20, 0) != 0);
+    assert(learner.stream == 0);
+
+    /* training and saving use the quantised values */
+    learner.history.interval = 1000000;
+    for (int t = 0; t < 20; t++)
+        assert(deeplearndata_training(&learner) > 0);
+    assert(deeplearndata_cache_save(cache_filename, csv_filename, &learner,
+                                    1, output_field_index, 0, 771) == 0);
+
+    /* converting from one quantised format to another would compound
+       their errors, so start again from the parsed values */
+    deeplearn_free(&learner);
+    random_seed = 771;
+    assert(deeplearndata_read_csv(csv_filename, &learner, 8, 2,
+                                  1, output_field_index, 0,
+                                  error_threshold, &random_seed) == samples);
+
+    /* half precision is closer to the original values */
+    assert(deeplearndata_set_input_storage(&learner,
+                                           DEEPLEARNDATA_STORE_FLOAT16) == 0);
+    assert(learner.inputs_quantised_bytes ==
+           (size_t)samples*learner.no_of_input_fields*2);
+    quantise_network_inputs(&learner, inputs);
+    for (int i = 0; i < samples*n; i++)
+        assert(fabs(inputs[i] - original[i]) <= NEURON_RANGE/2048.0f + 0.0001f);
+
+    /* and back to single precision */
+    assert(deeplearndata_set_input_storage(&learner,
+                                           DEEPLEARNDATA_STORE_FLOAT32) == 0);
+    assert(learner.inputs_quantised == 0);
+    assert(learner.inputs_quantised_bytes == 0);
+    for (int s = 0; s < samples; s++) {
+        deeplearndata * sample = deeplearndata_get(&learner, s);
+        assert(sample->inputs != 0);
+        assert(sample->inputs_quantised == 0);
+        deeplearndata_get_inputs(&learner, sample, fields);
+        assert(fields[0] == sample->inputs[0]);
+    }
+    quantise_network_inputs(&learner, inputs);
+    for (int i = 0; i < samples*n; i++)
+        assert(fabs(inputs[i] - original[i]) <= NEURON_RANGE/2048.0f + 0.0001f);
+    assert(deeplearndata_stream_init(&learner, 20, 0) == 0);
+    assert(deeplearndata_set_input_storage(&learner,
+                                           DEEPLEARNDATA_STORE_UINT8) != 0);
+    deeplearn_free(&learner);
+
+    /* the cache contains the values the quantised inputs represent */
+    random_seed = 771;
+    assert(deeplearndata_cache_load(cache_filename, csv_filename, &learner,
+                                    8, 2, 1, output_field_index, 0,
+                                    error_threshold, &random_seed) == samples);
+    assert(learner.input_storage == DEEPLEARNDATA_STORE_FLOAT32);
+    quantise_network_inputs(&learner, inputs);
+    for (int i = 0; i < samples*n; i++)
+        assert(fabs(inputs[i] - original[i]) <= NEURON_RANGE/510.0f + 0.0001f);
+    deeplearn_free(&learner);
+
+    free(original);
+    free(inputs);
+    free(fields);
+    remove(cache_filename);
+    remove(csv_filename);
+
+    printf("Ok\n");
+}
+
+int run_tests_quantise()
+{
+    printf("\nRunning quantise tests\n");
+
+    test_quantise_half();
+    test_quantise_storage();
+
+    printf("All quantise tests completed\n");
+    return 1;
+}
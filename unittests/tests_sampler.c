@@ -0,0 +1,201 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_sampler.h"
+
+static void test_sampler_proportional()
+{
+    deeplearn_sampler sampler;
+    int no_of_samples = 5;
+    int count[5], i, t;
+    unsigned int random_seed = 123;
+    float loss[] = { 0.0f, 0.1f, 0.2f, 0.3f, 1.0f };
+    float total = 0;
+
+    printf("test_sampler_proportional...");
+
+    assert(deeplearn_sampler_init(&sampler, no_of_samples, 1.0f, 1.0f) == 0);
+    assert(sampler.leaves == 8);
+
+    /* samples which have not been seen have equal priority */
+    for (i = 0; i < no_of_samples; i++) {
+        assert(deeplearn_sampler_priority(&sampler, i) == 1.0f);
+        assert(deeplearn_sampler_weight(&sampler, i) == 1.0f);
+    }
+
+    assert(deeplearn_sampler_update(&sampler, no_of_samples, 1.0f) != 0);
+    for (i = 0; i < no_of_samples; i++) {
+        assert(deeplearn_sampler_update(&sampler, i, loss[i]) == 0);
+        total += loss[i] + DEEPLEARN_SAMPLER_EPSILON;
+        count[i] = 0;
+    }
+    assert(fabs(sampler.sum_tree[1] - total) < 0.0001f);
+
+    for (t = 0; t < 100000; t++) {
+        i = deeplearn_sampler_sample(&sampler, &random_seed);
+        assert((i >= 0) && (i < no_of_samples));
+        count[i]++;
+    }
+
+    /* samples are drawn in proportion to their loss */
+    for (i = 0; i < no_of_samples; i++) {
+        float expected = (loss[i] + DEEPLEARN_SAMPLER_EPSILON)/total;
+        assert(fabs(count[i]/100000.0f - expected) < 0.01f);
+    }
+
+    /* the sample with the lowest priority has the largest weight */
+    assert(fabs(deeplearn_sampler_weight(&sampler, 0) - 1.0f) < 0.0001f);
+    assert(deeplearn_sampler_weight(&sampler, 4) <
+           deeplearn_sampler_weight(&sampler, 3));
+
+    deeplearn_sampler_free(&sampler);
+
+    printf("Ok\n");
+}
+
+static void test_sampler_weights()
+{
+    deeplearn_sampler sampler;
+    int no_of_samples = 4;
+    int count[4], i, t;
+    unsigned int random_seed = 456;
+    float weight[] = { 1.0f, 2.0f, 3.0f, 4.0f };
+
+    printf("test_sampler_weights...");
+
+    assert(deeplearn_sampler_init(&sampler, no_of_samples, 1.0f, 1.0f) == 0);
+    assert(sampler.weight == 0);
+
+    /* a weight of one doesn't need any storage */
+    assert(deeplearn_sampler_set_weight(&sampler, 0, 1.0f) == 0);
+    assert(sampler.weight == 0);
+    assert(deeplearn_sampler_set_weight(&sampler, 0, 0) != 0);
+    assert(deeplearn_sampler_set_weight(&sampler, no_of_samples, 1.0f) != 0);
+
+    for (i = 0; i < no_of_samples; i++) {
+        assert(deeplearn_sampler_set_weight(&sampler, i, weight[i]) == 0);
+        count[i] = 0;
+    }
+    assert(sampler.weight != 0);
+    assert(fabs(sampler.sum_tree[1] - 10.0f) < 0.0001f);
+
+    for (t = 0; t < 100000; t++)
+        count[deeplearn_sampler_sample(&sampler, &random_seed)]++;
+
+    /* with equal priorities samples are drawn in proportion to their
+       weight, which needs no correction */
+    for (i = 0; i < no_of_samples; i++) {
+        assert(fabs(count[i]/100000.0f - weight[i]/10.0f) < 0.01f);
+        assert(deeplearn_sampler_priority(&sampler, i) == 1.0f);
+        assert(fabs(deeplearn_sampler_weight(&sampler, i) - 1.0f) < 0.0001f);
+    }
+
+    /* the weight is kept when the priority changes */
+    assert(deeplearn_sampler_update(&sampler, 3, 1.0f) == 0);
+    assert(fabs(sampler.sum_tree[sampler.leaves + 3] -
+                4.0f*deeplearn_sampler_priority(&sampler, 3)) < 0.0001f);
+
+    deeplearn_sampler_free(&sampler);
+    assert(sampler.weight == 0);
+
+    printf("Ok\n");
+}
+
+static void test_sampler_training()
+{
+    deeplearn learner;
+    int no_of_hiddens=16;
+    int hidden_layers=2;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 2 };
+    float error_threshold_percent[] = { 1.6f, 1.6f, 3.0f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_sampler.csv";
+    int changed = 0;
+    FILE * fp;
+
+    printf("test_sampler_training...");
+
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    for (int i = 0; i < 40; i++)
+        fprintf(fp,"%f,%f,%f\n",(i%7)*0.5f,(i%3)*2.0f,(i%10 == 0 ? 1.0 : 0.0));
+    fclose(fp);
+
+    deeplearndata_read_csv(csv_filename,
+                           &learner,
+                           no_of_hiddens, hidden_layers,
+                           no_of_outputs,
+                           output_field_index, 0,
+                           error_threshold_percent,
+                           &random_seed);
+
+    assert(deeplearn_set_prioritised_sampling(&learner,
+                                              DEEPLEARN_SAMPLER_ALPHA,
+                                              DEEPLEARN_SAMPLER_BETA) == 0);
+
+    /* don't plot the training history */
+    learner.history.interval = 1000000;
+
+    /* go straight to the final training stage */
+    learner.current_hidden_layer = hidden_layers;
+    for (int t = 0; t < 200; t++)
+        assert(deeplearndata_training(&learner) == 2);
+
+    assert(learner.sampler->no_of_samples ==
+           learner.training_data_labeled_samples);
+
+    /* priorities now reflect the loss of the samples which were drawn */
+    for (int i = 0; i < learner.sampler->no_of_samples; i++) {
+        if (deeplearn_sampler_priority(learner.sampler, i) != 1.0f)
+            changed++;
+    }
+    assert(changed > 0);
+
+    /* uniform sampling again */
+    assert(deeplearn_set_prioritised_sampling(&learner, 0, 0) == 0);
+    assert(learner.sampler == 0);
+    assert(deeplearndata_training(&learner) == 2);
+
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+int run_tests_sampler()
+{
+    printf("\nRunning sampler tests\n");
+
+    test_sampler_proportional();
+    test_sampler_weights();
+    test_sampler_training();
+
+    printf("All sampler tests completed\n");
+    return 0;
+}
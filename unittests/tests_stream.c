@@ -0,0 +1,205 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_stream.h"
+
+static int renormalise_calls[2];
+
+static void stream_renormalise(deeplearn * learner, int type, int index,
+                               float previous_min, float previous_max,
+                               void * user_data)
+{
+    assert(user_data == (void*)renormalise_calls);
+    assert((type == DEEPLEARNDATA_STREAM_INPUT) ||
+           (type == DEEPLEARNDATA_STREAM_OUTPUT));
+    if (type == DEEPLEARNDATA_STREAM_INPUT)
+        assert((learner->input_range_min[index] < previous_min) ||
+               (learner->input_range_max[index] > previous_max));
+    else
+        assert((learner->output_range_min[index] < previous_min) ||
+               (learner->output_range_max[index] > previous_max));
+    renormalise_calls[type]++;
+}
+
+static void test_stream_append()
+{
+    deeplearn learner;
+    float error_threshold[] = { 1.0f, 1.0f, 1.0f };
+    unsigned int random_seed = 672;
+    float inputs[3], outputs[1];
+    int training = 0, test = 0, unlabeled = 0, i, retval;
+    unsigned int model_version;
+    deeplearndata * sample;
+
+    printf("test_stream_append...");
+
+    assert(deeplearn_init(&learner, 3, 6, 2, 1,
+                          error_threshold, &random_seed) == 0);
+    assert(deeplearndata_stream_init(&learner, 101, 0) != 0);
+    assert(deeplearndata_stream_init(&learner, 25, 7) == 0);
+    assert(learner.no_of_input_fields == 3);
+    assert(learner.field_length[0] == 0);
+    deeplearndata_stream_set_renormalise(&learner, stream_renormalise,
+                                         (void*)renormalise_calls);
+
+    for (i = 0; i < 1000; i++) {
+        inputs[0] = i;
+        inputs[1] = (i%10)*0.1f;
+        inputs[2] = -i*0.5f;
+        outputs[0] = (i%13 == 0) ? DEEPLEARN_UNKNOWN_VALUE : (i%3);
+        if (i%13 == 0)
+            unlabeled++;
+
+        model_version = learner.model_version;
+        retval = deeplearndata_stream_append(&learner, inputs, 0, outputs);
+        if (retval == DEEPLEARNDATA_STREAM_TEST) {
+            assert(outputs[0] != DEEPLEARN_UNKNOWN_VALUE);
+            test++;
+        }
+        else {
+            assert(retval == DEEPLEARNDATA_STREAM_TRAINING);
+            training++;
+        }
+
+        /* the first input extends its range with every sample */
+        assert(learner.input_range_max[0] == i);
+        assert(learner.model_version > model_version);
+    }
+
+    assert(learner.data_samples == 1000);
+    assert(learner.indexed_data_samples == 1000);
+    assert(learner.training_data_samples == training);
+    assert(learner.indexed_training_data_samples == training);
+    assert(learner.training_data_labeled_samples == training - unlabeled);
+    assert(learner.indexed_training_data_labeled_samples ==
+           training - unlabeled);
+    assert(learner.test_data_samples == test);
+    assert(learner.indexed_test_data_samples == test);
+    assert((test > 180) && (test < 290));
+
+    /* samples are in the order in which they were appended */
+    sample = learner.data;
+    for (i = 0; i < 1000; i++) {
+        assert(sample != 0);
+        assert(sample->inputs[0] == i);
+        assert(deeplearndata_get(&learner, i) == sample);
+        if (sample->labeled == 0)
+            assert(sample->flags == 1);
+        sample = sample->next;
+    }
+    assert(sample == 0);
+
+    for (i = 0; i < test; i++)
+        assert(deeplearndata_get_test(&learner, i)->labeled != 0);
+    for (i = 0; i < learner.indexed_training_data_labeled_samples; i++)
+        assert(deeplearndata_get_training_labeled(&learner, i)->flags == 1);
+
+    /* ranges */
+    assert(learner.input_range_min[0] == 0);
+    assert(fabs(learner.input_range_max[1] - 0.9f) < 0.0001f);
+    assert(learner.input_range_min[2] == -999*0.5f);
+    assert(learner.output_range_min[0] == 0);
+    assert(learner.output_range_max[0] == 2);
+    assert(renormalise_calls[DEEPLEARNDATA_STREAM_INPUT] > 1000);
+    assert(renormalise_calls[DEEPLEARNDATA_STREAM_OUTPUT] >= 2);
+
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_stream_training()
+{
+    deeplearn learner;
+    int output_field_index[] = { 2 };
+    float error_threshold[] = { 1.0f, 1.0f, 1.0f };
+    unsigned int random_seed = 672;
+    char * csv_filename = "/tmp/libdeep_stream.csv";
+    float inputs[2], outputs[1];
+    int samples;
+    FILE * fp;
+
+    printf("test_stream_training...");
+
+    fp = fopen(csv_filename, "w");
+    assert(fp);
+    for (int i = 0; i < 40; i++)
+        fprintf(fp, "%f,%f,%f\n", (i%7)*0.5f, (i%3)*2.0f, (i%2)*1.0f);
+    fclose(fp);
+
+    assert(deeplearndata_read_csv(csv_filename, &learner, 8, 2,
+                                  1, output_field_index, 0,
+                                  error_threshold, &random_seed) == 40);
+    learner.history.interval = 1000000;
+    assert(deeplearndata_stream_init(&learner, 20, 16) == 0);
+
+    /* new samples arrive while training */
+    for (int i = 0; i < 200; i++) {
+        inputs[0] = (i%9)*0.5f;
+        inputs[1] = (i%3)*2.0f;
+        outputs[0] = (i%2)*1.0f;
+        assert(deeplearndata_stream_append(&learner, inputs,
+                                           0, outputs) >= 0);
+        assert(deeplearndata_training(&learner) >= 0);
+    }
+    assert(learner.data_samples == 240);
+    assert(learner.input_range_max[0] == 4.0f);
+
+    /* the data set can be split again, after which appending continues */
+    assert(deeplearndata_create_datasets(&learner, 20) == 0);
+    samples = learner.indexed_training_data_samples +
+        learner.indexed_test_data_samples;
+    for (int i = 0; i < 50; i++) {
+        inputs[0] = i*0.1f;
+        inputs[1] = 2.0f;
+        outputs[0] = 1.0f;
+        assert(deeplearndata_stream_append(&learner, inputs,
+                                           0, outputs) >= 0);
+    }
+    assert(learner.indexed_training_data_samples +
+           learner.indexed_test_data_samples == samples + 50);
+    assert(deeplearndata_get(&learner, 289)->inputs[0] == 49*0.1f);
+    assert(deeplearndata_training(&learner) >= 0);
+
+    deeplearn_free(&learner);
+    remove(csv_filename);
+
+    printf("Ok\n");
+}
+
+int run_tests_stream()
+{
+    printf("\nRunning stream tests\n");
+
+    test_stream_append();
+    test_stream_training();
+
+    printf("All stream tests completed\n");
+    return 1;
+}
@@ -0,0 +1,130 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_trace.h"
+
+static void * test_trace_thread(void * arg)
+{
+    deeplearn * learner = (deeplearn*)arg;
+
+    deeplearn_feed_forward(learner);
+    return NULL;
+}
+
+static void test_trace_events()
+{
+    deeplearn learner;
+    int no_of_inputs=10;
+    int no_of_hiddens=16;
+    int hidden_layers=2;
+    int no_of_outputs=2;
+    float error_threshold[] = { 0.01f, 0.01f, 0.01f };
+    unsigned int random_seed = 123;
+    char * trace_filename = "/tmp/libdeep_trace.json";
+    char * model_filename = "/tmp/libdeep_trace.net";
+    char line[512];
+    int begin = 0, end = 0, found_save = 0, found_pretrain = 0;
+    int found_learn = 0, found_thread = 0;
+    pthread_t thread;
+    FILE * fp;
+
+    printf("test_trace_events...");
+
+    assert(deeplearn_init(&learner,
+                          no_of_inputs, no_of_hiddens,
+                          hidden_layers,
+                          no_of_outputs,
+                          error_threshold,
+                          &random_seed) == 0);
+
+    /* nothing is recorded before the trace starts */
+    deeplearn_trace_begin("test");
+    deeplearn_trace_end("test");
+    assert(deeplearn_trace_enabled() == 0);
+    assert(deeplearn_trace_stop() != 0);
+
+    assert(deeplearn_trace_start(trace_filename) == 0);
+    assert(deeplearn_trace_enabled() != 0);
+    assert(deeplearn_trace_start(trace_filename) != 0);
+
+    deeplearn_feed_forward(&learner);
+    deeplearn_update(&learner);
+
+    learner.current_hidden_layer = hidden_layers;
+    deeplearn_update(&learner);
+
+    fp = fopen(model_filename, "wb");
+    assert(fp);
+    assert(deeplearn_save(fp, &learner) == 0);
+    fclose(fp);
+
+    assert(pthread_create(&thread, NULL, test_trace_thread, &learner) == 0);
+    pthread_join(thread, NULL);
+
+    assert(deeplearn_trace_stop() == 0);
+    assert(deeplearn_trace_enabled() == 0);
+
+    fp = fopen(trace_filename, "r");
+    assert(fp);
+    assert(fgets(line, 511, fp) != NULL);
+    assert(strstr(line, "traceEvents") != NULL);
+    while (fgets(line, 511, fp) != NULL) {
+        if (strstr(line, "\"ph\":\"B\"")) begin++;
+        if (strstr(line, "\"ph\":\"E\"")) end++;
+        if (strstr(line, "\"name\":\"test\"")) assert(0);
+        if (strstr(line, "\"name\":\"deeplearn_save\"")) found_save = 1;
+        if (strstr(line, "\"name\":\"bp_learn\"")) found_learn = 1;
+        if (strstr(line, "\"name\":\"deeplearn_pretrain\"") &&
+            strstr(line, "\"args\":{\"layer\":0}"))
+            found_pretrain = 1;
+        if (strstr(line, "\"tid\":2")) found_thread = 1;
+    }
+    fclose(fp);
+
+    assert(begin > 0);
+    assert(begin == end);
+    assert(found_save == 1);
+    assert(found_learn == 1);
+    assert(found_pretrain == 1);
+    assert(found_thread == 1);
+
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+int run_tests_trace()
+{
+    printf("\nRunning trace tests\n");
+
+    test_trace_events();
+
+    printf("All trace tests completed\n");
+    return 0;
+}
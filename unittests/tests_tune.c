@@ -0,0 +1,256 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2015-2017  Bob Mottram <bob@freedombone.net>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_tune.h"
+
+static void random_values(float * values, int n, unsigned int * random_seed)
+{
+    for (int i = 0; i < n; i++)
+        values[i] = (rand_num(random_seed)%10000)/10000.0f;
+}
+
+/* writes a tuning file which selects the given algorithm
+   for a convolution */
+static void write_tune_file(char * filename, char * cpu,
+                            int shape[], int algorithm, int tasks)
+{
+    FILE * fp = fopen(filename, "w");
+
+    assert(fp);
+    fprintf(fp, "libdeep tune\n");
+    fprintf(fp, "cpu %s\n", cpu);
+    fprintf(fp, "convolve_image %d %d %d %d %d %d %d %d\n",
+            shape[0], shape[1], shape[2], shape[3], shape[4], shape[5],
+            algorithm, tasks);
+    fclose(fp);
+}
+
+static void test_tune_summed_area()
+{
+    char * filename = "/tmp/libdeep_tune.txt";
+    char cpu[DEEPLEARN_TUNE_MAX_CPU];
+    int img_width = 20, img_height = 16, feature_width = 5;
+    int no_of_features = 4, layer_width = 8;
+    unsigned int random_seed = 8352;
+    deeplearn_tune_choice choice;
+    float img[20*16*3], feature[4*5*5*3];
+    float direct[8*8*4*3], summed[8*8*4*3];
+
+    printf("test_tune_summed_area...");
+
+    deeplearn_tune_cpu_model(cpu, DEEPLEARN_TUNE_MAX_CPU);
+    assert(strlen(cpu) > 0);
+
+    for (int depth = 1; depth <= 3; depth += 2) {
+        for (int pooling_factor = 1; pooling_factor <= 2; pooling_factor++) {
+            int size = layer_width*layer_width*no_of_features*depth;
+            int shape[DEEPLEARN_TUNE_SHAPE] = {
+                img_width, img_height, depth, feature_width,
+                no_of_features, layer_width*pooling_factor
+            };
+
+            random_values(img, img_width*img_height*depth, &random_seed);
+            random_values(feature, no_of_features*feature_width*
+                          feature_width*depth, &random_seed);
+
+            deeplearn_tune_disable();
+            convolve_image(img, img_width, img_height, depth,
+                           feature_width, no_of_features, pooling_factor,
+                           feature, direct, layer_width);
+
+            /* the same convolution using summed area tables */
+            write_tune_file(filename, cpu, shape,
+                            DEEPLEARN_TUNE_SUMMED_AREA, 2);
+            deeplearn_tune_clear();
+            assert(deeplearn_tune_enable(filename) == 0);
+            assert(deeplearn_tune_get(DEEPLEARN_TUNE_CONVOLVE,
+                                      shape, &choice) == 0);
+            assert(choice.algorithm == DEEPLEARN_TUNE_SUMMED_AREA);
+            assert(choice.tasks == 2);
+
+            convolve_image(img, img_width, img_height, depth,
+                           feature_width, no_of_features, pooling_factor,
+                           feature, summed, layer_width);
+
+            for (int i = 0; i < size; i++)
+                assert(fabs(summed[i] - direct[i]) < 0.0001f);
+        }
+    }
+
+    /* decisions made on a different cpu are ignored */
+    int shape[DEEPLEARN_TUNE_SHAPE] = { 1, 2, 3, 4, 5, 6 };
+    write_tune_file(filename, "some other cpu", shape,
+                    DEEPLEARN_TUNE_SUMMED_AREA, 2);
+    deeplearn_tune_clear();
+    assert(deeplearn_tune_load(filename) == -3);
+    assert(deeplearn_tune_get(DEEPLEARN_TUNE_CONVOLVE,
+                              shape, &choice) != 0);
+
+    deeplearn_tune_disable();
+    deeplearn_tune_clear();
+    remove(filename);
+
+    printf("Ok\n");
+}
+
+static void test_tune_decide()
+{
+    char * filename = "/tmp/libdeep_tune.txt";
+    deeplearn_tune_choice candidate[DEEPLEARN_TUNE_MAX_CANDIDATES];
+    deeplearn_tune_choice choice, loaded;
+    int img_width = 24, img_height = 24, depth = 3, feature_width = 5;
+    int no_of_features = 4, layer_width = 10;
+    unsigned int random_seed = 5312;
+    float img[24*24*3], feature[4*5*5*3];
+    float layer[10*10*4*3];
+    int no_of_candidates;
+    int shape[DEEPLEARN_TUNE_SHAPE] = {
+        img_width, img_height, depth, feature_width,
+        no_of_features, layer_width
+    };
+
+    printf("test_tune_decide...");
+
+    remove(filename);
+    random_values(img, img_width*img_height*depth, &random_seed);
+    random_values(feature, no_of_features*feature_width*
+                  feature_width*depth, &random_seed);
+
+    no_of_candidates =
+        deeplearn_tune_candidates(DEEPLEARN_TUNE_CONVOLVE, candidate);
+    assert(no_of_candidates > 2);
+    assert(no_of_candidates <= DEEPLEARN_TUNE_MAX_CANDIDATES);
+
+    deeplearn_tune_clear();
+    assert(deeplearn_tune_enable(filename) == 0);
+    assert(deeplearn_tune_enabled());
+
+    /* each candidate is timed a few times before deciding */
+    for (int i = 0; i < no_of_candidates*DEEPLEARN_TUNE_TRIALS; i++) {
+        assert(deeplearn_tune_get(DEEPLEARN_TUNE_CONVOLVE,
+                                  shape, &choice) != 0);
+        convolve_image(img, img_width, img_height, depth,
+                       feature_width, no_of_features, 1,
+                       feature, layer, layer_width);
+    }
+    assert(deeplearn_tune_get(DEEPLEARN_TUNE_CONVOLVE,
+                              shape, &choice) == 0);
+    assert(choice.tasks > 0);
+
+    /* the decision was saved and can be loaded again */
+    deeplearn_tune_disable();
+    deeplearn_tune_clear();
+    assert(deeplearn_tune_get(DEEPLEARN_TUNE_CONVOLVE,
+                              shape, &loaded) != 0);
+    assert(deeplearn_tune_load(filename) == 0);
+    assert(deeplearn_tune_get(DEEPLEARN_TUNE_CONVOLVE,
+                              shape, &loaded) == 0);
+    assert(loaded.algorithm == choice.algorithm);
+    assert(loaded.tasks == choice.tasks);
+
+    deeplearn_tune_clear();
+    remove(filename);
+
+    printf("Ok\n");
+}
+
+static void test_tune_training()
+{
+    bp net1, net2;
+    int no_of_inputs = 10, no_of_outputs = 3;
+    unsigned int random_seed1 = 123, random_seed2 = 123;
+    float features1[16*3*3], features2[16*3*3];
+    float score_features[16];
+    float img[32*32];
+
+    printf("test_tune_training...");
+
+    /* feed forward gives the same result with any number of tasks */
+    assert(bp_init(&net1, no_of_inputs, 8, 2, no_of_outputs,
+                   &random_seed1) == 0);
+    assert(bp_init(&net2, no_of_inputs, 8, 2, no_of_outputs,
+                   &random_seed2) == 0);
+    net1.noise = 0;
+    net2.noise = 0;
+
+    deeplearn_tune_clear();
+    assert(deeplearn_tune_enable(NULL) == 0);
+    for (int t = 0; t < 50; t++) {
+        COUNTDOWN(i, no_of_inputs) {
+            float v = NEURON_LOW +
+                ((rand_num(&random_seed1)%10000)/10000.0f)*NEURON_RANGE;
+            bp_set_input(&net1, i, v);
+            bp_set_input(&net2, i, v);
+        }
+        deeplearn_tune_enable(NULL);
+        bp_feed_forward(&net1);
+        deeplearn_tune_disable();
+        bp_feed_forward(&net2);
+        COUNTDOWN(i, no_of_outputs)
+            assert(bp_get_output(&net1, i) == bp_get_output(&net2, i));
+    }
+
+    /* learning features gives the same result with any number of tasks */
+    random_values(img, 32*32, &random_seed1);
+    random_values(features1, 16*3*3, &random_seed1);
+    memcpy(features2, features1, 16*3*3*sizeof(float));
+    random_seed1 = 62;
+    random_seed2 = 62;
+    for (int t = 0; t < 50; t++) {
+        float score1, score2;
+
+        deeplearn_tune_enable(NULL);
+        score1 = learn_features(img, 32, 32, 1, 3, 16, features1,
+                                score_features, 10, 0.1f, &random_seed1);
+        deeplearn_tune_disable();
+        score2 = learn_features(img, 32, 32, 1, 3, 16, features2,
+                                score_features, 10, 0.1f, &random_seed2);
+        assert(score1 == score2);
+    }
+    for (int i = 0; i < 16*3*3; i++)
+        assert(features1[i] == features2[i]);
+
+    deeplearn_tune_clear();
+    bp_free(&net1);
+    bp_free(&net2);
+
+    printf("Ok\n");
+}
+
+int run_tests_tune()
+{
+    printf("\nRunning tune tests\n");
+
+    test_tune_summed_area();
+    test_tune_decide();
+    test_tune_training();
+
+    printf("All tune tests completed\n");
+    return 0;
+}